@@ -0,0 +1,735 @@
+/* bench-corpus.c - Runs the codegen corpus under each backend and profile */
+
+/*
+ * Every bench/corpus/NAME.c is run with
+ *
+ *   crispy --no-config [BACKEND ARGS] --repeat N --profiles PROFILE \
+ *          --bench-json FILE NAME.c
+ *
+ * once per backend and profile.  Its stdout must be NAME.expected once
+ * per run, so a profile that changes results fails instead of looking
+ * fast.  The medians crispy writes to FILE are collected into a table
+ * per script and a geometric-mean summary relative to the first
+ * backend and profile.
+ *
+ *   make bench-corpus
+ *   make bench-corpus BENCH_BACKENDS=default,mimalloc=--allocator=mimalloc
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <math.h>
+#include <string.h>
+
+typedef struct
+{
+    gchar  *name;
+    gchar **args;               /* extra crispy arguments, may be empty */
+} Backend;
+
+typedef struct
+{
+    gchar *name;
+    gchar *spec;                /* as passed to --profiles */
+} Profile;
+
+typedef struct
+{
+    const gchar *script;        /* not owned */
+    const gchar *backend;       /* not owned */
+    const gchar *profile;       /* not owned */
+    gboolean     ok;
+    gdouble      min_ms;
+    gdouble      median_ms;
+    gdouble      p95_ms;
+    gdouble      p99_ms;
+    gdouble      stddev_ms;
+} CorpusResult;
+
+static gchar   *opt_crispy   = NULL;
+static gchar   *opt_corpus   = NULL;
+static gchar   *opt_backends = NULL;
+static gchar   *opt_profiles = NULL;
+static gint     opt_runs     = 5;
+static gchar   *opt_json     = NULL;
+static gboolean opt_update   = FALSE;
+
+static GOptionEntry entries[] =
+{
+    { "crispy", 0, 0, G_OPTION_ARG_FILENAME, &opt_crispy,
+      "crispy executable to run the corpus with", "PATH" },
+    { "corpus", 0, 0, G_OPTION_ARG_FILENAME, &opt_corpus,
+      "Directory of NAME.c and NAME.expected (default bench/corpus)", "DIR" },
+    { "backends", 0, 0, G_OPTION_ARG_STRING, &opt_backends,
+      "Backends: default, isolate or NAME=CRISPY-ARGS (default default,isolate)",
+      "LIST" },
+    { "profiles", 0, 0, G_OPTION_ARG_STRING, &opt_profiles,
+      "Profiles for crispy --profiles (default debug,fast,O3,native)", "LIST" },
+    { "runs", 0, 0, G_OPTION_ARG_INT, &opt_runs,
+      "Runs per backend and profile (default 5)", "N" },
+    { "json", 0, 0, G_OPTION_ARG_FILENAME, &opt_json,
+      "Write the results as JSON to FILE (- for stdout)", "FILE" },
+    { "update", 0, 0, G_OPTION_ARG_NONE, &opt_update,
+      "Rewrite every NAME.expected from one plain run instead", NULL },
+    { NULL }
+};
+
+/* --- helper: "default", "isolate" or "NAME=ARGS" --- */
+static gboolean
+parse_backend(
+    const gchar  *spec,
+    Backend      *backend,
+    GError      **error
+){
+    const gchar *equals;
+
+    equals = strchr(spec, '=');
+    if (equals != NULL && equals != spec)
+    {
+        backend->name = g_strndup(spec, (gsize)(equals - spec));
+        if (equals[1] == '\0')
+            backend->args = g_new0(gchar *, 1);
+        else if (!g_shell_parse_argv(equals + 1, NULL, &backend->args, error))
+            return FALSE;
+        return TRUE;
+    }
+
+    if (strcmp(spec, "default") == 0)
+    {
+        backend->name = g_strdup(spec);
+        backend->args = g_new0(gchar *, 1);
+        return TRUE;
+    }
+
+    if (strcmp(spec, "isolate") == 0)
+    {
+        backend->name = g_strdup(spec);
+        backend->args = g_new0(gchar *, 2);
+        backend->args[0] = g_strdup("--isolate");
+        return TRUE;
+    }
+
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Unknown backend '%s' (expected default, isolate or "
+                "NAME=CRISPY-ARGS)", spec);
+    return FALSE;
+}
+
+static void
+clear_backend(
+    gpointer data
+){
+    Backend *backend = data;
+
+    g_free(backend->name);
+    g_strfreev(backend->args);
+}
+
+static void
+clear_profile(
+    gpointer data
+){
+    Profile *profile = data;
+
+    g_free(profile->name);
+    g_free(profile->spec);
+}
+
+static gint
+compare_names(
+    gconstpointer a,
+    gconstpointer b
+){
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+/* --- helper: remove a directory of files, as a cache dir is --- */
+static void
+remove_flat_dir(
+    const gchar *path
+){
+    GDir *dir;
+    const gchar *entry;
+
+    dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    while ((entry = g_dir_read_name(dir)) != NULL)
+    {
+        g_autofree gchar *file = NULL;
+
+        file = g_build_filename(path, entry, NULL);
+        g_unlink(file);
+    }
+
+    g_dir_close(dir);
+    g_rmdir(path);
+}
+
+/* --- helper: the NAME.c files of the corpus, sorted --- */
+static GPtrArray *
+list_scripts(
+    const gchar  *corpus,
+    GError      **error
+){
+    GPtrArray *scripts;
+    GDir *dir;
+    const gchar *entry;
+
+    dir = g_dir_open(corpus, 0, error);
+    if (dir == NULL)
+        return NULL;
+
+    scripts = g_ptr_array_new_with_free_func(g_free);
+    while ((entry = g_dir_read_name(dir)) != NULL)
+    {
+        if (g_str_has_suffix(entry, ".c"))
+            g_ptr_array_add(scripts, g_strndup(entry, strlen(entry) - 2));
+    }
+    g_dir_close(dir);
+
+    g_ptr_array_sort(scripts, compare_names);
+    return scripts;
+}
+
+/* --- helper: run crispy with @args, capturing stdout and stderr --- */
+static gboolean
+run_crispy(
+    GPtrArray    *args,
+    gchar       **out,
+    gchar       **err,
+    GError      **error
+){
+    g_autoptr(GSubprocessLauncher) launcher = NULL;
+    g_autoptr(GSubprocess) proc = NULL;
+
+    launcher = g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                         G_SUBPROCESS_FLAGS_STDERR_PIPE);
+    g_subprocess_launcher_unsetenv(launcher, "CRISPY_CONFIG_FILE");
+
+    g_ptr_array_add(args, NULL);
+    proc = g_subprocess_launcher_spawnv(launcher,
+                                        (const gchar * const *)args->pdata,
+                                        error);
+    g_ptr_array_remove_index(args, args->len - 1);
+    if (proc == NULL)
+        return FALSE;
+
+    if (!g_subprocess_communicate_utf8(proc, NULL, NULL, out, err, error))
+        return FALSE;
+
+    if (!g_subprocess_get_successful(proc))
+    {
+        g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                    "crispy exited with status %d:\n%s",
+                    g_subprocess_get_status(proc), *err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* --- helper: the number after "@key": on @line, in milliseconds --- */
+static gboolean
+read_json_us(
+    const gchar *line,
+    const gchar *key,
+    gdouble     *ms
+){
+    g_autofree gchar *needle = NULL;
+    const gchar *value;
+    gchar *end;
+
+    needle = g_strdup_printf("\"%s\": ", key);
+    value = strstr(line, needle);
+    if (value == NULL)
+        return FALSE;
+
+    value += strlen(needle);
+    *ms = g_ascii_strtod(value, &end) / 1000.0;
+    return end != value;
+}
+
+/*
+ * Reads the timings of the one profile in a file written by crispy
+ * --bench-json, which puts each profile on its own line.
+ */
+static gboolean
+parse_profile_json(
+    const gchar  *json,
+    CorpusResult *result
+){
+    g_auto(GStrv) lines = NULL;
+    guint i;
+
+    lines = g_strsplit(json, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (strstr(lines[i], "\"name\": ") == NULL)
+            continue;
+
+        return read_json_us(lines[i], "min_us", &result->min_ms) &&
+               read_json_us(lines[i], "median_us", &result->median_ms) &&
+               read_json_us(lines[i], "p95_us", &result->p95_ms) &&
+               read_json_us(lines[i], "p99_us", &result->p99_ms) &&
+               read_json_us(lines[i], "stddev_us", &result->stddev_ms);
+    }
+
+    return FALSE;
+}
+
+/* --- helper: does @out hold @expected exactly @times times? --- */
+static gboolean
+output_matches(
+    const gchar *out,
+    const gchar *expected,
+    guint        times
+){
+    gsize len;
+    guint i;
+
+    len = strlen(expected);
+    if (strlen(out) != len * times)
+        return FALSE;
+
+    for (i = 0; i < times; i++)
+    {
+        if (memcmp(out + i * len, expected, len) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * --- helper: one crispy run of @script per profile ---
+ *
+ * Each profile gets its own run, so its output is checked on its own
+ * and one miscompiled profile does not mark the others wrong.
+ */
+static gboolean
+run_script(
+    const gchar  *script,
+    const gchar  *source,
+    const gchar  *expected,
+    const gchar  *cache_dir,
+    const gchar  *json_path,
+    Backend      *backend,
+    GArray       *profiles,
+    GArray       *results,
+    GError      **error
+){
+    g_autofree gchar *runs = NULL;
+    CorpusResult result;
+    Profile *profile;
+    guint i;
+    guint j;
+
+    runs = g_strdup_printf("%d", opt_runs);
+
+    for (i = 0; i < profiles->len; i++)
+    {
+        g_autoptr(GPtrArray) args = NULL;
+        g_autofree gchar *out = NULL;
+        g_autofree gchar *err = NULL;
+        g_autofree gchar *json = NULL;
+
+        profile = &g_array_index(profiles, Profile, i);
+
+        args = g_ptr_array_new();
+        g_ptr_array_add(args, opt_crispy);
+        g_ptr_array_add(args, "--no-config");
+        g_ptr_array_add(args, "--cache-dir");
+        g_ptr_array_add(args, (gpointer)cache_dir);
+        for (j = 0; backend->args[j] != NULL; j++)
+            g_ptr_array_add(args, backend->args[j]);
+        g_ptr_array_add(args, "--repeat");
+        g_ptr_array_add(args, runs);
+        g_ptr_array_add(args, "--profiles");
+        g_ptr_array_add(args, profile->spec);
+        g_ptr_array_add(args, "--bench-json");
+        g_ptr_array_add(args, (gpointer)json_path);
+        g_ptr_array_add(args, (gpointer)source);
+
+        if (!run_crispy(args, &out, &err, error) ||
+            !g_file_get_contents(json_path, &json, NULL, error))
+        {
+            g_prefix_error(error, "profile '%s': ", profile->name);
+            return FALSE;
+        }
+
+        memset(&result, 0, sizeof(result));
+        result.script = script;
+        result.backend = backend->name;
+        result.profile = profile->name;
+        result.ok = output_matches(out, expected, (guint)opt_runs);
+        if (!parse_profile_json(json, &result))
+        {
+            g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                        "no timings for profile '%s' in:\n%s",
+                        profile->name, json);
+            return FALSE;
+        }
+        g_array_append_val(results, result);
+    }
+
+    return TRUE;
+}
+
+/* --- helper: write NAME.expected from one plain run --- */
+static gboolean
+update_expected(
+    const gchar  *source,
+    const gchar  *expected_path,
+    const gchar  *cache_dir,
+    GError      **error
+){
+    g_autoptr(GPtrArray) args = NULL;
+    g_autofree gchar *out = NULL;
+    g_autofree gchar *err = NULL;
+
+    args = g_ptr_array_new();
+    g_ptr_array_add(args, opt_crispy);
+    g_ptr_array_add(args, "--no-config");
+    g_ptr_array_add(args, "--cache-dir");
+    g_ptr_array_add(args, (gpointer)cache_dir);
+    g_ptr_array_add(args, (gpointer)source);
+
+    return run_crispy(args, &out, &err, error) &&
+           g_file_set_contents(expected_path, out, -1, error);
+}
+
+/* --- reporting --- */
+
+static CorpusResult *
+find_result(
+    GArray      *results,
+    const gchar *script,
+    const gchar *backend,
+    const gchar *profile
+){
+    CorpusResult *result;
+    guint i;
+
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CorpusResult, i);
+        if (strcmp(result->script, script) == 0 &&
+            strcmp(result->backend, backend) == 0 &&
+            strcmp(result->profile, profile) == 0)
+            return result;
+    }
+
+    return NULL;
+}
+
+/*
+ * Per script, one row per backend with the median of every profile.
+ * The summary is the geometric mean over scripts of each cell's
+ * speedup against the first backend and profile of the same script.
+ */
+static void
+print_report(
+    GPtrArray *scripts,
+    GArray    *backends,
+    GArray    *profiles,
+    GArray    *results
+){
+    CorpusResult *base;
+    CorpusResult *result;
+    Backend *backend;
+    Profile *profile;
+    const gchar *script;
+    gdouble log_sum;
+    guint n;
+    guint s;
+    guint b;
+    guint p;
+
+    for (s = 0; s < scripts->len; s++)
+    {
+        script = g_ptr_array_index(scripts, s);
+        g_print("\n%-12s", script);
+        for (p = 0; p < profiles->len; p++)
+            g_print(" %12s", g_array_index(profiles, Profile, p).name);
+        g_print("   (median ms)\n");
+
+        for (b = 0; b < backends->len; b++)
+        {
+            backend = &g_array_index(backends, Backend, b);
+            g_print("  %-10s", backend->name);
+            for (p = 0; p < profiles->len; p++)
+            {
+                profile = &g_array_index(profiles, Profile, p);
+                result = find_result(results, script, backend->name,
+                                     profile->name);
+                if (result == NULL)
+                    g_print(" %12s", "-");
+                else if (!result->ok)
+                    g_print(" %12s", "WRONG");
+                else
+                    g_print(" %12.3f", result->median_ms);
+            }
+            g_print("\n");
+        }
+    }
+
+    backend = &g_array_index(backends, Backend, 0);
+    profile = &g_array_index(profiles, Profile, 0);
+    g_print("\n%-12s", "speedup");
+    for (p = 0; p < profiles->len; p++)
+        g_print(" %12s", g_array_index(profiles, Profile, p).name);
+    g_print("   (geomean vs %s/%s)\n", backend->name, profile->name);
+
+    for (b = 0; b < backends->len; b++)
+    {
+        g_print("  %-10s", g_array_index(backends, Backend, b).name);
+        for (p = 0; p < profiles->len; p++)
+        {
+            log_sum = 0.0;
+            n = 0;
+            for (s = 0; s < scripts->len; s++)
+            {
+                script = g_ptr_array_index(scripts, s);
+                base = find_result(results, script, backend->name,
+                                   profile->name);
+                result = find_result(results, script,
+                                     g_array_index(backends, Backend, b).name,
+                                     g_array_index(profiles, Profile, p).name);
+                if (base == NULL || result == NULL || !base->ok ||
+                    !result->ok || result->median_ms <= 0.0)
+                    continue;
+
+                log_sum += log(base->median_ms / result->median_ms);
+                n++;
+            }
+
+            if (n == 0)
+                g_print(" %12s", "-");
+            else
+                g_print(" %11.2fx", exp(log_sum / n));
+        }
+        g_print("\n");
+    }
+}
+
+static gchar *
+results_to_json(
+    GArray *results
+){
+    CorpusResult *result;
+    GString *out;
+    guint i;
+
+    out = g_string_new("{\n");
+    g_string_append_printf(out, "  \"runs\": %d,\n  \"results\": [\n",
+                           opt_runs);
+
+    /* one result per line, so two runs compare with diff */
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CorpusResult, i);
+        g_string_append_printf(out,
+            "    {\"script\": \"%s\", \"backend\": \"%s\", "
+            "\"profile\": \"%s\", \"ok\": %s, \"min_ms\": %.3f, "
+            "\"median_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, "
+            "\"stddev_ms\": %.3f}%s\n",
+            result->script, result->backend, result->profile,
+            result->ok ? "true" : "false", result->min_ms,
+            result->median_ms, result->p95_ms, result->p99_ms,
+            result->stddev_ms, i + 1 < results->len ? "," : "");
+    }
+
+    g_string_append(out, "  ]\n}\n");
+    return g_string_free(out, FALSE);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GPtrArray) scripts = NULL;
+    g_autoptr(GArray) backends = NULL;
+    g_autoptr(GArray) profiles = NULL;
+    g_autoptr(GArray) results = NULL;
+    g_auto(GStrv) specs = NULL;
+    g_autofree gchar *work_dir = NULL;
+    g_autofree gchar *cache_dir = NULL;
+    g_autofree gchar *json_path = NULL;
+    g_autofree gchar *json = NULL;
+    const gchar *script;
+    const gchar *equals;
+    Backend backend;
+    Profile profile;
+    CorpusResult *result;
+    gint exit_code;
+    guint s;
+    guint b;
+    guint i;
+
+    context = g_option_context_new("- run the codegen corpus");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+
+    if (opt_crispy == NULL || opt_runs < 1)
+    {
+        g_printerr("Error: --crispy is required and --runs must be at "
+                   "least 1\n");
+        return 1;
+    }
+    if (opt_corpus == NULL)
+        opt_corpus = g_strdup("bench/corpus");
+
+    backends = g_array_new(FALSE, TRUE, sizeof(Backend));
+    g_array_set_clear_func(backends, clear_backend);
+    specs = g_strsplit(opt_backends != NULL ? opt_backends
+                                            : "default,isolate", ",", -1);
+    for (i = 0; specs[i] != NULL; i++)
+    {
+        g_strstrip(specs[i]);
+        if (specs[i][0] == '\0')
+            continue;
+
+        memset(&backend, 0, sizeof(backend));
+        if (!parse_backend(specs[i], &backend, &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            clear_backend(&backend);
+            return 1;
+        }
+        g_array_append_val(backends, backend);
+    }
+    g_clear_pointer(&specs, g_strfreev);
+
+    /* names only; crispy itself rejects an unknown profile */
+    profiles = g_array_new(FALSE, TRUE, sizeof(Profile));
+    g_array_set_clear_func(profiles, clear_profile);
+    specs = g_strsplit(opt_profiles != NULL ? opt_profiles
+                                            : "debug,fast,O3,native", ",", -1);
+    for (i = 0; specs[i] != NULL; i++)
+    {
+        g_strstrip(specs[i]);
+        if (specs[i][0] == '\0')
+            continue;
+
+        equals = strchr(specs[i], '=');
+        profile.spec = g_strdup(specs[i]);
+        profile.name = equals != NULL
+                       ? g_strndup(specs[i], (gsize)(equals - specs[i]))
+                       : g_strdup(specs[i]);
+        g_array_append_val(profiles, profile);
+    }
+
+    if (backends->len == 0 || profiles->len == 0)
+    {
+        g_printerr("Error: no backends or no profiles\n");
+        return 1;
+    }
+
+    scripts = list_scripts(opt_corpus, &error);
+    if (scripts == NULL)
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+
+    /* every profile is compiled once and shared by all backends */
+    work_dir = g_dir_make_tmp("crispy-corpus-XXXXXX", &error);
+    if (work_dir == NULL)
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+    cache_dir = g_build_filename(work_dir, "cache", NULL);
+    json_path = g_build_filename(work_dir, "timings.json", NULL);
+
+    results = g_array_new(FALSE, TRUE, sizeof(CorpusResult));
+    exit_code = 0;
+
+    for (s = 0; s < scripts->len && exit_code == 0; s++)
+    {
+        g_autofree gchar *source = NULL;
+        g_autofree gchar *expected_path = NULL;
+        g_autofree gchar *expected = NULL;
+
+        script = g_ptr_array_index(scripts, s);
+        source = g_strdup_printf("%s/%s.c", opt_corpus, script);
+        expected_path = g_strdup_printf("%s/%s.expected", opt_corpus, script);
+
+        if (opt_update)
+        {
+            g_print("Updating %s\n", expected_path);
+            if (!update_expected(source, expected_path, cache_dir, &error))
+                exit_code = 1;
+            continue;
+        }
+
+        if (!g_file_get_contents(expected_path, &expected, NULL, &error))
+        {
+            exit_code = 1;
+            break;
+        }
+
+        for (b = 0; b < backends->len && exit_code == 0; b++)
+        {
+            g_print("Running %s (%s)...\n", script,
+                    g_array_index(backends, Backend, b).name);
+            if (!run_script(script, source, expected, cache_dir, json_path,
+                            &g_array_index(backends, Backend, b), profiles,
+                            results, &error))
+            {
+                g_prefix_error(&error, "%s (%s): ", script,
+                               g_array_index(backends, Backend, b).name);
+                exit_code = 1;
+            }
+        }
+    }
+
+    remove_flat_dir(cache_dir);
+    g_unlink(json_path);
+    g_rmdir(work_dir);
+
+    if (exit_code != 0)
+    {
+        g_printerr("Error: %s\n", error->message);
+        return exit_code;
+    }
+    if (opt_update)
+        return 0;
+
+    print_report(scripts, backends, profiles, results);
+
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CorpusResult, i);
+        if (!result->ok)
+        {
+            g_printerr("Error: %s gave wrong output under %s/%s\n",
+                       result->script, result->backend, result->profile);
+            exit_code = 1;
+        }
+    }
+
+    if (opt_json != NULL)
+    {
+        json = results_to_json(results);
+        if (g_strcmp0(opt_json, "-") == 0)
+            g_print("%s", json);
+        else if (!g_file_set_contents(opt_json, json, -1, &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            return 1;
+        }
+    }
+
+    return exit_code;
+}
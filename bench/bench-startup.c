@@ -0,0 +1,607 @@
+/* bench-startup.c - Startup and pipeline benchmarks for the crispy binary */
+
+/*
+ * Runs the crispy executable the way users do and times each process
+ * from spawn to exit: cold compiles, warm cache hits, inline and stdin
+ * scripts, a C config, N loaded plugins and concurrent cold starts.
+ * Each case reports percentiles; --json writes them in a fixed layout
+ * and --baseline compares the medians against an earlier run.
+ *
+ *   make bench                  run and compare against bench/baseline.json
+ *   make bench-baseline         record bench/baseline.json
+ */
+
+#define CRISPY_COMPILATION
+#include "../src/crispy.h"
+#include "../src/core/crispy-bench-private.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define SCRIPT_SOURCE \
+    "#include <glib.h>\n" \
+    "gint main(gint argc, gchar **argv)\n" \
+    "{ (void)argc; (void)argv; return 0; }\n"
+
+#define CONFIG_SOURCE \
+    "#include <crispy.h>\n" \
+    "G_MODULE_EXPORT gboolean\n" \
+    "crispy_config_init(CrispyConfigContext *ctx)\n" \
+    "{\n" \
+    "    crispy_config_context_set_plugin_data(ctx, \"bench\", \"1\");\n" \
+    "    return TRUE;\n" \
+    "}\n"
+
+typedef struct
+{
+    const gchar *crispy;
+    gchar       *work_dir;
+    gchar       *script;
+    gchar       *config;
+    gchar       *warm_cache;
+    gchar       *plugin_list;       /* the plugin, n_plugins times */
+    guint        n_jobs;
+    guint        sample;            /* numbers cold cache dirs */
+} Bench;
+
+typedef gint64 (*BenchCaseFunc) (Bench   *bench,
+                                 GError **error);
+
+typedef struct
+{
+    const gchar   *name;
+    BenchCaseFunc  func;
+    gboolean       warm;             /* needs one unmeasured run first */
+} BenchCase;
+
+static gchar   *opt_crispy    = NULL;
+static gchar   *opt_plugin    = NULL;
+static gint     opt_runs      = 20;
+static gint     opt_plugins   = 16;
+static gint     opt_jobs      = 0;
+static gchar   *opt_json      = NULL;
+static gchar   *opt_baseline  = NULL;
+static gdouble  opt_threshold = 10.0;
+
+static GOptionEntry entries[] =
+{
+    { "crispy", 0, 0, G_OPTION_ARG_FILENAME, &opt_crispy,
+      "crispy executable to benchmark", "PATH" },
+    { "plugin", 0, 0, G_OPTION_ARG_FILENAME, &opt_plugin,
+      "Plugin .so for the plugin case (one that handles every hook)", "PATH" },
+    { "runs", 0, 0, G_OPTION_ARG_INT, &opt_runs,
+      "Samples per case (default 20)", "N" },
+    { "plugins", 0, 0, G_OPTION_ARG_INT, &opt_plugins,
+      "Plugins loaded in the plugin case (default 16)", "N" },
+    { "jobs", 0, 0, G_OPTION_ARG_INT, &opt_jobs,
+      "Processes in the concurrent case (default: CPUs, at most 8)", "N" },
+    { "json", 0, 0, G_OPTION_ARG_FILENAME, &opt_json,
+      "Write the results as JSON to FILE (- for stdout)", "FILE" },
+    { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &opt_baseline,
+      "Compare medians against a JSON file written by --json", "FILE" },
+    { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &opt_threshold,
+      "Median slowdown in percent that counts as a regression (default 10)",
+      "PCT" },
+    { NULL }
+};
+
+/* --- helper: remove a directory of files, as a cache dir is --- */
+static void
+remove_flat_dir(
+    const gchar *path
+){
+    GDir *dir;
+    const gchar *entry;
+
+    dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    while ((entry = g_dir_read_name(dir)) != NULL)
+    {
+        g_autofree gchar *file = NULL;
+
+        file = g_build_filename(path, entry, NULL);
+        g_unlink(file);
+    }
+
+    g_dir_close(dir);
+    g_rmdir(path);
+}
+
+/* --- helper: a fresh, empty cache dir for one cold sample --- */
+static gchar *
+cold_cache_dir(
+    Bench *bench
+){
+    return g_strdup_printf("%s/cold-%u", bench->work_dir, bench->sample++);
+}
+
+/* --- helper: start crispy with @args after --cache-dir @cache_dir --- */
+static GSubprocess *
+spawn_crispy(
+    Bench        *bench,
+    const gchar  *cache_dir,
+    gboolean      use_config,
+    const gchar  *stdin_path,
+    const gchar **args,
+    GError      **error
+){
+    g_autoptr(GSubprocessLauncher) launcher = NULL;
+    g_autoptr(GPtrArray) argv = NULL;
+    guint i;
+
+    launcher = g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_STDOUT_SILENCE);
+    if (use_config)
+        g_subprocess_launcher_setenv(launcher, "CRISPY_CONFIG_FILE",
+                                     bench->config, TRUE);
+    else
+        g_subprocess_launcher_unsetenv(launcher, "CRISPY_CONFIG_FILE");
+    if (stdin_path != NULL)
+        g_subprocess_launcher_set_stdin_file_path(launcher, stdin_path);
+
+    argv = g_ptr_array_new();
+    g_ptr_array_add(argv, (gpointer)bench->crispy);
+    if (!use_config)
+        g_ptr_array_add(argv, "--no-config");
+    g_ptr_array_add(argv, "--cache-dir");
+    g_ptr_array_add(argv, (gpointer)cache_dir);
+    for (i = 0; args[i] != NULL; i++)
+        g_ptr_array_add(argv, (gpointer)args[i]);
+    g_ptr_array_add(argv, NULL);
+
+    return g_subprocess_launcher_spawnv(launcher,
+                                        (const gchar * const *)argv->pdata,
+                                        error);
+}
+
+/* --- helper: wait for @proc; FALSE unless it exited with status 0 --- */
+static gboolean
+wait_crispy(
+    GSubprocess  *proc,
+    GError      **error
+){
+    if (!g_subprocess_wait(proc, NULL, error))
+        return FALSE;
+
+    if (!g_subprocess_get_successful(proc))
+    {
+        g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                    "crispy exited with status %d",
+                    g_subprocess_get_status(proc));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* --- helper: time one crispy run from spawn to exit, -1 on failure --- */
+static gint64
+time_crispy(
+    Bench        *bench,
+    const gchar  *cache_dir,
+    gboolean      use_config,
+    const gchar  *stdin_path,
+    const gchar **args,
+    GError      **error
+){
+    g_autoptr(GSubprocess) proc = NULL;
+    gint64 start;
+
+    start = g_get_monotonic_time();
+    proc = spawn_crispy(bench, cache_dir, use_config, stdin_path, args,
+                        error);
+    if (proc == NULL || !wait_crispy(proc, error))
+        return -1;
+
+    return g_get_monotonic_time() - start;
+}
+
+/* --- cases --- */
+
+static gint64
+case_cold_compile(
+    Bench   *bench,
+    GError **error
+){
+    g_autofree gchar *cache_dir = NULL;
+    const gchar *args[] = { bench->script, NULL };
+    gint64 elapsed;
+
+    cache_dir = cold_cache_dir(bench);
+    elapsed = time_crispy(bench, cache_dir, FALSE, NULL, args, error);
+    remove_flat_dir(cache_dir);
+
+    return elapsed;
+}
+
+static gint64
+case_warm_hit(
+    Bench   *bench,
+    GError **error
+){
+    const gchar *args[] = { bench->script, NULL };
+
+    return time_crispy(bench, bench->warm_cache, FALSE, NULL, args, error);
+}
+
+static gint64
+case_inline(
+    Bench   *bench,
+    GError **error
+){
+    const gchar *args[] = { "-i", "return 0;", NULL };
+
+    return time_crispy(bench, bench->warm_cache, FALSE, NULL, args, error);
+}
+
+static gint64
+case_stdin(
+    Bench   *bench,
+    GError **error
+){
+    const gchar *args[] = { "-", NULL };
+
+    return time_crispy(bench, bench->warm_cache, FALSE, bench->script,
+                       args, error);
+}
+
+static gint64
+case_config_load(
+    Bench   *bench,
+    GError **error
+){
+    const gchar *args[] = { bench->script, NULL };
+
+    return time_crispy(bench, bench->warm_cache, TRUE, NULL, args, error);
+}
+
+static gint64
+case_plugins(
+    Bench   *bench,
+    GError **error
+){
+    const gchar *args[] = { "-P", bench->plugin_list, bench->script, NULL };
+
+    return time_crispy(bench, bench->warm_cache, FALSE, NULL, args, error);
+}
+
+/*
+ * n_jobs processes compile the same script into one empty cache at
+ * once; the sample is the time until the last one exits.
+ */
+static gint64
+case_concurrent_cold(
+    Bench   *bench,
+    GError **error
+){
+    g_autofree gchar *cache_dir = NULL;
+    g_autoptr(GPtrArray) procs = NULL;
+    const gchar *args[] = { bench->script, NULL };
+    GSubprocess *proc;
+    gboolean ok;
+    gint64 start;
+    gint64 elapsed;
+    guint i;
+
+    cache_dir = cold_cache_dir(bench);
+    procs = g_ptr_array_new_with_free_func(g_object_unref);
+    elapsed = -1;
+    ok = TRUE;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < bench->n_jobs; i++)
+    {
+        proc = spawn_crispy(bench, cache_dir, FALSE, NULL, args, error);
+        if (proc == NULL)
+        {
+            ok = FALSE;
+            break;
+        }
+        g_ptr_array_add(procs, proc);
+    }
+
+    /* reap everything that started, even after a failure */
+    for (i = 0; i < procs->len; i++)
+    {
+        if (!wait_crispy(g_ptr_array_index(procs, i),
+                         ok ? error : NULL))
+            ok = FALSE;
+    }
+
+    if (ok)
+        elapsed = g_get_monotonic_time() - start;
+
+    remove_flat_dir(cache_dir);
+    return elapsed;
+}
+
+static const BenchCase cases[] =
+{
+    { "cold-compile",    case_cold_compile,    FALSE },
+    { "warm-hit",        case_warm_hit,        TRUE  },
+    { "inline",          case_inline,          TRUE  },
+    { "stdin",           case_stdin,           TRUE  },
+    { "config-load",     case_config_load,     TRUE  },
+    { "plugins",         case_plugins,         TRUE  },
+    { "concurrent-cold", case_concurrent_cold, FALSE }
+};
+
+/* --- reporting --- */
+
+typedef struct
+{
+    const gchar      *name;
+    CrispyBenchStats  stats;
+} CaseResult;
+
+static gchar *
+results_to_json(
+    Bench  *bench,
+    GArray *results
+){
+    CaseResult *result;
+    GString *out;
+    guint i;
+
+    out = g_string_new("{\n");
+    g_string_append_printf(out, "  \"runs\": %d,\n  \"plugins\": %d,\n"
+                           "  \"jobs\": %u,\n  \"cases\": [\n",
+                           opt_runs, opt_plugins, bench->n_jobs);
+
+    /* one case per line: baselines diff cleanly and parse by line */
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CaseResult, i);
+        g_string_append_printf(out,
+            "    {\"name\": \"%s\", \"min_us\": %.0f, \"median_us\": %.0f, "
+            "\"p95_us\": %.0f, \"p99_us\": %.0f, \"mean_us\": %.0f, "
+            "\"stddev_us\": %.0f}%s\n",
+            result->name, result->stats.min, result->stats.median,
+            result->stats.p95, result->stats.p99, result->stats.mean,
+            result->stats.stddev, i + 1 < results->len ? "," : "");
+    }
+
+    g_string_append(out, "  ]\n}\n");
+    return g_string_free(out, FALSE);
+}
+
+/* --- helper: case name -> median (gdouble *) from a --json file --- */
+static GHashTable *
+load_baseline(
+    const gchar  *path,
+    GError      **error
+){
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) lines = NULL;
+    GHashTable *medians;
+    const gchar *name;
+    const gchar *end;
+    const gchar *median;
+    gdouble *value;
+    guint i;
+
+    if (!g_file_get_contents(path, &contents, NULL, error))
+        return NULL;
+
+    medians = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        name = strstr(lines[i], "\"name\": \"");
+        median = strstr(lines[i], "\"median_us\": ");
+        if (name == NULL || median == NULL)
+            continue;
+
+        name += strlen("\"name\": \"");
+        end = strchr(name, '"');
+        if (end == NULL)
+            continue;
+
+        value = g_new(gdouble, 1);
+        *value = g_ascii_strtod(median + strlen("\"median_us\": "), NULL);
+        g_hash_table_replace(medians, g_strndup(name, end - name), value);
+    }
+
+    return medians;
+}
+
+/* --- helper: print the comparison; TRUE if nothing regressed --- */
+static gboolean
+compare_baseline(
+    GArray     *results,
+    GHashTable *baseline
+){
+    CaseResult *result;
+    const gdouble *base;
+    gdouble change;
+    gboolean ok;
+    guint i;
+
+    ok = TRUE;
+    g_print("\n%-16s %12s %12s %9s\n", "vs baseline", "was", "now", "change");
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CaseResult, i);
+        base = g_hash_table_lookup(baseline, result->name);
+        if (base == NULL || *base <= 0.0)
+        {
+            g_print("%-16s %12s %9.2f ms\n", result->name, "-",
+                    result->stats.median / 1000.0);
+            continue;
+        }
+
+        change = (result->stats.median - *base) / *base * 100.0;
+        g_print("%-16s %9.2f ms %9.2f ms %+8.1f%%%s\n", result->name,
+                *base / 1000.0, result->stats.median / 1000.0, change,
+                change > opt_threshold ? "  REGRESSION" : "");
+        if (change > opt_threshold)
+            ok = FALSE;
+    }
+
+    return ok;
+}
+
+/* --- helper: write the inputs every case shares --- */
+static gboolean
+setup_bench(
+    Bench   *bench,
+    GError **error
+){
+    GString *list;
+    gint i;
+
+    bench->work_dir = g_dir_make_tmp("crispy-bench-XXXXXX", error);
+    if (bench->work_dir == NULL)
+        return FALSE;
+
+    bench->script = g_build_filename(bench->work_dir, "hello.c", NULL);
+    bench->config = g_build_filename(bench->work_dir, "config.c", NULL);
+    bench->warm_cache = g_build_filename(bench->work_dir, "warm", NULL);
+
+    list = g_string_new(NULL);
+    for (i = 0; i < opt_plugins; i++)
+        g_string_append_printf(list, "%s%s", i > 0 ? "," : "", opt_plugin);
+    bench->plugin_list = g_string_free(list, FALSE);
+
+    return g_file_set_contents(bench->script, SCRIPT_SOURCE, -1, error) &&
+           g_file_set_contents(bench->config, CONFIG_SOURCE, -1, error);
+}
+
+static void
+teardown_bench(
+    Bench *bench
+){
+    if (bench->work_dir != NULL)
+    {
+        remove_flat_dir(bench->warm_cache);
+        g_unlink(bench->script);
+        g_unlink(bench->config);
+        g_rmdir(bench->work_dir);
+    }
+
+    g_free(bench->work_dir);
+    g_free(bench->script);
+    g_free(bench->config);
+    g_free(bench->warm_cache);
+    g_free(bench->plugin_list);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GArray) results = NULL;
+    g_autoptr(GArray) samples = NULL;
+    g_autoptr(GHashTable) baseline = NULL;
+    g_autofree gchar *json = NULL;
+    CaseResult result;
+    Bench bench;
+    gint64 elapsed;
+    gint exit_code;
+    guint c;
+    gint i;
+
+    context = g_option_context_new("- benchmark crispy startup");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+
+    if (opt_crispy == NULL || opt_plugin == NULL || opt_runs < 2 ||
+        opt_plugins < 1)
+    {
+        g_printerr("Error: --crispy and --plugin are required, "
+                   "--runs must be at least 2 and --plugins at least 1\n");
+        return 1;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.crispy = opt_crispy;
+    bench.n_jobs = opt_jobs > 0 ? (guint)opt_jobs
+                                : MIN(g_get_num_processors(), 8);
+
+    /* read the baseline first, so a bad path fails before the runs */
+    if (opt_baseline != NULL)
+    {
+        baseline = load_baseline(opt_baseline, &error);
+        if (baseline == NULL)
+        {
+            g_printerr("Error: %s\n", error->message);
+            return 1;
+        }
+    }
+
+    if (!setup_bench(&bench, &error))
+    {
+        g_printerr("Error: %s\n", error->message);
+        teardown_bench(&bench);
+        return 1;
+    }
+
+    results = g_array_new(FALSE, FALSE, sizeof(CaseResult));
+    samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+    exit_code = 0;
+
+    g_print("%-16s %6s %12s %12s %12s %12s\n",
+            "case", "runs", "min", "median", "p95", "p99");
+    for (c = 0; c < G_N_ELEMENTS(cases) && exit_code == 0; c++)
+    {
+        g_array_set_size(samples, 0);
+
+        /* warm cases start from a populated cache */
+        if (cases[c].warm && cases[c].func(&bench, &error) < 0)
+            exit_code = 1;
+
+        for (i = 0; i < opt_runs && exit_code == 0; i++)
+        {
+            elapsed = cases[c].func(&bench, &error);
+            if (elapsed < 0)
+                exit_code = 1;
+            else
+                g_array_append_val(samples, elapsed);
+        }
+
+        if (exit_code != 0)
+        {
+            g_printerr("Error: %s: %s\n", cases[c].name,
+                       error != NULL ? error->message : "failed");
+            break;
+        }
+
+        result.name = cases[c].name;
+        crispy_bench_compute_stats(samples, &result.stats);
+        g_array_append_val(results, result);
+        g_print("%-16s %6u %9.2f ms %9.2f ms %9.2f ms %9.2f ms\n",
+                result.name, result.stats.n_runs,
+                result.stats.min / 1000.0, result.stats.median / 1000.0,
+                result.stats.p95 / 1000.0, result.stats.p99 / 1000.0);
+    }
+
+    teardown_bench(&bench);
+    if (exit_code != 0)
+        return exit_code;
+
+    if (opt_json != NULL)
+    {
+        json = results_to_json(&bench, results);
+        if (g_strcmp0(opt_json, "-") == 0)
+            g_print("%s", json);
+        else if (!g_file_set_contents(opt_json, json, -1, &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            return 1;
+        }
+    }
+
+    if (baseline != NULL && !compare_baseline(results, baseline))
+        return 1;
+
+    return 0;
+}
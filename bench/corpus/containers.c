@@ -0,0 +1,162 @@
+#!/usr/bin/crispy
+
+/*
+ * containers.c - Codegen corpus: GLib strings and containers
+ *
+ * Builds a text of one million words from a fixed seed in a GString,
+ * splits it again with g_strsplit(), counts the words in a
+ * GHashTable, sorts the counts in a GPtrArray and indexes every word
+ * by its first letter in a GTree.  Allocation, hashing, string
+ * compares and pointer chasing rather than arithmetic.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#define N_WORDS 1000000
+
+static const gchar *syllables[] =
+{
+    "ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo",
+    "ba", "de", "fi", "go", "hu", "ja", "ke", "li",
+    "ma", "no", "pe", "qu", "ri", "so", "tu", "ve",
+    "wa", "xe", "yo", "zu", "cha", "sho", "thi", "pra"
+};
+
+typedef struct
+{
+    const gchar *word;
+    guint        count;
+} WordCount;
+
+/* xorshift64*: the same text on every platform and glib version */
+static guint64
+next_random(
+    guint64 *state
+){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * G_GUINT64_CONSTANT(0x2545F4914F6CDD1D);
+}
+
+static gint
+compare_counts(
+    gconstpointer a,
+    gconstpointer b
+){
+    const WordCount *x = *(WordCount * const *)a;
+    const WordCount *y = *(WordCount * const *)b;
+
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+
+    return strcmp(x->word, y->word);
+}
+
+static gint
+compare_chars(
+    gconstpointer a,
+    gconstpointer b,
+    gpointer      user_data
+){
+    return GPOINTER_TO_INT(a) - GPOINTER_TO_INT(b);
+}
+
+static gboolean
+print_letter(
+    gpointer key,
+    gpointer value,
+    gpointer user_data
+){
+    g_print("  %c: %u words\n", GPOINTER_TO_INT(key),
+            g_hash_table_size(value));
+    return FALSE;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(GHashTable) counts = NULL;
+    g_autoptr(GPtrArray) sorted = NULL;
+    g_autoptr(GTree) by_letter = NULL;
+    g_auto(GStrv) words = NULL;
+    GHashTableIter iter;
+    GHashTable *letter_words;
+    GString *text;
+    WordCount *entry;
+    gpointer key;
+    gpointer value;
+    guint64 state;
+    guint64 r;
+    guint n_syllables;
+    guint i;
+    guint j;
+
+    state = G_GUINT64_CONSTANT(0x9E3779B97F4A7C15);
+    text = g_string_new(NULL);
+    for (i = 0; i < N_WORDS; i++)
+    {
+        r = next_random(&state);
+        n_syllables = 1 + (guint)(r % 3);
+        if (i > 0)
+            g_string_append_c(text, ' ');
+        for (j = 0; j < n_syllables; j++)
+        {
+            r >>= 8;
+            g_string_append(text, syllables[r % G_N_ELEMENTS(syllables)]);
+        }
+    }
+
+    words = g_strsplit(text->str, " ", -1);
+    g_print("%u words, %lu bytes of text\n", g_strv_length(words),
+            (gulong)text->len);
+    g_string_free(text, TRUE);
+
+    counts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    for (i = 0; words[i] != NULL; i++)
+    {
+        entry = g_hash_table_lookup(counts, words[i]);
+        if (entry == NULL)
+        {
+            entry = g_new0(WordCount, 1);
+            entry->word = words[i];
+            g_hash_table_insert(counts, words[i], entry);
+        }
+        entry->count++;
+    }
+
+    sorted = g_ptr_array_sized_new(g_hash_table_size(counts));
+    by_letter = g_tree_new_full(compare_chars, NULL, NULL,
+                                (GDestroyNotify)g_hash_table_unref);
+    g_hash_table_iter_init(&iter, counts);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        g_ptr_array_add(sorted, value);
+
+        letter_words = g_tree_lookup(by_letter,
+                                     GINT_TO_POINTER(((gchar *)key)[0]));
+        if (letter_words == NULL)
+        {
+            letter_words = g_hash_table_new(g_str_hash, g_str_equal);
+            g_tree_insert(by_letter, GINT_TO_POINTER(((gchar *)key)[0]),
+                          letter_words);
+        }
+        g_hash_table_add(letter_words, key);
+    }
+    g_ptr_array_sort(sorted, compare_counts);
+
+    g_print("%u distinct words, most frequent:\n", sorted->len);
+    for (i = 0; i < 10 && i < sorted->len; i++)
+    {
+        entry = g_ptr_array_index(sorted, i);
+        g_print("  %-12s %u\n", entry->word, entry->count);
+    }
+
+    g_print("distinct words by first letter:\n");
+    g_tree_foreach(by_letter, print_letter, NULL);
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#!/usr/bin/crispy
+
+/*
+ * fileio.c - Codegen corpus: GIO streams and checksums
+ *
+ * examples/file-io.c at volume: writes 32 files of 1 MiB of
+ * pseudo-random bytes from a fixed seed through GFileOutputStream in
+ * 64 KiB chunks, reads them back through GFileInputStream into a
+ * SHA-256, and reads them once more with g_file_get_contents() to
+ * check the round trip.  Files live in a private temp directory that
+ * is removed afterwards.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#define N_FILES    32
+#define FILE_SIZE  (1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+
+/* xorshift64*: the same bytes on every platform and glib version */
+static guint64
+next_random(
+    guint64 *state
+){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * G_GUINT64_CONSTANT(0x2545F4914F6CDD1D);
+}
+
+static gboolean
+write_file(
+    const gchar  *path,
+    guint64      *state,
+    GError      **error
+){
+    g_autoptr(GFile) file = NULL;
+    g_autoptr(GFileOutputStream) out = NULL;
+    guint64 chunk[CHUNK_SIZE / sizeof(guint64)];
+    gsize written;
+    guint i;
+    guint j;
+
+    file = g_file_new_for_path(path);
+    out = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+    if (out == NULL)
+        return FALSE;
+
+    for (i = 0; i < FILE_SIZE / CHUNK_SIZE; i++)
+    {
+        for (j = 0; j < G_N_ELEMENTS(chunk); j++)
+            chunk[j] = GUINT64_TO_LE(next_random(state));
+
+        if (!g_output_stream_write_all(G_OUTPUT_STREAM(out), chunk,
+                                       sizeof(chunk), &written, NULL, error))
+            return FALSE;
+    }
+
+    return g_output_stream_close(G_OUTPUT_STREAM(out), NULL, error);
+}
+
+static gboolean
+hash_file(
+    const gchar  *path,
+    GChecksum    *checksum,
+    GError      **error
+){
+    g_autoptr(GFile) file = NULL;
+    g_autoptr(GFileInputStream) in = NULL;
+    guchar chunk[CHUNK_SIZE];
+    gsize n_read;
+
+    file = g_file_new_for_path(path);
+    in = g_file_read(file, NULL, error);
+    if (in == NULL)
+        return FALSE;
+
+    do
+    {
+        if (!g_input_stream_read_all(G_INPUT_STREAM(in), chunk, sizeof(chunk),
+                                     &n_read, NULL, error))
+            return FALSE;
+        g_checksum_update(checksum, chunk, n_read);
+    }
+    while (n_read == sizeof(chunk));
+
+    return g_input_stream_close(G_INPUT_STREAM(in), NULL, error);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GChecksum) checksum = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+    gsize length;
+    gsize total;
+    guint64 state;
+    gint exit_code;
+    guint i;
+
+    dir = g_dir_make_tmp("crispy-corpus-XXXXXX", &error);
+    if (dir == NULL)
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+
+    state = G_GUINT64_CONSTANT(0x9E3779B97F4A7C15);
+    checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    total = 0;
+    exit_code = 0;
+
+    for (i = 0; i < N_FILES && exit_code == 0; i++)
+    {
+        g_free(path);
+        path = g_strdup_printf("%s/data-%02u.bin", dir, i);
+        if (!write_file(path, &state, &error) ||
+            !hash_file(path, checksum, &error) ||
+            !g_file_get_contents(path, &contents, &length, &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        else if (length != FILE_SIZE)
+        {
+            g_printerr("Error: %s is %lu bytes\n", path, (gulong)length);
+            exit_code = 1;
+        }
+        else
+            total += length;
+
+        g_clear_pointer(&contents, g_free);
+    }
+
+    for (i = 0; i < N_FILES; i++)
+    {
+        g_free(path);
+        path = g_strdup_printf("%s/data-%02u.bin", dir, i);
+        g_unlink(path);
+    }
+    g_rmdir(dir);
+
+    if (exit_code != 0)
+        return exit_code;
+
+    g_print("%u files, %lu bytes written and read back\n", N_FILES,
+            (gulong)total);
+    g_print("sha256 %s\n", g_checksum_get_string(checksum));
+    return 0;
+}
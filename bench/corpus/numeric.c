@@ -0,0 +1,122 @@
+#!/usr/bin/crispy
+
+/*
+ * numeric.c - Codegen corpus: integer and floating-point loops
+ *
+ * The number crunching of examples/math.c scaled up to something worth
+ * timing: a Leibniz series for pi, a sum of square roots, a sieve of
+ * Eratosthenes and the longest Collatz chain.  Tight loops the
+ * optimizer can unroll and, for the integer kernels, vectorize.
+ */
+
+#define CRISPY_PARAMS "-lm"
+
+#include <math.h>
+#include <glib.h>
+#include <string.h>
+
+#define SERIES_TERMS  10000000
+#define SIEVE_LIMIT   10000000
+#define COLLATZ_LIMIT 1000000
+
+static gdouble
+leibniz_pi(
+    guint n_terms
+){
+    gdouble sum;
+    guint k;
+
+    sum = 0.0;
+    for (k = 0; k < n_terms; k++)
+        sum += (k & 1 ? -4.0 : 4.0) / (2.0 * k + 1.0);
+
+    return sum;
+}
+
+static gdouble
+sum_of_roots(
+    guint n
+){
+    gdouble sum;
+    guint i;
+
+    sum = 0.0;
+    for (i = 1; i <= n; i++)
+        sum += sqrt((gdouble)i);
+
+    return sum;
+}
+
+static guint
+count_primes(
+    guint limit
+){
+    g_autofree guint8 *composite = NULL;
+    guint count;
+    guint64 j;
+    guint i;
+
+    composite = g_malloc0(limit + 1);
+    count = 0;
+    for (i = 2; i <= limit; i++)
+    {
+        if (composite[i])
+            continue;
+
+        count++;
+        for (j = (guint64)i * i; j <= limit; j += i)
+            composite[j] = 1;
+    }
+
+    return count;
+}
+
+static guint
+longest_collatz(
+    guint  limit,
+    guint *steps
+){
+    guint64 n;
+    guint best;
+    guint length;
+    guint i;
+
+    best = 1;
+    *steps = 0;
+    for (i = 1; i < limit; i++)
+    {
+        length = 0;
+        for (n = i; n != 1; length++)
+            n = n & 1 ? 3 * n + 1 : n / 2;
+
+        if (length > *steps)
+        {
+            *steps = length;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    guint start;
+    guint steps;
+
+    g_print("pi, %u terms:          %.12f\n", SERIES_TERMS,
+            leibniz_pi(SERIES_TERMS));
+    g_print("sum of sqrt(1..%u):   %.6e\n", SERIES_TERMS,
+            sum_of_roots(SERIES_TERMS));
+    g_print("primes <= %u:         %u\n", SIEVE_LIMIT,
+            count_primes(SIEVE_LIMIT));
+
+    start = longest_collatz(COLLATZ_LIMIT, &steps);
+    g_print("longest Collatz < %u:  %u (%u steps)\n", COLLATZ_LIMIT,
+            start, steps);
+
+    return 0;
+}
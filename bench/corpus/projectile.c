@@ -0,0 +1,97 @@
+#!/usr/bin/crispy
+
+/*
+ * projectile.c - Codegen corpus: floating-point integration
+ *
+ * The projectile of examples/physics.c with quadratic air drag, which
+ * has no closed form: every half degree from 0.5 to 89.5 is flown with
+ * an explicit Euler step of 0.5 ms, for five launch speeds, and the
+ * angle with the longest range is printed.  Mostly dependent
+ * multiply-adds and one sqrt() per step.
+ */
+
+#define CRISPY_PARAMS "-lm"
+
+#include <math.h>
+#include <glib.h>
+
+#define GRAVITY 9.81
+#define DRAG    0.0005   /* per metre: a = -DRAG * |v| * v */
+#define DT      5e-4
+
+/*
+ * fly:
+ * @v0: launch speed (m/s)
+ * @angle_deg: launch angle (degrees)
+ *
+ * Returns: distance where the projectile comes back to y = 0,
+ *   interpolated within the last step
+ */
+static gdouble
+fly(
+    gdouble v0,
+    gdouble angle_deg
+){
+    gdouble angle_rad;
+    gdouble vx;
+    gdouble vy;
+    gdouble x;
+    gdouble y;
+    gdouble prev_x;
+    gdouble prev_y;
+    gdouble v;
+
+    angle_rad = angle_deg * G_PI / 180.0;
+    vx = v0 * cos(angle_rad);
+    vy = v0 * sin(angle_rad);
+    x = 0.0;
+    y = 0.0;
+
+    do
+    {
+        prev_x = x;
+        prev_y = y;
+
+        v = sqrt(vx * vx + vy * vy);
+        vx -= DRAG * v * vx * DT;
+        vy -= (GRAVITY + DRAG * v * vy) * DT;
+        x += vx * DT;
+        y += vy * DT;
+    }
+    while (y > 0.0);
+
+    return prev_x + (x - prev_x) * prev_y / (prev_y - y);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    const gdouble speeds[] = { 10.0, 25.0, 50.0, 100.0, 200.0 };
+    gdouble best_range;
+    gdouble best_angle;
+    gdouble range;
+    guint i;
+    gint half_deg;
+
+    for (i = 0; i < G_N_ELEMENTS(speeds); i++)
+    {
+        best_range = 0.0;
+        best_angle = 0.0;
+        for (half_deg = 1; half_deg < 180; half_deg++)
+        {
+            range = fly(speeds[i], half_deg * 0.5);
+            if (range > best_range)
+            {
+                best_range = range;
+                best_angle = half_deg * 0.5;
+            }
+        }
+
+        g_print("v0 %5.1f m/s: best angle %4.1f deg, range %9.2f m\n",
+                speeds[i], best_angle, best_range);
+    }
+
+    return 0;
+}
@@ -36,6 +36,7 @@ BINDIR_RELEASE := $(BUILDDIR)/release
 # Build options (0 or 1)
 DEBUG ?= 0
 ASAN ?= 0
+TSAN ?= 0
 BUILD_GIR ?= 0
 BUILD_TESTS ?= 1
 
@@ -75,6 +76,14 @@ ifeq ($(DEBUG),1)
         CFLAGS_BUILD += -fsanitize=address -fsanitize=undefined
         LDFLAGS_ASAN := -fsanitize=address -fsanitize=undefined
     endif
+    # ThreadSanitizer cannot be combined with ASAN
+    ifeq ($(TSAN),1)
+        ifeq ($(ASAN),1)
+            $(error ASAN=1 and TSAN=1 cannot be used together)
+        endif
+        CFLAGS_BUILD += -fsanitize=thread
+        LDFLAGS_TSAN := -fsanitize=thread
+    endif
 else
     CFLAGS_BUILD := -O2 -DNDEBUG
 endif
@@ -98,12 +107,15 @@ CFLAGS_INC := -I. -Isrc -I$(OUTDIR)
 CFLAGS_BASE += -DCRISPY_SYSCONFDIR=\"$(SYSCONFDIR)\"
 CFLAGS_BASE += -DCRISPY_DATADIR=\"$(DATADIR)\"
 CFLAGS_BASE += -DCRISPY_DEV_INCLUDE_DIR=\"$(CURDIR)/src\"
+CFLAGS_BASE += -DCRISPY_DEV_LIB_DIR=\"$(CURDIR)/$(OUTDIR)\"
+CFLAGS_BASE += -DCRISPY_INCLUDEDIR=\"$(INCLUDEDIR)/crispy\"
+CFLAGS_BASE += -DCRISPY_LIBDIR=\"$(LIBDIR)\"
 
 # Combine all CFLAGS
 CFLAGS := $(CFLAGS_BASE) $(CFLAGS_BUILD) $(CFLAGS_INC) $(CFLAGS_DEPS)
 
 # Linker flags
-LDFLAGS := $(LDFLAGS_DEPS) $(LDFLAGS_ASAN)
+LDFLAGS := $(LDFLAGS_DEPS) -ldl -lm $(LDFLAGS_ASAN) $(LDFLAGS_TSAN)
 LDFLAGS_SHARED := -shared -Wl,-soname,libcrispy.so.$(VERSION_MAJOR)
 
 # Library names
@@ -113,6 +125,14 @@ LIB_SHARED := lib$(LIB_NAME).so
 LIB_SHARED_FULL := lib$(LIB_NAME).so.$(VERSION)
 LIB_SHARED_MAJOR := lib$(LIB_NAME).so.$(VERSION_MAJOR)
 
+# Script runtime library (linked into scripts that include crispy-runtime.h)
+RUNTIME_LIB_NAME := crispy-runtime
+RUNTIME_SHARED := lib$(RUNTIME_LIB_NAME).so
+RUNTIME_SHARED_FULL := lib$(RUNTIME_LIB_NAME).so.$(VERSION)
+RUNTIME_SHARED_MAJOR := lib$(RUNTIME_LIB_NAME).so.$(VERSION_MAJOR)
+LDFLAGS_RUNTIME_SHARED := -shared -Wl,-soname,$(RUNTIME_SHARED_MAJOR)
+LDFLAGS_RUNTIME := $(shell $(PKG_CONFIG) --libs glib-2.0 2>/dev/null) $(LDFLAGS_ASAN) $(LDFLAGS_TSAN)
+
 # GIR settings
 GIR_NAMESPACE := Crispy
 GIR_VERSION := $(VERSION_MAJOR).$(VERSION_MINOR)
@@ -121,7 +141,7 @@ TYPELIB_FILE := $(GIR_NAMESPACE)-$(GIR_VERSION).typelib
 
 # Test framework
 TEST_CFLAGS := $(CFLAGS) $(shell $(PKG_CONFIG) --cflags glib-2.0)
-TEST_LDFLAGS := $(LDFLAGS) -L$(OUTDIR) -lcrispy -Wl,-rpath,$(OUTDIR)
+TEST_LDFLAGS := $(LDFLAGS) -L$(OUTDIR) -lcrispy -l$(RUNTIME_LIB_NAME) -Wl,-rpath,$(OUTDIR)
 
 # Print configuration (for debugging)
 .PHONY: show-config
@@ -137,6 +157,7 @@ show-config:
 	@echo "LIBDIR:       $(LIBDIR)"
 	@echo "DEBUG:        $(DEBUG)"
 	@echo "ASAN:         $(ASAN)"
+	@echo "TSAN:         $(TSAN)"
 	@echo "BUILD_GIR:    $(BUILD_GIR)"
 	@echo "BUILD_TESTS:  $(BUILD_TESTS)"
 
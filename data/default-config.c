@@ -77,6 +77,17 @@ crispy_config_init(CrispyConfigContext *ctx)
 	/* --- Override cache directory --- */
 	/* crispy_config_context_set_cache_dir(ctx, "/tmp/crispy-cache"); */
 
+	/* --- Execution placement (--cpus, --numa-node, --sched win) --- */
+	/* crispy_config_context_set_cpus(ctx, "0-3"); */
+	/* crispy_config_context_set_numa_node(ctx, 0); */
+	/* crispy_config_context_set_sched(ctx, "batch"); */
+
+	/* --- Default allocator (CRISPY_ALLOCATOR and --allocator win) --- */
+	/* crispy_config_context_set_allocator(ctx, "mimalloc"); */
+
+	/* --- Run telemetry (--telemetry and --metrics win) --- */
+	/* crispy_config_context_set_telemetry(ctx, "/tmp/crispy-runs.jsonl", NULL); */
+
 	/* --- Inspect or modify script argv before execution --- */
 	/* gint argc = crispy_config_context_get_script_argc(ctx); */
 	/* gchar **argv = crispy_config_context_get_script_argv(ctx); */
@@ -0,0 +1,81 @@
+#!/usr/bin/crispy
+
+/*
+ * hot-swap.c - A long-running script that survives edits
+ *
+ * Prints a line every second from a GMainLoop and keeps a warm cache
+ * of computed values.  Run it with --hot-swap, then edit this file
+ * (change the greeting, say) and save: crispy recompiles in the
+ * background, hands the state to the new code and carries on with the
+ * tick count and cache intact.
+ *
+ *   crispy --hot-swap examples/hot-swap.c
+ */
+
+#include <glib.h>
+
+#define GREETING "hello"
+
+typedef struct
+{
+    GMainLoop  *loop;
+    GHashTable *squares;    /* warm cache that must survive a swap */
+    guint       ticks;
+    guint       timer_id;   /* owned by whichever version is running */
+} State;
+
+static State *state = NULL;
+
+static gboolean
+tick(
+    gpointer user_data
+){
+    gpointer cached;
+    guint n;
+
+    n = state->ticks++ % 100;
+    cached = g_hash_table_lookup(state->squares, GUINT_TO_POINTER(n));
+    if (cached == NULL)
+    {
+        cached = GUINT_TO_POINTER(n * n + 1);
+        g_hash_table_insert(state->squares, GUINT_TO_POINTER(n), cached);
+    }
+
+    g_print("%s: tick %u, %u cached\n", GREETING, state->ticks,
+            g_hash_table_size(state->squares));
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* called on the old version: detach callbacks, hand over the state */
+gpointer
+crispy_state_save(void)
+{
+    g_source_remove(state->timer_id);
+    state->timer_id = 0;
+    return state;
+}
+
+/* called on the new version: take the state, attach callbacks */
+void
+crispy_state_restore(
+    gpointer saved
+){
+    state = (State *)saved;
+    state->timer_id = g_timeout_add_seconds(1, tick, NULL);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    state = g_new0(State, 1);
+    state->loop = g_main_loop_new(NULL, FALSE);
+    state->squares = g_hash_table_new(g_direct_hash, g_direct_equal);
+    state->timer_id = g_timeout_add_seconds(1, tick, NULL);
+
+    g_main_loop_run(state->loop);
+
+    return 0;
+}
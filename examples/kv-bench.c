@@ -0,0 +1,133 @@
+#!/usr/bin/crispy
+
+/*
+ * kv-bench.c - CrispyKv throughput from 1 to N processes
+ *
+ * Each process does OPS operations on a shared store of 10000 keys:
+ * mostly lock-free gets, plus WRITE_PCT percent compare-and-swap
+ * increments under the writer lock.  Prints the total rate for 1, 2,
+ * 4, ... up to MAX_PROCS processes.
+ *
+ *   crispy examples/kv-bench.c [MAX_PROCS] [OPS] [WRITE_PCT]
+ */
+
+#include <glib.h>
+#include <crispy-runtime.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define N_KEYS (10000)
+
+/* keeps the compiler from dropping the reads */
+static volatile guint64 sink;
+
+static void
+run_worker(
+    guint  seed,
+    gint   ops,
+    gint   write_pct
+){
+    g_autoptr(CrispyKv) kv = NULL;
+    gchar key[32];
+    const guint64 *current;
+    guint64 old_value;
+    guint64 new_value;
+    guint64 sum;
+    gint i;
+
+    kv = crispy_kv_open("kv-bench", NULL);
+    if (kv == NULL)
+        _exit(1);
+
+    sum = 0;
+    for (i = 0; i < ops; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        g_snprintf(key, sizeof(key), "key-%u", (seed >> 8) % N_KEYS);
+
+        if ((gint)((seed >> 20) % 100) >= write_pct)
+        {
+            current = crispy_kv_get(kv, key, NULL);
+            sum += current != NULL ? *current : 0;
+            continue;
+        }
+
+        /* retry until no other process got in between */
+        do
+        {
+            current = crispy_kv_get(kv, key, NULL);
+            old_value = current != NULL ? *current : 0;
+            new_value = old_value + 1;
+        }
+        while (!crispy_kv_compare_and_swap(kv, key, &old_value,
+                                           sizeof(old_value), &new_value,
+                                           sizeof(new_value), NULL));
+    }
+
+    sink = sum;
+    _exit(0);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(CrispyKv) kv = NULL;
+    g_autoptr(GError) error = NULL;
+    gchar key[32];
+    guint64 zero;
+    gint max_procs;
+    gint ops;
+    gint write_pct;
+    gint procs;
+    gint status;
+    gint i;
+    gint64 start;
+    gdouble seconds;
+
+    max_procs = argc > 1 ? atoi(argv[1]) : (gint)g_get_num_processors();
+    ops = argc > 2 ? atoi(argv[2]) : 1000000;
+    write_pct = argc > 3 ? atoi(argv[3]) : 1;
+
+    kv = crispy_kv_open("kv-bench", &error);
+    if (kv == NULL)
+    {
+        g_printerr("Error: %s\n", error->message);
+        return 1;
+    }
+
+    /* every key starts at 0, so workers never see a missing key */
+    zero = 0;
+    for (i = 0; i < N_KEYS; i++)
+    {
+        g_snprintf(key, sizeof(key), "key-%d", i);
+        if (!crispy_kv_put(kv, key, &zero, sizeof(zero), &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            return 1;
+        }
+    }
+
+    g_print("%5s %14s\n", "procs", "ops/s");
+    for (procs = 1; procs <= max_procs; procs *= 2)
+    {
+        start = g_get_monotonic_time();
+        for (i = 0; i < procs; i++)
+        {
+            if (fork() == 0)
+                run_worker((guint)i + 1, ops, write_pct);
+        }
+        for (i = 0; i < procs; i++)
+        {
+            if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                g_printerr("worker failed\n");
+        }
+        seconds = (gdouble)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+
+        g_print("%5d %14.0f\n", procs, (gdouble)procs * ops / seconds);
+    }
+
+    return 0;
+}
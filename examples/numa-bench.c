@@ -0,0 +1,194 @@
+#!/usr/bin/crispy
+
+/*
+ * numa-bench.c - local vs remote NUMA memory bandwidth
+ *
+ * CRISPY_NUMA_NODE below makes crispy run the script, and every thread
+ * of the parallel pool, on the CPUs of node 0.  The benchmark then
+ * binds one buffer to node 0 and one to node 1 with mbind() and sums
+ * each with crispy_parallel_reduce(), printing the bandwidth of both.
+ * On a machine with a single node there is nothing to compare and the
+ * script says so.
+ *
+ *   crispy examples/numa-bench.c [MIB] [PASSES]
+ */
+
+#define CRISPY_NUMA_NODE "0"
+
+#include <glib.h>
+#include <crispy-runtime.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define MPOL_BIND_MODE (2)    /* MPOL_BIND from <linux/mempolicy.h> */
+
+/* keeps the compiler from dropping the sums */
+static volatile guint64 sink;
+
+static void
+sum_map(
+    gint64   begin,
+    gint64   end,
+    gpointer acc,
+    gpointer user_data
+){
+    const guint64 *words;
+    guint64 sum;
+    gint64 i;
+
+    words = user_data;
+    sum = 0;
+    for (i = begin; i < end; i++)
+        sum += words[i];
+    *(guint64 *)acc += sum;
+}
+
+static void
+sum_combine(
+    gpointer      acc,
+    gconstpointer other,
+    gpointer      user_data
+){
+    (void)user_data;
+    *(guint64 *)acc += *(const guint64 *)other;
+}
+
+static void
+fill_map(
+    gint64   begin,
+    gint64   end,
+    gpointer user_data
+){
+    guint64 *words;
+    gint64 i;
+
+    words = user_data;
+    for (i = begin; i < end; i++)
+        words[i] = (guint64)i;
+}
+
+/* --- helper: number of NUMA nodes, 1 without NUMA support --- */
+static gint
+count_nodes(void)
+{
+    g_autoptr(GDir) dir = NULL;
+    const gchar *name;
+    gint n;
+
+    dir = g_dir_open("/sys/devices/system/node", 0, NULL);
+    if (dir == NULL)
+        return 1;
+
+    n = 0;
+    while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        if (g_str_has_prefix(name, "node") && g_ascii_isdigit(name[4]))
+            n++;
+    }
+
+    return MAX(n, 1);
+}
+
+/*
+ * measure:
+ * @node: node whose memory to read
+ * @bytes: buffer size
+ * @passes: number of times to sum the buffer
+ *
+ * Maps a fresh buffer bound to @node, faults it in from the pool and
+ * then times @passes parallel sums over it.
+ *
+ * Returns: bandwidth in GB/s, or a negative value if @node's memory
+ *          could not be bound
+ */
+static gdouble
+measure(
+    gint   node,
+    gsize  bytes,
+    gint   passes
+){
+    guint64 *words;
+    gulong mask;
+    guint64 total;
+    guint64 zero;
+    gint64 n_words;
+    gint64 start;
+    gdouble seconds;
+    gint i;
+
+    words = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (words == MAP_FAILED)
+        return -1.0;
+
+    /* pages are placed on @node when first touched, by any thread */
+    mask = 1UL << node;
+    if (syscall(SYS_mbind, words, bytes, MPOL_BIND_MODE, &mask,
+                sizeof(mask) * 8 + 1, 0) != 0)
+    {
+        munmap(words, bytes);
+        return -1.0;
+    }
+
+    n_words = (gint64)(bytes / sizeof(guint64));
+    crispy_parallel_for(0, n_words, 0, fill_map, words);
+
+    zero = 0;
+    total = 0;
+    start = g_get_monotonic_time();
+    for (i = 0; i < passes; i++)
+    {
+        guint64 sum;
+
+        crispy_parallel_reduce(0, n_words, 0, &sum, sizeof(sum), &zero,
+                               sum_map, sum_combine, words);
+        total += sum;
+    }
+    seconds = (gdouble)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+
+    sink = total;
+    munmap(words, bytes);
+
+    return (gdouble)bytes * passes / seconds / 1e9;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    gsize bytes;
+    gint passes;
+    gint n_nodes;
+    gdouble local;
+    gdouble remote;
+
+    bytes = (gsize)(argc > 1 ? atoi(argv[1]) : 1024) << 20;
+    passes = argc > 2 ? atoi(argv[2]) : 10;
+
+    n_nodes = count_nodes();
+    if (n_nodes < 2)
+    {
+        g_print("Only one NUMA node; nothing to compare.\n");
+        return 0;
+    }
+
+    g_print("%d nodes, %u threads, %" G_GSIZE_FORMAT " MiB x %d passes\n",
+            n_nodes, crispy_parallel_get_concurrency(), bytes >> 20, passes);
+
+    local = measure(0, bytes, passes);
+    remote = measure(1, bytes, passes);
+    if (local < 0.0 || remote < 0.0)
+    {
+        g_printerr("Error: mbind() failed; is the kernel built with NUMA?\n");
+        return 1;
+    }
+
+    g_print("%-8s %10.2f GB/s\n", "local", local);
+    g_print("%-8s %10.2f GB/s\n", "remote", remote);
+    g_print("remote is %.0f%% of local\n", 100.0 * remote / local);
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+#!/usr/bin/crispy
+
+/*
+ * parallel.c - crispy_parallel_reduce() scaling benchmark
+ *
+ * Sweeps a grid of launch angles and velocities, integrating each
+ * projectile (with quadratic air drag) until it lands, and reduces the
+ * grid to the longest shot.  The same sweep is run with 1, 2, ... N
+ * threads and the wall time and speedup of each run are printed.
+ *
+ * N defaults to the number of CPUs the process may use (affinity mask
+ * and cgroup quota); pass a number to override it:
+ *   crispy examples/parallel.c 8
+ */
+
+#define CRISPY_PARAMS "-lm -O2"
+
+#include <math.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <crispy-runtime.h>
+
+#define N_ANGLES     360
+#define N_VELOCITIES 100
+
+typedef struct
+{
+    gdouble best_range;
+    gdouble best_angle;
+    gdouble best_v0;
+    gint64  steps;
+} Shot;
+
+/*
+ * fly:
+ * @v0: launch velocity (m/s)
+ * @angle_deg: launch angle (degrees)
+ * @steps: (out): integration steps taken
+ *
+ * Integrates one projectile with drag using a fixed 10 ms time step.
+ *
+ * Returns: horizontal distance travelled before landing
+ */
+static gdouble
+fly(
+    gdouble  v0,
+    gdouble  angle_deg,
+    gint64  *steps
+){
+    const gdouble g = 9.81;
+    const gdouble k = 0.0005;
+    const gdouble dt = 0.01;
+    gdouble vx;
+    gdouble vy;
+    gdouble x;
+    gdouble y;
+    gdouble v;
+
+    vx = v0 * cos(angle_deg * G_PI / 180.0);
+    vy = v0 * sin(angle_deg * G_PI / 180.0);
+    x = 0.0;
+    y = 0.0;
+
+    do
+    {
+        v = sqrt(vx * vx + vy * vy);
+        vx -= k * v * vx * dt;
+        vy -= (g + k * v * vy) * dt;
+        x += vx * dt;
+        y += vy * dt;
+        (*steps)++;
+    } while (y > 0.0);
+
+    return x;
+}
+
+static void
+sweep_map(
+    gint64   begin,
+    gint64   end,
+    gpointer acc,
+    gpointer user_data
+){
+    Shot *best;
+    gint64 i;
+    gdouble angle;
+    gdouble v0;
+    gdouble range;
+
+    best = acc;
+    for (i = begin; i < end; i++)
+    {
+        angle = 0.1 + (gdouble)(i % N_ANGLES) * (89.8 / N_ANGLES);
+        v0 = 10.0 + (gdouble)(i / N_ANGLES);
+
+        range = fly(v0, angle, &best->steps);
+        if (range > best->best_range)
+        {
+            best->best_range = range;
+            best->best_angle = angle;
+            best->best_v0 = v0;
+        }
+    }
+}
+
+static void
+sweep_combine(
+    gpointer      acc,
+    gconstpointer other,
+    gpointer      user_data
+){
+    Shot *a;
+    const Shot *b;
+
+    a = acc;
+    b = other;
+
+    a->steps += b->steps;
+    if (b->best_range > a->best_range)
+    {
+        a->best_range = b->best_range;
+        a->best_angle = b->best_angle;
+        a->best_v0 = b->best_v0;
+    }
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    CrispyTimer timer;
+    Shot identity = { 0.0, 0.0, 0.0, 0 };
+    Shot result;
+    gdouble base_ms;
+    gdouble ms;
+    guint max_threads;
+    guint n;
+
+    max_threads = crispy_parallel_get_concurrency();
+    if (argc > 1 && atoi(argv[1]) > 0)
+        max_threads = (guint)atoi(argv[1]);
+
+    g_print("Projectile sweep: %d angles x %d velocities\n",
+            N_ANGLES, N_VELOCITIES);
+    g_print("Detected concurrency: %u\n\n", crispy_parallel_get_concurrency());
+    g_print("  %7s  %10s  %8s  %10s\n",
+            "threads", "time(ms)", "speedup", "efficiency");
+    g_print("  %7s  %10s  %8s  %10s\n",
+            "-------", "--------", "-------", "----------");
+
+    base_ms = 0.0;
+    for (n = 1; n <= max_threads; n++)
+    {
+        crispy_parallel_set_concurrency(n);
+
+        crispy_timer_start(&timer);
+        crispy_parallel_reduce(0, (gint64)N_ANGLES * N_VELOCITIES, 0,
+                               &result, sizeof(result), &identity,
+                               sweep_map, sweep_combine, NULL);
+        ms = crispy_timer_elapsed_ms(&timer);
+
+        if (n == 1)
+            base_ms = ms;
+
+        g_print("  %7u  %10.2f  %7.2fx  %9.0f%%\n",
+                n, ms, base_ms / ms, 100.0 * base_ms / ms / n);
+    }
+
+    crispy_parallel_set_concurrency(0);
+
+    g_print("\nLongest shot: %.1f m (v0=%.1f m/s, angle=%.1f deg)\n",
+            result.best_range, result.best_v0, result.best_angle);
+    g_print("Integration steps per sweep: %" G_GINT64_FORMAT "\n",
+            result.steps);
+
+    return 0;
+}
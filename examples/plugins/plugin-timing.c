@@ -17,18 +17,35 @@ CRISPY_PLUGIN_DEFINE(
  * crispy_plugin_on_post_execute:
  * @ctx: the hook context with timing data
  *
- * Prints a timing report for each phase of the execution pipeline
- * to stderr. Only fires after the script has finished executing.
+ * Prints a timing report for each phase of the execution pipeline,
+ * and the time each plugin's hooks have taken so far, to stderr.
+ * Only fires after the script has finished executing.
  *
  * Returns: %CRISPY_HOOK_CONTINUE always
  */
 CrispyHookResult
 crispy_plugin_on_post_execute(CrispyHookContext *ctx)
 {
+    const CrispyPluginCost *cost;
+    gint64 wall;
+    gint64 cpu;
+    guint i;
+    gint h;
+
     g_printerr("\n--- Crispy Timing Report ---\n");
     g_printerr("  Source:     %s\n",
                ctx->source_path != NULL ? ctx->source_path : "(inline/stdin)");
     g_printerr("  Cache hit:  %s\n", ctx->cache_hit ? "yes" : "no");
+    if (ctx->isa_target != NULL)
+        g_printerr("  ISA clone:  %s\n", ctx->isa_target);
+    if (ctx->cpus != NULL)
+        g_printerr("  CPUs:       %s\n", ctx->cpus);
+    if (ctx->numa_node >= 0)
+        g_printerr("  NUMA node:  %d\n", ctx->numa_node);
+    if (ctx->sched != NULL)
+        g_printerr("  Sched:      %s\n", ctx->sched);
+    if (ctx->allocator != NULL)
+        g_printerr("  Allocator:  %s\n", ctx->allocator);
     g_printerr("  Params:     %.3f ms\n", ctx->time_param_expand / 1000.0);
     g_printerr("  Hash:       %.3f ms\n", ctx->time_hash / 1000.0);
     g_printerr("  Cache chk:  %.3f ms\n", ctx->time_cache_check / 1000.0);
@@ -37,6 +54,21 @@ crispy_plugin_on_post_execute(CrispyHookContext *ctx)
     g_printerr("  Execute:    %.3f ms\n", ctx->time_execute / 1000.0);
     g_printerr("  Total:      %.3f ms\n", ctx->time_total / 1000.0);
     g_printerr("  Exit code:  %d\n", ctx->exit_code);
+
+    /* hooks up to now, this one excluded */
+    for (i = 0; ctx->plugin_costs != NULL && i < ctx->plugin_costs->len; i++)
+    {
+        cost = &g_array_index(ctx->plugin_costs, CrispyPluginCost, i);
+        wall = 0;
+        cpu = 0;
+        for (h = 0; h < CRISPY_HOOK_POINT_COUNT; h++)
+        {
+            wall += cost->wall_ns[h];
+            cpu += cost->cpu_ns[h];
+        }
+        g_printerr("  Plugin %-12s %.3f ms (%.3f ms CPU)\n",
+                   cost->name, wall / 1000000.0, cpu / 1000000.0);
+    }
     g_printerr("----------------------------\n");
 
     return CRISPY_HOOK_CONTINUE;
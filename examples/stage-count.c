@@ -0,0 +1,50 @@
+#!/usr/bin/crispy
+
+/*
+ * stage-count.c - Pipeline stage: count lines and bytes, like `wc -lc`
+ *
+ * Last stage of the pipeline benchmark in docs/scripting.md.
+ *
+ *   seq 100 | crispy examples/stage-count.c
+ */
+
+#include <glib.h>
+#include <crispy-runtime.h>
+
+gint
+crispy_stage_main(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    gchar buf[64 * 1024];
+    guint64 lines;
+    guint64 bytes;
+    gssize n;
+    gssize i;
+
+    lines = 0;
+    bytes = 0;
+    while ((n = crispy_stage_read(stage, buf, sizeof(buf))) > 0)
+    {
+        bytes += (guint64)n;
+        for (i = 0; i < n; i++)
+            lines += (buf[i] == '\n');
+    }
+
+    crispy_writer_printf(crispy_stage_get_output(stage),
+                         "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT "\n",
+                         lines, bytes);
+    return n < 0 ? 1 : 0;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    CrispyStageFunc stage;
+
+    stage = crispy_stage_main;
+    return crispy_pipeline_run(&stage, &argc, &argv, 1);
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/crispy
+
+/*
+ * stage-grep.c - Pipeline stage: keep lines containing a string
+ *
+ * Middle stage of the pipeline benchmark in docs/scripting.md.
+ *
+ *   seq 100 | crispy examples/stage-grep.c 7
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <crispy-runtime.h>
+
+gint
+crispy_stage_main(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    CrispyWriter *out;
+    const gchar *needle;
+    gchar *line;
+    gsize len;
+
+    if (argc < 2)
+    {
+        g_printerr("Usage: %s STRING\n", argv[0]);
+        return 2;
+    }
+    needle = argv[1];
+    out = crispy_stage_get_output(stage);
+
+    while ((line = crispy_stage_read_line(stage, &len)) != NULL)
+    {
+        if (strstr(line, needle) == NULL)
+            continue;
+        crispy_writer_write(out, line, len);
+        crispy_writer_putc(out, '\n');
+    }
+
+    return 0;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    CrispyStageFunc stage;
+
+    stage = crispy_stage_main;
+    return crispy_pipeline_run(&stage, &argc, &argv, 1);
+}
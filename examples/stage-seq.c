@@ -0,0 +1,51 @@
+#!/usr/bin/crispy
+
+/*
+ * stage-seq.c - Pipeline stage: print the numbers 1..N, one per line
+ *
+ * First stage of the pipeline benchmark in docs/scripting.md.  Runs
+ * alone, in a shell pipeline or as a stage of `crispy --pipeline`:
+ *
+ *   crispy examples/stage-seq.c 1000000 | crispy examples/stage-grep.c 7
+ *   crispy --pipeline 'examples/stage-seq.c 1000000' \
+ *       'examples/stage-grep.c 7' examples/stage-count.c
+ */
+
+#include <glib.h>
+#include <crispy-runtime.h>
+
+gint
+crispy_stage_main(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    CrispyWriter *out;
+    gint64 n;
+    gint64 i;
+
+    n = argc > 1 ? g_ascii_strtoll(argv[1], NULL, 10) : 1000000;
+    out = crispy_stage_get_output(stage);
+
+    for (i = 1; i <= n; i++)
+    {
+        crispy_writer_printf(out, "%" G_GINT64_FORMAT "\n", i);
+
+        /* stop once the next stage has stopped reading */
+        if ((i & 0xffff) == 0 && !crispy_writer_flush(out))
+            break;
+    }
+
+    return 0;
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    CrispyStageFunc stage;
+
+    stage = crispy_stage_main;
+    return crispy_pipeline_run(&stage, &argc, &argv, 1);
+}
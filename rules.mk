@@ -2,7 +2,7 @@
 # Pattern rules and common build recipes
 
 # All source objects depend on the generated version header
-$(LIB_OBJS) $(MAIN_OBJ): src/crispy-version.h
+$(LIB_OBJS) $(RUNTIME_OBJS) $(MAIN_OBJ): src/crispy-version.h
 
 # main.o depends on generated headers
 $(MAIN_OBJ): $(OUTDIR)/crispy-default-config.h
@@ -21,11 +21,20 @@ $(OBJDIR)/interfaces/%.o: src/interfaces/%.c | $(OBJDIR)
 	@$(MKDIR_P) $(dir $@)
 	$(CC) $(CFLAGS) -c $< -o $@
 
+$(OBJDIR)/runtime/%.o: src/runtime/%.c | $(OBJDIR)
+	@$(MKDIR_P) $(dir $@)
+	$(CC) $(CFLAGS) -c $< -o $@
+
 # Test compilation
 $(OBJDIR)/tests/%.o: tests/%.c | $(OBJDIR)
 	@$(MKDIR_P) $(dir $@)
 	$(CC) $(TEST_CFLAGS) -c $< -o $@
 
+# Benchmark driver compilation
+$(OBJDIR)/bench/%.o: bench/%.c | $(OBJDIR)
+	@$(MKDIR_P) $(dir $@)
+	$(CC) $(TEST_CFLAGS) -c $< -o $@
+
 # Static library creation
 $(OUTDIR)/$(LIB_STATIC): $(LIB_OBJS)
 	@$(MKDIR_P) $(dir $@)
@@ -38,6 +47,13 @@ $(OUTDIR)/$(LIB_SHARED_FULL): $(LIB_OBJS)
 	cd $(OUTDIR) && ln -sf $(LIB_SHARED_FULL) $(LIB_SHARED_MAJOR)
 	cd $(OUTDIR) && ln -sf $(LIB_SHARED_MAJOR) $(LIB_SHARED)
 
+# Script runtime shared library (depends on glib only)
+$(OUTDIR)/$(RUNTIME_SHARED_FULL): $(RUNTIME_OBJS)
+	@$(MKDIR_P) $(dir $@)
+	$(CC) $(LDFLAGS_RUNTIME_SHARED) -o $@ $^ $(LDFLAGS_RUNTIME)
+	cd $(OUTDIR) && ln -sf $(RUNTIME_SHARED_FULL) $(RUNTIME_SHARED_MAJOR)
+	cd $(OUTDIR) && ln -sf $(RUNTIME_SHARED_MAJOR) $(RUNTIME_SHARED)
+
 # Executable linking
 $(OUTDIR)/crispy: $(OBJDIR)/main.o $(OUTDIR)/$(LIB_SHARED_FULL)
 	$(CC) -o $@ $(OBJDIR)/main.o -L$(OUTDIR) -lcrispy $(LDFLAGS) -Wl,-rpath,'$$ORIGIN'
@@ -69,6 +85,7 @@ $(OBJDIR):
 	@$(MKDIR_P) $(OBJDIR)
 	@$(MKDIR_P) $(OBJDIR)/core
 	@$(MKDIR_P) $(OBJDIR)/interfaces
+	@$(MKDIR_P) $(OBJDIR)/runtime
 	@$(MKDIR_P) $(OBJDIR)/tests
 
 $(OUTDIR):
@@ -138,12 +155,15 @@ install-bin: $(MAIN_OBJ) $(OUTDIR)/$(LIB_SHARED_FULL)
 	$(CC) -o $(DESTDIR)$(BINDIR)/crispy $(MAIN_OBJ) \
 		-L$(OUTDIR) -lcrispy $(LDFLAGS) -Wl,-rpath,$(LIBDIR)
 
-install-lib: $(OUTDIR)/$(LIB_STATIC) $(OUTDIR)/$(LIB_SHARED_FULL)
+install-lib: $(OUTDIR)/$(LIB_STATIC) $(OUTDIR)/$(LIB_SHARED_FULL) $(OUTDIR)/$(RUNTIME_SHARED_FULL)
 	$(MKDIR_P) $(DESTDIR)$(LIBDIR)
 	$(INSTALL_PROGRAM) $(OUTDIR)/$(LIB_SHARED_FULL) $(DESTDIR)$(LIBDIR)/
 	$(INSTALL_DATA) $(OUTDIR)/$(LIB_STATIC) $(DESTDIR)$(LIBDIR)/
 	cd $(DESTDIR)$(LIBDIR) && ln -sf $(LIB_SHARED_FULL) $(LIB_SHARED_MAJOR)
 	cd $(DESTDIR)$(LIBDIR) && ln -sf $(LIB_SHARED_MAJOR) $(LIB_SHARED)
+	$(INSTALL_PROGRAM) $(OUTDIR)/$(RUNTIME_SHARED_FULL) $(DESTDIR)$(LIBDIR)/
+	cd $(DESTDIR)$(LIBDIR) && ln -sf $(RUNTIME_SHARED_FULL) $(RUNTIME_SHARED_MAJOR)
+	cd $(DESTDIR)$(LIBDIR) && ln -sf $(RUNTIME_SHARED_MAJOR) $(RUNTIME_SHARED)
 	-ldconfig 2>/dev/null || true
 
 install-headers:
@@ -152,6 +172,9 @@ install-headers:
 	$(INSTALL_DATA) src/crispy-types.h $(DESTDIR)$(INCLUDEDIR)/crispy/
 	$(INSTALL_DATA) src/crispy-version.h $(DESTDIR)$(INCLUDEDIR)/crispy/
 	$(INSTALL_DATA) src/crispy-plugin.h $(DESTDIR)$(INCLUDEDIR)/crispy/
+	$(INSTALL_DATA) src/crispy-runtime.h $(DESTDIR)$(INCLUDEDIR)/crispy/
+	$(MKDIR_P) $(DESTDIR)$(INCLUDEDIR)/crispy/runtime
+	$(INSTALL_DATA) src/runtime/*.h $(DESTDIR)$(INCLUDEDIR)/crispy/runtime/
 	$(MKDIR_P) $(DESTDIR)$(INCLUDEDIR)/crispy/interfaces
 	$(INSTALL_DATA) src/interfaces/*.h $(DESTDIR)$(INCLUDEDIR)/crispy/interfaces/
 	$(MKDIR_P) $(DESTDIR)$(INCLUDEDIR)/crispy/core
@@ -182,6 +205,9 @@ uninstall:
 	rm -f $(DESTDIR)$(LIBDIR)/$(LIB_SHARED_FULL)
 	rm -f $(DESTDIR)$(LIBDIR)/$(LIB_SHARED_MAJOR)
 	rm -f $(DESTDIR)$(LIBDIR)/$(LIB_SHARED)
+	rm -f $(DESTDIR)$(LIBDIR)/$(RUNTIME_SHARED_FULL)
+	rm -f $(DESTDIR)$(LIBDIR)/$(RUNTIME_SHARED_MAJOR)
+	rm -f $(DESTDIR)$(LIBDIR)/$(RUNTIME_SHARED)
 	rm -rf $(DESTDIR)$(INCLUDEDIR)/crispy
 	rm -f $(DESTDIR)$(PKGCONFIGDIR)/crispy.pc
 	rm -f $(DESTDIR)$(GIRDIR)/$(GIR_FILE)
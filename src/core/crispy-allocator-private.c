@@ -0,0 +1,237 @@
+/* crispy-allocator-private.c - Internal malloc replacement via LD_PRELOAD */
+
+#define _GNU_SOURCE
+#define CRISPY_COMPILATION
+#include "crispy-allocator-private.h"
+#include "../crispy-types.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/* set across the re-exec; removed again by crispy_allocator_startup() */
+#define ENV_ACTIVE          "CRISPY_ALLOCATOR_ACTIVE"
+#define ENV_SAVED_PRELOAD   "CRISPY_ALLOCATOR_SAVED_PRELOAD"
+
+typedef struct
+{
+    const gchar *name;
+    const gchar *libraries[4];
+} KnownAllocator;
+
+static const KnownAllocator known_allocators[] =
+{
+    { "mimalloc", { "libmimalloc.so.2", "libmimalloc.so", NULL } },
+    { "jemalloc", { "libjemalloc.so.2", "libjemalloc.so", NULL } },
+    { "tcmalloc", { "libtcmalloc_minimal.so.4", "libtcmalloc.so.4",
+                    "libtcmalloc_minimal.so", NULL } },
+    { "tbbmalloc", { "libtbbmalloc_proxy.so.2", "libtbbmalloc_proxy.so", NULL } },
+};
+
+static const gchar *system_lib_dirs[] =
+{
+    "/usr/local/lib64", "/usr/local/lib", "/usr/lib64", "/usr/lib",
+    "/lib64", "/lib", NULL
+};
+
+static const gchar *active_allocator = NULL;
+static gboolean     reexecuted = FALSE;
+
+/* --- helper: NULL, "", "system" and "glibc" mean no preload --- */
+static gboolean
+is_system_allocator(
+    const gchar *name
+){
+    return name == NULL || name[0] == '\0' ||
+           g_ascii_strcasecmp(name, "system") == 0 ||
+           g_ascii_strcasecmp(name, "glibc") == 0;
+}
+
+/* --- helper: append the directory of the object defining @addr --- */
+static void
+add_dir_of(
+    GPtrArray     *dirs,
+    gconstpointer  addr
+){
+    Dl_info info;
+
+    if (dladdr(addr, &info) != 0 && info.dli_fname != NULL &&
+        g_path_is_absolute(info.dli_fname))
+        g_ptr_array_add(dirs, g_path_get_dirname(info.dli_fname));
+}
+
+/* --- public API --- */
+
+void
+crispy_allocator_startup(void)
+{
+    g_auto(GStrv) preload = NULL;
+    const gchar *active;
+    const gchar *saved;
+    void *handle;
+
+    active = g_getenv(ENV_ACTIVE);
+    if (active == NULL)
+        return;
+
+    reexecuted = TRUE;
+
+    /* crispy_allocator_select() put the allocator first */
+    preload = g_strsplit(g_getenv("LD_PRELOAD") != NULL ?
+                         g_getenv("LD_PRELOAD") : "", ":", 2);
+    if (preload[0] != NULL)
+    {
+        handle = dlopen(preload[0], RTLD_LAZY | RTLD_NOLOAD);
+        if (handle != NULL)
+        {
+            active_allocator = g_intern_string(active);
+            dlclose(handle);
+        }
+    }
+
+    saved = g_getenv(ENV_SAVED_PRELOAD);
+    if (saved != NULL)
+        g_setenv("LD_PRELOAD", saved, TRUE);
+    else
+        g_unsetenv("LD_PRELOAD");
+    g_unsetenv(ENV_SAVED_PRELOAD);
+    g_unsetenv(ENV_ACTIVE);
+}
+
+gchar *
+crispy_allocator_find(
+    const gchar  *name,
+    GError      **error
+){
+    g_autoptr(GPtrArray) dirs = NULL;
+    g_autofree gchar *fallback = NULL;
+    const gchar * const *libraries;
+    const gchar *single[2];
+    const gchar *env;
+    gchar *path;
+    guint i;
+    guint d;
+
+    g_return_val_if_fail(name != NULL, NULL);
+
+    if (strchr(name, '/') != NULL)
+    {
+        if (g_file_test(name, G_FILE_TEST_IS_REGULAR))
+            return g_canonicalize_filename(name, NULL);
+
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                    "Allocator library '%s' does not exist", name);
+        return NULL;
+    }
+
+    /* "foo" is "libfoo.so" unless it is one of the well-known ones */
+    fallback = g_str_has_prefix(name, "lib") ? g_strdup(name)
+                                             : g_strdup_printf("lib%s.so", name);
+    single[0] = fallback;
+    single[1] = NULL;
+    libraries = single;
+    for (i = 0; i < G_N_ELEMENTS(known_allocators); i++)
+    {
+        if (g_ascii_strcasecmp(name, known_allocators[i].name) == 0)
+            libraries = known_allocators[i].libraries;
+    }
+
+    dirs = g_ptr_array_new_with_free_func(g_free);
+    env = g_getenv("LD_LIBRARY_PATH");
+    if (env != NULL)
+    {
+        g_auto(GStrv) parts = NULL;
+
+        parts = g_strsplit(env, ":", -1);
+        for (d = 0; parts[d] != NULL; d++)
+        {
+            if (parts[d][0] != '\0')
+                g_ptr_array_add(dirs, g_strdup(parts[d]));
+        }
+    }
+    add_dir_of(dirs, (gconstpointer)&strlen);
+    add_dir_of(dirs, (gconstpointer)&g_malloc);
+    for (d = 0; system_lib_dirs[d] != NULL; d++)
+        g_ptr_array_add(dirs, g_strdup(system_lib_dirs[d]));
+
+    for (i = 0; libraries[i] != NULL; i++)
+    {
+        for (d = 0; d < dirs->len; d++)
+        {
+            path = g_build_filename(g_ptr_array_index(dirs, d),
+                                    libraries[i], NULL);
+            if (g_file_test(path, G_FILE_TEST_EXISTS))
+                return path;
+            g_free(path);
+        }
+    }
+
+    g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                "Allocator '%s' is not installed (looked for %s)",
+                name, libraries[0]);
+    return NULL;
+}
+
+gboolean
+crispy_allocator_select(
+    const gchar  *name,
+    gchar       **argv,
+    GError      **error
+){
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *preload = NULL;
+    g_autofree gchar *saved = NULL;
+    const gchar *old;
+    gint saved_errno;
+
+    g_return_val_if_fail(argv != NULL, FALSE);
+
+    if (is_system_allocator(name))
+        return TRUE;
+    if (active_allocator != NULL && g_ascii_strcasecmp(active_allocator, name) == 0)
+        return TRUE;
+
+    /* never re-exec twice: the first attempt did not take */
+    if (reexecuted)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                    "Allocator '%s' could not be preloaded", name);
+        return FALSE;
+    }
+
+    path = crispy_allocator_find(name, error);
+    if (path == NULL)
+        return FALSE;
+
+    old = g_getenv("LD_PRELOAD");
+    saved = g_strdup(old);
+    preload = old != NULL && old[0] != '\0'
+              ? g_strconcat(path, ":", old, NULL) : g_strdup(path);
+    if (saved != NULL)
+        g_setenv(ENV_SAVED_PRELOAD, saved, TRUE);
+    g_setenv(ENV_ACTIVE, name, TRUE);
+    g_setenv("LD_PRELOAD", preload, TRUE);
+
+    execv("/proc/self/exe", argv);
+
+    /* still here: undo the environment and carry on with glibc */
+    saved_errno = errno;
+    if (saved != NULL)
+        g_setenv("LD_PRELOAD", saved, TRUE);
+    else
+        g_unsetenv("LD_PRELOAD");
+    g_unsetenv(ENV_SAVED_PRELOAD);
+    g_unsetenv(ENV_ACTIVE);
+
+    g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                "Failed to re-execute with allocator '%s': %s",
+                name, g_strerror(saved_errno));
+    return FALSE;
+}
+
+const gchar *
+crispy_allocator_get_active(void)
+{
+    return active_allocator;
+}
@@ -0,0 +1,74 @@
+/* crispy-allocator-private.h - Internal malloc replacement via LD_PRELOAD */
+
+/*
+ * Support for --allocator, CRISPY_ALLOCATOR and the config default:
+ * a replacement malloc only takes over a process if it is loaded
+ * before libc, so crispy re-executes itself once with the allocator in
+ * LD_PRELOAD.  Used by the crispy binary; CrispyScript reports the
+ * active allocator to plugins.  This header is NOT installed or
+ * included in the public umbrella header.
+ */
+
+#ifndef CRISPY_ALLOCATOR_PRIVATE_H
+#define CRISPY_ALLOCATOR_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * crispy_allocator_startup:
+ *
+ * Called first thing in main().  If this process is the re-execution
+ * started by crispy_allocator_select(), checks that the allocator was
+ * really preloaded and restores LD_PRELOAD to what it was, so programs
+ * the script runs do not inherit the allocator.
+ */
+void         crispy_allocator_startup     (void);
+
+/**
+ * crispy_allocator_find:
+ * @name: "mimalloc", "jemalloc", "tcmalloc", "tbbmalloc", another
+ *   library name, or a path to a shared object
+ * @error: (nullable): return location for a #GError
+ *
+ * Finds the shared object providing @name in LD_LIBRARY_PATH, the
+ * directories libc and glib were loaded from, and the usual system
+ * library directories.
+ *
+ * Returns: (transfer full) (nullable): absolute path of the library,
+ *   or %NULL with %CRISPY_ERROR_LOAD
+ */
+gchar       *crispy_allocator_find        (const gchar  *name,
+                                           GError      **error);
+
+/**
+ * crispy_allocator_select:
+ * @name: (nullable): allocator to use; %NULL, "", "system" and
+ *   "glibc" mean the system allocator
+ * @argv: crispy's original, unmodified argv
+ * @error: (nullable): return location for a #GError
+ *
+ * Makes @name the process allocator.  If it is not already active,
+ * this re-executes /proc/self/exe with @argv and the allocator in
+ * LD_PRELOAD and does not return.  It is called once, after the
+ * config is loaded and before anything else is started.
+ *
+ * Returns: %TRUE if @name is active; %FALSE with %CRISPY_ERROR_LOAD if
+ *   it cannot be found or preloaded, leaving the system allocator
+ */
+gboolean     crispy_allocator_select      (const gchar  *name,
+                                           gchar       **argv,
+                                           GError      **error);
+
+/**
+ * crispy_allocator_get_active:
+ *
+ * Returns: (nullable): name of the preloaded allocator, or %NULL for
+ *   the system allocator
+ */
+const gchar *crispy_allocator_get_active  (void);
+
+G_END_DECLS
+
+#endif /* CRISPY_ALLOCATOR_PRIVATE_H */
@@ -0,0 +1,539 @@
+/* crispy-bench-private.c - Internal repeated runs and timing statistics */
+
+#define _GNU_SOURCE
+#define CRISPY_COMPILATION
+#include "crispy-bench-private.h"
+#include "crispy-script-private.h"
+#include "../crispy-types.h"
+
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* one --bench sample should take at least this long */
+#define BENCH_SAMPLE_NS     (10 * 1000 * 1000)
+#define BENCH_MAX_ITERS     (G_GUINT64_CONSTANT(1) << 40)
+
+typedef struct
+{
+    const gchar *name;
+    const gchar *flags;
+} BenchProfile;
+
+static const BenchProfile bench_profiles[] =
+{
+    { "debug",  "-O0 -g" },
+    { "fast",   "-O2" },
+    { "O3",     "-O3" },
+    { "size",   "-Os" },
+    { "native", "-O2 -march=native" },
+    { "lto",    "-O2 -flto" },
+};
+
+/* two-sided 95% quantiles of Student's t for 1..30 degrees of freedom */
+static const gdouble t_quantiles[] =
+{
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+/*
+ * --- helper: one crispy_script_run() in a forked child ---
+ *
+ * The exit code comes back through the child's exit status, so only
+ * its low 8 bits survive: a main() returning -1 reports 255.
+ */
+static gboolean
+run_in_child(
+    CrispyScript  *script,
+    gint           argc,
+    gchar        **argv,
+    gint64        *time_execute,
+    gint          *exit_code,
+    GError       **error
+){
+    gboolean ran;
+    gint fds[2];
+    gint status;
+    gint code;
+    gssize got;
+    pid_t pid;
+
+    if (pipe(fds) != 0)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to create pipe: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    /* the child must not print the parent's buffered output again */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to fork: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        ran = crispy_script_run_internal(script, argc, argv, &code, NULL);
+        crispy_script_flush_output_internal(script);
+        if (!ran)
+            _exit(255);
+
+        /* no time on the pipe tells the parent the run failed */
+        *time_execute = crispy_script_get_time_execute_internal(script);
+        if (write(fds[1], time_execute, sizeof(*time_execute)) < 0)
+            _exit(255);
+        _exit(code);
+    }
+
+    close(fds[1]);
+    got = read(fds[0], time_execute, sizeof(*time_execute));
+    close(fds[0]);
+
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    if (got != (gssize)sizeof(*time_execute) || !WIFEXITED(status))
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                    "Forked run did not complete");
+        return FALSE;
+    }
+
+    *exit_code = WEXITSTATUS(status);
+    return TRUE;
+}
+
+static gint
+compare_gint64(
+    gconstpointer a,
+    gconstpointer b
+){
+    gint64 x;
+    gint64 y;
+
+    x = *(const gint64 *)a;
+    y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* --- helper: nearest-rank percentile of sorted @samples --- */
+static gdouble
+percentile(
+    GArray  *samples,
+    gdouble  p
+){
+    guint rank;
+
+    rank = (guint)ceil(p * samples->len);
+    if (rank < 1)
+        rank = 1;
+    if (rank > samples->len)
+        rank = samples->len;
+
+    return (gdouble)g_array_index(samples, gint64, rank - 1);
+}
+
+/* --- helper: wall time of one call of @func, in nanoseconds --- */
+static gint64
+time_call(
+    CrispyBenchmarkFunc func,
+    guint64             n_iters
+){
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    func(n_iters);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (gint64)(end.tv_sec - start.tv_sec) * G_GINT64_CONSTANT(1000000000) +
+           (end.tv_nsec - start.tv_nsec);
+}
+
+/* --- helper: append @value as a JSON string --- */
+static void
+append_json_string(
+    GString     *out,
+    const gchar *value
+){
+    const gchar *p;
+
+    g_string_append_c(out, '"');
+    for (p = value; *p != '\0'; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf(out, "\\%c", *p);
+        else if ((guchar)*p < 0x20)
+            g_string_append_printf(out, "\\u%04x", (guint)(guchar)*p);
+        else
+            g_string_append_c(out, *p);
+    }
+    g_string_append_c(out, '"');
+}
+
+/* --- helper: append "key": value with three decimals, locale-free --- */
+static void
+append_json_double(
+    GString     *out,
+    const gchar *key,
+    gdouble      value
+){
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf(out, ", \"%s\": %s", key,
+                           g_ascii_formatd(buf, sizeof(buf), "%.3f", value));
+}
+
+/* --- public API --- */
+
+gboolean
+crispy_bench_repeat(
+    CrispyScript  *script,
+    gint           argc,
+    gchar        **argv,
+    guint          n_runs,
+    gboolean       fork_each,
+    GArray        *samples,
+    gint          *exit_code,
+    GError       **error
+){
+    gint64 time_execute;
+    guint i;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(script), FALSE);
+    g_return_val_if_fail(samples != NULL, FALSE);
+    g_return_val_if_fail(exit_code != NULL, FALSE);
+
+    *exit_code = 0;
+    for (i = 0; i < n_runs; i++)
+    {
+        if (fork_each)
+        {
+            if (!run_in_child(script, argc, argv, &time_execute,
+                              exit_code, error))
+                return FALSE;
+        }
+        else
+        {
+            /* a negative exit code is a sample like any other */
+            if (!crispy_script_run_internal(script, argc, argv, exit_code,
+                                            error))
+                return FALSE;
+            time_execute = crispy_script_get_time_execute_internal(script);
+        }
+
+        g_array_append_val(samples, time_execute);
+    }
+
+    crispy_script_flush_output_internal(script);
+    return TRUE;
+}
+
+void
+crispy_bench_compute_stats(
+    GArray           *samples,
+    CrispyBenchStats *stats
+){
+    gdouble sum;
+    gdouble delta;
+    gdouble squares;
+    guint n;
+    guint i;
+
+    g_return_if_fail(samples != NULL && samples->len > 0);
+
+    g_array_sort(samples, compare_gint64);
+    n = samples->len;
+
+    sum = 0.0;
+    for (i = 0; i < n; i++)
+        sum += (gdouble)g_array_index(samples, gint64, i);
+
+    squares = 0.0;
+    for (i = 0; i < n; i++)
+    {
+        delta = (gdouble)g_array_index(samples, gint64, i) - sum / n;
+        squares += delta * delta;
+    }
+
+    stats->n_runs = n;
+    stats->min = (gdouble)g_array_index(samples, gint64, 0);
+    if (n % 2 == 1)
+        stats->median = (gdouble)g_array_index(samples, gint64, n / 2);
+    else
+        stats->median = ((gdouble)g_array_index(samples, gint64, n / 2 - 1) +
+                         (gdouble)g_array_index(samples, gint64, n / 2)) / 2.0;
+    stats->p95 = percentile(samples, 0.95);
+    stats->p99 = percentile(samples, 0.99);
+    stats->mean = sum / n;
+    stats->stddev = n > 1 ? sqrt(squares / (n - 1)) : 0.0;
+}
+
+gboolean
+crispy_bench_parse_profile(
+    const gchar  *spec,
+    gchar       **name,
+    gchar       **flags,
+    GError      **error
+){
+    const gchar *equals;
+    guint i;
+
+    g_return_val_if_fail(spec != NULL, FALSE);
+
+    equals = strchr(spec, '=');
+    if (equals != NULL && equals != spec)
+    {
+        *name = g_strndup(spec, (gsize)(equals - spec));
+        *flags = g_strdup(equals + 1);
+        return TRUE;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(bench_profiles); i++)
+    {
+        if (strcmp(spec, bench_profiles[i].name) == 0)
+        {
+            *name = g_strdup(bench_profiles[i].name);
+            *flags = g_strdup(bench_profiles[i].flags);
+            return TRUE;
+        }
+    }
+
+    g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PARAMS,
+                "Unknown profile '%s' (expected debug, fast, O3, size, "
+                "native, lto or NAME=FLAGS)", spec);
+    return FALSE;
+}
+
+gchar **
+crispy_bench_find_benchmarks(
+    const gchar *source
+){
+    g_autoptr(GPtrArray) names = NULL;
+    g_auto(GStrv) lines = NULL;
+    const gchar *p;
+    const gchar *start;
+    gchar *name;
+    guint i;
+
+    names = g_ptr_array_new_with_free_func(g_free);
+    if (source != NULL && strstr(source, "CRISPY_BENCHMARK") != NULL)
+    {
+        lines = g_strsplit(source, "\n", -1);
+        for (i = 0; lines[i] != NULL; i++)
+        {
+            p = lines[i];
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (!g_str_has_prefix(p, "CRISPY_BENCHMARK"))
+                continue;
+            p += strlen("CRISPY_BENCHMARK");
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p != '(')
+                continue;
+            p++;
+            while (*p == ' ' || *p == '\t')
+                p++;
+
+            start = p;
+            while (g_ascii_isalnum(*p) || *p == '_')
+                p++;
+            if (p == start || g_ascii_isdigit(*start))
+                continue;
+
+            name = g_strndup(start, (gsize)(p - start));
+            if (g_ptr_array_find_with_equal_func(names, name, g_str_equal, NULL))
+                g_free(name);
+            else
+                g_ptr_array_add(names, name);
+        }
+    }
+
+    g_ptr_array_add(names, NULL);
+    return (gchar **)g_ptr_array_free(g_steal_pointer(&names), FALSE);
+}
+
+gboolean
+crispy_bench_pin(
+    CrispyPlacement  *placement,
+    gchar           **applied_cpus,
+    GError          **error
+){
+    gint cpu;
+
+    g_return_val_if_fail(placement != NULL, FALSE);
+
+    if (placement->cpus == NULL && placement->numa_node < 0)
+    {
+        cpu = sched_getcpu();
+        if (cpu >= 0)
+            placement->cpus = g_strdup_printf("%d", cpu);
+    }
+
+    return crispy_placement_apply(placement, applied_cpus, error);
+}
+
+void
+crispy_bench_measure(
+    CrispyBenchmarkFunc  func,
+    guint                n_samples,
+    CrispyBenchResult   *result
+){
+    g_autoptr(GArray) samples = NULL;
+    gdouble scale;
+    gdouble half_width;
+    guint64 iterations;
+    guint64 next;
+    gint64 elapsed;
+    guint i;
+
+    g_return_if_fail(func != NULL);
+    g_return_if_fail(result != NULL);
+
+    if (n_samples < 2)
+        n_samples = 2;
+
+    /* calibrate: aim 20% past the target, growing at most 10x a step */
+    iterations = 1;
+    for (;;)
+    {
+        elapsed = time_call(func, iterations);
+        if (elapsed >= BENCH_SAMPLE_NS || iterations >= BENCH_MAX_ITERS)
+            break;
+
+        scale = elapsed > 0 ? (BENCH_SAMPLE_NS * 1.2) / elapsed : 10.0;
+        if (scale > 10.0)
+            scale = 10.0;
+        next = (guint64)(iterations * scale);
+        iterations = next > iterations ? MIN(next, BENCH_MAX_ITERS)
+                                       : iterations + 1;
+    }
+
+    samples = g_array_sized_new(FALSE, FALSE, sizeof(gint64), n_samples);
+    for (i = 0; i < n_samples; i++)
+    {
+        elapsed = time_call(func, iterations);
+        g_array_append_val(samples, elapsed);
+    }
+
+    /* totals per sample, scaled down to one iteration */
+    crispy_bench_compute_stats(samples, &result->stats);
+    result->stats.min /= iterations;
+    result->stats.median /= iterations;
+    result->stats.p95 /= iterations;
+    result->stats.p99 /= iterations;
+    result->stats.mean /= iterations;
+    result->stats.stddev /= iterations;
+    result->iterations = iterations;
+
+    half_width = (n_samples - 1 <= G_N_ELEMENTS(t_quantiles)
+                  ? t_quantiles[n_samples - 2] : 1.960) *
+                 result->stats.stddev / sqrt((gdouble)n_samples);
+    result->ci_low = result->stats.mean - half_width;
+    result->ci_high = result->stats.mean + half_width;
+}
+
+gchar *
+crispy_bench_runs_to_json(
+    const gchar *script,
+    gboolean     forked,
+    GArray      *results
+){
+    CrispyBenchRunResult *result;
+    GString *out;
+    guint i;
+
+    g_return_val_if_fail(results != NULL, NULL);
+
+    out = g_string_new("{\n  \"script\": ");
+    if (script != NULL)
+        append_json_string(out, script);
+    else
+        g_string_append(out, "null");
+    g_string_append_printf(out, ",\n  \"forked\": %s,\n  \"profiles\": [\n",
+                           forked ? "true" : "false");
+
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CrispyBenchRunResult, i);
+        g_string_append(out, "    {\"name\": ");
+        if (result->name != NULL)
+            append_json_string(out, result->name);
+        else
+            g_string_append(out, "null");
+        g_string_append_printf(out, ", \"runs\": %u, \"exit_code\": %d",
+                               result->stats.n_runs, result->exit_code);
+        append_json_double(out, "min_us", result->stats.min);
+        append_json_double(out, "median_us", result->stats.median);
+        append_json_double(out, "p95_us", result->stats.p95);
+        append_json_double(out, "p99_us", result->stats.p99);
+        append_json_double(out, "mean_us", result->stats.mean);
+        append_json_double(out, "stddev_us", result->stats.stddev);
+        g_string_append(out, i + 1 < results->len ? "},\n" : "}\n");
+    }
+
+    g_string_append(out, "  ]\n}\n");
+    return g_string_free(out, FALSE);
+}
+
+gchar *
+crispy_bench_results_to_json(
+    const gchar *script,
+    const gchar *cpus,
+    GArray      *results
+){
+    CrispyBenchResult *result;
+    GString *out;
+    guint i;
+
+    g_return_val_if_fail(results != NULL, NULL);
+
+    out = g_string_new("{\n  \"script\": ");
+    if (script != NULL)
+        append_json_string(out, script);
+    else
+        g_string_append(out, "null");
+    g_string_append(out, ",\n  \"cpus\": ");
+    if (cpus != NULL)
+        append_json_string(out, cpus);
+    else
+        g_string_append(out, "null");
+    g_string_append(out, ",\n  \"benchmarks\": [\n");
+
+    for (i = 0; i < results->len; i++)
+    {
+        result = &g_array_index(results, CrispyBenchResult, i);
+        g_string_append(out, "    {\"name\": ");
+        append_json_string(out, result->name);
+        g_string_append_printf(out, ", \"iterations\": %" G_GUINT64_FORMAT
+                               ", \"samples\": %u",
+                               result->iterations, result->stats.n_runs);
+        append_json_double(out, "ns_per_op", result->stats.mean);
+        append_json_double(out, "ci95_low", result->ci_low);
+        append_json_double(out, "ci95_high", result->ci_high);
+        append_json_double(out, "min", result->stats.min);
+        append_json_double(out, "median", result->stats.median);
+        append_json_double(out, "stddev", result->stats.stddev);
+        g_string_append(out, i + 1 < results->len ? "},\n" : "}\n");
+    }
+
+    g_string_append(out, "  ]\n}\n");
+    return g_string_free(out, FALSE);
+}
@@ -0,0 +1,221 @@
+/* crispy-bench-private.h - Internal repeated runs and timing statistics */
+
+/*
+ * Support for --repeat and --profiles: runs a prepared script's main()
+ * many times, in the loaded module or in a forked child per run, and
+ * summarizes the time_execute of each run.  Also runs the functions a
+ * script defines with CRISPY_BENCHMARK() for --bench.  Used by the
+ * crispy binary.  This header is NOT installed or included in the
+ * public umbrella header.
+ */
+
+#ifndef CRISPY_BENCH_PRIVATE_H
+#define CRISPY_BENCH_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+#include "crispy-placement-private.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyBenchStats:
+ * @n_runs: number of samples
+ * @min: fastest run
+ * @median: median run
+ * @p95: 95th percentile (nearest rank)
+ * @p99: 99th percentile (nearest rank)
+ * @mean: arithmetic mean
+ * @stddev: sample standard deviation, 0 for a single run
+ *
+ * Summary of a set of run times, in the unit of the samples:
+ * microseconds for crispy_bench_repeat(), nanoseconds per operation
+ * for crispy_bench_measure().
+ */
+typedef struct
+{
+    guint   n_runs;
+    gdouble min;
+    gdouble median;
+    gdouble p95;
+    gdouble p99;
+    gdouble mean;
+    gdouble stddev;
+} CrispyBenchStats;
+
+/**
+ * crispy_bench_repeat:
+ * @script: a prepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @n_runs: number of runs
+ * @fork_each: run each main() in a forked child, for scripts that
+ *   keep state between calls
+ * @samples: (element-type gint64): receives the time_execute of each
+ *   run in microseconds
+ * @exit_code: (out): exit code of the last run; with @fork_each only
+ *   modulo 256, as for any process
+ * @error: (nullable): return location for a #GError
+ *
+ * Calls crispy_script_run() @n_runs times.  In-process runs share the
+ * module's globals, exactly as a second call to main() would.  With
+ * @fork_each every run starts from the state right after loading.
+ * PRE_EXECUTE and POST_EXECUTE fire for every run.
+ *
+ * Returns: %TRUE if every run completed, whatever its exit code.  An
+ *   in-process run aborted by a plugin fails without setting @error.
+ */
+gboolean crispy_bench_repeat       (CrispyScript      *script,
+                                    gint               argc,
+                                    gchar            **argv,
+                                    guint              n_runs,
+                                    gboolean           fork_each,
+                                    GArray            *samples,
+                                    gint              *exit_code,
+                                    GError           **error);
+
+/**
+ * crispy_bench_compute_stats:
+ * @samples: (element-type gint64): run times in microseconds
+ * @stats: (out caller-allocates): the summary
+ *
+ * Fills @stats from @samples, which must not be empty.  @samples is
+ * left sorted.
+ */
+void     crispy_bench_compute_stats (GArray           *samples,
+                                     CrispyBenchStats *stats);
+
+/**
+ * crispy_bench_parse_profile:
+ * @spec: "debug", "fast", "O3", "size", "native", "lto", or
+ *   "NAME=FLAGS" for a custom profile
+ * @name: (out) (transfer full): profile name
+ * @flags: (out) (transfer full): compiler flags of the profile
+ * @error: (nullable): return location for a #GError
+ *
+ * Returns: %TRUE on success; %FALSE with %CRISPY_ERROR_PARAMS for an
+ *   unknown profile
+ */
+gboolean crispy_bench_parse_profile (const gchar       *spec,
+                                     gchar            **name,
+                                     gchar            **flags,
+                                     GError           **error);
+
+/**
+ * CrispyBenchRunResult:
+ * @name: (nullable): profile name, not owned; %NULL without --profiles
+ * @stats: time_execute of the runs in microseconds
+ * @exit_code: exit code of the last run
+ *
+ * Outcome of the --repeat runs of one build.
+ */
+typedef struct
+{
+    const gchar      *name;
+    CrispyBenchStats  stats;
+    gint              exit_code;
+} CrispyBenchRunResult;
+
+/**
+ * crispy_bench_runs_to_json:
+ * @script: (nullable): script path
+ * @forked: whether the runs used --repeat-fork
+ * @results: (element-type CrispyBenchRunResult): one entry per profile
+ *
+ * Formats @results as JSON with a fixed key order and one profile per
+ * line, as crispy_bench_results_to_json() does for --bench.  Times are
+ * in microseconds, under keys ending in "_us".
+ *
+ * Returns: (transfer full): the JSON document
+ */
+gchar   *crispy_bench_runs_to_json  (const gchar       *script,
+                                     gboolean           forked,
+                                     GArray            *results);
+
+/**
+ * CrispyBenchmarkFunc:
+ * @n_iters: number of times to run the code under test
+ *
+ * A function defined with CRISPY_BENCHMARK().
+ */
+typedef void (*CrispyBenchmarkFunc) (guint64 n_iters);
+
+/**
+ * CrispyBenchResult:
+ * @name: benchmark name, not owned
+ * @iterations: iterations per sample
+ * @stats: nanoseconds per iteration over the samples
+ * @ci_low: lower bound of the 95% confidence interval of the mean
+ * @ci_high: upper bound of the 95% confidence interval of the mean
+ *
+ * Outcome of crispy_bench_measure().
+ */
+typedef struct
+{
+    const gchar      *name;
+    guint64           iterations;
+    CrispyBenchStats  stats;
+    gdouble           ci_low;
+    gdouble           ci_high;
+} CrispyBenchResult;
+
+/**
+ * crispy_bench_find_benchmarks:
+ * @source: (nullable): script source
+ *
+ * Finds the names of the CRISPY_BENCHMARK() lines in @source, in
+ * source order and without duplicates.
+ *
+ * Returns: (transfer full): %NULL-terminated list of names, empty if
+ *   there are none
+ */
+gchar  **crispy_bench_find_benchmarks (const gchar       *source);
+
+/**
+ * crispy_bench_pin:
+ * @placement: placement from the command line, config and script
+ * @applied_cpus: (out) (transfer full): the CPU list benchmarks run on
+ * @error: (nullable): return location for a #GError
+ *
+ * Applies @placement.  Without a CPU list or NUMA node the calling
+ * thread is pinned to the CPU it is running on, so migrations do not
+ * add noise to the samples.
+ *
+ * Returns: %FALSE with %CRISPY_ERROR_PLACEMENT on failure
+ */
+gboolean crispy_bench_pin             (CrispyPlacement   *placement,
+                                       gchar            **applied_cpus,
+                                       GError           **error);
+
+/**
+ * crispy_bench_measure:
+ * @func: the benchmark
+ * @n_samples: number of samples, at least 2
+ * @result: (out caller-allocates): timings; @result->name is left alone
+ *
+ * Raises the iteration count until one call of @func takes at least
+ * 10 ms, then takes @n_samples timed calls with that count.  The
+ * calibration calls double as warm-up.
+ */
+void     crispy_bench_measure         (CrispyBenchmarkFunc  func,
+                                       guint                n_samples,
+                                       CrispyBenchResult   *result);
+
+/**
+ * crispy_bench_results_to_json:
+ * @script: (nullable): script path
+ * @cpus: (nullable): CPU list the benchmarks ran on
+ * @results: (element-type CrispyBenchResult): measured benchmarks
+ *
+ * Formats @results as JSON with a fixed key order and one benchmark per
+ * line, so that results of two commits can be compared with diff.
+ *
+ * Returns: (transfer full): the JSON document
+ */
+gchar   *crispy_bench_results_to_json (const gchar       *script,
+                                       const gchar       *cpus,
+                                       GArray            *results);
+
+G_END_DECLS
+
+#endif /* CRISPY_BENCH_PRIVATE_H */
@@ -53,6 +53,13 @@ crispy_config_context_init_internal(
     ctx->flags = 0;
     ctx->flags_set = FALSE;
     ctx->cache_dir = NULL;
+
+    ctx->cpus = NULL;
+    ctx->numa_node = -1;
+    ctx->sched = NULL;
+    ctx->allocator = NULL;
+    ctx->telemetry_log = NULL;
+    ctx->telemetry_metrics = NULL;
 }
 
 void
@@ -66,6 +73,11 @@ crispy_config_context_clear_internal(
     g_free(ctx->extra_flags);
     g_free(ctx->override_flags);
     g_free(ctx->cache_dir);
+    g_free(ctx->cpus);
+    g_free(ctx->sched);
+    g_free(ctx->allocator);
+    g_free(ctx->telemetry_log);
+    g_free(ctx->telemetry_metrics);
 
     if (ctx->plugin_paths != NULL)
         g_ptr_array_unref(ctx->plugin_paths);
@@ -235,6 +247,59 @@ crispy_config_context_set_cache_dir(
     ctx->cache_dir = g_strdup(cache_dir);
 }
 
+/* --- Execution placement --- */
+
+void
+crispy_config_context_set_cpus(
+    CrispyConfigContext *ctx,
+    const gchar         *cpus
+){
+    g_free(ctx->cpus);
+    ctx->cpus = g_strdup(cpus);
+}
+
+void
+crispy_config_context_set_numa_node(
+    CrispyConfigContext *ctx,
+    gint                 node
+){
+    ctx->numa_node = node >= 0 ? node : -1;
+}
+
+void
+crispy_config_context_set_sched(
+    CrispyConfigContext *ctx,
+    const gchar         *sched
+){
+    g_free(ctx->sched);
+    ctx->sched = g_strdup(sched);
+}
+
+/* --- Allocator --- */
+
+void
+crispy_config_context_set_allocator(
+    CrispyConfigContext *ctx,
+    const gchar         *allocator
+){
+    g_free(ctx->allocator);
+    ctx->allocator = g_strdup(allocator);
+}
+
+/* --- Telemetry --- */
+
+void
+crispy_config_context_set_telemetry(
+    CrispyConfigContext *ctx,
+    const gchar         *log_path,
+    const gchar         *metrics_path
+){
+    g_free(ctx->telemetry_log);
+    g_free(ctx->telemetry_metrics);
+    ctx->telemetry_log = g_strdup(log_path);
+    ctx->telemetry_metrics = g_strdup(metrics_path);
+}
+
 /* --- Internal result accessors (used by main.c) --- */
 
 const gchar *
@@ -282,6 +347,121 @@ crispy_config_context_get_cache_dir_internal(
     return ctx->cache_dir;
 }
 
+void
+crispy_config_context_get_placement_internal(
+    CrispyConfigContext  *ctx,
+    const gchar         **cpus,
+    gint                 *numa_node,
+    const gchar         **sched
+){
+    *cpus = ctx->cpus;
+    *numa_node = ctx->numa_node;
+    *sched = ctx->sched;
+}
+
+const gchar *
+crispy_config_context_get_allocator_internal(
+    CrispyConfigContext *ctx
+){
+    return ctx->allocator;
+}
+
+void
+crispy_config_context_get_telemetry_internal(
+    CrispyConfigContext  *ctx,
+    const gchar         **log_path,
+    const gchar         **metrics_path
+){
+    *log_path = ctx->telemetry_log;
+    *metrics_path = ctx->telemetry_metrics;
+}
+
+GVariant *
+crispy_config_context_to_variant_internal(
+    CrispyConfigContext *ctx
+){
+    GVariantBuilder plugins;
+    GVariantBuilder data;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    guint i;
+
+    g_variant_builder_init(&plugins, G_VARIANT_TYPE_STRING_ARRAY);
+    for (i = 0; i < ctx->plugin_paths->len; i++)
+        g_variant_builder_add(&plugins, "s",
+                              g_ptr_array_index(ctx->plugin_paths, i));
+
+    g_variant_builder_init(&data, G_VARIANT_TYPE("a{ss}"));
+    g_hash_table_iter_init(&iter, ctx->plugin_data);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        g_variant_builder_add(&data, "{ss}", key,
+                              value != NULL ? value : "");
+
+    return g_variant_ref_sink(g_variant_new(
+        CRISPY_CONFIG_SNAPSHOT_TYPE,
+        ctx->extra_flags, ctx->override_flags, &plugins, &data,
+        ctx->flags, ctx->flags_set, ctx->cache_dir,
+        ctx->cpus, ctx->numa_node, ctx->sched, ctx->allocator,
+        ctx->telemetry_log, ctx->telemetry_metrics));
+}
+
+gboolean
+crispy_config_context_apply_variant_internal(
+    CrispyConfigContext *ctx,
+    GVariant            *snapshot
+){
+    g_autoptr(GVariantIter) plugins = NULL;
+    g_autoptr(GVariantIter) data = NULL;
+    const gchar *extra_flags;
+    const gchar *override_flags;
+    const gchar *cache_dir;
+    const gchar *cpus;
+    const gchar *sched;
+    const gchar *allocator;
+    const gchar *telemetry_log;
+    const gchar *telemetry_metrics;
+    const gchar *key;
+    const gchar *value;
+    guint flags;
+    gboolean flags_set;
+    gint numa_node;
+
+    /*
+     * A snapshot read from disk always has the right type, because the
+     * loader names it.  Truncated or garbled bytes show up as data that
+     * is not in normal form, which g_variant_get() would quietly read
+     * as defaults.
+     */
+    if (!g_variant_is_of_type(snapshot,
+                              G_VARIANT_TYPE(CRISPY_CONFIG_SNAPSHOT_TYPE)) ||
+        !g_variant_is_normal_form(snapshot))
+        return FALSE;
+
+    g_variant_get(snapshot, "(m&sm&sasa{ss}ubm&sm&sim&sm&sm&sm&s)",
+                  &extra_flags, &override_flags, &plugins, &data,
+                  &flags, &flags_set, &cache_dir,
+                  &cpus, &numa_node, &sched, &allocator,
+                  &telemetry_log, &telemetry_metrics);
+
+    crispy_config_context_set_extra_flags(ctx, extra_flags);
+    crispy_config_context_set_override_flags(ctx, override_flags);
+    while (g_variant_iter_next(plugins, "&s", &value))
+        crispy_config_context_add_plugin(ctx, value);
+    while (g_variant_iter_next(data, "{&s&s}", &key, &value))
+        crispy_config_context_set_plugin_data(ctx, key, value);
+    if (flags_set)
+        crispy_config_context_set_flags(ctx, flags);
+    crispy_config_context_set_cache_dir(ctx, cache_dir);
+    crispy_config_context_set_cpus(ctx, cpus);
+    crispy_config_context_set_numa_node(ctx, numa_node);
+    crispy_config_context_set_sched(ctx, sched);
+    crispy_config_context_set_allocator(ctx, allocator);
+    crispy_config_context_set_telemetry(ctx, telemetry_log, telemetry_metrics);
+
+    return TRUE;
+}
+
 /* --- Script argv management --- */
 
 void
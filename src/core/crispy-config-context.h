@@ -69,6 +69,18 @@ struct _CrispyConfigContext
 
     /* cache override */
     gchar         *cache_dir;
+
+    /* execution placement */
+    gchar         *cpus;           /* CPU list, NULL if unset */
+    gint           numa_node;      /* -1 if unset */
+    gchar         *sched;          /* scheduling policy, NULL if unset */
+
+    /* malloc replacement, NULL for the system allocator */
+    gchar         *allocator;
+
+    /* per-run telemetry, NULL if unset */
+    gchar         *telemetry_log;
+    gchar         *telemetry_metrics;
 };
 #endif /* CRISPY_COMPILATION */
 
@@ -259,6 +271,73 @@ void crispy_config_context_add_flags (CrispyConfigContext *ctx,
 void crispy_config_context_set_cache_dir (CrispyConfigContext *ctx,
                                           const gchar         *cache_dir);
 
+/* --- Execution placement --- */
+
+/**
+ * crispy_config_context_set_cpus:
+ * @ctx: a #CrispyConfigContext
+ * @cpus: (nullable): CPU list such as "0-3,8", or %NULL to unset
+ *
+ * Pins scripts to @cpus before they run.  Overridden by --cpus;
+ * overrides a script's CRISPY_CPUS.
+ */
+void crispy_config_context_set_cpus (CrispyConfigContext *ctx,
+                                     const gchar         *cpus);
+
+/**
+ * crispy_config_context_set_numa_node:
+ * @ctx: a #CrispyConfigContext
+ * @node: NUMA node, or -1 to unset
+ *
+ * Runs scripts on the CPUs of @node and prefers its memory.
+ * Overridden by --numa-node; overrides a script's CRISPY_NUMA_NODE.
+ */
+void crispy_config_context_set_numa_node (CrispyConfigContext *ctx,
+                                          gint                 node);
+
+/**
+ * crispy_config_context_set_sched:
+ * @ctx: a #CrispyConfigContext
+ * @sched: (nullable): "other", "batch", "idle", "fifo[:PRIO]" or
+ *   "rr[:PRIO]", or %NULL to unset
+ *
+ * Sets the scheduling policy scripts run under.  Overridden by
+ * --sched; overrides a script's CRISPY_SCHED.
+ */
+void crispy_config_context_set_sched (CrispyConfigContext *ctx,
+                                      const gchar         *sched);
+
+/* --- Allocator --- */
+
+/**
+ * crispy_config_context_set_allocator:
+ * @ctx: a #CrispyConfigContext
+ * @allocator: (nullable): "mimalloc", "jemalloc", "tcmalloc", a library
+ *   name or path, or %NULL / "system" for the system allocator
+ *
+ * Sets the default malloc replacement.  A script's CRISPY_ALLOCATOR
+ * and --allocator take precedence.
+ */
+void crispy_config_context_set_allocator (CrispyConfigContext *ctx,
+                                          const gchar         *allocator);
+
+/* --- Telemetry --- */
+
+/**
+ * crispy_config_context_set_telemetry:
+ * @ctx: a #CrispyConfigContext
+ * @log_path: (nullable): file to append one JSON line per script run
+ *   to, or %NULL for none
+ * @metrics_path: (nullable): OpenMetrics text file to keep phase
+ *   latency histograms in, or %NULL for none
+ *
+ * Sets where script runs are reported.  --telemetry and --metrics
+ * take precedence.
+ */
+void crispy_config_context_set_telemetry (CrispyConfigContext *ctx,
+                                          const gchar         *log_path,
+                                          const gchar         *metrics_path);
+
 /* --- Script argv management --- */
 
 /**
@@ -371,6 +450,78 @@ guint crispy_config_context_get_flags_internal (CrispyConfigContext *ctx,
  */
 const gchar * crispy_config_context_get_cache_dir_internal (CrispyConfigContext *ctx);
 
+/**
+ * crispy_config_context_get_placement_internal:
+ * @ctx: a #CrispyConfigContext
+ * @cpus: (out) (transfer none) (nullable): the CPU list, or %NULL
+ * @numa_node: (out): the NUMA node, or -1
+ * @sched: (out) (transfer none) (nullable): the scheduling policy, or %NULL
+ *
+ * Returns the placement set by set_cpus/set_numa_node/set_sched.
+ */
+void crispy_config_context_get_placement_internal (CrispyConfigContext  *ctx,
+                                                   const gchar         **cpus,
+                                                   gint                 *numa_node,
+                                                   const gchar         **sched);
+
+/**
+ * crispy_config_context_get_allocator_internal:
+ * @ctx: a #CrispyConfigContext
+ *
+ * Returns the default allocator (may be %NULL).
+ *
+ * Returns: (transfer none) (nullable): the allocator name
+ */
+const gchar * crispy_config_context_get_allocator_internal (CrispyConfigContext *ctx);
+
+/**
+ * crispy_config_context_get_telemetry_internal:
+ * @ctx: a #CrispyConfigContext
+ * @log_path: (out) (transfer none) (nullable): the JSON lines file, or %NULL
+ * @metrics_path: (out) (transfer none) (nullable): the OpenMetrics file,
+ *   or %NULL
+ *
+ * Returns the files set by set_telemetry.
+ */
+void crispy_config_context_get_telemetry_internal (CrispyConfigContext  *ctx,
+                                                   const gchar         **log_path,
+                                                   const gchar         **metrics_path);
+
+/**
+ * CRISPY_CONFIG_SNAPSHOT_TYPE:
+ *
+ * #GVariant type of a config snapshot: extra flags, override flags,
+ * plugin paths, plugin data, CrispyFlags, whether they were set, cache
+ * dir, CPU list, NUMA node, scheduling policy, allocator, telemetry log
+ * and metrics file.
+ */
+#define CRISPY_CONFIG_SNAPSHOT_TYPE "(msmsasa{ss}ubmsmsimsmsmsms)"
+
+/**
+ * crispy_config_context_to_variant_internal:
+ * @ctx: a #CrispyConfigContext after crispy_config_init()
+ *
+ * Captures everything the config set, for a pure config snapshot.
+ * Script argv and the config module itself are not part of it.
+ *
+ * Returns: (transfer full): a #GVariant of type
+ *   %CRISPY_CONFIG_SNAPSHOT_TYPE
+ */
+GVariant * crispy_config_context_to_variant_internal (CrispyConfigContext *ctx);
+
+/**
+ * crispy_config_context_apply_variant_internal:
+ * @ctx: a freshly initialized #CrispyConfigContext
+ * @snapshot: a #GVariant from crispy_config_context_to_variant_internal()
+ *
+ * Sets @ctx up as the config that produced @snapshot would have.
+ *
+ * Returns: %FALSE, leaving @ctx alone, if @snapshot has the wrong type
+ *   or is not in normal form, as a corrupt snapshot file is not
+ */
+gboolean crispy_config_context_apply_variant_internal (CrispyConfigContext *ctx,
+                                                       GVariant            *snapshot);
+
 G_END_DECLS
 
 #endif /* CRISPY_CONFIG_CONTEXT_H */
@@ -12,16 +12,24 @@
  * The config source may define CRISPY_PARAMS to pass extra compiler
  * flags.  The compiled .so must export a `crispy_config_init` symbol.
  *
+ * A config that defines CRISPY_CONFIG_PURE promises that what it sets
+ * depends only on its source and the input files the macro lists.
+ * The resulting context is saved as a GVariant snapshot next to the
+ * cached builds, and later runs apply the snapshot without compiling,
+ * loading or running the config.
+ *
  * Follows the same pattern as gst's gst-config-compiler.c.
  */
 
 #define CRISPY_COMPILATION
 #include "crispy-config-loader.h"
 #include "crispy-source-utils-private.h"
+#include "crispy-memo-private.h"
 #include "crispy-config-context.h"
 #include "../interfaces/crispy-compiler.h"
 #include "../interfaces/crispy-cache-provider.h"
 #include "../crispy-types.h"
+#include "../crispy-version.h"
 
 #include <glib.h>
 #include <gmodule.h>
@@ -30,47 +38,99 @@
 /* --- Internal helpers --- */
 
 /**
- * get_crispy_include_flags:
+ * snapshot_path_for:
+ * @config_path: path to the config .c file
+ * @source_content: the config source
+ * @inputs: (array zero-terminated=1): CRISPY_CONFIG_PURE inputs,
+ *   relative ones resolved in place against the config's directory
+ * @compiler: compiler the config would be built with
+ * @cache: cache the snapshot lives in
  *
- * Attempts to get crispy's include flags. In development mode,
- * uses CRISPY_DEV_INCLUDE_DIR. When installed, uses pkg-config.
+ * The key covers everything a pure config may depend on: crispy's
+ * version, the snapshot layout, the compiler, the source and the
+ * contents of the declared inputs.
  *
- * Returns: (transfer full): include flags string; free with g_free()
+ * Returns: (transfer full): where the snapshot is stored
  */
 static gchar *
-get_crispy_include_flags(void)
-{
-#ifdef CRISPY_DEV_INCLUDE_DIR
-    /*
-     * Development mode: point to the source directory so that
-     * config files can #include <crispy.h>
-     */
-    if (g_file_test(CRISPY_DEV_INCLUDE_DIR "/crispy.h",
-                    G_FILE_TEST_IS_REGULAR))
-    {
-        return g_strdup("-I" CRISPY_DEV_INCLUDE_DIR);
-    }
-#endif
+snapshot_path_for(
+    const gchar         *config_path,
+    const gchar         *source_content,
+    gchar              **inputs,
+    CrispyCompiler      *compiler,
+    CrispyCacheProvider *cache
+){
+    g_autoptr(GChecksum) checksum = NULL;
+    g_autofree gchar *config_dir = NULL;
+    const gchar *compiler_version;
+    gchar *absolute;
+    guint i;
 
-    /* installed case: query pkg-config for crispy */
+    config_dir = g_path_get_dirname(config_path);
+    for (i = 0; inputs[i] != NULL; i++)
     {
-        g_autofree gchar *cmd = NULL;
-        g_autofree gchar *stdout_output = NULL;
-        g_autofree gchar *stderr_output = NULL;
-        gint exit_status;
-
-        cmd = g_strdup("pkg-config --cflags crispy");
-        if (g_spawn_command_line_sync(cmd, &stdout_output,
-                                      &stderr_output,
-                                      &exit_status, NULL) &&
-            g_spawn_check_wait_status(exit_status, NULL))
-        {
-            g_strstrip(stdout_output);
-            return g_steal_pointer(&stdout_output);
-        }
+        if (g_path_is_absolute(inputs[i]))
+            continue;
+        absolute = g_build_filename(config_dir, inputs[i], NULL);
+        g_free(inputs[i]);
+        inputs[i] = absolute;
     }
 
-    return g_strdup("");
+    compiler_version = crispy_compiler_get_version(compiler);
+
+    checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, (const guchar *)CRISPY_VERSION_STRING,
+                      sizeof(CRISPY_VERSION_STRING));
+    /* a layout change must not apply an old snapshot field by field */
+    g_checksum_update(checksum, (const guchar *)CRISPY_CONFIG_SNAPSHOT_TYPE,
+                      sizeof(CRISPY_CONFIG_SNAPSHOT_TYPE));
+    if (compiler_version != NULL)
+        g_checksum_update(checksum, (const guchar *)compiler_version,
+                          strlen(compiler_version) + 1);
+    g_checksum_update(checksum, (const guchar *)source_content,
+                      strlen(source_content) + 1);
+    crispy_memo_hash_inputs(checksum, (const gchar * const *)inputs);
+
+    return crispy_memo_cache_path(cache, g_checksum_get_string(checksum),
+                                  ".cfgsnap");
+}
+
+/* --- helper: apply a saved snapshot; FALSE if there is none or it is bad --- */
+static gboolean
+load_snapshot(
+    const gchar         *snapshot_path,
+    CrispyConfigContext *ctx
+){
+    g_autoptr(GVariant) snapshot = NULL;
+    gchar *contents;
+    gsize length;
+
+    if (!g_file_get_contents(snapshot_path, &contents, &length, NULL))
+        return FALSE;
+
+    snapshot = g_variant_ref_sink(g_variant_new_from_data(
+        G_VARIANT_TYPE(CRISPY_CONFIG_SNAPSHOT_TYPE), contents, length,
+        FALSE, g_free, contents));
+
+    return crispy_config_context_apply_variant_internal(ctx, snapshot);
+}
+
+/* --- helper: record what the config set, for the next run --- */
+static void
+save_snapshot(
+    const gchar         *snapshot_path,
+    CrispyConfigContext *ctx
+){
+    g_autoptr(GVariant) snapshot = NULL;
+    g_autoptr(GError) error = NULL;
+
+    snapshot = crispy_config_context_to_variant_internal(ctx);
+
+    /* written to a temporary file and renamed, so readers never see half */
+    if (!g_file_set_contents(snapshot_path,
+                             g_variant_get_data(snapshot),
+                             (gssize)g_variant_get_size(snapshot), &error))
+        g_debug("Config snapshot not saved: %s", error->message);
 }
 
 /* --- Public API --- */
@@ -136,10 +196,11 @@ crispy_config_loader_compile_and_load(
     g_autofree gchar *source_content = NULL;
     g_autofree gchar *raw_params = NULL;
     g_autofree gchar *expanded_params = NULL;
-    g_autofree gchar *crispy_flags = NULL;
     g_autofree gchar *extra_flags = NULL;
     g_autofree gchar *hash = NULL;
     g_autofree gchar *so_path = NULL;
+    g_autofree gchar *snapshot_path = NULL;
+    g_auto(GStrv) pure_inputs = NULL;
     const gchar *compiler_version;
     GModule *module;
     gpointer symbol;
@@ -155,6 +216,20 @@ crispy_config_loader_compile_and_load(
     if (!g_file_get_contents(config_path, &source_content, NULL, error))
         return FALSE;
 
+    /* CRISPY_CONFIG_PURE: apply the saved context if there is one */
+    pure_inputs = crispy_memo_detect_list(source_content,
+                                          "CRISPY_CONFIG_PURE");
+    if (pure_inputs != NULL)
+    {
+        snapshot_path = snapshot_path_for(config_path, source_content,
+                                          pure_inputs, compiler, cache);
+        if (load_snapshot(snapshot_path, ctx))
+        {
+            g_debug("Config snapshot hit: %s", snapshot_path);
+            return TRUE;
+        }
+    }
+
     /* extract optional CRISPY_PARAMS from the config source */
     raw_params = crispy_source_extract_params(source_content);
 
@@ -165,11 +240,12 @@ crispy_config_loader_compile_and_load(
     if (expanded_params == NULL)
         expanded_params = g_strdup("");
 
-    /* get crispy include flags so config can #include <crispy.h> */
-    crispy_flags = get_crispy_include_flags();
-
-    /* build the combined extra_flags string for compilation */
-    extra_flags = g_strdup_printf("%s %s", crispy_flags, expanded_params);
+    /*
+     * build the combined extra_flags string for compilation; crispy's
+     * include flags let the config #include <crispy.h>
+     */
+    extra_flags = g_strdup_printf("%s %s", crispy_source_get_include_flags(),
+                                  expanded_params);
 
     /* compute content hash for caching */
     compiler_version = crispy_compiler_get_version(compiler);
@@ -234,6 +310,13 @@ crispy_config_loader_compile_and_load(
         return FALSE;
     }
 
+    /*
+     * A pure config that rewrote the script's argv depends on it after
+     * all; its context cannot be replayed for other scripts.
+     */
+    if (snapshot_path != NULL && !ctx->script_argv_owned)
+        save_snapshot(snapshot_path, ctx);
+
     /* keep the module open so config symbols remain available */
 
     return TRUE;
@@ -153,7 +153,11 @@ file_cache_purge(
     count = 0;
     while ((entry = g_dir_read_name(dir)) != NULL)
     {
-        if (g_str_has_suffix(entry, ".so"))
+        /* builds, CRISPY_PURE results, init and config snapshots */
+        if (g_str_has_suffix(entry, ".so") ||
+            g_str_has_suffix(entry, ".memo") ||
+            g_str_has_suffix(entry, ".snap") ||
+            g_str_has_suffix(entry, ".cfgsnap"))
         {
             g_autofree gchar *path = NULL;
 
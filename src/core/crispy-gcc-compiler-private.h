@@ -0,0 +1,34 @@
+/* crispy-gcc-compiler-private.h - Internal gcc compiler API (not installed) */
+
+#ifndef CRISPY_GCC_COMPILER_PRIVATE_H
+#define CRISPY_GCC_COMPILER_PRIVATE_H
+
+#include "crispy-gcc-compiler.h"
+
+G_BEGIN_DECLS
+
+/**
+ * crispy_gcc_compiler_compile_shared_with_report_internal:
+ * @self: a #CrispyGccCompiler
+ * @source_path: path to the C source file
+ * @output_path: path for the output .so file
+ * @extra_flags: (nullable): additional compiler flags
+ * @report: (out) (transfer full): gcc's stderr on success
+ * @error: return location for a #GError, or %NULL
+ *
+ * Like crispy_compiler_compile_shared(), with -ftime-report and -H
+ * added to the command, for --trace.  The flags only change what gcc
+ * prints, so the output is the same as without them.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ */
+gboolean crispy_gcc_compiler_compile_shared_with_report_internal (CrispyGccCompiler  *self,
+                                                                  const gchar        *source_path,
+                                                                  const gchar        *output_path,
+                                                                  const gchar        *extra_flags,
+                                                                  gchar             **report,
+                                                                  GError            **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_GCC_COMPILER_PRIVATE_H */
@@ -2,11 +2,15 @@
 
 #define CRISPY_COMPILATION
 #include "crispy-gcc-compiler.h"
+#include "crispy-gcc-compiler-private.h"
 #include "../interfaces/crispy-compiler.h"
 #include "../crispy-types.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 
 /**
  * SECTION:crispy-gcc-compiler
@@ -93,7 +97,74 @@ first_line(
     return g_strdup(text);
 }
 
-/* --- helper: build and run a gcc command --- */
+/*
+ * --- helper: gcc's stderr without what -H and -ftime-report add ---
+ *
+ * Drops the include tree (one '.' per level, a space, a path), the
+ * "Multiple include guards" list up to the blank line ending it, and
+ * the time report from its "Time variable" header to the TOTAL row,
+ * so a failed traced compile reads like any other.
+ */
+static gchar *
+strip_report(
+    const gchar *std_err
+){
+    g_auto(GStrv) lines = NULL;
+    GString *out;
+    gboolean in_guards;
+    gboolean in_times;
+    gsize depth;
+    guint i;
+
+    out = g_string_new(NULL);
+    in_guards = FALSE;
+    in_times = FALSE;
+
+    lines = g_strsplit(std_err, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (in_guards)
+        {
+            in_guards = lines[i][0] != '\0';
+            continue;
+        }
+        if (in_times)
+        {
+            in_times = !g_str_has_prefix(g_strchug(lines[i]), "TOTAL ");
+            continue;
+        }
+
+        depth = strspn(lines[i], ".");
+        if (depth > 0 && lines[i][depth] == ' ')
+            continue;
+        if (g_str_has_prefix(lines[i], "Multiple include guards"))
+        {
+            in_guards = TRUE;
+            continue;
+        }
+        if (g_str_has_prefix(lines[i], "Time variable"))
+        {
+            in_times = TRUE;
+            continue;
+        }
+
+        /* the split leaves an empty last line; don't add a newline for it */
+        if (lines[i + 1] != NULL)
+            g_string_append_printf(out, "%s\n", lines[i]);
+        else
+            g_string_append(out, lines[i]);
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+/*
+ * --- helper: build and run a gcc command ---
+ *
+ * With @report, gcc also runs with -ftime-report and -H and its
+ * stderr is returned there on success.  On failure the error message
+ * gets the diagnostics only.
+ */
 static gboolean
 run_gcc(
     CrispyGccCompilerPrivate  *priv,
@@ -101,23 +172,38 @@ run_gcc(
     const gchar               *source_path,
     const gchar               *output_path,
     const gchar               *extra_flags,
+    gchar                    **report,
     GError                   **error
 ){
+    static gint tmp_counter = 0;
     g_autofree gchar *cmd = NULL;
+    g_autofree gchar *tmp_path = NULL;
     gchar *std_out;
     gchar *std_err;
     gint exit_status;
+    gint saved_errno;
 
     std_out = NULL;
     std_err = NULL;
     exit_status = 0;
 
+    /*
+     * gcc writes to a name unique to this process and call, which is
+     * then renamed over @output_path.  Another thread or process that
+     * compiles or loads the same cache entry concurrently never sees a
+     * partially written file.
+     */
+    tmp_path = g_strdup_printf("%s.%d-%d.tmp",
+                               output_path, (gint)getpid(),
+                               g_atomic_int_add(&tmp_counter, 1));
+
     /* build the compilation command */
-    cmd = g_strdup_printf("gcc -std=gnu89 %s %s %s -o %s %s",
+    cmd = g_strdup_printf("gcc -std=gnu89 %s %s %s%s -o %s %s",
                           mode_flags,
                           priv->base_flags,
                           extra_flags != NULL ? extra_flags : "",
-                          output_path,
+                          report != NULL ? " -ftime-report -H" : "",
+                          tmp_path,
                           source_path);
 
     if (!g_spawn_command_line_sync(cmd, &std_out, &std_err, &exit_status, error))
@@ -131,6 +217,13 @@ run_gcc(
 
     if (!g_spawn_check_wait_status(exit_status, NULL))
     {
+        if (report != NULL && std_err != NULL)
+        {
+            g_autofree gchar *traced = std_err;
+
+            std_err = strip_report(traced);
+        }
+
         /* report gcc stderr as the error message */
         g_set_error(error,
                     CRISPY_ERROR,
@@ -139,10 +232,29 @@ run_gcc(
                     std_err != NULL ? std_err : "(no output)",
                     cmd);
         g_free(std_err);
+        g_unlink(tmp_path);
+        return FALSE;
+    }
+
+    if (report != NULL)
+        *report = std_err;
+    else
+        g_free(std_err);
+
+    if (g_rename(tmp_path, output_path) != 0)
+    {
+        saved_errno = errno;
+        g_set_error(error,
+                    CRISPY_ERROR,
+                    CRISPY_ERROR_IO,
+                    "Failed to rename %s to %s: %s",
+                    tmp_path, output_path, g_strerror(saved_errno));
+        g_unlink(tmp_path);
+        if (report != NULL)
+            g_clear_pointer(report, g_free);
         return FALSE;
     }
 
-    g_free(std_err);
     return TRUE;
 }
 
@@ -180,7 +292,7 @@ gcc_compiler_compile_shared(
 
     priv = crispy_gcc_compiler_get_instance_private(CRISPY_GCC_COMPILER(self));
     return run_gcc(priv, "-shared -fPIC", source_path, output_path,
-                   extra_flags, error);
+                   extra_flags, NULL, error);
 }
 
 static gboolean
@@ -195,7 +307,7 @@ gcc_compiler_compile_executable(
 
     priv = crispy_gcc_compiler_get_instance_private(CRISPY_GCC_COMPILER(self));
     return run_gcc(priv, "-g -O0", source_path, output_path,
-                   extra_flags, error);
+                   extra_flags, NULL, error);
 }
 
 static void
@@ -290,3 +402,24 @@ crispy_gcc_compiler_new(
 
     return self;
 }
+
+/* --- internal API --- */
+
+gboolean
+crispy_gcc_compiler_compile_shared_with_report_internal(
+    CrispyGccCompiler  *self,
+    const gchar        *source_path,
+    const gchar        *output_path,
+    const gchar        *extra_flags,
+    gchar             **report,
+    GError            **error
+){
+    CrispyGccCompilerPrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_GCC_COMPILER(self), FALSE);
+    g_return_val_if_fail(report != NULL, FALSE);
+
+    priv = crispy_gcc_compiler_get_instance_private(self);
+    return run_gcc(priv, "-shared -fPIC", source_path, output_path,
+                   extra_flags, report, error);
+}
@@ -0,0 +1,318 @@
+/* crispy-hot-swap-private.c - Internal live code replacement for running scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-hot-swap-private.h"
+#include "crispy-script-private.h"
+#include "../crispy-types.h"
+
+#include <gio/gio.h>
+
+struct _CrispyHotSwap
+{
+    CrispyScript  *script;        /* the original script, borrowed */
+    CrispyScript  *running;       /* version whose callbacks are live */
+    GPtrArray     *generations;   /* swapped-in CrispyScript*, kept loaded */
+    gchar         *source_path;
+    GFileMonitor  *monitor;
+    guint          debounce_id;
+    gint           argc;
+    gchar        **argv;
+
+    gboolean       building;      /* a rebuild is running on a worker */
+    gboolean       pending;       /* the source changed again meanwhile */
+    gboolean       stopped;       /* freed when the rebuild completes */
+};
+
+/* task data for one rebuild */
+typedef struct
+{
+    CrispyHotSwap *hot_swap;
+    CrispyScript  *next;
+} RebuildData;
+
+static void start_rebuild (CrispyHotSwap *self);
+
+static void
+rebuild_data_free(
+    gpointer data
+){
+    RebuildData *rebuild;
+
+    rebuild = (RebuildData *)data;
+    g_object_unref(rebuild->next);
+    g_free(rebuild);
+}
+
+/* --- helper: release everything --- */
+static void
+hot_swap_free(
+    CrispyHotSwap *self
+){
+    g_ptr_array_unref(self->generations);
+    g_free(self->source_path);
+    g_strfreev(self->argv);
+    g_free(self);
+}
+
+/*
+ * hot_swap_apply:
+ *
+ * Hands the running version's state to @next and makes @next the
+ * running version.  Nothing changes if either side lacks its export.
+ * Superseded modules stay loaded: the original main() is still on the
+ * stack, and the state may point into any earlier version.
+ */
+static void
+hot_swap_apply(
+    CrispyHotSwap *self,
+    CrispyScript  *next
+){
+    CrispyStateSaveFunc save;
+    CrispyStateRestoreFunc restore;
+    gpointer state;
+
+    save = (CrispyStateSaveFunc)crispy_script_lookup_symbol_internal(
+        self->running, "crispy_state_save");
+    restore = (CrispyStateRestoreFunc)crispy_script_lookup_symbol_internal(
+        next, "crispy_state_restore");
+
+    if (save == NULL || restore == NULL)
+    {
+        g_warning("Hot swap of %s skipped: %s does not export %s",
+                  self->source_path,
+                  save == NULL ? "the running version" : "the new version",
+                  save == NULL ? "crispy_state_save()"
+                               : "crispy_state_restore()");
+        g_object_unref(next);
+        return;
+    }
+
+    state = save();
+    restore(state);
+
+    g_ptr_array_add(self->generations, next);
+    self->running = next;
+
+    g_message("Hot-swapped %s (version %u)",
+              self->source_path, self->generations->len + 1);
+}
+
+/* --- worker thread: compile and load the new version --- */
+static void
+rebuild_thread(
+    GTask        *task,
+    gpointer      source_object,
+    gpointer      task_data,
+    GCancellable *cancellable
+){
+    RebuildData *rebuild;
+    GError *error;
+
+    rebuild = (RebuildData *)task_data;
+    error = NULL;
+
+    /* argc/argv are immutable and outlive the task */
+    if (!crispy_script_prepare(rebuild->next,
+                               rebuild->hot_swap->argc,
+                               rebuild->hot_swap->argv,
+                               &error))
+    {
+        /* a plugin abort fails prepare without an error */
+        if (error == NULL)
+            g_set_error(&error, CRISPY_ERROR, CRISPY_ERROR_LOAD,
+                        "Rebuild aborted by a plugin");
+        g_task_return_error(task, error);
+        return;
+    }
+
+    g_task_return_pointer(task, g_object_ref(rebuild->next),
+                          g_object_unref);
+}
+
+/* --- main context: rebuild finished --- */
+static void
+on_rebuilt(
+    GObject      *source_object,
+    GAsyncResult *result,
+    gpointer      user_data
+){
+    CrispyHotSwap *self;
+    CrispyScript *next;
+    g_autoptr(GError) error = NULL;
+
+    self = (CrispyHotSwap *)user_data;
+    self->building = FALSE;
+
+    next = (CrispyScript *)g_task_propagate_pointer(G_TASK(result), &error);
+
+    if (self->stopped)
+    {
+        g_clear_object(&next);
+        hot_swap_free(self);
+        return;
+    }
+
+    /* a broken edit keeps the running version */
+    if (next == NULL)
+        g_warning("Hot swap of %s failed: %s", self->source_path,
+                  error != NULL ? error->message : "unknown error");
+    else
+        hot_swap_apply(self, next);
+
+    if (self->pending)
+    {
+        self->pending = FALSE;
+        start_rebuild(self);
+    }
+}
+
+static void
+start_rebuild(
+    CrispyHotSwap *self
+){
+    g_autoptr(GTask) task = NULL;
+    g_autoptr(GError) error = NULL;
+    RebuildData *rebuild;
+    CrispyScript *next;
+
+    if (self->building)
+    {
+        self->pending = TRUE;
+        return;
+    }
+
+    next = crispy_script_respawn_internal(self->script, CRISPY_FLAG_NONE,
+                                          CRISPY_FLAG_HOT_SWAP, &error);
+    if (next == NULL)
+    {
+        g_warning("Hot swap of %s failed: %s",
+                  self->source_path, error->message);
+        return;
+    }
+
+    rebuild = g_new0(RebuildData, 1);
+    rebuild->hot_swap = self;
+    rebuild->next = next;
+
+    task = g_task_new(NULL, NULL, on_rebuilt, self);
+    g_task_set_task_data(task, rebuild, rebuild_data_free);
+
+    self->building = TRUE;
+    g_task_run_in_thread(task, rebuild_thread);
+}
+
+static gboolean
+on_debounce(
+    gpointer user_data
+){
+    CrispyHotSwap *self;
+
+    self = (CrispyHotSwap *)user_data;
+    self->debounce_id = 0;
+    start_rebuild(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_source_changed(
+    GFileMonitor      *monitor,
+    GFile             *file,
+    GFile             *other_file,
+    GFileMonitorEvent  event,
+    gpointer           user_data
+){
+    CrispyHotSwap *self;
+
+    self = (CrispyHotSwap *)user_data;
+
+    /*
+     * In-place saves end with CHANGES_DONE_HINT; editors that write a
+     * temp file and rename it over the source show up as a rename or
+     * a move in.
+     */
+    switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+        break;
+    default:
+        return;
+    }
+
+    if (self->debounce_id != 0)
+        g_source_remove(self->debounce_id);
+    self->debounce_id = g_timeout_add(CRISPY_HOT_SWAP_DEBOUNCE_MS,
+                                      on_debounce, self);
+}
+
+CrispyHotSwap *
+crispy_hot_swap_start(
+    CrispyScript   *script,
+    const gchar    *source_path,
+    gint            argc,
+    gchar         **argv,
+    GError        **error
+){
+    CrispyHotSwap *self;
+    g_autoptr(GFile) file = NULL;
+    gint i;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(script), NULL);
+    g_return_val_if_fail(source_path != NULL, NULL);
+
+    file = g_file_new_for_path(source_path);
+
+    self = g_new0(CrispyHotSwap, 1);
+    self->monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES,
+                                        NULL, error);
+    if (self->monitor == NULL)
+    {
+        g_free(self);
+        return NULL;
+    }
+
+    self->script = script;
+    self->running = script;
+    self->generations = g_ptr_array_new_with_free_func(g_object_unref);
+    self->source_path = g_strdup(source_path);
+
+    self->argc = argc;
+    self->argv = g_new0(gchar *, argc + 1);
+    for (i = 0; i < argc; i++)
+        self->argv[i] = g_strdup(argv[i]);
+
+    g_signal_connect(self->monitor, "changed",
+                     G_CALLBACK(on_source_changed), self);
+
+    return self;
+}
+
+void
+crispy_hot_swap_stop(
+    CrispyHotSwap *self
+){
+    if (self == NULL)
+        return;
+
+    g_signal_handlers_disconnect_by_data(self->monitor, self);
+    g_file_monitor_cancel(self->monitor);
+    g_clear_object(&self->monitor);
+
+    if (self->debounce_id != 0)
+    {
+        g_source_remove(self->debounce_id);
+        self->debounce_id = 0;
+    }
+
+    /* on_rebuilt() frees us once the worker is done */
+    if (self->building)
+    {
+        self->stopped = TRUE;
+        return;
+    }
+
+    hot_swap_free(self);
+}
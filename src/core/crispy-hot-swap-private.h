@@ -0,0 +1,70 @@
+/* crispy-hot-swap-private.h - Internal live code replacement for running scripts */
+
+/*
+ * Support for CRISPY_FLAG_HOT_SWAP: while a script's main() runs a
+ * GMainLoop, its source file is watched; each change is compiled on a
+ * worker thread, and the new module takes over the running one's state
+ * through the optional crispy_state_save()/crispy_state_restore()
+ * exports.  Used by CrispyScript.  This header is NOT installed or
+ * included in the public umbrella header.
+ */
+
+#ifndef CRISPY_HOT_SWAP_PRIVATE_H
+#define CRISPY_HOT_SWAP_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_HOT_SWAP_DEBOUNCE_MS:
+ *
+ * How long the source must stay unchanged before a rebuild starts, so
+ * that an editor's save (often several writes and a rename) triggers
+ * one compile.
+ */
+#define CRISPY_HOT_SWAP_DEBOUNCE_MS (200)
+
+/**
+ * CrispyHotSwap:
+ *
+ * Opaque watcher for one running script.
+ */
+typedef struct _CrispyHotSwap CrispyHotSwap;
+
+/**
+ * crispy_hot_swap_start:
+ * @script: the prepared #CrispyScript about to run (not referenced)
+ * @source_path: the script's source file
+ * @argc: argument count, passed to plugin hooks of each rebuild
+ * @argv: (array length=argc): argument vector, copied
+ * @error: (nullable): return location for a #GError
+ *
+ * Starts watching @source_path.  File events, rebuild completions and
+ * swaps are all dispatched from the global-default #GMainContext, so
+ * nothing happens unless the script iterates it (g_main_loop_run() on
+ * a loop created with a %NULL context).
+ *
+ * Returns: (transfer full) (nullable): the watcher, or %NULL with
+ *   @error set
+ */
+CrispyHotSwap *crispy_hot_swap_start (CrispyScript   *script,
+                                      const gchar    *source_path,
+                                      gint            argc,
+                                      gchar         **argv,
+                                      GError        **error);
+
+/**
+ * crispy_hot_swap_stop:
+ * @self: (nullable) (transfer full): a #CrispyHotSwap
+ *
+ * Stops watching and unloads every swapped-in version.  Call after
+ * main() has returned.  A rebuild still in flight is discarded when it
+ * completes.
+ */
+void           crispy_hot_swap_stop  (CrispyHotSwap  *self);
+
+G_END_DECLS
+
+#endif /* CRISPY_HOT_SWAP_PRIVATE_H */
@@ -0,0 +1,74 @@
+/* crispy-isolate-private.c - Internal link-map namespace loading */
+
+#define _GNU_SOURCE
+#define CRISPY_COMPILATION
+#include "crispy-isolate-private.h"
+#include "../crispy-types.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+
+typedef gint (*IsolateFflushFunc)(FILE *stream);
+
+gpointer
+crispy_isolate_open(
+    const gchar  *path,
+    GError      **error
+){
+    void *handle;
+
+    g_return_val_if_fail(path != NULL, NULL);
+
+    /*
+     * RTLD_LOCAL keeps the module's symbols out of the namespace's
+     * global scope; lookups go through crispy_isolate_symbol().
+     */
+    handle = dlmopen(LM_ID_NEWLM, path, RTLD_LAZY | RTLD_LOCAL);
+    if (handle == NULL)
+    {
+        g_set_error(error,
+                    CRISPY_ERROR,
+                    CRISPY_ERROR_LOAD,
+                    "Failed to load module into a new namespace: %s",
+                    dlerror());
+        return NULL;
+    }
+
+    return handle;
+}
+
+gboolean
+crispy_isolate_symbol(
+    gpointer      handle,
+    const gchar  *name,
+    gpointer     *symbol
+){
+    g_return_val_if_fail(handle != NULL, FALSE);
+    g_return_val_if_fail(name != NULL, FALSE);
+    g_return_val_if_fail(symbol != NULL, FALSE);
+
+    *symbol = dlsym(handle, name);
+    return *symbol != NULL;
+}
+
+void
+crispy_isolate_flush(
+    gpointer handle
+){
+    IsolateFflushFunc ns_fflush;
+
+    g_return_if_fail(handle != NULL);
+
+    /* the module's dependencies include its own libc */
+    ns_fflush = (IsolateFflushFunc)dlsym(handle, "fflush");
+    if (ns_fflush != NULL)
+        ns_fflush(NULL);
+}
+
+void
+crispy_isolate_close(
+    gpointer handle
+){
+    if (handle != NULL)
+        dlclose(handle);
+}
@@ -0,0 +1,72 @@
+/* crispy-isolate-private.h - Internal link-map namespace loading */
+
+/*
+ * Support for CRISPY_FLAG_ISOLATE: each script module is loaded with
+ * dlmopen(LM_ID_NEWLM) into a link-map namespace of its own, so its
+ * globals and exported symbols cannot collide with those of the host
+ * or of other scripts.  Used by CrispyScript.  This header is NOT
+ * installed or included in the public umbrella header.
+ */
+
+#ifndef CRISPY_ISOLATE_PRIVATE_H
+#define CRISPY_ISOLATE_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * crispy_isolate_open:
+ * @path: path of the shared object to load
+ * @error: (nullable): return location for a #GError
+ *
+ * Loads @path and its dependencies into a new link-map namespace.
+ * glibc gives every namespace its own copy of libc and of any other
+ * library the module needs; only the dynamic loader is shared.  The
+ * number of namespaces per process is fixed by glibc (16, including
+ * the main one), and static TLS for each libc copy may run out
+ * sooner; see the `glibc.rtld.nns` and `glibc.rtld.optional_static_tls`
+ * tunables.
+ *
+ * Returns: (nullable): an opaque handle, or %NULL with @error set
+ *   (%CRISPY_ERROR_LOAD)
+ */
+gpointer crispy_isolate_open   (const gchar  *path,
+                                GError      **error);
+
+/**
+ * crispy_isolate_symbol:
+ * @handle: a handle from crispy_isolate_open()
+ * @name: symbol name
+ * @symbol: (out): return location for the symbol's address
+ *
+ * Looks up @name in the module and the libraries of its namespace.
+ *
+ * Returns: %TRUE if @name was found
+ */
+gboolean crispy_isolate_symbol (gpointer      handle,
+                                const gchar  *name,
+                                gpointer     *symbol);
+
+/**
+ * crispy_isolate_flush:
+ * @handle: a handle from crispy_isolate_open()
+ *
+ * Flushes every stdio stream of the namespace's libc.  Its stdout
+ * buffer is separate from the host's, so this must run after the
+ * script returns to keep output in order.
+ */
+void     crispy_isolate_flush  (gpointer      handle);
+
+/**
+ * crispy_isolate_close:
+ * @handle: (nullable): a handle from crispy_isolate_open()
+ *
+ * Unloads the module.  The namespace is released once nothing in it
+ * is loaded any more.
+ */
+void     crispy_isolate_close  (gpointer      handle);
+
+G_END_DECLS
+
+#endif /* CRISPY_ISOLATE_PRIVATE_H */
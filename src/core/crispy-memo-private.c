@@ -0,0 +1,530 @@
+/* crispy-memo-private.c - Internal result memoization for pure scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-memo-private.h"
+#include "../crispy-types.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CRISPY_MEMO_MAGIC     "CRSPMEMO"
+#define CRISPY_MEMO_VERSION   (1)
+#define CRISPY_MEMO_CHUNK     (64 * 1024)
+
+/* on-disk record: this header, then output_len bytes of stdout */
+typedef struct
+{
+    gchar    magic[8];
+    guint32  version;
+    gint32   exit_code;
+    guint64  output_len;
+} CrispyMemoHeader;
+
+struct _CrispyMemo
+{
+    gchar        *path;            /* <cache dir>/<key>.memo */
+    GMappedFile  *record;          /* set by a successful lookup */
+
+    GByteArray   *stdin_data;      /* NULL: stdin was not read */
+    gboolean      stdin_rewound;   /* regular file, already seeked back */
+
+    /* capture state */
+    gint          saved_stdout;    /* -1 unless capturing */
+    gint          pipe_read;
+    GThread      *tee;
+    GByteArray   *output;          /* header + stdout */
+    gboolean      overflow;        /* beyond CRISPY_MEMO_MAX_OUTPUT */
+    gboolean      write_failed;    /* passing through to stdout failed */
+};
+
+/* --- helpers --- */
+
+static gboolean
+write_all(
+    gint           fd,
+    const guint8  *data,
+    gsize          len
+){
+    gssize n;
+
+    while (len > 0)
+    {
+        n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data += n;
+        len -= (gsize)n;
+    }
+
+    return TRUE;
+}
+
+/* --- helper: length-prefix a field so fields cannot run together --- */
+static void
+hash_field(
+    GChecksum     *checksum,
+    const gchar   *tag,
+    gconstpointer  data,
+    gsize          len
+){
+    gchar prefix[64];
+
+    g_snprintf(prefix, sizeof(prefix), "%s:%" G_GSIZE_FORMAT ":", tag, len);
+    g_checksum_update(checksum, (const guchar *)prefix, -1);
+    if (len > 0)
+        g_checksum_update(checksum, (const guchar *)data, (gssize)len);
+}
+
+/*
+ * read_stdin:
+ *
+ * Reads fd 0 to end of input.  A closed stdin reads as empty.  A regular file is seeked back to where it
+ * was, so the script can read it again without a copy.
+ */
+static gboolean
+read_stdin(
+    CrispyMemo *memo
+){
+    struct stat st;
+    guint8 buf[CRISPY_MEMO_CHUNK];
+    off_t offset;
+    gssize n;
+
+    if (fstat(STDIN_FILENO, &st) != 0)
+        return TRUE;
+
+    offset = S_ISREG(st.st_mode) ? lseek(STDIN_FILENO, 0, SEEK_CUR) : -1;
+
+    memo->stdin_data = g_byte_array_new();
+    for (;;)
+    {
+        n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return FALSE;
+        if (n == 0)
+            break;
+        g_byte_array_append(memo->stdin_data, buf, (guint)n);
+    }
+
+    if (offset >= 0 && lseek(STDIN_FILENO, offset, SEEK_SET) == offset)
+        memo->stdin_rewound = TRUE;
+
+    return TRUE;
+}
+
+/*
+ * restore_stdin:
+ *
+ * Gives the script the stdin bytes read_stdin() consumed, through an
+ * unlinked temp file in place of fd 0.
+ */
+static gboolean
+restore_stdin(
+    CrispyMemo *memo
+){
+    g_autofree gchar *tmp_path = NULL;
+    gint fd;
+
+    if (memo->stdin_data == NULL || memo->stdin_rewound)
+        return TRUE;
+
+    fd = g_file_open_tmp("crispy-stdin-XXXXXX", &tmp_path, NULL);
+    if (fd < 0)
+        return FALSE;
+    unlink(tmp_path);
+
+    if (!write_all(fd, memo->stdin_data->data, memo->stdin_data->len) ||
+        lseek(fd, 0, SEEK_SET) != 0 ||
+        dup2(fd, STDIN_FILENO) < 0)
+    {
+        close(fd);
+        return FALSE;
+    }
+    close(fd);
+
+    /* later captures must not restore again */
+    memo->stdin_rewound = TRUE;
+    return TRUE;
+}
+
+/*
+ * parse_list_define:
+ *
+ * If the line [@line, @line_end) is `#define @name`, stores its
+ * quoted value, if any, in @value and returns %TRUE.
+ */
+static gboolean
+parse_list_define(
+    const gchar  *line,
+    const gchar  *line_end,
+    const gchar  *name,
+    gchar       **value
+){
+    const gchar *p;
+    const gchar *quote;
+    const gchar *end;
+
+    p = line;
+    while (p < line_end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (!g_str_has_prefix(p, "#define"))
+        return FALSE;
+    p += strlen("#define");
+    while (p < line_end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (!g_str_has_prefix(p, name))
+        return FALSE;
+    p += strlen(name);
+    if (p < line_end && *p != ' ' && *p != '\t' && *p != '\r')
+        return FALSE;
+
+    *value = NULL;
+    quote = memchr(p, '"', (gsize)(line_end - p));
+    if (quote != NULL)
+    {
+        end = memchr(quote + 1, '"', (gsize)(line_end - quote - 1));
+        if (end != NULL)
+            *value = g_strndup(quote + 1, (gsize)(end - quote - 1));
+    }
+
+    return TRUE;
+}
+
+/* --- declared inputs --- */
+
+gchar **
+crispy_memo_detect_list(
+    const gchar *source,
+    const gchar *name
+){
+    const gchar *pos;
+    const gchar *line_end;
+    g_autofree gchar *value = NULL;
+    g_auto(GStrv) parts = NULL;
+    GPtrArray *inputs;
+    gboolean found;
+    guint i;
+
+    g_return_val_if_fail(name != NULL, NULL);
+
+    if (source == NULL || strstr(source, name) == NULL)
+        return NULL;
+
+    found = FALSE;
+    pos = source;
+    while (!found && *pos != '\0')
+    {
+        line_end = strchr(pos, '\n');
+        if (line_end == NULL)
+            line_end = pos + strlen(pos);
+
+        found = parse_list_define(pos, line_end, name, &value);
+        pos = (*line_end == '\n') ? line_end + 1 : line_end;
+    }
+    if (!found)
+        return NULL;
+
+    inputs = g_ptr_array_new();
+    parts = g_strsplit(value != NULL ? value : "", ";", -1);
+    for (i = 0; parts[i] != NULL; i++)
+    {
+        g_strstrip(parts[i]);
+        if (parts[i][0] != '\0')
+            g_ptr_array_add(inputs, g_strdup(parts[i]));
+    }
+    g_ptr_array_add(inputs, NULL);
+
+    return (gchar **)g_ptr_array_free(inputs, FALSE);
+}
+
+gchar **
+crispy_memo_detect(
+    const gchar *source
+){
+    return crispy_memo_detect_list(source, "CRISPY_PURE");
+}
+
+void
+crispy_memo_hash_inputs(
+    GChecksum           *checksum,
+    const gchar * const *inputs
+){
+    guint i;
+
+    for (i = 0; inputs[i] != NULL; i++)
+    {
+        g_autoptr(GMappedFile) mapped = NULL;
+
+        hash_field(checksum, "input", inputs[i], strlen(inputs[i]));
+        mapped = g_mapped_file_new(inputs[i], FALSE, NULL);
+        if (mapped == NULL)
+            hash_field(checksum, "missing", NULL, 0);
+        else
+            hash_field(checksum, "contents",
+                       g_mapped_file_get_contents(mapped),
+                       g_mapped_file_get_length(mapped));
+    }
+}
+
+gchar *
+crispy_memo_cache_path(
+    CrispyCacheProvider *cache,
+    const gchar         *key,
+    const gchar         *suffix
+){
+    g_autofree gchar *so_path = NULL;
+
+    /* records sit next to the builds: <key>.so -> <key><suffix> */
+    so_path = crispy_cache_provider_get_path(cache, key);
+    if (g_str_has_suffix(so_path, ".so"))
+        so_path[strlen(so_path) - 3] = '\0';
+
+    return g_strconcat(so_path, suffix, NULL);
+}
+
+/* --- lifecycle --- */
+
+CrispyMemo *
+crispy_memo_new(
+    CrispyCacheProvider  *cache,
+    const gchar          *artifact_hash,
+    const gchar * const  *inputs,
+    gint                  argc,
+    gchar               **argv
+){
+    CrispyMemo *memo;
+    g_autoptr(GChecksum) checksum = NULL;
+    gchar count[32];
+    gint i;
+
+    g_return_val_if_fail(CRISPY_IS_CACHE_PROVIDER(cache), NULL);
+    g_return_val_if_fail(artifact_hash != NULL, NULL);
+    g_return_val_if_fail(inputs != NULL, NULL);
+
+    /* what will be typed is not known yet, so there is no key */
+    if (isatty(STDIN_FILENO))
+        return NULL;
+
+    memo = g_new0(CrispyMemo, 1);
+    memo->saved_stdout = -1;
+    memo->pipe_read = -1;
+
+    if (!read_stdin(memo))
+    {
+        crispy_memo_free(memo);
+        return NULL;
+    }
+
+    checksum = g_checksum_new(CRISPY_HASH_ALGO);
+    hash_field(checksum, "memo", CRISPY_MEMO_MAGIC, strlen(CRISPY_MEMO_MAGIC));
+    hash_field(checksum, "artifact", artifact_hash, strlen(artifact_hash));
+
+    g_snprintf(count, sizeof(count), "%d", argc);
+    hash_field(checksum, "argc", count, strlen(count));
+    for (i = 0; i < argc; i++)
+        hash_field(checksum, "arg", argv[i], strlen(argv[i]));
+
+    if (memo->stdin_data != NULL)
+        hash_field(checksum, "stdin", memo->stdin_data->data,
+                   memo->stdin_data->len);
+    else
+        hash_field(checksum, "stdin", NULL, 0);
+
+    crispy_memo_hash_inputs(checksum, inputs);
+
+    memo->path = crispy_memo_cache_path(cache,
+                                        g_checksum_get_string(checksum),
+                                        ".memo");
+
+    return memo;
+}
+
+void
+crispy_memo_free(
+    CrispyMemo *memo
+){
+    if (memo == NULL)
+        return;
+
+    if (memo->saved_stdout >= 0)
+    {
+        dup2(memo->saved_stdout, STDOUT_FILENO);
+        g_thread_join(memo->tee);
+        close(memo->saved_stdout);
+        close(memo->pipe_read);
+    }
+
+    if (memo->record != NULL)
+        g_mapped_file_unref(memo->record);
+    if (memo->stdin_data != NULL)
+        g_byte_array_unref(memo->stdin_data);
+    if (memo->output != NULL)
+        g_byte_array_unref(memo->output);
+    g_free(memo->path);
+    g_free(memo);
+}
+
+/* --- replay --- */
+
+gboolean
+crispy_memo_lookup(
+    CrispyMemo *memo
+){
+    const CrispyMemoHeader *header;
+    GMappedFile *record;
+    gsize len;
+
+    g_return_val_if_fail(memo != NULL, FALSE);
+
+    record = g_mapped_file_new(memo->path, FALSE, NULL);
+    if (record == NULL)
+        return FALSE;
+
+    /* a record from another version or a torn file is a miss */
+    len = g_mapped_file_get_length(record);
+    header = (const CrispyMemoHeader *)g_mapped_file_get_contents(record);
+    if (len < sizeof(*header) ||
+        memcmp(header->magic, CRISPY_MEMO_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CRISPY_MEMO_VERSION ||
+        header->output_len != len - sizeof(*header))
+    {
+        g_mapped_file_unref(record);
+        return FALSE;
+    }
+
+    if (memo->record != NULL)
+        g_mapped_file_unref(memo->record);
+    memo->record = record;
+
+    return TRUE;
+}
+
+gint
+crispy_memo_replay(
+    CrispyMemo *memo
+){
+    const CrispyMemoHeader *header;
+
+    g_return_val_if_fail(memo != NULL && memo->record != NULL, -1);
+
+    header = (const CrispyMemoHeader *)g_mapped_file_get_contents(memo->record);
+
+    fflush(stdout);
+    write_all(STDOUT_FILENO, (const guint8 *)(header + 1),
+              (gsize)header->output_len);
+
+    return header->exit_code;
+}
+
+/* --- capture --- */
+
+static gpointer
+tee_output(
+    gpointer data
+){
+    CrispyMemo *memo;
+    guint8 buf[CRISPY_MEMO_CHUNK];
+    gssize n;
+
+    memo = (CrispyMemo *)data;
+
+    for (;;)
+    {
+        n = read(memo->pipe_read, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        if (!memo->write_failed &&
+            !write_all(memo->saved_stdout, buf, (gsize)n))
+            memo->write_failed = TRUE;
+
+        if (memo->output->len + (gsize)n >
+            sizeof(CrispyMemoHeader) + CRISPY_MEMO_MAX_OUTPUT)
+            memo->overflow = TRUE;
+        if (!memo->overflow)
+            g_byte_array_append(memo->output, buf, (guint)n);
+    }
+
+    return NULL;
+}
+
+gboolean
+crispy_memo_begin_capture(
+    CrispyMemo *memo
+){
+    gint fds[2];
+
+    g_return_val_if_fail(memo != NULL, FALSE);
+    g_return_val_if_fail(memo->saved_stdout < 0, FALSE);
+
+    if (!restore_stdin(memo))
+        return FALSE;
+
+    fflush(stdout);
+    if (pipe(fds) != 0)
+        return FALSE;
+
+    memo->saved_stdout = dup(STDOUT_FILENO);
+    if (memo->saved_stdout < 0 || dup2(fds[1], STDOUT_FILENO) < 0)
+    {
+        if (memo->saved_stdout >= 0)
+            close(memo->saved_stdout);
+        memo->saved_stdout = -1;
+        close(fds[0]);
+        close(fds[1]);
+        return FALSE;
+    }
+    close(fds[1]);
+
+    memo->pipe_read = fds[0];
+    memo->output = g_byte_array_sized_new(sizeof(CrispyMemoHeader) +
+                                          CRISPY_MEMO_CHUNK);
+    g_byte_array_set_size(memo->output, sizeof(CrispyMemoHeader));
+    memo->overflow = FALSE;
+    memo->write_failed = FALSE;
+    memo->tee = g_thread_new("crispy-memo", tee_output, memo);
+
+    return TRUE;
+}
+
+void
+crispy_memo_end_capture(
+    CrispyMemo *memo,
+    gint        exit_code
+){
+    CrispyMemoHeader *header;
+
+    g_return_if_fail(memo != NULL && memo->saved_stdout >= 0);
+
+    /* closing the last write end ends the tee thread's input */
+    dup2(memo->saved_stdout, STDOUT_FILENO);
+    g_thread_join(memo->tee);
+    memo->tee = NULL;
+    close(memo->saved_stdout);
+    close(memo->pipe_read);
+    memo->saved_stdout = -1;
+    memo->pipe_read = -1;
+
+    if (memo->overflow || memo->write_failed)
+        return;
+
+    header = (CrispyMemoHeader *)memo->output->data;
+    memcpy(header->magic, CRISPY_MEMO_MAGIC, sizeof(header->magic));
+    header->version = CRISPY_MEMO_VERSION;
+    header->exit_code = exit_code;
+    header->output_len = memo->output->len - sizeof(*header);
+
+    /* written to a temp file and renamed: readers never see half */
+    g_file_set_contents(memo->path, (const gchar *)memo->output->data,
+                        (gssize)memo->output->len, NULL);
+}
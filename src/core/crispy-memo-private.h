@@ -0,0 +1,159 @@
+/* crispy-memo-private.h - Internal result memoization for pure scripts */
+
+/*
+ * Support for CRISPY_PURE: a script that declares itself a pure
+ * function of its argv, its stdin and a list of input files has its
+ * stdout and exit code recorded in the cache, and an identical later
+ * invocation replays the record instead of running.  Used by
+ * CrispyScript.  This header is NOT installed or included in the
+ * public umbrella header.
+ */
+
+#ifndef CRISPY_MEMO_PRIVATE_H
+#define CRISPY_MEMO_PRIVATE_H
+
+#include <glib.h>
+#include "../interfaces/crispy-cache-provider.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_MEMO_MAX_OUTPUT:
+ *
+ * Largest stdout, in bytes, that is recorded.  A run that prints more
+ * is passed through as usual but not memoized.
+ */
+#define CRISPY_MEMO_MAX_OUTPUT (64 * 1024 * 1024)
+
+typedef struct _CrispyMemo CrispyMemo;
+
+/**
+ * crispy_memo_detect:
+ * @source: (nullable): source text of a C file
+ *
+ * Looks for `#define CRISPY_PURE` at the start of a line.  The macro
+ * may be empty or a string of semicolon-separated input files:
+ * `#define CRISPY_PURE "data.csv;template.html"`.  Relative paths are
+ * resolved against the working directory, as the script would.
+ *
+ * Returns: (transfer full) (nullable) (array zero-terminated=1): the
+ *   declared inputs, possibly none, or %NULL if @source is not pure
+ */
+gchar      **crispy_memo_detect   (const gchar          *source);
+
+/**
+ * crispy_memo_detect_list:
+ * @source: (nullable): source text of a C file
+ * @name: macro name to look for
+ *
+ * Like crispy_memo_detect() for any macro that declares a list of
+ * input files the same way, such as CRISPY_INIT_INPUTS.
+ *
+ * Returns: (transfer full) (nullable) (array zero-terminated=1): the
+ *   declared inputs, possibly none, or %NULL if @name is not defined
+ */
+gchar      **crispy_memo_detect_list   (const gchar     *source,
+                                        const gchar     *name);
+
+/**
+ * crispy_memo_hash_inputs:
+ * @checksum: checksum being built
+ * @inputs: (array zero-terminated=1): declared input files
+ *
+ * Feeds the name and contents of each input into @checksum.  A
+ * missing input is hashed as missing.
+ */
+void         crispy_memo_hash_inputs   (GChecksum           *checksum,
+                                        const gchar * const *inputs);
+
+/**
+ * crispy_memo_cache_path:
+ * @cache: cache the record lives in
+ * @key: record key
+ * @suffix: file extension, such as ".memo"
+ *
+ * Returns: (transfer full): where a record for @key is stored: next
+ *   to the cache's builds, with @suffix in place of ".so"
+ */
+gchar       *crispy_memo_cache_path    (CrispyCacheProvider *cache,
+                                        const gchar         *key,
+                                        const gchar         *suffix);
+
+/**
+ * crispy_memo_new:
+ * @cache: cache the record lives in, next to the script's build
+ * @artifact_hash: cache hash of the script's build
+ * @inputs: (array zero-terminated=1): declared input files
+ * @argc: argument count
+ * @argv: (array length=argc): argument vector, argv[0] included
+ *
+ * Reads all of standard input and computes the memo key from
+ * @artifact_hash, @argv, the stdin bytes and the contents of @inputs.
+ * A missing input is hashed as missing.
+ *
+ * Returns: (transfer full) (nullable): a new #CrispyMemo, or %NULL if
+ *   standard input is a terminal or could not be read; the script then
+ *   runs without memoization
+ */
+CrispyMemo  *crispy_memo_new      (CrispyCacheProvider  *cache,
+                                   const gchar          *artifact_hash,
+                                   const gchar * const  *inputs,
+                                   gint                  argc,
+                                   gchar               **argv);
+
+/**
+ * crispy_memo_lookup:
+ * @memo: a #CrispyMemo
+ *
+ * Returns: %TRUE if a valid record exists for @memo's key
+ */
+gboolean     crispy_memo_lookup   (CrispyMemo           *memo);
+
+/**
+ * crispy_memo_replay:
+ * @memo: a #CrispyMemo for which crispy_memo_lookup() succeeded
+ *
+ * Writes the recorded output to standard output.
+ *
+ * Returns: the recorded exit code
+ */
+gint         crispy_memo_replay   (CrispyMemo           *memo);
+
+/**
+ * crispy_memo_begin_capture:
+ * @memo: a #CrispyMemo
+ *
+ * Prepares to run the script for real: gives it back the stdin bytes
+ * crispy_memo_new() consumed, and points standard output at a pipe
+ * that a thread copies both to the original stdout and into the
+ * record.
+ *
+ * Returns: %TRUE if capturing; %FALSE if the run cannot be recorded,
+ *   in which case stdin has still been restored
+ */
+gboolean     crispy_memo_begin_capture (CrispyMemo      *memo);
+
+/**
+ * crispy_memo_end_capture:
+ * @memo: a capturing #CrispyMemo
+ * @exit_code: the script's exit code
+ *
+ * Puts standard output back and stores the record, unless the output
+ * was too large or could not be passed through.  The caller flushes
+ * any stdio or writer buffers first.
+ */
+void         crispy_memo_end_capture   (CrispyMemo      *memo,
+                                        gint             exit_code);
+
+/**
+ * crispy_memo_free:
+ * @memo: (nullable): a #CrispyMemo
+ *
+ * Frees @memo, ending a capture that is still running without
+ * recording it.
+ */
+void         crispy_memo_free     (CrispyMemo           *memo);
+
+G_END_DECLS
+
+#endif /* CRISPY_MEMO_PRIVATE_H */
@@ -0,0 +1,142 @@
+/* crispy-multiversion-private.c - Internal ISA multiversioning helpers */
+
+#define CRISPY_COMPILATION
+#include "crispy-multiversion-private.h"
+
+#include <string.h>
+
+/*
+ * The target list matches the target_clones attribute below, best
+ * first, so crispy_multiversion_select() makes the same choice as the
+ * ifunc resolver gcc generates for each cloned function.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CRISPY_MULTIVERSION_ATTRIBUTE \
+    "'-DCRISPY_MULTIVERSION=__attribute__((target_clones(\"default\",\"avx2\",\"avx512f\")))'"
+
+static const gchar * const mv_targets[]      = { "avx512f", "avx2", NULL };
+static const gchar * const mv_target_flags[] = { "-mavx512f", "-mavx2", NULL };
+#else
+#define CRISPY_MULTIVERSION_ATTRIBUTE "-DCRISPY_MULTIVERSION="
+
+static const gchar * const mv_targets[]      = { NULL };
+static const gchar * const mv_target_flags[] = { NULL };
+#endif
+
+/* --- helper: is @p the start of the identifier @name? --- */
+static gboolean
+is_identifier_at(
+    const gchar *source,
+    const gchar *p,
+    const gchar *name
+){
+    gsize len;
+
+    len = strlen(name);
+    if (strncmp(p, name, len) != 0)
+        return FALSE;
+    if (p > source && (g_ascii_isalnum(p[-1]) || p[-1] == '_'))
+        return FALSE;
+    if (g_ascii_isalnum(p[len]) || p[len] == '_')
+        return FALSE;
+
+    return TRUE;
+}
+
+CrispyMultiversionMode
+crispy_multiversion_detect(
+    const gchar *source
+){
+    CrispyMultiversionMode mode;
+    const gchar *p;
+
+    if (source == NULL)
+        return CRISPY_MULTIVERSION_NONE;
+
+    mode = CRISPY_MULTIVERSION_NONE;
+    p = source;
+    while ((p = strstr(p, "CRISPY_MULTIVERSION")) != NULL)
+    {
+        if (is_identifier_at(source, p, "CRISPY_MULTIVERSION_SCRIPT"))
+            return CRISPY_MULTIVERSION_SCRIPT;
+        if (is_identifier_at(source, p, "CRISPY_MULTIVERSION"))
+            mode = CRISPY_MULTIVERSION_FUNCTIONS;
+        p += strlen("CRISPY_MULTIVERSION");
+    }
+
+    return mode;
+}
+
+const gchar *
+crispy_multiversion_get_define_flags(
+    CrispyMultiversionMode mode
+){
+    if (mode == CRISPY_MULTIVERSION_FUNCTIONS)
+        return CRISPY_MULTIVERSION_ATTRIBUTE;
+
+    return "-DCRISPY_MULTIVERSION=";
+}
+
+const gchar * const *
+crispy_multiversion_get_targets(void)
+{
+    return mv_targets;
+}
+
+const gchar *
+crispy_multiversion_get_target_flags(
+    const gchar *target
+){
+    guint i;
+
+    for (i = 0; mv_targets[i] != NULL; i++)
+    {
+        if (g_strcmp0(mv_targets[i], target) == 0)
+            return mv_target_flags[i];
+    }
+
+    return "";
+}
+
+const gchar *
+crispy_multiversion_select(void)
+{
+    static const gchar *selected = NULL;
+
+    if (g_once_init_enter(&selected))
+    {
+        const gchar *best;
+
+        best = "default";
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            best = "avx512f";
+        else if (__builtin_cpu_supports("avx2"))
+            best = "avx2";
+#endif
+        g_once_init_leave(&selected, best);
+    }
+
+    return selected;
+}
+
+gchar *
+crispy_multiversion_get_variant_path(
+    const gchar *so_path,
+    const gchar *target
+){
+    g_return_val_if_fail(so_path != NULL, NULL);
+
+    if (target == NULL || g_strcmp0(target, "default") == 0)
+        return g_strdup(so_path);
+
+    if (g_str_has_suffix(so_path, ".so"))
+    {
+        return g_strdup_printf("%.*s.%s.so",
+                               (gint)(strlen(so_path) - strlen(".so")),
+                               so_path, target);
+    }
+
+    return g_strdup_printf("%s.%s", so_path, target);
+}
@@ -0,0 +1,98 @@
+/* crispy-multiversion-private.h - Internal ISA multiversioning helpers */
+
+/*
+ * Support for CRISPY_MULTIVERSION: per-function target_clones and
+ * whole-script per-ISA builds, plus the load-time choice of clone.
+ * Used by CrispyScript.  This header is NOT installed or included in
+ * the public umbrella header.
+ */
+
+#ifndef CRISPY_MULTIVERSION_PRIVATE_H
+#define CRISPY_MULTIVERSION_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyMultiversionMode:
+ * @CRISPY_MULTIVERSION_NONE: the script does not ask for clones
+ * @CRISPY_MULTIVERSION_FUNCTIONS: functions marked `CRISPY_MULTIVERSION`
+ *   are compiled as `target_clones` and dispatched by the dynamic loader
+ * @CRISPY_MULTIVERSION_SCRIPT: the script contains
+ *   `#define CRISPY_MULTIVERSION_SCRIPT`; the whole script is compiled
+ *   once per target ISA and crispy loads the best build
+ */
+typedef enum
+{
+    CRISPY_MULTIVERSION_NONE,
+    CRISPY_MULTIVERSION_FUNCTIONS,
+    CRISPY_MULTIVERSION_SCRIPT
+} CrispyMultiversionMode;
+
+/**
+ * crispy_multiversion_detect:
+ * @source: (nullable): source text of a C file
+ *
+ * Returns: how @source asks to be multiversioned
+ */
+CrispyMultiversionMode crispy_multiversion_detect        (const gchar            *source);
+
+/**
+ * crispy_multiversion_get_define_flags:
+ * @mode: a #CrispyMultiversionMode other than %CRISPY_MULTIVERSION_NONE
+ *
+ * Returns the `-D` flag that defines the `CRISPY_MULTIVERSION`
+ * attribute macro for @mode: a `target_clones` attribute in function
+ * mode, empty in script mode (the whole script is already cloned) and
+ * on architectures without clone support.
+ *
+ * Returns: (transfer none): the define flag
+ */
+const gchar           *crispy_multiversion_get_define_flags (CrispyMultiversionMode  mode);
+
+/**
+ * crispy_multiversion_get_targets:
+ *
+ * Returns the non-default ISA targets, best first, that are cloned
+ * on this architecture.  Empty where multiversioning is unsupported.
+ *
+ * Returns: (transfer none) (array zero-terminated=1): target names
+ */
+const gchar * const   *crispy_multiversion_get_targets      (void);
+
+/**
+ * crispy_multiversion_get_target_flags:
+ * @target: a name from crispy_multiversion_get_targets()
+ *
+ * Returns: (transfer none): the gcc flags that enable @target
+ */
+const gchar           *crispy_multiversion_get_target_flags (const gchar            *target);
+
+/**
+ * crispy_multiversion_select:
+ *
+ * Picks the best target this CPU supports, using the same priority
+ * as the target_clones resolver.  Computed once.
+ *
+ * Returns: (transfer none): a target name, or "default"
+ */
+const gchar           *crispy_multiversion_select           (void);
+
+/**
+ * crispy_multiversion_get_variant_path:
+ * @so_path: cached shared object path (`<hash>.so`)
+ * @target: a target name
+ *
+ * Returns the path of the @target build of a whole-script
+ * multiversioned cache entry, `<hash>.<target>.so`.  The "default"
+ * target is @so_path itself.
+ *
+ * Returns: (transfer full): the variant path
+ */
+gchar                 *crispy_multiversion_get_variant_path (const gchar            *so_path,
+                                                             const gchar            *target);
+
+G_END_DECLS
+
+#endif /* CRISPY_MULTIVERSION_PRIVATE_H */
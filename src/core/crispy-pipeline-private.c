@@ -0,0 +1,71 @@
+/* crispy-pipeline-private.c - Internal in-process script pipelines */
+
+#define CRISPY_COMPILATION
+#include "crispy-pipeline-private.h"
+#include "crispy-script-private.h"
+#include "../crispy-types.h"
+
+/*
+ * Mirrors crispy_pipeline_run() in crispy-stage.h.  The core library
+ * does not link against the runtime; the function is found through the
+ * first stage's module, which does.
+ */
+typedef gint (*CrispyPipelineRunFunc) (gpointer  *stages,
+                                       gint      *argcs,
+                                       gchar   ***argvs,
+                                       guint      n_stages);
+
+gint
+crispy_pipeline_execute(
+    CrispyScript  **scripts,
+    gint           *argcs,
+    gchar        ***argvs,
+    guint           n_stages,
+    GError        **error
+){
+    g_autofree gpointer *stages = NULL;
+    CrispyPipelineRunFunc run;
+    gboolean dry_run;
+    gint exit_code;
+    guint i;
+
+    g_return_val_if_fail(scripts != NULL, -1);
+    g_return_val_if_fail(argcs != NULL && argvs != NULL, -1);
+    g_return_val_if_fail(n_stages > 0, -1);
+
+    stages = g_new0(gpointer, n_stages);
+    dry_run = FALSE;
+    for (i = 0; i < n_stages; i++)
+    {
+        crispy_script_set_entry_point_internal(scripts[i],
+                                               CRISPY_PIPELINE_STAGE_SYMBOL);
+        /* every stage has its own main() and maybe helpers of one name */
+        crispy_script_set_local_symbols_internal(scripts[i], TRUE);
+        if (!crispy_script_prepare(scripts[i], argcs[i], argvs[i], error))
+            return -1;
+
+        stages[i] = crispy_script_lookup_symbol_internal(
+            scripts[i], CRISPY_PIPELINE_STAGE_SYMBOL);
+
+        /* only a dry run prepares successfully without loading */
+        if (stages[i] == NULL)
+            dry_run = TRUE;
+    }
+    if (dry_run)
+        return 0;
+
+    run = (CrispyPipelineRunFunc)crispy_script_lookup_symbol_internal(
+        scripts[0], "crispy_pipeline_run");
+    if (run == NULL)
+    {
+        g_set_error(error,
+                    CRISPY_ERROR,
+                    CRISPY_ERROR_LOAD,
+                    "Pipeline stages must include <crispy-runtime.h>");
+        return -1;
+    }
+
+    /* -1 means the pipeline could not start; a failing stage is 1 */
+    exit_code = run(stages, argcs, argvs, n_stages);
+    return exit_code < 0 ? 1 : exit_code;
+}
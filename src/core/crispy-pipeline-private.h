@@ -0,0 +1,51 @@
+/* crispy-pipeline-private.h - Internal in-process script pipelines */
+
+/*
+ * Support for `crispy --pipeline`: several scripts are loaded into one
+ * process and run as the stages of a pipeline, each on its own thread,
+ * by the runtime's crispy_pipeline_run().  Used by the crispy binary.
+ * This header is NOT installed or included in the public umbrella
+ * header.
+ */
+
+#ifndef CRISPY_PIPELINE_PRIVATE_H
+#define CRISPY_PIPELINE_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_PIPELINE_STAGE_SYMBOL:
+ *
+ * Entry point every pipeline stage script must export, with the
+ * signature of the runtime's CrispyStageFunc.
+ */
+#define CRISPY_PIPELINE_STAGE_SYMBOL "crispy_stage_main"
+
+/**
+ * crispy_pipeline_execute:
+ * @scripts: (array length=n_stages): unprepared scripts, first to last
+ * @argcs: (array length=n_stages): argument count of each stage
+ * @argvs: (array length=n_stages): argument vector of each stage
+ * @n_stages: number of stages, at least 1
+ * @error: (nullable): return location for a #GError
+ *
+ * Compiles and loads every script, resolves its
+ * %CRISPY_PIPELINE_STAGE_SYMBOL and runs the stages connected first to
+ * last.  The scripts' PRE_EXECUTE and POST_EXECUTE hooks do not fire;
+ * the stages are not run through crispy_script_run().
+ *
+ * Returns: the last stage's exit code, 1 if it was negative, or -1 if
+ *   a stage could not be loaded; @error is set unless a plugin aborted
+ */
+gint crispy_pipeline_execute (CrispyScript  **scripts,
+                              gint           *argcs,
+                              gchar        ***argvs,
+                              guint           n_stages,
+                              GError        **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_PIPELINE_PRIVATE_H */
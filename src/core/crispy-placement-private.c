@@ -0,0 +1,357 @@
+/* crispy-placement-private.c - Internal CPU, NUMA and scheduler placement */
+
+#define _GNU_SOURCE
+#define CRISPY_COMPILATION
+#include "crispy-placement-private.h"
+#include "crispy-source-utils-private.h"
+#include "../crispy-types.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define NUMA_SYSFS_DIR          "/sys/devices/system/node"
+
+/* from <linux/mempolicy.h>, which is not always installed */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED          (1)
+#endif
+
+#define NODEMASK_LONGS          (16)
+
+/* --- helper: parse "0-3,8" into @set --- */
+static gboolean
+parse_cpu_list(
+    const gchar  *list,
+    cpu_set_t    *set,
+    GError      **error
+){
+    g_auto(GStrv) ranges = NULL;
+    gchar *end;
+    gulong first;
+    gulong last;
+    gulong cpu;
+    guint i;
+
+    CPU_ZERO(set);
+    ranges = g_strsplit(list, ",", -1);
+    for (i = 0; ranges[i] != NULL; i++)
+    {
+        g_strstrip(ranges[i]);
+        if (ranges[i][0] == '\0')
+            continue;
+        if (!g_ascii_isdigit(ranges[i][0]))
+            goto invalid;
+
+        first = strtoul(ranges[i], &end, 10);
+        last = first;
+        if (*end == '-')
+        {
+            if (!g_ascii_isdigit(end[1]))
+                goto invalid;
+            last = strtoul(end + 1, &end, 10);
+        }
+        if (*end != '\0' || last < first || last >= CPU_SETSIZE)
+            goto invalid;
+
+        for (cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+    }
+
+    if (CPU_COUNT(set) == 0)
+        goto invalid;
+
+    return TRUE;
+
+invalid:
+    g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                "Invalid CPU list '%s'", list);
+    return FALSE;
+}
+
+/* --- helper: format @set as "0-3,8" --- */
+static gchar *
+format_cpu_list(
+    const cpu_set_t *set
+){
+    GString *list;
+    gint cpu;
+    gint last;
+
+    list = g_string_new(NULL);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, set))
+            continue;
+
+        last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+            last++;
+
+        if (list->len > 0)
+            g_string_append_c(list, ',');
+        if (last == cpu)
+            g_string_append_printf(list, "%d", cpu);
+        else
+            g_string_append_printf(list, "%d-%d", cpu, last);
+        cpu = last;
+    }
+
+    return g_string_free(list, FALSE);
+}
+
+/*
+ * node_cpus:
+ *
+ * Reads the CPUs of NUMA node @node from sysfs.  Without NUMA support
+ * there is no node directory at all; node 0 is then the whole machine
+ * and @set is left as the current affinity.
+ */
+static gboolean
+node_cpus(
+    gint        node,
+    cpu_set_t  *set,
+    GError    **error
+){
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+
+    if (!g_file_test(NUMA_SYSFS_DIR, G_FILE_TEST_IS_DIR) && node == 0)
+        return sched_getaffinity(0, sizeof(*set), set) == 0;
+
+    path = g_strdup_printf(NUMA_SYSFS_DIR "/node%d/cpulist", node);
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                    "NUMA node %d does not exist", node);
+        return FALSE;
+    }
+
+    g_strstrip(contents);
+    if (contents[0] == '\0')
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                    "NUMA node %d has no CPUs", node);
+        return FALSE;
+    }
+
+    return parse_cpu_list(contents, set, error);
+}
+
+/* --- helper: prefer @node for the calling thread's allocations --- */
+static void
+prefer_node(
+    gint node
+){
+    gulong mask[NODEMASK_LONGS];
+    guint bits;
+
+    bits = (guint)(sizeof(gulong) * 8);
+    if ((guint)node >= NODEMASK_LONGS * bits)
+        return;
+
+    memset(mask, 0, sizeof(mask));
+    mask[node / bits] |= 1UL << (node % bits);
+
+    /* kernels without NUMA return ENOSYS; nothing to prefer then */
+    (void)syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                  (gulong)(NODEMASK_LONGS * bits + 1));
+}
+
+/* --- helper: "fifo:10" -> SCHED_FIFO, priority 10 --- */
+static gboolean
+parse_sched(
+    const gchar         *spec,
+    gint                *policy,
+    struct sched_param  *param,
+    GError             **error
+){
+    g_autofree gchar *name = NULL;
+    const gchar *colon;
+    gchar *end;
+    glong priority;
+    gboolean realtime;
+
+    colon = strchr(spec, ':');
+    name = colon != NULL ? g_strndup(spec, (gsize)(colon - spec)) : g_strdup(spec);
+
+    if (g_ascii_strcasecmp(name, "other") == 0)
+        *policy = SCHED_OTHER;
+    else if (g_ascii_strcasecmp(name, "batch") == 0)
+        *policy = SCHED_BATCH;
+    else if (g_ascii_strcasecmp(name, "idle") == 0)
+        *policy = SCHED_IDLE;
+    else if (g_ascii_strcasecmp(name, "fifo") == 0)
+        *policy = SCHED_FIFO;
+    else if (g_ascii_strcasecmp(name, "rr") == 0)
+        *policy = SCHED_RR;
+    else
+        goto invalid;
+
+    realtime = (*policy == SCHED_FIFO || *policy == SCHED_RR);
+    memset(param, 0, sizeof(*param));
+    if (realtime)
+        param->sched_priority = sched_get_priority_min(*policy);
+
+    if (colon != NULL)
+    {
+        priority = strtol(colon + 1, &end, 10);
+        if (!realtime || colon[1] == '\0' || *end != '\0' ||
+            priority < sched_get_priority_min(*policy) ||
+            priority > sched_get_priority_max(*policy))
+            goto invalid;
+        param->sched_priority = (gint)priority;
+    }
+
+    return TRUE;
+
+invalid:
+    g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                "Invalid scheduling policy '%s' (expected other, batch, "
+                "idle, fifo[:PRIO] or rr[:PRIO])", spec);
+    return FALSE;
+}
+
+/* --- public API --- */
+
+void
+crispy_placement_clear(
+    CrispyPlacement *placement
+){
+    g_clear_pointer(&placement->cpus, g_free);
+    g_clear_pointer(&placement->sched, g_free);
+    placement->numa_node = -1;
+}
+
+gboolean
+crispy_placement_is_set(
+    const CrispyPlacement *placement
+){
+    return placement->cpus != NULL || placement->numa_node >= 0 ||
+           placement->sched != NULL;
+}
+
+void
+crispy_placement_fill(
+    CrispyPlacement *placement,
+    const gchar     *cpus,
+    gint             numa_node,
+    const gchar     *sched
+){
+    if (placement->cpus == NULL && cpus != NULL)
+        placement->cpus = g_strdup(cpus);
+    if (placement->numa_node < 0 && numa_node >= 0)
+        placement->numa_node = numa_node;
+    if (placement->sched == NULL && sched != NULL)
+        placement->sched = g_strdup(sched);
+}
+
+gboolean
+crispy_placement_fill_from_source(
+    CrispyPlacement  *placement,
+    const gchar      *source,
+    GError          **error
+){
+    g_autofree gchar *cpus = NULL;
+    g_autofree gchar *node = NULL;
+    g_autofree gchar *sched = NULL;
+    gchar *end;
+    glong numa_node;
+
+    cpus = crispy_source_extract_define(source, "CRISPY_CPUS");
+    node = crispy_source_extract_define(source, "CRISPY_NUMA_NODE");
+    sched = crispy_source_extract_define(source, "CRISPY_SCHED");
+
+    numa_node = -1;
+    if (node != NULL)
+    {
+        numa_node = strtol(node, &end, 10);
+        if (node[0] == '\0' || *end != '\0' || numa_node < 0 ||
+            numa_node > G_MAXINT)
+        {
+            g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                        "Invalid CRISPY_NUMA_NODE '%s'", node);
+            return FALSE;
+        }
+    }
+
+    crispy_placement_fill(placement, cpus, (gint)numa_node, sched);
+    return TRUE;
+}
+
+gboolean
+crispy_placement_apply(
+    const CrispyPlacement  *placement,
+    gchar                 **applied_cpus,
+    GError                **error
+){
+    cpu_set_t cpus;
+    cpu_set_t node_set;
+    struct sched_param param;
+    gboolean pin;
+    gint policy;
+
+    pin = FALSE;
+    if (placement->cpus != NULL)
+    {
+        if (!parse_cpu_list(placement->cpus, &cpus, error))
+            return FALSE;
+        pin = TRUE;
+    }
+
+    if (placement->numa_node >= 0)
+    {
+        if (!node_cpus(placement->numa_node, &node_set, error))
+            return FALSE;
+
+        if (pin)
+            CPU_AND(&cpus, &cpus, &node_set);
+        else
+            memcpy(&cpus, &node_set, sizeof(cpus));
+        pin = TRUE;
+
+        if (CPU_COUNT(&cpus) == 0)
+        {
+            g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                        "CPU list '%s' has no CPU on NUMA node %d",
+                        placement->cpus, placement->numa_node);
+            return FALSE;
+        }
+    }
+
+    if (pin && sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                    "Failed to set CPU affinity: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    /* first-touch pages now come from the node the threads run on */
+    if (placement->numa_node >= 0)
+        prefer_node(placement->numa_node);
+
+    if (placement->sched != NULL)
+    {
+        if (!parse_sched(placement->sched, &policy, &param, error))
+            return FALSE;
+        if (sched_setscheduler(0, policy, &param) != 0)
+        {
+            g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PLACEMENT,
+                        "Failed to set scheduling policy '%s': %s",
+                        placement->sched, g_strerror(errno));
+            return FALSE;
+        }
+    }
+
+    if (applied_cpus != NULL)
+    {
+        *applied_cpus = NULL;
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+            *applied_cpus = format_cpu_list(&cpus);
+    }
+
+    return TRUE;
+}
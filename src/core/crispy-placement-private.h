@@ -0,0 +1,105 @@
+/* crispy-placement-private.h - Internal CPU, NUMA and scheduler placement */
+
+/*
+ * Support for --cpus, --numa-node and --sched and their config and
+ * CRISPY_CPUS / CRISPY_NUMA_NODE / CRISPY_SCHED source equivalents:
+ * pins the thread that runs the script, and so every thread it starts,
+ * before PRE_EXECUTE.  Used by CrispyScript and the crispy binary.
+ * This header is NOT installed or included in the public umbrella
+ * header.
+ */
+
+#ifndef CRISPY_PLACEMENT_PRIVATE_H
+#define CRISPY_PLACEMENT_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyPlacement:
+ * @cpus: CPU list such as "0-3,8", or %NULL
+ * @numa_node: NUMA node whose CPUs and memory to use, or -1
+ * @sched: scheduling policy: "other", "batch", "idle", "fifo[:PRIO]"
+ *   or "rr[:PRIO]", or %NULL
+ *
+ * Where a script runs.  Unset fields leave the inherited setting
+ * alone.  With both @cpus and @numa_node, the script runs on the CPUs
+ * of the node that are also in @cpus.
+ */
+typedef struct
+{
+    gchar *cpus;
+    gint   numa_node;
+    gchar *sched;
+} CrispyPlacement;
+
+#define CRISPY_PLACEMENT_INIT { NULL, -1, NULL }
+
+/**
+ * crispy_placement_clear:
+ * @placement: a #CrispyPlacement
+ *
+ * Frees the strings in @placement and unsets every field.
+ */
+void     crispy_placement_clear       (CrispyPlacement       *placement);
+
+/**
+ * crispy_placement_is_set:
+ * @placement: a #CrispyPlacement
+ *
+ * Returns: %TRUE if any field is set
+ */
+gboolean crispy_placement_is_set      (const CrispyPlacement *placement);
+
+/**
+ * crispy_placement_fill:
+ * @placement: a #CrispyPlacement
+ * @cpus: (nullable): CPU list
+ * @numa_node: NUMA node, or -1
+ * @sched: (nullable): scheduling policy
+ *
+ * Sets each field of @placement that is still unset from the
+ * arguments, so callers fill from the highest priority source down.
+ */
+void     crispy_placement_fill        (CrispyPlacement       *placement,
+                                       const gchar           *cpus,
+                                       gint                   numa_node,
+                                       const gchar           *sched);
+
+/**
+ * crispy_placement_fill_from_source:
+ * @placement: a #CrispyPlacement
+ * @source: (nullable): script source
+ * @error: (nullable): return location for a #GError
+ *
+ * Like crispy_placement_fill() with the values of the script's
+ * `#define CRISPY_CPUS`, `CRISPY_NUMA_NODE` and `CRISPY_SCHED`.
+ *
+ * Returns: %FALSE if CRISPY_NUMA_NODE is not a node number
+ */
+gboolean crispy_placement_fill_from_source (CrispyPlacement  *placement,
+                                            const gchar      *source,
+                                            GError          **error);
+
+/**
+ * crispy_placement_apply:
+ * @placement: a #CrispyPlacement
+ * @applied_cpus: (out) (optional) (transfer full): the calling thread's
+ *   CPU list afterwards
+ * @error: (nullable): return location for a #GError
+ *
+ * Applies @placement to the calling thread: CPU affinity, preferred
+ * memory node and scheduling policy.  Threads created afterwards
+ * inherit all three.  On a machine without NUMA support node 0 means
+ * every CPU and any other node is an error.
+ *
+ * Returns: %TRUE on success; %FALSE with %CRISPY_ERROR_PLACEMENT
+ */
+gboolean crispy_placement_apply       (const CrispyPlacement  *placement,
+                                       gchar                 **applied_cpus,
+                                       GError                **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_PLACEMENT_PRIVATE_H */
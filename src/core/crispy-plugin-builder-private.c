@@ -0,0 +1,161 @@
+/* crispy-plugin-builder-private.c - Internal compilation of plugin sources */
+
+#define CRISPY_COMPILATION
+#include "crispy-plugin-builder-private.h"
+#include "crispy-source-utils-private.h"
+#include "../crispy-types.h"
+
+#include <string.h>
+
+typedef struct
+{
+    CrispyPluginBuild   *build;
+    CrispyCompiler      *compiler;
+    CrispyCacheProvider *cache;
+} BuildJob;
+
+/* --- helper: whether @path names a plugin source --- */
+static gboolean
+is_plugin_source(
+    const gchar *path
+){
+    return g_str_has_suffix(path, ".c");
+}
+
+/* --- helper: compile one plugin source through the cache --- */
+static gboolean
+build_source(
+    CrispyPluginBuild   *build,
+    CrispyCompiler      *compiler,
+    CrispyCacheProvider *cache,
+    GError             **error
+){
+    g_autofree gchar *source_content = NULL;
+    g_autofree gchar *raw_params = NULL;
+    g_autofree gchar *expanded_params = NULL;
+    g_autofree gchar *extra_flags = NULL;
+    g_autofree gchar *hash = NULL;
+    g_autofree gchar *so_path = NULL;
+
+    if (!g_file_get_contents(build->path, &source_content, NULL, error))
+        return FALSE;
+
+    raw_params = crispy_source_extract_params(source_content);
+    expanded_params = crispy_source_shell_expand(raw_params, error);
+    if (expanded_params == NULL && raw_params != NULL)
+        return FALSE;
+    if (expanded_params == NULL)
+        expanded_params = g_strdup("");
+
+    /* crispy's include flags let the plugin #include "crispy-plugin.h" */
+    extra_flags = g_strdup_printf("%s %s", crispy_source_get_include_flags(),
+                                  expanded_params);
+
+    hash = crispy_cache_provider_compute_hash(
+        cache, source_content, -1, extra_flags,
+        crispy_compiler_get_version(compiler));
+    so_path = crispy_cache_provider_get_path(cache, hash);
+
+    build->cache_hit = crispy_cache_provider_has_valid(cache, hash,
+                                                       build->path);
+    if (!build->cache_hit)
+    {
+        g_debug("Plugin compile: %s -> %s", build->path, so_path);
+        if (!crispy_compiler_compile_shared(compiler, build->path, so_path,
+                                            extra_flags, error))
+            return FALSE;
+    }
+    else
+    {
+        g_debug("Plugin cache hit: %s", so_path);
+    }
+
+    build->so_path = g_steal_pointer(&so_path);
+    return TRUE;
+}
+
+/* --- helper: GThreadFunc wrapper around build_source() --- */
+static gpointer
+build_job_run(
+    gpointer data
+){
+    BuildJob *job;
+    GError *error;
+
+    job = data;
+    error = NULL;
+    if (!build_source(job->build, job->compiler, job->cache, &error))
+    {
+        g_prefix_error(&error, "Failed to build plugin '%s': ",
+                       job->build->path);
+        job->build->error = error;
+    }
+
+    return NULL;
+}
+
+/* --- public API --- */
+
+void
+crispy_plugin_build_all(
+    CrispyPluginBuild   *builds,
+    guint                n_builds,
+    CrispyCompiler      *compiler,
+    CrispyCacheProvider *cache
+){
+    g_autofree BuildJob *jobs = NULL;
+    g_autofree GThread **threads = NULL;
+    guint n_jobs;
+    guint i;
+
+    g_return_if_fail(builds != NULL || n_builds == 0);
+    g_return_if_fail(compiler != NULL);
+    g_return_if_fail(cache != NULL);
+
+    jobs = g_new0(BuildJob, n_builds);
+    threads = g_new0(GThread *, n_builds);
+    n_jobs = 0;
+
+    for (i = 0; i < n_builds; i++)
+    {
+        if (!is_plugin_source(builds[i].path))
+        {
+            builds[i].so_path = g_strdup(builds[i].path);
+            builds[i].cache_hit = TRUE;
+            continue;
+        }
+
+        jobs[n_jobs].build = &builds[i];
+        jobs[n_jobs].compiler = compiler;
+        jobs[n_jobs].cache = cache;
+        n_jobs++;
+    }
+
+    if (n_jobs == 0)
+        return;
+
+    /*
+     * Each source is independent: gcc runs as a separate process and
+     * writes through a temporary file, so the compilations only share
+     * the read-only compiler and cache.  The last job runs on the
+     * calling thread.
+     */
+    for (i = 0; i + 1 < n_jobs; i++)
+        threads[i] = g_thread_new("crispy-plugin-cc", build_job_run,
+                                  &jobs[i]);
+
+    build_job_run(&jobs[n_jobs - 1]);
+
+    for (i = 0; i + 1 < n_jobs; i++)
+        g_thread_join(threads[i]);
+}
+
+void
+crispy_plugin_build_clear(
+    CrispyPluginBuild *build
+){
+    g_return_if_fail(build != NULL);
+
+    g_clear_pointer(&build->so_path, g_free);
+    g_clear_error(&build->error);
+}
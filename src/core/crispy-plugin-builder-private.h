@@ -0,0 +1,68 @@
+/* crispy-plugin-builder-private.h - Internal compilation of plugin sources */
+
+/*
+ * Support for passing plugin .c files to -P and the config's plugin
+ * list: each source is compiled to a shared object through the same
+ * CrispyCompiler and CrispyCacheProvider used for scripts and the
+ * config, then loaded like any other plugin .so.  Used by the crispy
+ * binary.  This header is NOT installed or included in the public
+ * umbrella header.
+ */
+
+#ifndef CRISPY_PLUGIN_BUILDER_PRIVATE_H
+#define CRISPY_PLUGIN_BUILDER_PRIVATE_H
+
+#include <glib.h>
+#include "../interfaces/crispy-compiler.h"
+#include "../interfaces/crispy-cache-provider.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyPluginBuild:
+ * @path: plugin path as given, not owned
+ * @so_path: shared object to load, set by crispy_plugin_build_all()
+ * @cache_hit: whether @so_path was already in the cache
+ * @error: why @path could not be built, or %NULL
+ *
+ * One entry of crispy_plugin_build_all().  Exactly one of @so_path and
+ * @error is set after the build.
+ */
+typedef struct
+{
+    const gchar *path;
+    gchar       *so_path;
+    gboolean     cache_hit;
+    GError      *error;
+} CrispyPluginBuild;
+
+/**
+ * crispy_plugin_build_all:
+ * @builds: (array length=n_builds): plugins to build
+ * @n_builds: number of entries in @builds
+ * @compiler: compiler for plugin sources
+ * @cache: cache for the compiled plugins
+ *
+ * Paths ending in ".c" are compiled with `-shared -fPIC`, crispy's
+ * include flags and the source's CRISPY_PARAMS, keyed in @cache by
+ * source content, flags and compiler version exactly like scripts.
+ * Other paths are taken to be shared objects and passed through.
+ * Sources that miss the cache are compiled in parallel, one thread
+ * each.
+ */
+void crispy_plugin_build_all   (CrispyPluginBuild   *builds,
+                                guint                n_builds,
+                                CrispyCompiler      *compiler,
+                                CrispyCacheProvider *cache);
+
+/**
+ * crispy_plugin_build_clear:
+ * @build: a #CrispyPluginBuild
+ *
+ * Frees the @so_path and @error of @build.
+ */
+void crispy_plugin_build_clear (CrispyPluginBuild   *build);
+
+G_END_DECLS
+
+#endif /* CRISPY_PLUGIN_BUILDER_PRIVATE_H */
@@ -5,9 +5,34 @@
 
 #include "crispy-plugin-engine.h"
 #include "../crispy-plugin.h"
+#include "crispy-trace-private.h"
 
 G_BEGIN_DECLS
 
+/**
+ * crispy_plugin_engine_has_hook:
+ * @self: a #CrispyPluginEngine
+ * @hook_point: a hook point
+ *
+ * Tells whether any loaded plugin exports a handler for @hook_point, so
+ * callers can skip filling the hook context.  Lock-free.
+ *
+ * Returns: %TRUE if dispatching @hook_point would call a plugin
+ */
+gboolean         crispy_plugin_engine_has_hook (CrispyPluginEngine *self,
+                                                CrispyHookPoint     hook_point);
+
+/**
+ * crispy_plugin_engine_hook_name:
+ * @hook_point: a hook point
+ *
+ * Short name of @hook_point as used in warnings, traces and telemetry,
+ * e.g. "post_execute" for %CRISPY_HOOK_POST_EXECUTE.
+ *
+ * Returns: (transfer none): a static string
+ */
+const gchar     *crispy_plugin_engine_hook_name (CrispyHookPoint     hook_point);
+
 /**
  * crispy_plugin_engine_dispatch:
  * @self: a #CrispyPluginEngine
@@ -16,12 +41,21 @@ G_BEGIN_DECLS
  *
  * Dispatches a hook to all loaded plugins that export a handler for
  * the given @hook_point. Each plugin's handler is called in load order.
+ * Only plugins subscribed to @hook_point are visited, and a hook with no
+ * subscriber returns at once.
  * If any plugin returns %CRISPY_HOOK_ABORT, dispatch stops immediately.
  *
  * The @ctx->plugin_data field is swapped to each plugin's private
  * data before calling its hook, and the @ctx->engine field is set
  * to @self for shared data store access.
  *
+ * Safe to call from several threads at once.  Each call iterates the
+ * plugins loaded when it started and holds no lock while hooks run.
+ *
+ * If @ctx->plugin_costs is set, each hook call's wall and thread CPU
+ * time are added to its plugin's #CrispyPluginCost, which is appended
+ * the first time the plugin runs.  The array belongs to one pipeline.
+ *
  * Returns: %CRISPY_HOOK_CONTINUE if all plugins continued,
  *   or the first non-continue result
  */
@@ -29,6 +63,30 @@ CrispyHookResult crispy_plugin_engine_dispatch (CrispyPluginEngine *self,
                                                 CrispyHookPoint     hook_point,
                                                 CrispyHookContext  *ctx);
 
+/**
+ * crispy_plugin_engine_check_costs:
+ * @self: a #CrispyPluginEngine
+ * @costs: (nullable) (element-type CrispyPluginCost): costs of one run
+ *
+ * Emits a warning for each plugin in @costs over the threshold set with
+ * crispy_plugin_engine_set_cost_warning().  Does nothing when no
+ * threshold is set.
+ */
+void             crispy_plugin_engine_check_costs (CrispyPluginEngine *self,
+                                                   GArray             *costs);
+
+/**
+ * crispy_plugin_engine_set_trace_internal:
+ * @self: a #CrispyPluginEngine
+ * @trace: (nullable): trace to record hook calls in
+ *
+ * Records every hook call as a span in @trace, named after the plugin,
+ * with the hook point and thread CPU time as arguments.  Set it before
+ * the first dispatch.  The engine keeps a reference.
+ */
+void             crispy_plugin_engine_set_trace_internal (CrispyPluginEngine *self,
+                                                          CrispyTrace        *trace);
+
 G_END_DECLS
 
 #endif /* CRISPY_PLUGIN_ENGINE_PRIVATE_H */
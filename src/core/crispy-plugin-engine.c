@@ -1,14 +1,17 @@
 /* crispy-plugin-engine.c - Plugin engine implementation */
 
+#define _GNU_SOURCE
 #define CRISPY_COMPILATION
 #include "crispy-plugin-engine.h"
 #include "crispy-plugin-engine-private.h"
+#include "crispy-trace-private.h"
 #include "../crispy-plugin.h"
 #include "../crispy-types.h"
 
 #include <glib.h>
 #include <gmodule.h>
 #include <string.h>
+#include <time.h>
 
 /**
  * SECTION:crispy-plugin-engine
@@ -22,6 +25,21 @@
  *
  * The engine also provides a shared data store (string-keyed hash
  * table) for inter-plugin communication.
+ *
+ * An engine may be shared by pipelines running on several threads.
+ * The plugin table is copy-on-write: loading a plugin publishes a new
+ * table, and each dispatch iterates the snapshot it started with, so
+ * hooks never run under a lock.  The data store is guarded by a
+ * reader/writer lock.
+ *
+ * Every table lists, per hook point, the plugins that export a handler
+ * for it, so a dispatch only visits subscribers.  A bitmask of the hook
+ * points with at least one subscriber is read without any lock, and a
+ * hook nobody handles costs a single atomic load.
+ *
+ * When the hook context carries a plugin_costs array, every hook call
+ * is timed, wall clock and thread CPU, and added to its plugin's entry.
+ * With a trace set, each hook call is also recorded as a span.
  */
 
 /* hook symbol names, indexed by CrispyHookPoint */
@@ -46,6 +64,7 @@ typedef struct
     gpointer                   plugin_data;
     CrispyPluginShutdownFunc   shutdown_func;
     CrispyPluginHookFunc       hooks[CRISPY_HOOK_POINT_COUNT];
+    guint                      index;   /* position in load order */
 } CrispyPluginEntry;
 
 /* data store entry for destroy notify */
@@ -85,6 +104,52 @@ plugin_entry_free(
     g_free(entry);
 }
 
+/* published plugin table (atomic refcounted box), never modified */
+typedef struct
+{
+    GPtrArray *plugins;                               /* of CrispyPluginEntry*, load order */
+    GPtrArray *subscribers[CRISPY_HOOK_POINT_COUNT];  /* entries handling each hook */
+} PluginTable;
+
+static void
+plugin_table_clear(
+    gpointer ptr
+){
+    PluginTable *table;
+    gint i;
+
+    table = (PluginTable *)ptr;
+    g_ptr_array_unref(table->plugins);
+    for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
+        g_ptr_array_unref(table->subscribers[i]);
+}
+
+/* --- helper: a table that takes over @plugins, with its subscriber lists --- */
+static PluginTable *
+plugin_table_new(
+    GPtrArray *plugins
+){
+    PluginTable *table;
+    CrispyPluginEntry *entry;
+    guint j;
+    gint i;
+
+    table = g_atomic_rc_box_new0(PluginTable);
+    table->plugins = plugins;
+    for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
+    {
+        table->subscribers[i] = g_ptr_array_new();
+        for (j = 0; j < plugins->len; j++)
+        {
+            entry = (CrispyPluginEntry *)g_ptr_array_index(plugins, j);
+            if (entry->hooks[i] != NULL)
+                g_ptr_array_add(table->subscribers[i], entry);
+        }
+    }
+
+    return table;
+}
+
 struct _CrispyPluginEngine
 {
     GObject parent_instance;
@@ -92,12 +157,87 @@ struct _CrispyPluginEngine
 
 typedef struct
 {
-    GPtrArray   *plugins;     /* of CrispyPluginEntry* */
-    GHashTable  *data_store;  /* string -> DataStoreEntry* */
+    GRWLock      plugins_lock; /* guards the table pointer */
+    PluginTable *table;        /* current plugin table */
+    guint        hook_mask;    /* bit n: some plugin handles hook n; only grows */
+    GRWLock      data_lock;    /* guards data_store */
+    GHashTable  *data_store;   /* string -> DataStoreEntry* */
+    gint64       cost_warning_ns; /* 0: never warn */
+    CrispyTrace *trace;        /* --trace, or NULL */
 } CrispyPluginEnginePrivate;
 
 G_DEFINE_FINAL_TYPE_WITH_PRIVATE(CrispyPluginEngine, crispy_plugin_engine, G_TYPE_OBJECT)
 
+/* --- helper: take a reference to the current plugin table --- */
+static PluginTable *
+table_snapshot(
+    CrispyPluginEnginePrivate *priv
+){
+    PluginTable *table;
+
+    g_rw_lock_reader_lock(&priv->plugins_lock);
+    table = g_atomic_rc_box_acquire(priv->table);
+    g_rw_lock_reader_unlock(&priv->plugins_lock);
+
+    return table;
+}
+
+/* --- helper: nanoseconds on @clock --- */
+static gint64
+clock_ns(
+    clockid_t clock
+){
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+/* --- helper: the cost entry of @entry, appended on its first hook --- */
+static CrispyPluginCost *
+cost_for_entry(
+    GArray            *costs,
+    CrispyPluginEntry *entry
+){
+    CrispyPluginCost *cost;
+    CrispyPluginCost fresh;
+    guint i;
+
+    for (i = 0; i < costs->len; i++)
+    {
+        cost = &g_array_index(costs, CrispyPluginCost, i);
+        if (cost->index == entry->index)
+            return cost;
+    }
+
+    memset(&fresh, 0, sizeof(fresh));
+    fresh.index = entry->index;
+    fresh.name = entry->info->name;
+    g_array_append_val(costs, fresh);
+
+    return &g_array_index(costs, CrispyPluginCost, costs->len - 1);
+}
+
+/* --- helper: record one hook call as a span named after the plugin --- */
+static void
+trace_hook(
+    CrispyTrace       *trace,
+    CrispyPluginEntry *entry,
+    CrispyHookPoint    hook_point,
+    gint64             start,
+    gint64             duration,
+    gint64             cpu_ns
+){
+    g_autofree gchar *args = NULL;
+
+    args = g_strdup_printf(
+        "{\"hook\": \"%s\", \"cpu_us\": %" G_GINT64_FORMAT "}",
+        crispy_plugin_engine_hook_name(hook_point),
+        cpu_ns / 1000);
+    crispy_trace_add_span(trace, "hook", entry->info->name, start, duration,
+                          args);
+}
+
 /* --- GObject lifecycle --- */
 
 static void
@@ -105,12 +245,19 @@ crispy_plugin_engine_finalize(
     GObject *object
 ){
     CrispyPluginEnginePrivate *priv;
+    guint i;
 
     priv = crispy_plugin_engine_get_instance_private(CRISPY_PLUGIN_ENGINE(object));
 
-    /* plugins are freed (and shutdown called) via the element free func */
-    g_ptr_array_unref(priv->plugins);
+    /* entries are shared by every published table; free them once */
+    for (i = 0; i < priv->table->plugins->len; i++)
+        plugin_entry_free(g_ptr_array_index(priv->table->plugins, i));
+    g_atomic_rc_box_release_full(priv->table, plugin_table_clear);
     g_hash_table_unref(priv->data_store);
+    g_clear_pointer(&priv->trace, crispy_trace_unref);
+
+    g_rw_lock_clear(&priv->plugins_lock);
+    g_rw_lock_clear(&priv->data_lock);
 
     G_OBJECT_CLASS(crispy_plugin_engine_parent_class)->finalize(object);
 }
@@ -133,7 +280,10 @@ crispy_plugin_engine_init(
 
     priv = crispy_plugin_engine_get_instance_private(self);
 
-    priv->plugins = g_ptr_array_new_with_free_func(plugin_entry_free);
+    g_rw_lock_init(&priv->plugins_lock);
+    g_rw_lock_init(&priv->data_lock);
+
+    priv->table = plugin_table_new(g_ptr_array_new());
     priv->data_store = g_hash_table_new_full(g_str_hash, g_str_equal,
                                               g_free, data_store_entry_free);
 }
@@ -158,6 +308,10 @@ crispy_plugin_engine_load(
     GModule *module;
     const CrispyPluginInfo *info;
     CrispyPluginInitFunc init_func;
+    GPtrArray *plugins;
+    PluginTable *old_table;
+    guint hook_mask;
+    guint j;
     gint i;
 
     g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), FALSE);
@@ -203,18 +357,35 @@ crispy_plugin_engine_load(
                     (gpointer *)&entry->shutdown_func);
 
     /* resolve optional hook functions */
+    hook_mask = 0;
     for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
     {
         entry->hooks[i] = NULL;
         g_module_symbol(module, hook_symbol_names[i],
                         (gpointer *)&entry->hooks[i]);
+        if (entry->hooks[i] != NULL)
+            hook_mask |= 1u << i;
     }
 
     /* call init if provided */
     if (init_func != NULL)
         entry->plugin_data = init_func();
 
-    g_ptr_array_add(priv->plugins, entry);
+    /* publish a new table; running dispatches keep their snapshot */
+    g_rw_lock_writer_lock(&priv->plugins_lock);
+    old_table = priv->table;
+    plugins = g_ptr_array_sized_new(old_table->plugins->len + 1);
+    for (j = 0; j < old_table->plugins->len; j++)
+        g_ptr_array_add(plugins, g_ptr_array_index(old_table->plugins, j));
+    entry->index = plugins->len;
+    g_ptr_array_add(plugins, entry);
+    priv->table = plugin_table_new(plugins);
+    g_rw_lock_writer_unlock(&priv->plugins_lock);
+
+    /* only after the table: a dispatch that sees the bit finds the hook */
+    g_atomic_int_or(&priv->hook_mask, hook_mask);
+
+    g_atomic_rc_box_release_full(old_table, plugin_table_clear);
     return TRUE;
 }
 
@@ -255,11 +426,17 @@ crispy_plugin_engine_get_plugin_count(
     CrispyPluginEngine *self
 ){
     CrispyPluginEnginePrivate *priv;
+    guint count;
 
     g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), 0);
 
     priv = crispy_plugin_engine_get_instance_private(self);
-    return priv->plugins->len;
+
+    g_rw_lock_reader_lock(&priv->plugins_lock);
+    count = priv->table->plugins->len;
+    g_rw_lock_reader_unlock(&priv->plugins_lock);
+
+    return count;
 }
 
 void
@@ -282,7 +459,9 @@ crispy_plugin_engine_set_data(
     entry->destroy = destroy;
 
     /* replaces any existing entry (old one freed via destroy notify) */
+    g_rw_lock_writer_lock(&priv->data_lock);
     g_hash_table_replace(priv->data_store, g_strdup(key), entry);
+    g_rw_lock_writer_unlock(&priv->data_lock);
 }
 
 gpointer
@@ -292,21 +471,73 @@ crispy_plugin_engine_get_data(
 ){
     CrispyPluginEnginePrivate *priv;
     DataStoreEntry *entry;
+    gpointer data;
 
     g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), NULL);
     g_return_val_if_fail(key != NULL, NULL);
 
     priv = crispy_plugin_engine_get_instance_private(self);
 
+    g_rw_lock_reader_lock(&priv->data_lock);
     entry = (DataStoreEntry *)g_hash_table_lookup(priv->data_store, key);
-    if (entry != NULL)
-        return entry->data;
+    data = entry != NULL ? entry->data : NULL;
+    g_rw_lock_reader_unlock(&priv->data_lock);
+
+    return data;
+}
+
+void
+crispy_plugin_engine_set_cost_warning(
+    CrispyPluginEngine *self,
+    gdouble             threshold_ms
+){
+    CrispyPluginEnginePrivate *priv;
 
-    return NULL;
+    g_return_if_fail(CRISPY_IS_PLUGIN_ENGINE(self));
+    g_return_if_fail(threshold_ms >= 0.0);
+
+    priv = crispy_plugin_engine_get_instance_private(self);
+    priv->cost_warning_ns = (gint64)(threshold_ms * 1000000.0);
+}
+
+gdouble
+crispy_plugin_engine_get_cost_warning(
+    CrispyPluginEngine *self
+){
+    CrispyPluginEnginePrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), 0.0);
+
+    priv = crispy_plugin_engine_get_instance_private(self);
+    return (gdouble)priv->cost_warning_ns / 1000000.0;
 }
 
 /* --- internal dispatch --- */
 
+const gchar *
+crispy_plugin_engine_hook_name(
+    CrispyHookPoint hook_point
+){
+    g_return_val_if_fail(hook_point < CRISPY_HOOK_POINT_COUNT, NULL);
+
+    /* "crispy_plugin_on_post_execute" -> "post_execute" */
+    return hook_symbol_names[hook_point] + strlen("crispy_plugin_on_");
+}
+
+gboolean
+crispy_plugin_engine_has_hook(
+    CrispyPluginEngine *self,
+    CrispyHookPoint     hook_point
+){
+    CrispyPluginEnginePrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), FALSE);
+    g_return_val_if_fail(hook_point < CRISPY_HOOK_POINT_COUNT, FALSE);
+
+    priv = crispy_plugin_engine_get_instance_private(self);
+    return (g_atomic_int_get(&priv->hook_mask) & (1u << hook_point)) != 0;
+}
+
 CrispyHookResult
 crispy_plugin_engine_dispatch(
     CrispyPluginEngine *self,
@@ -315,7 +546,15 @@ crispy_plugin_engine_dispatch(
 ){
     CrispyPluginEnginePrivate *priv;
     CrispyPluginEntry *entry;
+    CrispyPluginCost *cost;
     CrispyHookResult result;
+    PluginTable *table;
+    GPtrArray *subscribers;
+    gpointer plugin_data;
+    gint64 wall_start;
+    gint64 cpu_start;
+    gint64 wall;
+    gint64 cpu;
     guint i;
 
     g_return_val_if_fail(CRISPY_IS_PLUGIN_ENGINE(self), CRISPY_HOOK_CONTINUE);
@@ -327,24 +566,120 @@ crispy_plugin_engine_dispatch(
     ctx->hook_point = hook_point;
     ctx->engine = (gpointer)self;
 
-    for (i = 0; i < priv->plugins->len; i++)
-    {
-        entry = (CrispyPluginEntry *)g_ptr_array_index(priv->plugins, i);
+    /* nobody handles this hook: no snapshot, no lock */
+    if ((g_atomic_int_get(&priv->hook_mask) & (1u << hook_point)) == 0)
+        return CRISPY_HOOK_CONTINUE;
 
-        if (entry->hooks[hook_point] == NULL)
-            continue;
+    table = table_snapshot(priv);
+    subscribers = table->subscribers[hook_point];
+    result = CRISPY_HOOK_CONTINUE;
+
+    for (i = 0; i < subscribers->len; i++)
+    {
+        entry = (CrispyPluginEntry *)g_ptr_array_index(subscribers, i);
 
         /* swap in this plugin's private data */
-        ctx->plugin_data = entry->plugin_data;
+        plugin_data = g_atomic_pointer_get(&entry->plugin_data);
+        ctx->plugin_data = plugin_data;
 
-        result = entry->hooks[hook_point](ctx);
+        if (ctx->plugin_costs == NULL && priv->trace == NULL)
+            result = entry->hooks[hook_point](ctx);
+        else
+        {
+            wall_start = clock_ns(CLOCK_MONOTONIC);
+            cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+            result = entry->hooks[hook_point](ctx);
+            cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+            wall = clock_ns(CLOCK_MONOTONIC) - wall_start;
+
+            /* after the hook: it may have read the array */
+            if (ctx->plugin_costs != NULL)
+            {
+                cost = cost_for_entry(ctx->plugin_costs, entry);
+                cost->calls[hook_point]++;
+                cost->wall_ns[hook_point] += wall;
+                cost->cpu_ns[hook_point] += cpu;
+            }
+
+            /* same clock as g_get_monotonic_time(), in microseconds */
+            if (priv->trace != NULL)
+                trace_hook(priv->trace, entry, hook_point,
+                           wall_start / 1000, wall / 1000, cpu);
+        }
 
-        /* store back any updated plugin_data */
-        entry->plugin_data = ctx->plugin_data;
+        /*
+         * Store back plugin_data only if the hook replaced it, so a
+         * concurrent pipeline's update is not clobbered with a stale
+         * copy.  The data itself is shared by every pipeline.
+         */
+        if (ctx->plugin_data != plugin_data)
+            g_atomic_pointer_set(&entry->plugin_data, ctx->plugin_data);
 
         if (result != CRISPY_HOOK_CONTINUE)
-            return result;
+            break;
+    }
+
+    g_atomic_rc_box_release_full(table, plugin_table_clear);
+    return result;
+}
+
+void
+crispy_plugin_engine_check_costs(
+    CrispyPluginEngine *self,
+    GArray             *costs
+){
+    CrispyPluginEnginePrivate *priv;
+    CrispyPluginCost *cost;
+    gint64 wall;
+    gint64 cpu;
+    gint slowest;
+    guint i;
+    gint h;
+
+    g_return_if_fail(CRISPY_IS_PLUGIN_ENGINE(self));
+
+    priv = crispy_plugin_engine_get_instance_private(self);
+    if (priv->cost_warning_ns == 0 || costs == NULL)
+        return;
+
+    for (i = 0; i < costs->len; i++)
+    {
+        cost = &g_array_index(costs, CrispyPluginCost, i);
+        wall = 0;
+        cpu = 0;
+        slowest = 0;
+        for (h = 0; h < CRISPY_HOOK_POINT_COUNT; h++)
+        {
+            wall += cost->wall_ns[h];
+            cpu += cost->cpu_ns[h];
+            if (cost->wall_ns[h] > cost->wall_ns[slowest])
+                slowest = h;
+        }
+
+        if (wall <= priv->cost_warning_ns)
+            continue;
+
+        g_warning("Plugin '%s' added %.2f ms (%.2f ms CPU), "
+                  "%.2f ms of it in %s",
+                  cost->name, (gdouble)wall / 1000000.0,
+                  (gdouble)cpu / 1000000.0,
+                  (gdouble)cost->wall_ns[slowest] / 1000000.0,
+                  crispy_plugin_engine_hook_name(slowest));
     }
+}
 
-    return CRISPY_HOOK_CONTINUE;
+void
+crispy_plugin_engine_set_trace_internal(
+    CrispyPluginEngine *self,
+    CrispyTrace        *trace
+){
+    CrispyPluginEnginePrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_PLUGIN_ENGINE(self));
+
+    priv = crispy_plugin_engine_get_instance_private(self);
+    if (trace != NULL)
+        crispy_trace_ref(trace);
+    g_clear_pointer(&priv->trace, crispy_trace_unref);
+    priv->trace = trace;
 }
@@ -77,6 +77,7 @@ guint crispy_plugin_engine_get_plugin_count (CrispyPluginEngine *self);
  * Stores arbitrary data in the engine's shared data store, keyed
  * by @key. This allows inter-plugin communication. If @key already
  * exists, the old value is freed via its destroy notify.
+ * Thread-safe.
  */
 void crispy_plugin_engine_set_data (CrispyPluginEngine *self,
                                     const gchar        *key,
@@ -89,12 +90,35 @@ void crispy_plugin_engine_set_data (CrispyPluginEngine *self,
  * @key: a string key to look up
  *
  * Retrieves data previously stored with crispy_plugin_engine_set_data().
+ * Thread-safe; the returned pointer is valid until @key is replaced.
  *
  * Returns: (transfer none) (nullable): the stored data, or %NULL
  */
 gpointer crispy_plugin_engine_get_data (CrispyPluginEngine *self,
                                         const gchar        *key);
 
+/**
+ * crispy_plugin_engine_set_cost_warning:
+ * @self: a #CrispyPluginEngine
+ * @threshold_ms: milliseconds, or 0 to turn the warning off
+ *
+ * Warns about any plugin whose hooks together take longer than
+ * @threshold_ms of wall time in one script run.  The warning names the
+ * plugin, its wall and CPU time and the hook it spent most time in.
+ * Off by default.
+ */
+void    crispy_plugin_engine_set_cost_warning (CrispyPluginEngine *self,
+                                               gdouble             threshold_ms);
+
+/**
+ * crispy_plugin_engine_get_cost_warning:
+ * @self: a #CrispyPluginEngine
+ *
+ * Returns: the threshold set with crispy_plugin_engine_set_cost_warning(),
+ *   0 when off
+ */
+gdouble crispy_plugin_engine_get_cost_warning (CrispyPluginEngine *self);
+
 G_END_DECLS
 
 #endif /* CRISPY_PLUGIN_ENGINE_H */
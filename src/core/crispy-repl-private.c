@@ -0,0 +1,629 @@
+/* crispy-repl-private.c - Internal incremental C REPL */
+
+#define CRISPY_COMPILATION
+#include "crispy-repl-private.h"
+#include "crispy-source-utils-private.h"
+#include "../crispy-types.h"
+
+#include <glib/gstdio.h>
+#include <gmodule.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef enum
+{
+    CELL_DIRECTIVE,     /* #include, #define, ... */
+    CELL_DECLARATION,   /* globals, prototypes, types */
+    CELL_FUNCTION,      /* a function definition */
+    CELL_STATEMENT      /* code to run once */
+} CellKind;
+
+typedef struct
+{
+    CrispyCompiler *compiler;
+    gchar          *session_dir;
+    gchar          *prelude;        /* default includes plus -I headers */
+    const gchar    *extra_flags;
+    GString        *directives;     /* accepted directive cells */
+    GString        *declarations;   /* externs for earlier cells' symbols */
+    GPtrArray      *modules;        /* GModule*, in load order */
+    guint           n_cells;
+} CrispyRepl;
+
+/* statements a file-scope cell can never start with */
+static const gchar * const statement_keywords[] = {
+    "if", "else", "for", "while", "do", "switch", "return", "break",
+    "continue", "goto", "g_autoptr", "g_autofree", "g_auto", NULL
+};
+
+/* words that can only start a declaration */
+static const gchar * const declaration_keywords[] = {
+    "typedef", "extern", "static", "inline", "const", "volatile",
+    "struct", "union", "enum", "unsigned", "signed", NULL
+};
+
+/* --- lexing helpers --- */
+
+/*
+ * skip_literal:
+ *
+ * If @p starts a string or character literal or a comment, returns the
+ * position just past it; otherwise returns @p.
+ */
+static const gchar *
+skip_literal(
+    const gchar *p
+){
+    const gchar *end;
+    gchar quote;
+
+    if (p[0] == '/' && p[1] == '*')
+    {
+        end = strstr(p + 2, "*/");
+        return (end != NULL) ? end + 2 : p + strlen(p);
+    }
+    if (p[0] == '/' && p[1] == '/')
+    {
+        while (*p != '\0' && *p != '\n')
+            p++;
+        return p;
+    }
+    if (*p != '"' && *p != '\'')
+        return p;
+
+    quote = *p++;
+    while (*p != '\0' && *p != quote)
+    {
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        p++;
+    }
+
+    return (*p == quote) ? p + 1 : p;
+}
+
+/*
+ * find_top_level:
+ *
+ * Returns the first occurrence of any character in @chars outside
+ * brackets, literals and comments, or %NULL.
+ */
+static const gchar *
+find_top_level(
+    const gchar *text,
+    const gchar *chars
+){
+    const gchar *p;
+    const gchar *next;
+    gint depth;
+
+    depth = 0;
+    p = text;
+    while (*p != '\0')
+    {
+        next = skip_literal(p);
+        if (next != p)
+        {
+            p = next;
+            continue;
+        }
+
+        if (depth == 0 && strchr(chars, *p) != NULL)
+            return p;
+        if (*p == '(' || *p == '[' || *p == '{')
+            depth++;
+        else if ((*p == ')' || *p == ']' || *p == '}') && depth > 0)
+            depth--;
+        p++;
+    }
+
+    return NULL;
+}
+
+/* --- helper: are all brackets in @text closed? --- */
+static gboolean
+brackets_balanced(
+    const gchar *text
+){
+    const gchar *p;
+    const gchar *next;
+    gint depth;
+
+    depth = 0;
+    p = text;
+    while (*p != '\0')
+    {
+        next = skip_literal(p);
+        if (next != p)
+        {
+            p = next;
+            continue;
+        }
+
+        if (*p == '(' || *p == '[' || *p == '{')
+            depth++;
+        else if (*p == ')' || *p == ']' || *p == '}')
+            depth--;
+        p++;
+    }
+
+    return depth <= 0;
+}
+
+/* --- helper: does @text start with the identifier @word? --- */
+static gboolean
+starts_with_word(
+    const gchar *text,
+    const gchar *word
+){
+    gsize len;
+
+    len = strlen(word);
+    return strncmp(text, word, len) == 0 &&
+           !g_ascii_isalnum(text[len]) && text[len] != '_';
+}
+
+/* --- cells --- */
+
+/*
+ * cell_is_complete:
+ *
+ * A directive ends with a line that has no trailing backslash; anything
+ * else once its brackets balance and it ends in ';' or '}'.
+ */
+static gboolean
+cell_is_complete(
+    const gchar *cell
+){
+    gsize len;
+
+    len = strlen(cell);
+    while (len > 0 && g_ascii_isspace(cell[len - 1]))
+        len--;
+    if (len == 0)
+        return FALSE;
+
+    if (cell[0] == '#')
+        return cell[len - 1] != '\\';
+
+    return (cell[len - 1] == ';' || cell[len - 1] == '}') &&
+           brackets_balanced(cell);
+}
+
+/*
+ * classify_cell:
+ *
+ * Tells declarations from statements by their first two tokens: a
+ * declaration starts with a storage class, qualifier or tag keyword,
+ * or with a type name followed by another identifier or a '*'.  Anything else, such
+ * as a call, an assignment or a control statement, is a statement.
+ */
+static CellKind
+classify_cell(
+    const gchar *cell
+){
+    const gchar *p;
+    const gchar *brace;
+    gboolean is_declaration;
+    guint i;
+
+    if (cell[0] == '#')
+        return CELL_DIRECTIVE;
+
+    if (!g_ascii_isalpha(cell[0]) && cell[0] != '_')
+        return CELL_STATEMENT;
+
+    for (i = 0; statement_keywords[i] != NULL; i++)
+    {
+        if (starts_with_word(cell, statement_keywords[i]))
+            return CELL_STATEMENT;
+    }
+
+    is_declaration = FALSE;
+    for (i = 0; declaration_keywords[i] != NULL; i++)
+    {
+        if (starts_with_word(cell, declaration_keywords[i]))
+            is_declaration = TRUE;
+    }
+
+    /* otherwise: a type name is followed by a name or a '*' */
+    if (!is_declaration)
+    {
+        p = cell;
+        while (g_ascii_isalnum(*p) || *p == '_')
+            p++;
+        while (g_ascii_isspace(*p))
+            p++;
+        if (!g_ascii_isalpha(*p) && *p != '_' && *p != '*')
+            return CELL_STATEMENT;
+    }
+
+    /* a body right after a parameter list makes a function */
+    brace = find_top_level(cell, "{=;");
+    if (brace != NULL && *brace == '{')
+    {
+        p = brace;
+        while (p > cell && g_ascii_isspace(p[-1]))
+            p--;
+        if (p > cell && p[-1] == ')')
+            return CELL_FUNCTION;
+    }
+
+    return CELL_DECLARATION;
+}
+
+/* --- helper: position just past the bracket opened at @p --- */
+static const gchar *
+skip_brackets(
+    const gchar *p
+){
+    const gchar *close;
+
+    close = find_top_level(p + 1, ")]}");
+    return (close != NULL) ? close + 1 : p + strlen(p);
+}
+
+/*
+ * append_extern:
+ *
+ * Appends what later cells need to see of one file-scope declaration
+ * (@decl, up to but not including its ';').  Types, typedefs and
+ * existing extern declarations are copied; definitions become extern
+ * declarations with every initializer removed.
+ */
+static void
+append_extern(
+    GString     *out,
+    const gchar *decl,
+    gsize        len
+){
+    g_autofree gchar *text = NULL;
+    const gchar *p;
+    const gchar *stop;
+
+    text = g_strndup(decl, len);
+    g_strstrip(text);
+    if (text[0] == '\0')
+        return;
+
+    if (starts_with_word(text, "typedef") || starts_with_word(text, "extern"))
+    {
+        g_string_append_printf(out, "%s;\n", text);
+        return;
+    }
+
+    /* "struct tag { ... }" with no declarator is just a type */
+    if (starts_with_word(text, "struct") || starts_with_word(text, "union") ||
+        starts_with_word(text, "enum"))
+    {
+        p = find_top_level(text, "{=");
+        if (p != NULL && *p == '{')
+        {
+            p = skip_brackets(p);
+            while (g_ascii_isspace(*p))
+                p++;
+            if (*p == '\0')
+            {
+                g_string_append_printf(out, "%s;\n", text);
+                return;
+            }
+        }
+    }
+
+    g_string_append(out, "extern ");
+    p = text;
+    while ((stop = find_top_level(p, "=")) != NULL)
+    {
+        g_string_append_len(out, p, stop - p);
+
+        /* drop "= initializer" up to the next declarator */
+        p = find_top_level(stop, ",");
+        if (p == NULL)
+            p = stop + strlen(stop);
+    }
+    g_string_append_printf(out, "%s;\n", p);
+}
+
+/* --- helper: blank out a leading "static" so later cells can link --- */
+static void
+drop_static(
+    gchar *cell
+){
+    if (starts_with_word(cell, "static"))
+        memset(cell, ' ', strlen("static"));
+}
+
+/* --- session --- */
+
+/* --- helper: print a compile error without the gcc command line --- */
+static void
+report_error(
+    const GError *error
+){
+    const gchar *command;
+
+    command = strstr(error->message, "\nCommand: ");
+    if (command != NULL)
+        g_printerr("%.*s\n", (gint)(command - error->message), error->message);
+    else
+        g_printerr("%s\n", error->message);
+}
+
+/*
+ * compile_cell:
+ *
+ * Writes @body after the prelude, directives and earlier cells' extern
+ * declarations to cell-N.c, for the current cell N, and compiles it to
+ * cell-N.so.
+ */
+static gchar *
+compile_cell(
+    CrispyRepl   *self,
+    const gchar  *directives,
+    const gchar  *body,
+    GError      **error
+){
+    g_autofree gchar *source_path = NULL;
+    g_autofree gchar *source = NULL;
+    g_autofree gchar *flags = NULL;
+    gchar *so_path;
+    const gchar *runtime_flags;
+
+    source_path = g_strdup_printf("%s/cell-%u.c", self->session_dir,
+                                  self->n_cells);
+    so_path = g_strdup_printf("%s/cell-%u.so", self->session_dir,
+                              self->n_cells);
+
+    source = g_strdup_printf("%s%s%s%s\n",
+                             self->prelude, directives,
+                             self->declarations->str, body);
+    if (!g_file_set_contents(source_path, source, -1, error))
+    {
+        g_free(so_path);
+        return NULL;
+    }
+
+    /* cells that include <crispy-runtime.h> link libcrispy-runtime */
+    runtime_flags = crispy_source_includes_runtime(directives)
+        ? crispy_source_get_runtime_flags()
+        : "";
+    flags = g_strjoin(" ", runtime_flags,
+                      self->extra_flags != NULL ? self->extra_flags : "",
+                      NULL);
+
+    if (!crispy_compiler_compile_shared(self->compiler, source_path,
+                                        so_path, flags, error))
+    {
+        g_free(so_path);
+        return NULL;
+    }
+
+    return so_path;
+}
+
+/*
+ * load_cell:
+ *
+ * Opens a compiled cell.  GModule loads with RTLD_GLOBAL, so the
+ * cell's symbols become visible to every cell loaded after it.
+ */
+static GModule *
+load_cell(
+    CrispyRepl   *self,
+    const gchar  *so_path,
+    GError      **error
+){
+    GModule *module;
+
+    module = g_module_open(so_path, G_MODULE_BIND_LAZY);
+    if (module == NULL)
+    {
+        g_set_error(error,
+                    CRISPY_ERROR,
+                    CRISPY_ERROR_LOAD,
+                    "Failed to load module: %s",
+                    g_module_error());
+        return NULL;
+    }
+
+    g_ptr_array_add(self->modules, module);
+    return module;
+}
+
+/* --- helper: run one complete cell --- */
+static void
+eval_cell(
+    CrispyRepl *self,
+    gchar      *cell
+){
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *so_path = NULL;
+    g_autofree gchar *directives = NULL;
+    g_autofree gchar *body = NULL;
+    GModule *module;
+    CellKind kind;
+
+    kind = classify_cell(cell);
+    self->n_cells++;
+
+    switch (kind)
+    {
+    case CELL_DIRECTIVE:
+        /* compile an empty cell to check the directive before keeping it */
+        directives = g_strdup_printf("%s%s\n", self->directives->str, cell);
+        so_path = compile_cell(self, directives, "", &error);
+        if (so_path == NULL)
+        {
+            report_error(error);
+            return;
+        }
+        g_string_assign(self->directives, directives);
+        break;
+
+    case CELL_DECLARATION:
+    case CELL_FUNCTION:
+        drop_static(cell);
+
+        /* #line makes gcc report positions within the cell */
+        body = g_strdup_printf("#line 1 \"cell %u\"\n%s",
+                               self->n_cells, cell);
+        so_path = compile_cell(self, self->directives->str, body, &error);
+        if (so_path == NULL || load_cell(self, so_path, &error) == NULL)
+        {
+            report_error(error);
+            return;
+        }
+
+        if (kind == CELL_FUNCTION)
+        {
+            const gchar *brace;
+
+            brace = find_top_level(cell, "{");
+            append_extern(self->declarations, cell, (gsize)(brace - cell));
+        }
+        else
+        {
+            const gchar *p;
+            const gchar *semi;
+
+            for (p = cell; (semi = find_top_level(p, ";")) != NULL; p = semi + 1)
+                append_extern(self->declarations, p, (gsize)(semi - p));
+        }
+        break;
+
+    case CELL_STATEMENT:
+    {
+        void (*run)(void);
+        g_autofree gchar *symbol = NULL;
+
+        symbol = g_strdup_printf("crispy_repl_cell_%u", self->n_cells);
+        body = g_strdup_printf("void\n%s(void)\n{\n#line 1 \"cell %u\"\n%s\n}",
+                               symbol, self->n_cells, cell);
+
+        so_path = compile_cell(self, self->directives->str, body, &error);
+        if (so_path == NULL)
+        {
+            report_error(error);
+            return;
+        }
+
+        module = load_cell(self, so_path, &error);
+        if (module == NULL ||
+            !g_module_symbol(module, symbol, (gpointer *)&run))
+        {
+            if (error != NULL)
+                report_error(error);
+            return;
+        }
+
+        run();
+        fflush(stdout);
+        break;
+    }
+    }
+}
+
+gint
+crispy_repl_run(
+    CrispyCompiler  *compiler,
+    FILE            *input,
+    const gchar     *extra_includes,
+    const gchar     *extra_flags,
+    GError         **error
+){
+    CrispyRepl self;
+    GString *cell;
+    gchar line[4096];
+    gboolean interactive;
+    gint i;
+
+    g_return_val_if_fail(CRISPY_IS_COMPILER(compiler), -1);
+    g_return_val_if_fail(input != NULL, -1);
+
+    memset(&self, 0, sizeof(self));
+    self.session_dir = g_dir_make_tmp("crispy-repl-XXXXXX", error);
+    if (self.session_dir == NULL)
+        return -1;
+
+    self.compiler = compiler;
+    self.prelude = crispy_source_build_prelude(extra_includes);
+    self.extra_flags = extra_flags;
+    self.directives = g_string_new(NULL);
+    self.declarations = g_string_new(NULL);
+    self.modules = g_ptr_array_new();
+
+    interactive = isatty(fileno(input)) && isatty(STDOUT_FILENO);
+    cell = g_string_new(NULL);
+
+    for (;;)
+    {
+        if (interactive)
+        {
+            g_print("%s", cell->len == 0 ? "crispy> " : "   ...> ");
+            fflush(stdout);
+        }
+
+        if (fgets(line, sizeof(line), input) == NULL)
+            break;
+
+        /* a blank line submits an unfinished cell */
+        if (line[strspn(line, " \t\r\n")] == '\0')
+        {
+            if (cell->len > 0)
+            {
+                g_strstrip(cell->str);
+                eval_cell(&self, cell->str);
+                g_string_truncate(cell, 0);
+            }
+            continue;
+        }
+
+        if (cell->len == 0 &&
+            g_str_has_prefix(line + strspn(line, " \t"), ".quit"))
+            break;
+
+        g_string_append(cell, line);
+        if (line[strlen(line) - 1] != '\n')
+            g_string_append_c(cell, '\n');
+
+        if (cell_is_complete(cell->str))
+        {
+            g_strstrip(cell->str);
+            eval_cell(&self, cell->str);
+            g_string_truncate(cell, 0);
+        }
+    }
+
+    /* a final cell without a trailing newline */
+    g_strstrip(cell->str);
+    if (cell->str[0] != '\0')
+        eval_cell(&self, cell->str);
+
+    if (interactive)
+        g_print("\n");
+
+    /* later cells reference earlier ones: unload newest first */
+    for (i = (gint)self.modules->len - 1; i >= 0; i--)
+        g_module_close(g_ptr_array_index(self.modules, i));
+
+    for (i = 1; i <= (gint)self.n_cells; i++)
+    {
+        g_autofree gchar *source_path = NULL;
+        g_autofree gchar *so_path = NULL;
+
+        source_path = g_strdup_printf("%s/cell-%d.c", self.session_dir, i);
+        so_path = g_strdup_printf("%s/cell-%d.so", self.session_dir, i);
+        g_unlink(source_path);
+        g_unlink(so_path);
+    }
+    g_rmdir(self.session_dir);
+
+    g_string_free(cell, TRUE);
+    g_ptr_array_unref(self.modules);
+    g_string_free(self.declarations, TRUE);
+    g_string_free(self.directives, TRUE);
+    g_free(self.prelude);
+    g_free(self.session_dir);
+
+    return 0;
+}
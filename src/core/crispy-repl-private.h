@@ -0,0 +1,53 @@
+/* crispy-repl-private.h - Internal incremental C REPL */
+
+/*
+ * Support for `crispy --repl`: every cell the user enters is compiled
+ * on its own into a small shared object that resolves earlier cells'
+ * globals and functions through the dynamic linker.  Used by the
+ * crispy binary.  This header is NOT installed or included in the
+ * public umbrella header.
+ */
+
+#ifndef CRISPY_REPL_PRIVATE_H
+#define CRISPY_REPL_PRIVATE_H
+
+#include <glib.h>
+#include <stdio.h>
+#include "../interfaces/crispy-compiler.h"
+
+G_BEGIN_DECLS
+
+/**
+ * crispy_repl_run:
+ * @compiler: the #CrispyCompiler to build cells with
+ * @input: stream to read cells from, usually stdin
+ * @extra_includes: (nullable): semicolon-separated headers added to
+ *   every cell's prelude, as with `-I`
+ * @extra_flags: (nullable): compiler flags for every cell
+ * @error: (nullable): return location for a #GError
+ *
+ * Reads cells from @input until end of input or a `.quit` line.  A cell
+ * is complete once its brackets balance and it ends in `;` or `}`; an
+ * empty line submits whatever has been typed.  Each cell is one of:
+ *
+ * - a preprocessor directive, added to the prelude of later cells;
+ * - a file-scope declaration or function definition, loaded and kept,
+ *   with an `extern` declaration or prototype added for later cells;
+ * - statements, wrapped in a function, loaded and called once.
+ *
+ * Only the new cell is compiled.  A cell that fails to compile is
+ * reported and forgotten.  Prompts are shown when @input and stdout are
+ * terminals.
+ *
+ * Returns: 0 at the end of the session, or -1 with @error set if the
+ *   session could not start
+ */
+gint crispy_repl_run (CrispyCompiler  *compiler,
+                      FILE            *input,
+                      const gchar     *extra_includes,
+                      const gchar     *extra_flags,
+                      GError         **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_REPL_PRIVATE_H */
@@ -0,0 +1,177 @@
+/* crispy-script-private.h - Internal CrispyScript helpers */
+
+/*
+ * Accessors used by other core modules (hot swap, watch, pipeline) that
+ * need to build a sibling script or reach into a loaded module.  This header is NOT
+ * installed or included in the public umbrella header.
+ */
+
+#ifndef CRISPY_SCRIPT_PRIVATE_H
+#define CRISPY_SCRIPT_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+#include "crispy-placement-private.h"
+#include "crispy-trace-private.h"
+
+G_BEGIN_DECLS
+
+/**
+ * crispy_script_respawn_internal:
+ * @self: a #CrispyScript created from a file
+ * @set_flags: #CrispyFlags to add
+ * @clear_flags: #CrispyFlags to remove
+ * @error: return location for a #GError, or %NULL
+ *
+ * Re-reads @self's source file into a new, unprepared script with the
+ * same compiler, cache, config flags, placement and plugin engine, and @self's
+ * flags adjusted by @set_flags and @clear_flags.
+ *
+ * Returns: (transfer full) (nullable): the new script
+ */
+CrispyScript *crispy_script_respawn_internal         (CrispyScript  *self,
+                                                      CrispyFlags    set_flags,
+                                                      CrispyFlags    clear_flags,
+                                                      GError       **error);
+
+/**
+ * crispy_script_lookup_symbol_internal:
+ * @self: a prepared #CrispyScript
+ * @name: symbol name
+ *
+ * Returns: (nullable): the address of @name in the loaded module, or
+ *   %NULL if it is not exported
+ */
+gpointer      crispy_script_lookup_symbol_internal   (CrispyScript  *self,
+                                                      const gchar   *name);
+
+/**
+ * crispy_script_set_entry_point_internal:
+ * @self: a #CrispyScript that has not been prepared
+ * @name: (nullable): symbol to resolve instead of `main`, or %NULL
+ *
+ * Makes crispy_script_prepare() look up @name as the script's entry
+ * point.  The symbol is only resolved, never called through
+ * crispy_script_run(), unless it has main()'s signature.  With %NULL,
+ * prepare requires no entry point and crispy_script_run() cannot be
+ * used; the caller finds what it needs with
+ * crispy_script_lookup_symbol_internal().
+ */
+void          crispy_script_set_entry_point_internal (CrispyScript  *self,
+                                                      const gchar   *name);
+
+/**
+ * crispy_script_set_local_symbols_internal:
+ * @self: a #CrispyScript that has not been prepared
+ * @local: %TRUE to load the script with %G_MODULE_BIND_LOCAL
+ *
+ * By default a script's module is loaded with RTLD_GLOBAL, so its
+ * non-static symbols take the place of the same names in every module
+ * loaded after it.  With @local set they stay private to the script,
+ * which lets several scripts that define the same names share a
+ * process.
+ */
+void          crispy_script_set_local_symbols_internal (CrispyScript  *self,
+                                                        gboolean       local);
+
+/**
+ * crispy_script_set_placement_internal:
+ * @self: a #CrispyScript
+ * @placement: CPU, NUMA and scheduler placement from the command line
+ * @defaults: (nullable): placement from the config
+ *
+ * Copies both into @self.  crispy_script_run() fills the fields
+ * @placement leaves unset from the script's CRISPY_CPUS,
+ * CRISPY_NUMA_NODE and CRISPY_SCHED, then from @defaults, and applies
+ * the result before PRE_EXECUTE.
+ */
+void          crispy_script_set_placement_internal   (CrispyScript          *self,
+                                                      const CrispyPlacement *placement,
+                                                      const CrispyPlacement *defaults);
+
+/**
+ * crispy_script_set_telemetry_internal:
+ * @self: a #CrispyScript
+ * @log_path: (nullable): JSON lines file to append one line per run to
+ * @metrics_path: (nullable): OpenMetrics text file to fold each run into
+ *
+ * After every crispy_script_run() that executed main() or replayed a
+ * CRISPY_PURE result, reports the run to the given files (see
+ * crispy-telemetry-private.h).  Respawned scripts inherit both.
+ */
+void          crispy_script_set_telemetry_internal   (CrispyScript  *self,
+                                                      const gchar   *log_path,
+                                                      const gchar   *metrics_path);
+
+/**
+ * crispy_script_set_trace_internal:
+ * @self: a #CrispyScript
+ * @trace: (nullable): trace to record the pipeline steps in
+ *
+ * Records param_expand, hash, cache_check, compile, module_load and
+ * execute as spans in @trace.  With #CrispyGccCompiler, each gcc run
+ * adds its own phases under compile.  @self keeps a reference, and
+ * respawned scripts share @trace.
+ */
+void          crispy_script_set_trace_internal       (CrispyScript  *self,
+                                                      CrispyTrace   *trace);
+
+/**
+ * crispy_script_run_internal:
+ * @self: a prepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @exit_code: (out): main()'s return value
+ * @error: return location for a #GError, or %NULL
+ *
+ * crispy_script_run() with failure reported apart from the exit code,
+ * so that a main() returning a negative value is not mistaken for an
+ * error.  A plugin aborting the run fails without setting @error.
+ *
+ * Returns: %TRUE if main() ran and no plugin aborted the run
+ */
+gboolean      crispy_script_run_internal             (CrispyScript  *self,
+                                                      gint           argc,
+                                                      gchar        **argv,
+                                                      gint          *exit_code,
+                                                      GError       **error);
+
+/**
+ * crispy_script_flush_output_internal:
+ * @self: a #CrispyScript
+ *
+ * Pushes out everything the script has printed so far: stdio, and
+ * the runtime's crispy_stdout() writer, which would otherwise only be
+ * flushed when the module is closed.
+ */
+void          crispy_script_flush_output_internal    (CrispyScript  *self);
+
+/**
+ * crispy_script_get_time_execute_internal:
+ * @self: a #CrispyScript
+ *
+ * Returns: microseconds the last crispy_script_run() spent in main()
+ */
+gint64        crispy_script_get_time_execute_internal (CrispyScript  *self);
+
+/**
+ * crispy_script_get_source_path_internal:
+ * @self: a #CrispyScript
+ *
+ * Returns: (nullable): the script's source file, or %NULL for inline
+ *   and stdin scripts
+ */
+const gchar  *crispy_script_get_source_path_internal (CrispyScript  *self);
+
+/**
+ * crispy_script_get_source_internal:
+ * @self: a #CrispyScript
+ *
+ * Returns: the script's source without the shebang and CRISPY_PARAMS
+ *   lines, as it is compiled
+ */
+const gchar  *crispy_script_get_source_internal      (CrispyScript  *self);
+
+G_END_DECLS
+
+#endif /* CRISPY_SCRIPT_PRIVATE_H */
@@ -2,7 +2,18 @@
 
 #define CRISPY_COMPILATION
 #include "crispy-script.h"
+#include "crispy-script-private.h"
 #include "crispy-source-utils-private.h"
+#include "crispy-multiversion-private.h"
+#include "crispy-isolate-private.h"
+#include "crispy-hot-swap-private.h"
+#include "crispy-memo-private.h"
+#include "crispy-snapshot-private.h"
+#include "crispy-placement-private.h"
+#include "crispy-allocator-private.h"
+#include "crispy-telemetry-private.h"
+#include "crispy-trace-private.h"
+#include "crispy-gcc-compiler-private.h"
 #include "crispy-plugin-engine.h"
 #include "crispy-plugin-engine-private.h"
 #include "../interfaces/crispy-compiler.h"
@@ -55,13 +66,45 @@ typedef struct
     gchar       *hash;              /* SHA256 hex string */
 
     GModule     *module;            /* loaded shared object */
+    gpointer     isolated_module;   /* dlmopen handle (CRISPY_FLAG_ISOLATE) */
+    CrispyMainFunc main_func;       /* resolved by crispy_script_prepare() */
+    const gchar *entry_point;       /* symbol main_func is looked up as, or NULL */
+    gboolean     local_symbols;     /* keep the module's symbols private */
     CrispyFlags  flags;
 
+    const gchar *isa_target;        /* CRISPY_MULTIVERSION clone, or NULL */
+    const gchar *compiler_version;  /* queried on first use */
+
+    /* --cpus / --numa-node / --sched from the command line and config */
+    CrispyPlacement placement;
+    CrispyPlacement placement_defaults;  /* from the config */
+    CrispyPlacement run_placement;  /* CLI, CRISPY_CPUS & co, then config */
+    gchar       *applied_cpus;      /* affinity after placement, or NULL */
+
     /* config-injected compiler flags */
     gchar       *config_extra_flags;    /* prepended before CRISPY_PARAMS */
     gchar       *config_override_flags; /* appended after everything */
 
     gint         exit_code;
+
+    /* pipeline state carried from crispy_script_prepare() to _run() */
+    CrispyHookContext hook_ctx;
+    GArray      *plugin_costs;      /* of CrispyPluginCost, NULL without plugins */
+    gboolean     costs_checked;     /* cost warning given for this prepare */
+    gchar       *cached_so_path;
+    gboolean     cache_hit;
+    gint64       t_start;
+
+    /* --telemetry / --metrics, NULL when off */
+    gchar       *telemetry_log;
+    gchar       *telemetry_metrics;
+    gboolean     first_run;         /* no run since the last prepare */
+    CrispyTrace *trace;             /* --trace, or NULL */
+
+    /* CRISPY_PURE result memoization */
+    gboolean     memoize;           /* set by crispy_script_execute() */
+    CrispyMemo  *memo;              /* NULL unless the script is pure */
+    gboolean     memo_hit;          /* run replays the recorded result */
 } CrispyScriptPrivate;
 
 G_DEFINE_FINAL_TYPE_WITH_PRIVATE(CrispyScript, crispy_script, G_TYPE_OBJECT)
@@ -147,28 +190,12 @@ build_inline_source(
     const gchar *extra_includes
 ){
     GString *src;
-    gchar **headers;
-    gint i;
+    gchar *prelude;
 
-    src = g_string_new(NULL);
-
-    /* default includes */
-    g_string_append(src, "#include <glib.h>\n");
-    g_string_append(src, "#include <gio/gio.h>\n");
-    g_string_append(src, "#include <glib-object.h>\n");
-
-    /* extra includes from -I flag */
-    if (extra_includes != NULL && extra_includes[0] != '\0')
-    {
-        headers = g_strsplit(extra_includes, ";", -1);
-        for (i = 0; headers[i] != NULL; i++)
-        {
-            g_strstrip(headers[i]);
-            if (headers[i][0] != '\0')
-                g_string_append_printf(src, "#include <%s>\n", headers[i]);
-        }
-        g_strfreev(headers);
-    }
+    /* default includes plus the -I headers */
+    prelude = crispy_source_build_prelude(extra_includes);
+    src = g_string_new(prelude);
+    g_free(prelude);
 
     /* wrap code in main() */
     g_string_append(src, "\ngint\nmain(\n"
@@ -182,6 +209,21 @@ build_inline_source(
     return g_string_free(src, FALSE);
 }
 
+/* --- helper: flush stdio and the runtime's crispy_stdout() writer --- */
+void
+crispy_script_flush_output_internal(
+    CrispyScript *self
+){
+    gboolean (*writer_flush)(gpointer writer);
+
+    writer_flush = (gboolean (*)(gpointer))
+        crispy_script_lookup_symbol_internal(self, "crispy_writer_flush");
+    if (writer_flush != NULL)
+        writer_flush(NULL);
+
+    fflush(stdout);
+}
+
 /* --- GObject lifecycle --- */
 
 static void
@@ -195,6 +237,7 @@ crispy_script_finalize(
     /* close module if still loaded */
     if (priv->module != NULL)
         g_module_close(priv->module);
+    crispy_isolate_close(priv->isolated_module);
 
     /* clean up temp file unless preserve flag is set */
     if (priv->temp_source_path != NULL &&
@@ -214,8 +257,20 @@ crispy_script_finalize(
     g_free(priv->modified_source);
     g_free(priv->temp_source_path);
     g_free(priv->hash);
+    g_free(priv->cached_so_path);
     g_free(priv->config_extra_flags);
     g_free(priv->config_override_flags);
+    g_free(priv->telemetry_log);
+    g_free(priv->telemetry_metrics);
+    g_clear_pointer(&priv->trace, crispy_trace_unref);
+
+    crispy_memo_free(priv->memo);
+
+    crispy_placement_clear(&priv->placement);
+    crispy_placement_clear(&priv->placement_defaults);
+    crispy_placement_clear(&priv->run_placement);
+    g_free(priv->applied_cpus);
+    g_clear_pointer(&priv->plugin_costs, g_array_unref);
 
     G_OBJECT_CLASS(crispy_script_parent_class)->finalize(object);
 }
@@ -234,7 +289,13 @@ static void
 crispy_script_init(
     CrispyScript *self
 ){
-    (void)self;
+    CrispyScriptPrivate *priv;
+
+    priv = crispy_script_get_instance_private(self);
+    priv->entry_point = "main";
+    priv->placement.numa_node = -1;
+    priv->placement_defaults.numa_node = -1;
+    priv->run_placement.numa_node = -1;
 }
 
 /* --- constructors --- */
@@ -402,17 +463,15 @@ crispy_script_set_override_flags(
     priv->config_override_flags = g_strdup(override_flags);
 }
 
-/* --- helper: dispatch hook if engine is set --- */
-static CrispyHookResult
-dispatch_hook(
-    CrispyScriptPrivate *priv,
-    CrispyHookPoint      hook_point,
-    CrispyHookContext   *ctx
+/* --- helper: the compiler version, asked for once per script --- */
+static const gchar *
+get_compiler_version(
+    CrispyScriptPrivate *priv
 ){
-    if (priv->plugin_engine == NULL)
-        return CRISPY_HOOK_CONTINUE;
+    if (priv->compiler_version == NULL)
+        priv->compiler_version = crispy_compiler_get_version(priv->compiler);
 
-    return crispy_plugin_engine_dispatch(priv->plugin_engine, hook_point, ctx);
+    return priv->compiler_version;
 }
 
 /* --- helper: populate hook context from current private state --- */
@@ -426,10 +485,6 @@ populate_hook_context(
     gchar              **argv,
     GError             **error
 ){
-    const gchar *compiler_version;
-
-    compiler_version = crispy_compiler_get_version(priv->compiler);
-
     ctx->source_path      = priv->source_path;
     ctx->source_content   = priv->source_content;
     ctx->source_len       = priv->source_len;
@@ -437,10 +492,15 @@ populate_hook_context(
     ctx->expanded_params  = priv->expanded_params;
     ctx->hash             = priv->hash;
     ctx->cached_so_path   = cached_so_path;
-    ctx->compiler_version = compiler_version;
+    ctx->compiler_version = get_compiler_version(priv);
     ctx->temp_source_path = priv->temp_source_path;
     ctx->flags            = priv->flags;
     ctx->cache_hit        = cache_hit;
+    ctx->isa_target       = priv->isa_target;
+    ctx->cpus             = priv->applied_cpus;
+    ctx->numa_node        = priv->run_placement.numa_node;
+    ctx->sched            = priv->run_placement.sched;
+    ctx->allocator        = crispy_allocator_get_active();
 
     /* mutable fields */
     ctx->modified_source  = priv->modified_source;
@@ -455,10 +515,144 @@ populate_hook_context(
     ctx->error            = error;
 }
 
+/*
+ * --- helper: fill the hook context and dispatch @hook_point ---
+ *
+ * Without a subscribed plugin the context is left alone apart from
+ * the fields callers read back after the hook.
+ */
+static CrispyHookResult
+fire_hook(
+    CrispyScriptPrivate *priv,
+    CrispyHookPoint      hook_point,
+    CrispyHookContext   *ctx,
+    const gchar         *cached_so_path,
+    gboolean             cache_hit,
+    gint                 argc,
+    gchar              **argv,
+    GError             **error
+){
+    if (priv->plugin_engine == NULL ||
+        !crispy_plugin_engine_has_hook(priv->plugin_engine, hook_point))
+    {
+        ctx->extra_flags     = NULL;
+        ctx->argc            = argc;
+        ctx->argv            = argv;
+        ctx->force_recompile = FALSE;
+        return CRISPY_HOOK_CONTINUE;
+    }
+
+    populate_hook_context(priv, ctx, cached_so_path, cache_hit,
+                          argc, argv, error);
+    ctx->time_total = g_get_monotonic_time() - priv->t_start;
+
+    return crispy_plugin_engine_dispatch(priv->plugin_engine, hook_point, ctx);
+}
+
+/* --- helper: record a pipeline step under --trace --- */
+static void
+trace_step(
+    CrispyScriptPrivate *priv,
+    const gchar         *name,
+    gint64               start,
+    gint64               duration
+){
+    if (priv->trace != NULL)
+        crispy_trace_add_span(priv->trace, "crispy", name, start, duration,
+                              NULL);
+}
+
+/*
+ * --- helper: compile the temp source to a shared object ---
+ *
+ * Under --trace with the gcc backend, gcc reports its own phases,
+ * which become child spans of the compile step.
+ */
+static gboolean
+compile_shared(
+    CrispyScriptPrivate  *priv,
+    const gchar          *output_path,
+    const gchar          *compile_flags,
+    GError              **error
+){
+    g_autofree gchar *report = NULL;
+    gint64 t_gcc;
+
+    if (priv->trace == NULL || !CRISPY_IS_GCC_COMPILER(priv->compiler))
+        return crispy_compiler_compile_shared(priv->compiler,
+                                              priv->temp_source_path,
+                                              output_path, compile_flags,
+                                              error);
+
+    t_gcc = g_get_monotonic_time();
+    if (!crispy_gcc_compiler_compile_shared_with_report_internal(
+            CRISPY_GCC_COMPILER(priv->compiler),
+            priv->temp_source_path,
+            output_path,
+            compile_flags,
+            &report,
+            error))
+        return FALSE;
+
+    crispy_trace_add_gcc_report(priv->trace, t_gcc,
+                                g_get_monotonic_time() - t_gcc, report);
+    return TRUE;
+}
+
+/*
+ * --- helper: report a finished run to --telemetry and --metrics ---
+ *
+ * Reads @priv rather than the hook context, which is only filled when
+ * a plugin handles the hook.  Failures are warnings: telemetry never
+ * changes how a script runs.
+ */
+static void
+record_telemetry(
+    CrispyScriptPrivate *priv,
+    gint64               t_run
+){
+    g_autoptr(GError) error = NULL;
+    CrispyTelemetryRecord record;
+    CrispyHookContext *ctx;
+
+    ctx = &priv->hook_ctx;
+    memset(&record, 0, sizeof(record));
+    record.script = priv->source_path;
+    record.hash = priv->hash;
+    record.cache_hit = priv->cache_hit || priv->memo_hit;
+    record.replayed = priv->memo_hit;
+    record.prepared = priv->first_run;
+    record.exit_code = priv->exit_code;
+    record.time_execute = ctx->time_execute;
+    record.time_total = g_get_monotonic_time() -
+                        (priv->first_run ? priv->t_start : t_run);
+    record.plugin_costs = priv->plugin_costs;
+    if (priv->first_run)
+    {
+        record.time_param_expand = ctx->time_param_expand;
+        record.time_hash = ctx->time_hash;
+        record.time_cache_check = ctx->time_cache_check;
+        record.time_compile = ctx->time_compile;
+        record.time_module_load = ctx->time_module_load;
+    }
+
+    if (priv->telemetry_log != NULL &&
+        !crispy_telemetry_append_log(priv->telemetry_log, &record, &error))
+    {
+        g_warning("%s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (priv->telemetry_metrics != NULL &&
+        !crispy_telemetry_update_metrics(priv->telemetry_metrics, &record,
+                                         &error))
+        g_warning("%s", error->message);
+}
+
 /* --- execution --- */
 
-gint
-crispy_script_execute(
+gboolean
+crispy_script_prepare(
     CrispyScript  *self,
     gint           argc,
     gchar        **argv,
@@ -466,67 +660,116 @@ crispy_script_execute(
 ){
     CrispyScriptPrivate *priv;
     const gchar *compiler_version;
-    g_autofree gchar *cached_so_path = NULL;
+    const gchar *runtime_flags;
+    const gchar *mv_flags;
+    CrispyMultiversionMode mv_mode;
+    g_autofree gchar *load_path = NULL;
     g_autofree gchar *compile_flags = NULL;
-    CrispyMainFunc main_func;
-    CrispyHookContext ctx;
+    CrispyHookContext *ctx;
     CrispyHookResult hook_result;
-    gboolean cache_hit;
-    gint64 t_start;
+    gboolean found_main;
     gint64 t_phase;
 
-    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), -1);
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), FALSE);
 
     priv = crispy_script_get_instance_private(self);
+    g_return_val_if_fail(priv->module == NULL &&
+                         priv->isolated_module == NULL, FALSE);
     priv->exit_code = -1;
 
-    memset(&ctx, 0, sizeof(ctx));
-    t_start = g_get_monotonic_time();
+    ctx = &priv->hook_ctx;
+    memset(ctx, 0, sizeof(*ctx));
+    priv->t_start = g_get_monotonic_time();
+    priv->first_run = TRUE;
+
+    /* plugin costs cover one prepare and every run that follows it */
+    if (priv->plugin_engine != NULL)
+    {
+        if (priv->plugin_costs == NULL)
+            priv->plugin_costs = g_array_new(FALSE, TRUE,
+                                             sizeof(CrispyPluginCost));
+        g_array_set_size(priv->plugin_costs, 0);
+        ctx->plugin_costs = priv->plugin_costs;
+        priv->costs_checked = FALSE;
+    }
 
     /*
      * [1] SOURCE_LOADED - source has been parsed, shebang/params stripped.
      * Plugins can inspect or modify the source here.
      */
-    populate_hook_context(priv, &ctx, NULL, FALSE, argc, argv, error);
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_SOURCE_LOADED, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_SOURCE_LOADED, ctx, NULL, FALSE,
+                            argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
+        return FALSE;
 
     /* apply source modifications from plugin */
-    if (ctx.modified_source != NULL &&
-        ctx.modified_source != priv->modified_source)
+    if (ctx->modified_source != NULL &&
+        ctx->modified_source != priv->modified_source)
     {
         g_free(priv->modified_source);
-        priv->modified_source = g_strdup(ctx.modified_source);
-        priv->modified_len = ctx.modified_len;
+        priv->modified_source = g_strdup(ctx->modified_source);
+        priv->modified_len = ctx->modified_len;
+    }
+
+    /* scripts that include <crispy-runtime.h> link libcrispy-runtime */
+    runtime_flags = crispy_source_includes_runtime(priv->modified_source)
+        ? crispy_source_get_runtime_flags()
+        : NULL;
+
+    /*
+     * CRISPY_MULTIVERSION: marked functions become target_clones, or
+     * with CRISPY_MULTIVERSION_SCRIPT the whole script is built once
+     * per ISA and the best build for this CPU is loaded.
+     */
+    mv_mode = crispy_multiversion_detect(priv->modified_source);
+    mv_flags = NULL;
+    priv->isa_target = NULL;
+    if (mv_mode != CRISPY_MULTIVERSION_NONE)
+    {
+        mv_flags = crispy_multiversion_get_define_flags(mv_mode);
+        priv->isa_target = crispy_multiversion_select();
     }
 
     /* [2] PARAMS_EXPANDED - shell-expand CRISPY_PARAMS */
     t_phase = g_get_monotonic_time();
     priv->expanded_params = shell_expand(priv->crispy_params, error);
     if (priv->expanded_params == NULL)
-        return -1;
-    ctx.time_param_expand = g_get_monotonic_time() - t_phase;
+        return FALSE;
+    ctx->time_param_expand = g_get_monotonic_time() - t_phase;
+    trace_step(priv, "param_expand", t_phase, ctx->time_param_expand);
 
-    populate_hook_context(priv, &ctx, NULL, FALSE, argc, argv, error);
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_PARAMS_EXPANDED, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_PARAMS_EXPANDED, ctx, NULL, FALSE,
+                            argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
+        return FALSE;
 
     /* [3] HASH_COMPUTED - compute cache hash
      *
      * The hash must include ALL flags that affect compilation:
-     * config extra_flags, expanded CRISPY_PARAMS, and config
-     * override_flags.  Otherwise different config flag sets
-     * produce the same hash and stale cache entries get reused.
+     * runtime library flags, multiversion defines, config extra_flags,
+     * expanded CRISPY_PARAMS, and config override_flags.  Otherwise
+     * different config flag sets produce the same hash and stale cache
+     * entries get reused.  The selected ISA is deliberately NOT part of
+     * the hash: one cache entry serves every CPU.
      */
     t_phase = g_get_monotonic_time();
-    compiler_version = crispy_compiler_get_version(priv->compiler);
+    compiler_version = get_compiler_version(priv);
 
     {
         g_autoptr(GString) hash_flags = g_string_new(NULL);
 
+        if (runtime_flags != NULL)
+        {
+            g_string_append(hash_flags, runtime_flags);
+            g_string_append_c(hash_flags, ' ');
+        }
+
+        if (mv_flags != NULL)
+        {
+            g_string_append(hash_flags, mv_flags);
+            g_string_append_c(hash_flags, ' ');
+        }
+
         if (priv->config_extra_flags != NULL &&
             priv->config_extra_flags[0] != '\0')
         {
@@ -554,70 +797,125 @@ crispy_script_execute(
             hash_flags->str,
             compiler_version);
     }
-    ctx.time_hash = g_get_monotonic_time() - t_phase;
+    ctx->time_hash = g_get_monotonic_time() - t_phase;
+    trace_step(priv, "hash", t_phase, ctx->time_hash);
 
     /* build cached .so path */
-    cached_so_path = crispy_cache_provider_get_path(priv->cache, priv->hash);
-
-    populate_hook_context(priv, &ctx, cached_so_path, FALSE, argc, argv, error);
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_HASH_COMPUTED, &ctx);
+    g_free(priv->cached_so_path);
+    priv->cached_so_path = crispy_cache_provider_get_path(priv->cache, priv->hash);
+
+    /* whole-script multiversioning loads the build for this CPU */
+    if (mv_mode == CRISPY_MULTIVERSION_SCRIPT)
+        load_path = crispy_multiversion_get_variant_path(priv->cached_so_path,
+                                                         priv->isa_target);
+    else
+        load_path = g_strdup(priv->cached_so_path);
+
+    hook_result = fire_hook(priv, CRISPY_HOOK_HASH_COMPUTED, ctx,
+                            priv->cached_so_path, FALSE, argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
+        return FALSE;
+
+    /*
+     * CRISPY_PURE: a result recorded for the same build, argv, stdin
+     * and input files stands in for the run, so nothing is compiled or
+     * loaded.  Only crispy_script_execute() memoizes: a plain prepare
+     * (hot swap, pipelines) must not consume stdin.
+     */
+    crispy_memo_free(priv->memo);
+    priv->memo = NULL;
+    priv->memo_hit = FALSE;
+    if (priv->memoize &&
+        !(priv->flags & (CRISPY_FLAG_DRY_RUN | CRISPY_FLAG_GDB |
+                         CRISPY_FLAG_HOT_SWAP)))
+    {
+        g_auto(GStrv) inputs = NULL;
+
+        inputs = crispy_memo_detect(priv->modified_source);
+        if (inputs != NULL)
+            priv->memo = crispy_memo_new(priv->cache, priv->hash,
+                                         (const gchar * const *)inputs,
+                                         argc, argv);
+
+        /* -n re-records instead of replaying */
+        if (priv->memo != NULL &&
+            !(priv->flags & CRISPY_FLAG_FORCE_COMPILE) &&
+            crispy_memo_lookup(priv->memo))
+        {
+            priv->memo_hit = TRUE;
+            return TRUE;
+        }
+    }
 
     /* [4] CACHE_CHECKED - check cache */
     t_phase = g_get_monotonic_time();
-    cache_hit = FALSE;
+    priv->cache_hit = FALSE;
     if (!(priv->flags & CRISPY_FLAG_FORCE_COMPILE))
     {
-        cache_hit = crispy_cache_provider_has_valid(
+        priv->cache_hit = crispy_cache_provider_has_valid(
             priv->cache, priv->hash, priv->source_path);
+
+        /* per-ISA builds are written after the base .so */
+        if (priv->cache_hit && g_strcmp0(load_path, priv->cached_so_path) != 0)
+            priv->cache_hit = g_file_test(load_path, G_FILE_TEST_IS_REGULAR);
     }
-    ctx.time_cache_check = g_get_monotonic_time() - t_phase;
+    ctx->time_cache_check = g_get_monotonic_time() - t_phase;
+    trace_step(priv, "cache_check", t_phase, ctx->time_cache_check);
 
-    populate_hook_context(priv, &ctx, cached_so_path, cache_hit, argc, argv, error);
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_CACHE_CHECKED, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_CACHE_CHECKED, ctx,
+                            priv->cached_so_path, priv->cache_hit,
+                            argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
-    if (hook_result == CRISPY_HOOK_FORCE_RECOMPILE || ctx.force_recompile)
-        cache_hit = FALSE;
+        return FALSE;
+    if (hook_result == CRISPY_HOOK_FORCE_RECOMPILE || ctx->force_recompile)
+        priv->cache_hit = FALSE;
 
-    if (!cache_hit)
+    if (!priv->cache_hit)
     {
         /* write temp source */
         if (!write_temp_source(priv, error))
-            return -1;
+            return FALSE;
 
         /* dry-run: just show what would happen */
         if (priv->flags & CRISPY_FLAG_DRY_RUN)
         {
             g_print("Would compile: %s -> %s\n",
-                    priv->temp_source_path, cached_so_path);
+                    priv->temp_source_path, priv->cached_so_path);
             g_print("Extra flags: %s\n",
                     priv->expanded_params != NULL ? priv->expanded_params : "(none)");
+            if (mv_mode != CRISPY_MULTIVERSION_NONE)
+                g_print("Multiversion: %s (this CPU: %s)\n",
+                        mv_mode == CRISPY_MULTIVERSION_SCRIPT
+                            ? "per-ISA builds" : "function clones",
+                        priv->isa_target);
             priv->exit_code = 0;
-            return 0;
+            return TRUE;
         }
 
         /* gdb mode: compile as executable and exec gdb */
         if (priv->flags & CRISPY_FLAG_GDB)
         {
             g_autofree gchar *exe_path = NULL;
+            g_autofree gchar *exe_flags = NULL;
             gchar **gdb_argv;
             gint gdb_argc;
             gint i;
 
             exe_path = g_strdup_printf("/tmp/crispy-dbg-%d", getpid());
+            exe_flags = g_strjoin(" ",
+                                  runtime_flags != NULL ? runtime_flags : "",
+                                  mv_flags != NULL ? mv_flags : "",
+                                  priv->expanded_params != NULL ? priv->expanded_params : "",
+                                  NULL);
 
             if (!crispy_compiler_compile_executable(
                     priv->compiler,
                     priv->temp_source_path,
                     exe_path,
-                    priv->expanded_params,
+                    exe_flags,
                     error))
             {
-                return -1;
+                return FALSE;
             }
 
             /* build gdb argument vector: gdb --args <exe> [script args...] */
@@ -640,20 +938,21 @@ crispy_script_execute(
                         "Failed to exec gdb: %s",
                         g_strerror(errno));
             g_strfreev(gdb_argv);
-            return -1;
+            return FALSE;
         }
 
         /* [5] PRE_COMPILE */
-        populate_hook_context(priv, &ctx, cached_so_path, cache_hit,
-                              argc, argv, error);
-        ctx.time_total = g_get_monotonic_time() - t_start;
-        hook_result = dispatch_hook(priv, CRISPY_HOOK_PRE_COMPILE, &ctx);
+        hook_result = fire_hook(priv, CRISPY_HOOK_PRE_COMPILE, ctx,
+                                priv->cached_so_path, priv->cache_hit,
+                                argc, argv, error);
         if (hook_result == CRISPY_HOOK_ABORT)
-            return -1;
+            return FALSE;
 
         /*
-         * Build compile_flags with three-tier precedence.
+         * Build compile_flags with tiered precedence.
          * gcc uses last-wins for conflicting flags, so order matters:
+         *   0. runtime flags         (only if crispy-runtime.h is used)
+         *      multiversion define   (only if CRISPY_MULTIVERSION is used)
          *   1. config extra_flags    (defaults, lowest priority)
          *   2. CRISPY_PARAMS         (script-level overrides)
          *   3. plugin extra_flags    (from PRE_COMPILE hook)
@@ -664,10 +963,24 @@ crispy_script_execute(
 
             flags_buf = g_string_new(NULL);
 
+            /* tier 0: libcrispy-runtime include/link flags */
+            if (runtime_flags != NULL)
+                g_string_append(flags_buf, runtime_flags);
+
+            /* tier 0: CRISPY_MULTIVERSION attribute macro */
+            if (mv_flags != NULL)
+            {
+                if (flags_buf->len > 0)
+                    g_string_append_c(flags_buf, ' ');
+                g_string_append(flags_buf, mv_flags);
+            }
+
             /* tier 1: config extra_flags (defaults) */
             if (priv->config_extra_flags != NULL &&
                 priv->config_extra_flags[0] != '\0')
             {
+                if (flags_buf->len > 0)
+                    g_string_append_c(flags_buf, ' ');
                 g_string_append(flags_buf, priv->config_extra_flags);
             }
 
@@ -681,11 +994,11 @@ crispy_script_execute(
             }
 
             /* tier 3: plugin-injected extra_flags */
-            if (ctx.extra_flags != NULL && ctx.extra_flags[0] != '\0')
+            if (ctx->extra_flags != NULL && ctx->extra_flags[0] != '\0')
             {
                 if (flags_buf->len > 0)
                     g_string_append_c(flags_buf, ' ');
-                g_string_append(flags_buf, ctx.extra_flags);
+                g_string_append(flags_buf, ctx->extra_flags);
             }
 
             /* tier 4: config override_flags (highest priority) */
@@ -702,86 +1015,295 @@ crispy_script_execute(
 
         /* normal compilation: compile to shared object */
         t_phase = g_get_monotonic_time();
-        if (!crispy_compiler_compile_shared(
-                priv->compiler,
-                priv->temp_source_path,
-                cached_so_path,
-                compile_flags,
-                error))
+        if (!compile_shared(priv, priv->cached_so_path, compile_flags, error))
+            return FALSE;
+
+        /*
+         * Whole-script multiversioning: build every ISA variant now,
+         * not just the one this CPU wants, because the cache may be
+         * shared with other machines.  The -m flag goes last so that
+         * no configured flag can turn the target ISA back off.
+         */
+        if (mv_mode == CRISPY_MULTIVERSION_SCRIPT)
         {
-            return -1;
+            const gchar * const *targets;
+            guint i;
+
+            targets = crispy_multiversion_get_targets();
+            for (i = 0; targets[i] != NULL; i++)
+            {
+                g_autofree gchar *variant_path = NULL;
+                g_autofree gchar *variant_flags = NULL;
+
+                variant_path = crispy_multiversion_get_variant_path(
+                    priv->cached_so_path, targets[i]);
+                variant_flags = g_strdup_printf("%s %s", compile_flags,
+                    crispy_multiversion_get_target_flags(targets[i]));
+
+                if (!compile_shared(priv, variant_path, variant_flags, error))
+                    return FALSE;
+            }
         }
-        ctx.time_compile = g_get_monotonic_time() - t_phase;
+        ctx->time_compile = g_get_monotonic_time() - t_phase;
+        trace_step(priv, "compile", t_phase, ctx->time_compile);
 
         /* [6] POST_COMPILE */
-        populate_hook_context(priv, &ctx, cached_so_path, cache_hit,
-                              argc, argv, error);
-        ctx.time_total = g_get_monotonic_time() - t_start;
-        hook_result = dispatch_hook(priv, CRISPY_HOOK_POST_COMPILE, &ctx);
+        hook_result = fire_hook(priv, CRISPY_HOOK_POST_COMPILE, ctx,
+                                priv->cached_so_path, priv->cache_hit,
+                                argc, argv, error);
         if (hook_result == CRISPY_HOOK_ABORT)
-            return -1;
+            return FALSE;
     }
 
     /* load the compiled shared object */
     t_phase = g_get_monotonic_time();
-    priv->module = g_module_open(cached_so_path, G_MODULE_BIND_LAZY);
-    if (priv->module == NULL)
+    if (priv->flags & CRISPY_FLAG_ISOLATE)
     {
-        g_set_error(error,
-                    CRISPY_ERROR,
-                    CRISPY_ERROR_LOAD,
-                    "Failed to load module: %s",
-                    g_module_error());
-        return -1;
+        /* private namespace: own globals, own copy of libc and glib */
+        priv->isolated_module = crispy_isolate_open(load_path, error);
+        if (priv->isolated_module == NULL)
+            return FALSE;
+    }
+    else
+    {
+        priv->module = g_module_open(load_path,
+                                     priv->local_symbols
+                                         ? G_MODULE_BIND_LAZY |
+                                           G_MODULE_BIND_LOCAL
+                                         : G_MODULE_BIND_LAZY);
+        if (priv->module == NULL)
+        {
+            g_set_error(error,
+                        CRISPY_ERROR,
+                        CRISPY_ERROR_LOAD,
+                        "Failed to load module: %s",
+                        g_module_error());
+            return FALSE;
+        }
     }
-    ctx.time_module_load = g_get_monotonic_time() - t_phase;
+    ctx->time_module_load = g_get_monotonic_time() - t_phase;
+    trace_step(priv, "module_load", t_phase, ctx->time_module_load);
 
     /* [7] MODULE_LOADED */
-    populate_hook_context(priv, &ctx, cached_so_path, cache_hit,
-                          argc, argv, error);
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_MODULE_LOADED, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_MODULE_LOADED, ctx,
+                            priv->cached_so_path, priv->cache_hit,
+                            argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
+        return FALSE;
 
-    /* look up the main symbol */
-    main_func = NULL;
-    if (!g_module_symbol(priv->module, "main", (gpointer *)&main_func))
+    /* look up the main symbol, unless the caller resolves its own */
+    priv->main_func = NULL;
+    if (priv->entry_point == NULL)
+        return TRUE;
+    if (priv->isolated_module != NULL)
+        found_main = crispy_isolate_symbol(priv->isolated_module,
+                                           priv->entry_point,
+                                           (gpointer *)&priv->main_func);
+    else
+        found_main = g_module_symbol(priv->module, priv->entry_point,
+                                     (gpointer *)&priv->main_func);
+    if (!found_main)
     {
         g_set_error(error,
                     CRISPY_ERROR,
                     CRISPY_ERROR_NO_MAIN,
-                    "No main() function found in script");
-        return -1;
+                    "No %s() function found in script",
+                    priv->entry_point);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+gboolean
+crispy_script_run_internal(
+    CrispyScript  *self,
+    gint           argc,
+    gchar        **argv,
+    gint          *exit_code,
+    GError       **error
+){
+    CrispyScriptPrivate *priv;
+    CrispyHookContext *ctx;
+    CrispyHookResult hook_result;
+    CrispyHotSwap *hot_swap;
+    gboolean capturing;
+    gint64 t_phase;
+    gint64 t_run;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), FALSE);
+    g_return_val_if_fail(exit_code != NULL, FALSE);
+
+    priv = crispy_script_get_instance_private(self);
+
+    ctx = &priv->hook_ctx;
+    t_run = g_get_monotonic_time();
+
+    /* CRISPY_PURE hit: replay instead of running; the replay is the execute */
+    if (priv->memo_hit)
+    {
+        priv->exit_code = crispy_memo_replay(priv->memo);
+        ctx->time_execute = g_get_monotonic_time() - t_run;
+        if (priv->telemetry_log != NULL || priv->telemetry_metrics != NULL)
+            record_telemetry(priv, t_run);
+        priv->first_run = FALSE;
+
+        *exit_code = priv->exit_code;
+        return TRUE;
+    }
+
+    /* a dry run that stopped before compiling has nothing to run */
+    if (priv->main_func == NULL && (priv->flags & CRISPY_FLAG_DRY_RUN))
+    {
+        *exit_code = priv->exit_code;
+        return TRUE;
+    }
+    g_return_val_if_fail(priv->main_func != NULL, FALSE);
+
+    /* the CLI wins over CRISPY_CPUS and friends, which win over the config */
+    crispy_placement_clear(&priv->run_placement);
+    crispy_placement_fill(&priv->run_placement, priv->placement.cpus,
+                          priv->placement.numa_node, priv->placement.sched);
+    if (!crispy_placement_fill_from_source(&priv->run_placement,
+                                           priv->modified_source, error))
+        return FALSE;
+    crispy_placement_fill(&priv->run_placement, priv->placement_defaults.cpus,
+                          priv->placement_defaults.numa_node,
+                          priv->placement_defaults.sched);
+    if (crispy_placement_is_set(&priv->run_placement))
+    {
+        g_clear_pointer(&priv->applied_cpus, g_free);
+        if (!crispy_placement_apply(&priv->run_placement,
+                                    &priv->applied_cpus, error))
+            return FALSE;
     }
 
     /* [8] PRE_EXECUTE - plugins can modify argc/argv here */
-    populate_hook_context(priv, &ctx, cached_so_path, cache_hit,
-                          argc, argv, error);
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_PRE_EXECUTE, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_PRE_EXECUTE, ctx,
+                            priv->cached_so_path, priv->cache_hit,
+                            argc, argv, error);
     if (hook_result == CRISPY_HOOK_ABORT)
-        return -1;
+        return FALSE;
     /* use potentially modified argc/argv from plugin */
-    argc = ctx.argc;
-    argv = ctx.argv;
+    argc = ctx->argc;
+    argv = ctx->argv;
+
+    /*
+     * Hot swap: watch the source while main() runs its main loop.
+     * An isolated module iterates its own copy of glib's default
+     * context, which the watcher never sees.
+     */
+    hot_swap = NULL;
+    if (priv->flags & CRISPY_FLAG_HOT_SWAP)
+    {
+        if (priv->isolated_module != NULL || priv->source_path == NULL)
+        {
+            g_set_error(error,
+                        CRISPY_ERROR,
+                        CRISPY_ERROR_LOAD,
+                        "Hot swap needs a script file and cannot be "
+                        "combined with namespace isolation");
+            return FALSE;
+        }
+
+        hot_swap = crispy_hot_swap_start(self, priv->source_path,
+                                         argc, argv, error);
+        if (hot_swap == NULL)
+            return FALSE;
+    }
+
+    /* CRISPY_PURE miss: record what this run prints */
+    capturing = priv->memo != NULL && crispy_memo_begin_capture(priv->memo);
+
+    /*
+     * crispy_init(): map the saved init arena, or build and save it.
+     * Once per load; later runs keep the root the first one set up.
+     */
+    if (priv->first_run)
+        crispy_snapshot_run_init(self, priv->cache, priv->hash,
+                                 priv->modified_source,
+                                 (priv->flags & CRISPY_FLAG_FORCE_COMPILE) != 0);
 
     /* execute the script */
     t_phase = g_get_monotonic_time();
-    priv->exit_code = main_func(argc, argv);
-    ctx.time_execute = g_get_monotonic_time() - t_phase;
+    if (priv->isolated_module != NULL)
+    {
+        /* the namespace has its own stdout buffer; keep output ordered */
+        fflush(stdout);
+        priv->exit_code = priv->main_func(argc, argv);
+        crispy_isolate_flush(priv->isolated_module);
+    }
+    else
+        priv->exit_code = priv->main_func(argc, argv);
+    ctx->time_execute = g_get_monotonic_time() - t_phase;
+    trace_step(priv, "execute", t_phase, ctx->time_execute);
+
+    if (capturing)
+    {
+        crispy_script_flush_output_internal(self);
+        crispy_memo_end_capture(priv->memo, priv->exit_code);
+    }
+
+    crispy_hot_swap_stop(hot_swap);
 
     /* [9] POST_EXECUTE */
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    populate_hook_context(priv, &ctx, cached_so_path, cache_hit,
-                          argc, argv, error);
-    ctx.exit_code = priv->exit_code;
-    ctx.time_total = g_get_monotonic_time() - t_start;
-    hook_result = dispatch_hook(priv, CRISPY_HOOK_POST_EXECUTE, &ctx);
+    hook_result = fire_hook(priv, CRISPY_HOOK_POST_EXECUTE, ctx,
+                            priv->cached_so_path, priv->cache_hit,
+                            argc, argv, error);
+    /* flag slow plugins once, not on every --repeat run */
+    if (priv->plugin_engine != NULL && !priv->costs_checked)
+    {
+        crispy_plugin_engine_check_costs(priv->plugin_engine,
+                                         priv->plugin_costs);
+        priv->costs_checked = TRUE;
+    }
+
+    if (priv->telemetry_log != NULL || priv->telemetry_metrics != NULL)
+        record_telemetry(priv, t_run);
+    priv->first_run = FALSE;
+
     if (hook_result == CRISPY_HOOK_ABORT)
+        return FALSE;
+
+    *exit_code = priv->exit_code;
+    return TRUE;
+}
+
+gint
+crispy_script_run(
+    CrispyScript  *self,
+    gint           argc,
+    gchar        **argv,
+    GError       **error
+){
+    gint exit_code;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), -1);
+
+    if (!crispy_script_run_internal(self, argc, argv, &exit_code, error))
         return -1;
 
-    return priv->exit_code;
+    return exit_code;
+}
+
+gint
+crispy_script_execute(
+    CrispyScript  *self,
+    gint           argc,
+    gchar        **argv,
+    GError       **error
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), -1);
+
+    priv = crispy_script_get_instance_private(self);
+    priv->memoize = TRUE;
+
+    if (!crispy_script_prepare(self, argc, argv, error))
+        return -1;
+
+    return crispy_script_run(self, argc, argv, error);
 }
 
 gint
@@ -796,6 +1318,187 @@ crispy_script_get_exit_code(
     return priv->exit_code;
 }
 
+CrispyScript *
+crispy_script_respawn_internal(
+    CrispyScript  *self,
+    CrispyFlags    set_flags,
+    CrispyFlags    clear_flags,
+    GError       **error
+){
+    CrispyScriptPrivate *priv;
+    CrispyScript *next;
+    CrispyScriptPrivate *next_priv;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), NULL);
+
+    priv = crispy_script_get_instance_private(self);
+    g_return_val_if_fail(priv->source_path != NULL, NULL);
+
+    next = crispy_script_new_from_file(priv->source_path,
+                                       priv->compiler,
+                                       priv->cache,
+                                       (priv->flags | set_flags) & ~clear_flags,
+                                       error);
+    if (next == NULL)
+        return NULL;
+
+    next_priv = crispy_script_get_instance_private(next);
+    next_priv->config_extra_flags = g_strdup(priv->config_extra_flags);
+    next_priv->config_override_flags = g_strdup(priv->config_override_flags);
+    crispy_placement_fill(&next_priv->placement, priv->placement.cpus,
+                          priv->placement.numa_node, priv->placement.sched);
+    crispy_placement_fill(&next_priv->placement_defaults,
+                          priv->placement_defaults.cpus,
+                          priv->placement_defaults.numa_node,
+                          priv->placement_defaults.sched);
+    next_priv->telemetry_log = g_strdup(priv->telemetry_log);
+    next_priv->telemetry_metrics = g_strdup(priv->telemetry_metrics);
+    if (priv->trace != NULL)
+        next_priv->trace = crispy_trace_ref(priv->trace);
+    if (priv->plugin_engine != NULL)
+        next_priv->plugin_engine = g_object_ref(priv->plugin_engine);
+
+    return next;
+}
+
+gpointer
+crispy_script_lookup_symbol_internal(
+    CrispyScript *self,
+    const gchar  *name
+){
+    CrispyScriptPrivate *priv;
+    gpointer symbol;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), NULL);
+    g_return_val_if_fail(name != NULL, NULL);
+
+    priv = crispy_script_get_instance_private(self);
+
+    symbol = NULL;
+    if (priv->isolated_module != NULL)
+        crispy_isolate_symbol(priv->isolated_module, name, &symbol);
+    else if (priv->module != NULL)
+        g_module_symbol(priv->module, name, &symbol);
+
+    return symbol;
+}
+
+void
+crispy_script_set_entry_point_internal(
+    CrispyScript *self,
+    const gchar  *name
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(self));
+
+    priv = crispy_script_get_instance_private(self);
+    priv->entry_point = (name != NULL) ? g_intern_string(name) : NULL;
+}
+
+void
+crispy_script_set_local_symbols_internal(
+    CrispyScript *self,
+    gboolean      local
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(self));
+
+    priv = crispy_script_get_instance_private(self);
+    priv->local_symbols = local;
+}
+
+void
+crispy_script_set_placement_internal(
+    CrispyScript          *self,
+    const CrispyPlacement *placement,
+    const CrispyPlacement *defaults
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(self));
+    g_return_if_fail(placement != NULL);
+
+    priv = crispy_script_get_instance_private(self);
+    crispy_placement_clear(&priv->placement);
+    crispy_placement_fill(&priv->placement, placement->cpus,
+                          placement->numa_node, placement->sched);
+    crispy_placement_clear(&priv->placement_defaults);
+    if (defaults != NULL)
+        crispy_placement_fill(&priv->placement_defaults, defaults->cpus,
+                              defaults->numa_node, defaults->sched);
+}
+
+void
+crispy_script_set_telemetry_internal(
+    CrispyScript *self,
+    const gchar  *log_path,
+    const gchar  *metrics_path
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(self));
+
+    priv = crispy_script_get_instance_private(self);
+    g_free(priv->telemetry_log);
+    g_free(priv->telemetry_metrics);
+    priv->telemetry_log = g_strdup(log_path);
+    priv->telemetry_metrics = g_strdup(metrics_path);
+}
+
+void
+crispy_script_set_trace_internal(
+    CrispyScript *self,
+    CrispyTrace  *trace
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(self));
+
+    priv = crispy_script_get_instance_private(self);
+    if (trace != NULL)
+        crispy_trace_ref(trace);
+    g_clear_pointer(&priv->trace, crispy_trace_unref);
+    priv->trace = trace;
+}
+
+gint64
+crispy_script_get_time_execute_internal(
+    CrispyScript *self
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), 0);
+
+    priv = crispy_script_get_instance_private(self);
+    return priv->hook_ctx.time_execute;
+}
+
+const gchar *
+crispy_script_get_source_path_internal(
+    CrispyScript *self
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), NULL);
+
+    priv = crispy_script_get_instance_private(self);
+    return priv->source_path;
+}
+
+const gchar *
+crispy_script_get_source_internal(
+    CrispyScript *self
+){
+    CrispyScriptPrivate *priv;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(self), NULL);
+
+    priv = crispy_script_get_instance_private(self);
+    return priv->modified_source;
+}
+
 const gchar *
 crispy_script_get_temp_source_path(
     CrispyScript *self
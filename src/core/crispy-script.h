@@ -87,6 +87,11 @@ CrispyScript *crispy_script_new_from_stdin (CrispyCompiler       *compiler,
  * -> load -> run main(). The script's exit code is stored and can be
  * retrieved with crispy_script_get_exit_code().
  *
+ * Equivalent to crispy_script_prepare() followed by crispy_script_run(),
+ * except that only this entry point memoizes `CRISPY_PURE` scripts: it
+ * reads all of stdin and may replay a recorded result instead of
+ * compiling and running.
+ *
  * Returns: the script's exit code, or -1 on error
  */
 gint crispy_script_execute (CrispyScript  *self,
@@ -94,6 +99,48 @@ gint crispy_script_execute (CrispyScript  *self,
                             gchar        **argv,
                             GError       **error);
 
+/**
+ * crispy_script_prepare:
+ * @self: a #CrispyScript
+ * @argc: argument count, passed to plugin hooks
+ * @argv: (array length=argc): argument vector, passed to plugin hooks
+ * @error: return location for a #GError, or %NULL
+ *
+ * Runs the first half of the pipeline: hash -> cache check -> compile
+ * (if needed) -> load, and resolves main().  Hooks up to
+ * %CRISPY_HOOK_MODULE_LOADED fire.  Can be called only once per
+ * script, on any thread; the script can then be run with
+ * crispy_script_run().
+ *
+ * With %CRISPY_FLAG_DRY_RUN and a cache miss, prints what would be
+ * compiled and returns %TRUE without loading anything.
+ *
+ * Returns: %TRUE on success, %FALSE with @error set
+ */
+gboolean crispy_script_prepare (CrispyScript  *self,
+                                gint           argc,
+                                gchar        **argv,
+                                GError       **error);
+
+/**
+ * crispy_script_run:
+ * @self: a prepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @error: return location for a #GError, or %NULL
+ *
+ * Calls main() of a script loaded by crispy_script_prepare(),
+ * dispatching %CRISPY_HOOK_PRE_EXECUTE and %CRISPY_HOOK_POST_EXECUTE
+ * around it.  May be called more than once; the module stays loaded
+ * until @self is finalized.
+ *
+ * Returns: the script's exit code, or -1 on error
+ */
+gint crispy_script_run (CrispyScript  *self,
+                        gint           argc,
+                        gchar        **argv,
+                        GError       **error);
+
 /**
  * crispy_script_get_exit_code:
  * @self: a #CrispyScript
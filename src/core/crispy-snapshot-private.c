@@ -0,0 +1,87 @@
+/* crispy-snapshot-private.c - Internal init arena snapshots */
+
+#define CRISPY_COMPILATION
+#include "crispy-snapshot-private.h"
+#include "crispy-script-private.h"
+#include "crispy-memo-private.h"
+#include "../crispy-types.h"
+
+#include <string.h>
+
+#define CRISPY_SNAPSHOT_KEY_TAG "CRSPSNAP"
+
+/* the script's hook */
+typedef gpointer (*CrispySnapshotInitFunc) (void);
+
+/*
+ * Mirror crispy_init_snapshot_load() and crispy_init_snapshot_save()
+ * in crispy-init.h.  The core library does not link against the
+ * runtime; they are found through the script's module, which does.
+ */
+typedef gboolean (*CrispySnapshotLoadFunc) (const gchar *path);
+typedef gboolean (*CrispySnapshotSaveFunc) (const gchar *path,
+                                            gpointer     root);
+
+/* --- helper: <cache dir>/<key>.snap for this build and its inputs --- */
+static gchar *
+snapshot_path(
+    CrispyCacheProvider *cache,
+    const gchar         *artifact_hash,
+    const gchar         *source
+){
+    g_autoptr(GChecksum) checksum = NULL;
+    g_auto(GStrv) inputs = NULL;
+
+    checksum = g_checksum_new(CRISPY_HASH_ALGO);
+    g_checksum_update(checksum, (const guchar *)CRISPY_SNAPSHOT_KEY_TAG, -1);
+    g_checksum_update(checksum, (const guchar *)artifact_hash, -1);
+
+    inputs = crispy_memo_detect_list(source, "CRISPY_INIT_INPUTS");
+    if (inputs != NULL)
+        crispy_memo_hash_inputs(checksum, (const gchar * const *)inputs);
+
+    return crispy_memo_cache_path(cache, g_checksum_get_string(checksum),
+                                  ".snap");
+}
+
+void
+crispy_snapshot_run_init(
+    CrispyScript        *script,
+    CrispyCacheProvider *cache,
+    const gchar         *artifact_hash,
+    const gchar         *source,
+    gboolean             refresh
+){
+    CrispySnapshotInitFunc init;
+    CrispySnapshotLoadFunc load;
+    CrispySnapshotSaveFunc save;
+    g_autofree gchar *path = NULL;
+    gpointer root;
+
+    g_return_if_fail(CRISPY_IS_SCRIPT(script));
+
+    init = (CrispySnapshotInitFunc)crispy_script_lookup_symbol_internal(
+        script, CRISPY_SNAPSHOT_INIT_SYMBOL);
+    if (init == NULL)
+        return;
+
+    load = (CrispySnapshotLoadFunc)crispy_script_lookup_symbol_internal(
+        script, "crispy_init_snapshot_load");
+    save = (CrispySnapshotSaveFunc)crispy_script_lookup_symbol_internal(
+        script, "crispy_init_snapshot_save");
+
+    /* without the runtime there is no init arena to snapshot */
+    if (load == NULL || save == NULL ||
+        cache == NULL || artifact_hash == NULL)
+    {
+        (void)init();
+        return;
+    }
+
+    path = snapshot_path(cache, artifact_hash, source);
+    if (!refresh && load(path))
+        return;
+
+    root = init();
+    (void)save(path, root);
+}
@@ -0,0 +1,51 @@
+/* crispy-snapshot-private.h - Internal init arena snapshots */
+
+/*
+ * Support for crispy_init(): a script that builds its long-lived data
+ * in the runtime's init arena has that arena saved to the cache after
+ * the first run, and later runs with the same build and the same
+ * declared inputs map the saved arena instead of calling crispy_init()
+ * again.  Used by CrispyScript.  This header is NOT installed or
+ * included in the public umbrella header.
+ */
+
+#ifndef CRISPY_SNAPSHOT_PRIVATE_H
+#define CRISPY_SNAPSHOT_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+#include "../interfaces/crispy-cache-provider.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_SNAPSHOT_INIT_SYMBOL:
+ *
+ * Optional function a script exports to build its init data:
+ * `gpointer crispy_init (void)`.
+ */
+#define CRISPY_SNAPSHOT_INIT_SYMBOL "crispy_init"
+
+/**
+ * crispy_snapshot_run_init:
+ * @script: a prepared #CrispyScript
+ * @cache: cache the snapshot lives in
+ * @artifact_hash: cache hash of @script's build
+ * @source: (nullable): the script's source, searched for
+ *   `#define CRISPY_INIT_INPUTS "a.txt;b.txt"`
+ * @refresh: call crispy_init() and save again even if a snapshot exists
+ *
+ * Does nothing unless @script exports crispy_init().  Otherwise maps
+ * the snapshot keyed by @artifact_hash and the contents of the
+ * declared inputs, or calls crispy_init() and saves one.  Failing to
+ * map or save a snapshot is not an error; crispy_init() just runs.
+ */
+void crispy_snapshot_run_init (CrispyScript        *script,
+                               CrispyCacheProvider *cache,
+                               const gchar         *artifact_hash,
+                               const gchar         *source,
+                               gboolean             refresh);
+
+G_END_DECLS
+
+#endif /* CRISPY_SNAPSHOT_PRIVATE_H */
@@ -2,7 +2,8 @@
 
 /*
  * Shared helpers for CRISPY_PARAMS extraction, shebang stripping,
- * and shell expansion.  Factored out of crispy-script.c so that
+ * shell expansion, the inline prelude, runtime library and local
+ * include detection.  Factored out of crispy-script.c so that
  * both the script orchestrator and the config loader can reuse
  * the same logic without duplication.
  */
@@ -73,6 +74,69 @@ crispy_source_extract_params(
     return NULL;
 }
 
+/* --- crispy_source_extract_define --- */
+
+gchar *
+crispy_source_extract_define(
+    const gchar *source,
+    const gchar *name
+){
+    const gchar *pos;
+    const gchar *line_end;
+    const gchar *p;
+    gsize name_len;
+    gchar *value;
+    gsize len;
+
+    g_return_val_if_fail(name != NULL, NULL);
+
+    if (source == NULL || strstr(source, name) == NULL)
+        return NULL;
+
+    name_len = strlen(name);
+    pos = source;
+    while (*pos != '\0')
+    {
+        line_end = strchr(pos, '\n');
+        if (line_end == NULL)
+            line_end = pos + strlen(pos);
+
+        p = pos;
+        while (p < line_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (g_str_has_prefix(p, "#define"))
+        {
+            p += strlen("#define");
+            while (p < line_end && (*p == ' ' || *p == '\t'))
+                p++;
+
+            /* the name must match exactly, not as a prefix */
+            if ((gsize)(line_end - p) >= name_len &&
+                strncmp(p, name, name_len) == 0 &&
+                (p + name_len == line_end ||
+                 p[name_len] == ' ' || p[name_len] == '\t' ||
+                 p[name_len] == '\r'))
+            {
+                p += name_len;
+                value = g_strstrip(g_strndup(p, (gsize)(line_end - p)));
+                len = strlen(value);
+                if (len >= 2 && value[0] == '"' && value[len - 1] == '"')
+                {
+                    memmove(value, value + 1, len - 2);
+                    value[len - 2] = '\0';
+                }
+                return value;
+            }
+        }
+
+        if (*line_end == '\0')
+            break;
+        pos = line_end + 1;
+    }
+
+    return NULL;
+}
+
 /* --- crispy_source_strip_header --- */
 
 gchar *
@@ -180,3 +244,260 @@ crispy_source_shell_expand(
     g_strstrip(std_out);
     return std_out;
 }
+
+/* --- crispy_source_build_prelude --- */
+
+gchar *
+crispy_source_build_prelude(
+    const gchar *extra_includes
+){
+    GString *src;
+    gchar **headers;
+    gint i;
+
+    src = g_string_new(NULL);
+
+    /* default includes */
+    g_string_append(src, "#include <glib.h>\n");
+    g_string_append(src, "#include <gio/gio.h>\n");
+    g_string_append(src, "#include <glib-object.h>\n");
+
+    /* extra includes from -I flag */
+    if (extra_includes != NULL && extra_includes[0] != '\0')
+    {
+        headers = g_strsplit(extra_includes, ";", -1);
+        for (i = 0; headers[i] != NULL; i++)
+        {
+            g_strstrip(headers[i]);
+            if (headers[i][0] != '\0')
+                g_string_append_printf(src, "#include <%s>\n", headers[i]);
+        }
+        g_strfreev(headers);
+    }
+
+    return g_string_free(src, FALSE);
+}
+
+/* --- crispy_source_includes_runtime --- */
+
+gboolean
+crispy_source_includes_runtime(
+    const gchar *source
+){
+    const gchar *pos;
+
+    if (source == NULL)
+        return FALSE;
+
+    /* cheap rejection before the line-by-line scan */
+    if (strstr(source, "crispy-runtime.h") == NULL)
+        return FALSE;
+
+    pos = source;
+    while (*pos != '\0')
+    {
+        const gchar *p;
+        const gchar *line_end;
+
+        line_end = strchr(pos, '\n');
+        if (line_end == NULL)
+            line_end = pos + strlen(pos);
+
+        /* match: [ws] # [ws] include [ws] <crispy-runtime.h> or "..." */
+        p = pos;
+        while (p < line_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (p < line_end && *p == '#')
+        {
+            p++;
+            while (p < line_end && (*p == ' ' || *p == '\t'))
+                p++;
+            if (g_str_has_prefix(p, "include"))
+            {
+                p += strlen("include");
+                while (p < line_end && (*p == ' ' || *p == '\t'))
+                    p++;
+                if (g_str_has_prefix(p, "<crispy-runtime.h>") ||
+                    g_str_has_prefix(p, "\"crispy-runtime.h\""))
+                {
+                    return TRUE;
+                }
+            }
+        }
+
+        if (*line_end == '\0')
+            break;
+        pos = line_end + 1;
+    }
+
+    return FALSE;
+}
+
+/* --- crispy_source_find_local_includes --- */
+
+gchar **
+crispy_source_find_local_includes(
+    const gchar *source
+){
+    GPtrArray *names;
+    const gchar *pos;
+
+    names = g_ptr_array_new();
+    pos = (source != NULL) ? source : "";
+
+    while (*pos != '\0')
+    {
+        const gchar *p;
+        const gchar *line_end;
+
+        line_end = strchr(pos, '\n');
+        if (line_end == NULL)
+            line_end = pos + strlen(pos);
+
+        /* match: [ws] # [ws] include [ws] "name" */
+        p = pos;
+        while (p < line_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (p < line_end && *p == '#')
+        {
+            p++;
+            while (p < line_end && (*p == ' ' || *p == '\t'))
+                p++;
+            if (g_str_has_prefix(p, "include"))
+            {
+                const gchar *name_end;
+
+                p += strlen("include");
+                while (p < line_end && (*p == ' ' || *p == '\t'))
+                    p++;
+                if (p < line_end && *p == '"')
+                {
+                    p++;
+                    name_end = memchr(p, '"', (gsize)(line_end - p));
+                    if (name_end != NULL && name_end > p)
+                        g_ptr_array_add(names,
+                                        g_strndup(p, (gsize)(name_end - p)));
+                }
+            }
+        }
+
+        if (*line_end == '\0')
+            break;
+        pos = line_end + 1;
+    }
+
+    g_ptr_array_add(names, NULL);
+    return (gchar **)g_ptr_array_free(names, FALSE);
+}
+
+/* --- crispy_source_get_runtime_flags --- */
+
+/*
+ * build_runtime_flags:
+ * @include_dir: directory containing crispy-runtime.h
+ * @lib_dir: directory containing libcrispy-runtime.so
+ *
+ * The library is wrapped in --no-as-needed so that toolchains which
+ * default to --as-needed still record the dependency: the script's
+ * object file comes after the flags on the gcc command line.
+ */
+static gchar *
+build_runtime_flags(
+    const gchar *include_dir,
+    const gchar *lib_dir
+){
+    return g_strdup_printf("-I%s -L%s -Wl,-rpath,%s "
+                           "-Wl,--push-state,--no-as-needed "
+                           "-lcrispy-runtime -Wl,--pop-state",
+                           include_dir, lib_dir, lib_dir);
+}
+
+const gchar *
+crispy_source_get_runtime_flags(void)
+{
+    static gchar *runtime_flags = NULL;
+
+    if (g_once_init_enter(&runtime_flags))
+    {
+        gchar *flags;
+
+        flags = NULL;
+
+#if defined(CRISPY_DEV_INCLUDE_DIR) && defined(CRISPY_DEV_LIB_DIR)
+        /*
+         * Development mode: use the source tree headers and the
+         * freshly built library so scripts can be run straight
+         * from the build directory.
+         */
+        if (g_file_test(CRISPY_DEV_INCLUDE_DIR "/crispy-runtime.h",
+                        G_FILE_TEST_IS_REGULAR) &&
+            g_file_test(CRISPY_DEV_LIB_DIR "/libcrispy-runtime.so",
+                        G_FILE_TEST_EXISTS))
+        {
+            flags = build_runtime_flags(CRISPY_DEV_INCLUDE_DIR,
+                                        CRISPY_DEV_LIB_DIR);
+        }
+#endif
+
+#if defined(CRISPY_INCLUDEDIR) && defined(CRISPY_LIBDIR)
+        if (flags == NULL)
+            flags = build_runtime_flags(CRISPY_INCLUDEDIR, CRISPY_LIBDIR);
+#endif
+
+        if (flags == NULL)
+            flags = g_strdup("-lcrispy-runtime");
+
+        g_once_init_leave(&runtime_flags, flags);
+    }
+
+    return runtime_flags;
+}
+
+const gchar *
+crispy_source_get_include_flags(void)
+{
+    static gchar *include_flags = NULL;
+
+    if (g_once_init_enter(&include_flags))
+    {
+        gchar *flags;
+
+        flags = NULL;
+
+#ifdef CRISPY_DEV_INCLUDE_DIR
+        /*
+         * Development mode: point to the source directory so that
+         * config files and plugins can #include <crispy.h>
+         */
+        if (g_file_test(CRISPY_DEV_INCLUDE_DIR "/crispy.h",
+                        G_FILE_TEST_IS_REGULAR))
+        {
+            flags = g_strdup("-I" CRISPY_DEV_INCLUDE_DIR);
+        }
+#endif
+
+        /* installed case: query pkg-config for crispy */
+        if (flags == NULL)
+        {
+            g_autofree gchar *stdout_output = NULL;
+            g_autofree gchar *stderr_output = NULL;
+            gint exit_status;
+
+            if (g_spawn_command_line_sync("pkg-config --cflags crispy",
+                                          &stdout_output, &stderr_output,
+                                          &exit_status, NULL) &&
+                g_spawn_check_wait_status(exit_status, NULL))
+            {
+                g_strstrip(stdout_output);
+                flags = g_steal_pointer(&stdout_output);
+            }
+        }
+
+        if (flags == NULL)
+            flags = g_strdup("");
+
+        g_once_init_leave(&include_flags, flags);
+    }
+
+    return include_flags;
+}
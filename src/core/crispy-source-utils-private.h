@@ -2,9 +2,10 @@
 
 /*
  * Shared helpers for extracting CRISPY_PARAMS, stripping shebangs,
- * and shell-expanding parameters.  Used by both CrispyScript and
- * the config loader.  This header is NOT installed or included in
- * the public umbrella header.
+ * shell-expanding parameters and building source around user code.
+ * Used by CrispyScript, the config loader, the plugin builder, watch
+ * mode and the REPL.  This header is NOT installed or included in the
+ * public umbrella header.
  */
 
 #ifndef CRISPY_SOURCE_UTILS_PRIVATE_H
@@ -26,6 +27,20 @@ G_BEGIN_DECLS
  */
 gchar *crispy_source_extract_params (const gchar *source);
 
+/**
+ * crispy_source_extract_define:
+ * @source: (nullable): source text of a C file
+ * @name: macro name, such as "CRISPY_CPUS"
+ *
+ * Finds `#define @name value` at the start of a line and returns the
+ * value, without surrounding quotes if it is a string literal.
+ *
+ * Returns: (transfer full) (nullable): the value, or %NULL if @name is
+ *   not defined
+ */
+gchar *crispy_source_extract_define (const gchar *source,
+                                     const gchar *name);
+
 /**
  * crispy_source_strip_header:
  * @source: full source text of a C file
@@ -58,6 +73,68 @@ gchar *crispy_source_strip_header (const gchar *source,
 gchar *crispy_source_shell_expand (const gchar  *params,
                                    GError      **error);
 
+/**
+ * crispy_source_build_prelude:
+ * @extra_includes: (nullable): semicolon-separated header names
+ *
+ * Builds the `#include` block that inline code and REPL cells are
+ * compiled with: `<glib.h>`, `<gio/gio.h>` and `<glib-object.h>`,
+ * followed by `#include <...>` for each header in @extra_includes.
+ *
+ * Returns: (transfer full): the prelude source text
+ */
+gchar *crispy_source_build_prelude (const gchar *extra_includes);
+
+/**
+ * crispy_source_includes_runtime:
+ * @source: (nullable): source text of a C file
+ *
+ * Checks whether @source contains an `#include <crispy-runtime.h>`
+ * (or the quoted form) directive.
+ *
+ * Returns: %TRUE if the script uses the crispy runtime library
+ */
+gboolean crispy_source_includes_runtime (const gchar *source);
+
+/**
+ * crispy_source_find_local_includes:
+ * @source: (nullable): source text of a C file
+ *
+ * Collects the names of all quoted `#include "..."` directives in
+ * @source, in order.  Angle-bracket includes are skipped.  Names are
+ * returned as written; resolving them is up to the caller.
+ *
+ * Returns: (transfer full): a %NULL-terminated array of names, free
+ *          with g_strfreev()
+ */
+gchar **crispy_source_find_local_includes (const gchar *source);
+
+/**
+ * crispy_source_get_runtime_flags:
+ *
+ * Returns the compiler flags needed to build against libcrispy-runtime:
+ * the include path, the library path with a matching rpath, and the
+ * library itself.  In development mode the source tree and build
+ * directory are used; otherwise the installed locations.  The result
+ * is computed once and cached for the lifetime of the process.
+ *
+ * Returns: (transfer none): the runtime flags
+ */
+const gchar *crispy_source_get_runtime_flags (void);
+
+/**
+ * crispy_source_get_include_flags:
+ *
+ * Returns the flags that let a config file or plugin source
+ * `#include <crispy.h>`: the source tree in development mode,
+ * otherwise `pkg-config --cflags crispy`, or an empty string if
+ * neither is available.  The result is computed once and cached for
+ * the lifetime of the process.
+ *
+ * Returns: (transfer none): the include flags
+ */
+const gchar *crispy_source_get_include_flags (void);
+
 G_END_DECLS
 
 #endif /* CRISPY_SOURCE_UTILS_PRIVATE_H */
@@ -0,0 +1,427 @@
+/* crispy-telemetry-private.c - Internal per-run telemetry log and metrics */
+
+#define CRISPY_COMPILATION
+#include "crispy-telemetry-private.h"
+#include "crispy-plugin-engine-private.h"
+#include "../crispy-types.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#define METRIC_PHASE    "crispy_phase_seconds"
+#define METRIC_RUNS     "crispy_runs_total"
+#define METRIC_FAILED   "crispy_failed_runs_total"
+
+/* upper bounds of the histogram buckets, in seconds; +Inf is implied */
+static const gchar *bucket_bounds[] =
+{
+    "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05",
+    "0.1", "0.5", "1.0", "5.0", "10.0", "60.0"
+};
+
+typedef enum
+{
+    PHASE_PARAM_EXPAND,
+    PHASE_HASH,
+    PHASE_CACHE_CHECK,
+    PHASE_COMPILE,
+    PHASE_MODULE_LOAD,
+    PHASE_EXECUTE,
+    PHASE_TOTAL,
+    N_PHASES
+} Phase;
+
+static const gchar *phase_names[N_PHASES] =
+{
+    "param_expand", "hash", "cache_check", "compile", "module_load",
+    "execute", "total"
+};
+
+/* --- helper: time of @phase in @record, or -1 if this run did not pay it --- */
+static gint64
+phase_time(
+    const CrispyTelemetryRecord *record,
+    Phase                        phase
+){
+    switch (phase)
+    {
+    case PHASE_PARAM_EXPAND:
+        return record->prepared ? record->time_param_expand : -1;
+    case PHASE_HASH:
+        return record->prepared ? record->time_hash : -1;
+    case PHASE_CACHE_CHECK:
+        return record->prepared && !record->replayed
+               ? record->time_cache_check : -1;
+    case PHASE_COMPILE:
+        return record->prepared && !record->cache_hit
+               ? record->time_compile : -1;
+    case PHASE_MODULE_LOAD:
+        return record->prepared && !record->replayed
+               ? record->time_module_load : -1;
+    case PHASE_EXECUTE:
+        return record->time_execute;
+    case PHASE_TOTAL:
+        return record->time_total;
+    default:
+        return -1;
+    }
+}
+
+/* --- helper: series name -> value (gdouble *) from an existing file --- */
+static GHashTable *
+read_series(
+    const gchar *contents
+){
+    g_auto(GStrv) lines = NULL;
+    GHashTable *series;
+    gdouble *value;
+    gchar *space;
+    guint i;
+
+    series = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if (contents == NULL)
+        return series;
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (lines[i][0] == '#' || lines[i][0] == '\0')
+            continue;
+
+        space = strrchr(lines[i], ' ');
+        if (space == NULL)
+            continue;
+
+        value = g_new(gdouble, 1);
+        *value = g_ascii_strtod(space + 1, NULL);
+        g_hash_table_replace(series, g_strndup(lines[i], space - lines[i]),
+                             value);
+    }
+
+    return series;
+}
+
+/* --- helper: add @delta to the series @name, creating it at 0 --- */
+static void
+add_to_series(
+    GHashTable  *series,
+    gchar       *name,
+    gdouble      delta
+){
+    gdouble *value;
+
+    value = g_hash_table_lookup(series, name);
+    if (value == NULL)
+    {
+        value = g_new0(gdouble, 1);
+        g_hash_table_replace(series, g_strdup(name), value);
+    }
+    *value += delta;
+    g_free(name);
+}
+
+/* --- helper: append "NAME VALUE\n", counts without decimals --- */
+static void
+append_sample(
+    GString     *out,
+    GHashTable  *series,
+    gchar       *name,
+    gboolean     is_count
+){
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    gdouble *value;
+
+    value = g_hash_table_lookup(series, name);
+    g_string_append_printf(out, "%s %s\n", name,
+                           g_ascii_formatd(buf, sizeof(buf),
+                                           is_count ? "%.0f" : "%.6f",
+                                           value != NULL ? *value : 0.0));
+    g_free(name);
+}
+
+static gchar *
+bucket_name(
+    Phase        phase,
+    const gchar *le
+){
+    return g_strdup_printf(METRIC_PHASE "_bucket{phase=\"%s\",le=\"%s\"}",
+                           phase_names[phase], le);
+}
+
+static gchar *
+format_metrics(
+    GHashTable *series
+){
+    GString *out;
+    guint b;
+    gint p;
+
+    out = g_string_new(NULL);
+    g_string_append(out,
+        "# HELP " METRIC_PHASE " Time crispy spent in each phase of a "
+        "script run.\n"
+        "# TYPE " METRIC_PHASE " histogram\n"
+        "# UNIT " METRIC_PHASE " seconds\n");
+    for (p = 0; p < N_PHASES; p++)
+    {
+        for (b = 0; b < G_N_ELEMENTS(bucket_bounds); b++)
+            append_sample(out, series, bucket_name(p, bucket_bounds[b]), TRUE);
+        append_sample(out, series, bucket_name(p, "+Inf"), TRUE);
+        append_sample(out, series,
+                      g_strdup_printf(METRIC_PHASE "_count{phase=\"%s\"}",
+                                      phase_names[p]), TRUE);
+        append_sample(out, series,
+                      g_strdup_printf(METRIC_PHASE "_sum{phase=\"%s\"}",
+                                      phase_names[p]), FALSE);
+    }
+
+    g_string_append(out,
+        "# HELP crispy_runs Script runs, by whether the compiled script "
+        "was cached.\n"
+        "# TYPE crispy_runs counter\n");
+    append_sample(out, series, g_strdup(METRIC_RUNS "{cache=\"hit\"}"), TRUE);
+    append_sample(out, series, g_strdup(METRIC_RUNS "{cache=\"miss\"}"), TRUE);
+
+    g_string_append(out,
+        "# HELP crispy_failed_runs Script runs that exited non-zero.\n"
+        "# TYPE crispy_failed_runs counter\n");
+    append_sample(out, series, g_strdup(METRIC_FAILED), TRUE);
+
+    g_string_append(out, "# EOF\n");
+    return g_string_free(out, FALSE);
+}
+
+/* --- helper: append ', "plugin_costs": [...]', skipping idle hooks --- */
+static void
+append_plugin_costs(
+    GString *out,
+    GArray  *costs
+){
+    CrispyPluginCost *cost;
+    gboolean first;
+    guint i;
+    guint h;
+
+    g_string_append(out, ", \"plugin_costs\": [");
+    for (i = 0; costs != NULL && i < costs->len; i++)
+    {
+        cost = &g_array_index(costs, CrispyPluginCost, i);
+        g_string_append(out, i > 0 ? ", {\"name\": " : "{\"name\": ");
+        crispy_telemetry_append_json_string(out, cost->name);
+        g_string_append(out, ", \"hooks\": {");
+
+        first = TRUE;
+        for (h = 0; h < CRISPY_HOOK_POINT_COUNT; h++)
+        {
+            if (cost->calls[h] == 0)
+                continue;
+            g_string_append_printf(out,
+                "%s\"%s\": {\"calls\": %u"
+                ", \"wall_ns\": %" G_GINT64_FORMAT
+                ", \"cpu_ns\": %" G_GINT64_FORMAT "}",
+                first ? "" : ", ",
+                crispy_plugin_engine_hook_name((CrispyHookPoint)h),
+                cost->calls[h], cost->wall_ns[h], cost->cpu_ns[h]);
+            first = FALSE;
+        }
+        g_string_append(out, "}}");
+    }
+    g_string_append_c(out, ']');
+}
+
+/* --- public API --- */
+
+void
+crispy_telemetry_append_json_string(
+    GString     *out,
+    const gchar *value
+){
+    const gchar *p;
+
+    if (value == NULL)
+    {
+        g_string_append(out, "null");
+        return;
+    }
+
+    g_string_append_c(out, '"');
+    for (p = value; *p != '\0'; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf(out, "\\%c", *p);
+        else if ((guchar)*p < 0x20)
+            g_string_append_printf(out, "\\u%04x", (guint)(guchar)*p);
+        else
+            g_string_append_c(out, *p);
+    }
+    g_string_append_c(out, '"');
+}
+
+gchar *
+crispy_telemetry_format_line(
+    const CrispyTelemetryRecord *record
+){
+    g_autoptr(GDateTime) now = NULL;
+    g_autofree gchar *ts = NULL;
+    GString *out;
+
+    g_return_val_if_fail(record != NULL, NULL);
+
+    now = g_date_time_new_now_utc();
+    ts = g_date_time_format_iso8601(now);
+
+    out = g_string_new("{\"ts\": ");
+    crispy_telemetry_append_json_string(out, ts);
+    g_string_append(out, ", \"host\": ");
+    crispy_telemetry_append_json_string(out, g_get_host_name());
+    g_string_append_printf(out, ", \"pid\": %d, \"script\": ", (gint)getpid());
+    crispy_telemetry_append_json_string(out, record->script);
+    g_string_append(out, ", \"hash\": ");
+    crispy_telemetry_append_json_string(out, record->hash);
+    g_string_append_printf(out,
+        ", \"cache_hit\": %s, \"replayed\": %s, \"exit_code\": %d"
+        ", \"time_param_expand\": %" G_GINT64_FORMAT
+        ", \"time_hash\": %" G_GINT64_FORMAT
+        ", \"time_cache_check\": %" G_GINT64_FORMAT
+        ", \"time_compile\": %" G_GINT64_FORMAT
+        ", \"time_module_load\": %" G_GINT64_FORMAT
+        ", \"time_execute\": %" G_GINT64_FORMAT
+        ", \"time_total\": %" G_GINT64_FORMAT,
+        record->cache_hit ? "true" : "false",
+        record->replayed ? "true" : "false", record->exit_code,
+        record->time_param_expand, record->time_hash,
+        record->time_cache_check, record->time_compile,
+        record->time_module_load, record->time_execute, record->time_total);
+    append_plugin_costs(out, record->plugin_costs);
+    g_string_append(out, "}\n");
+
+    return g_string_free(out, FALSE);
+}
+
+gboolean
+crispy_telemetry_append_log(
+    const gchar                 *path,
+    const CrispyTelemetryRecord *record,
+    GError                     **error
+){
+    g_autofree gchar *line = NULL;
+    gsize len;
+    gsize done;
+    gssize n;
+    gint fd;
+
+    g_return_val_if_fail(path != NULL, FALSE);
+    g_return_val_if_fail(record != NULL, FALSE);
+
+    line = crispy_telemetry_format_line(record);
+    len = strlen(line);
+
+    fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to open telemetry log '%s': %s",
+                    path, g_strerror(errno));
+        return FALSE;
+    }
+
+    /* one write() of a whole line is atomic with O_APPEND */
+    done = 0;
+    while (done < len)
+    {
+        n = write(fd, line + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                        "Failed to write telemetry log '%s': %s",
+                        path, g_strerror(errno));
+            close(fd);
+            return FALSE;
+        }
+        done += (gsize)n;
+    }
+
+    close(fd);
+    return TRUE;
+}
+
+gboolean
+crispy_telemetry_update_metrics(
+    const gchar                 *path,
+    const CrispyTelemetryRecord *record,
+    GError                     **error
+){
+    g_autoptr(GHashTable) series = NULL;
+    g_autoptr(GError) write_error = NULL;
+    g_autofree gchar *lock_path = NULL;
+    g_autofree gchar *contents = NULL;
+    g_autofree gchar *text = NULL;
+    gdouble seconds;
+    gboolean ok;
+    gint64 us;
+    guint b;
+    gint lock_fd;
+    gint p;
+
+    g_return_val_if_fail(path != NULL, FALSE);
+    g_return_val_if_fail(record != NULL, FALSE);
+
+    /* the file itself is replaced, so lock a sibling that stays put */
+    lock_path = g_strconcat(path, ".lock", NULL);
+    lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) < 0)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to lock '%s': %s", lock_path, g_strerror(errno));
+        if (lock_fd >= 0)
+            close(lock_fd);
+        return FALSE;
+    }
+
+    /* a missing or unreadable file starts the counts over */
+    g_file_get_contents(path, &contents, NULL, NULL);
+    series = read_series(contents);
+
+    for (p = 0; p < N_PHASES; p++)
+    {
+        us = phase_time(record, p);
+        if (us < 0)
+            continue;
+
+        seconds = (gdouble)us / G_USEC_PER_SEC;
+        for (b = 0; b < G_N_ELEMENTS(bucket_bounds); b++)
+        {
+            if (seconds <= g_ascii_strtod(bucket_bounds[b], NULL))
+                add_to_series(series, bucket_name(p, bucket_bounds[b]), 1.0);
+        }
+        add_to_series(series, bucket_name(p, "+Inf"), 1.0);
+        add_to_series(series,
+                      g_strdup_printf(METRIC_PHASE "_count{phase=\"%s\"}",
+                                      phase_names[p]), 1.0);
+        add_to_series(series,
+                      g_strdup_printf(METRIC_PHASE "_sum{phase=\"%s\"}",
+                                      phase_names[p]), seconds);
+    }
+
+    add_to_series(series,
+                  g_strdup(record->cache_hit ? METRIC_RUNS "{cache=\"hit\"}"
+                                             : METRIC_RUNS "{cache=\"miss\"}"),
+                  1.0);
+    add_to_series(series, g_strdup(METRIC_FAILED),
+                  record->exit_code != 0 ? 1.0 : 0.0);
+
+    /* write-and-rename: the collector never sees a partial file */
+    text = format_metrics(series);
+    ok = g_file_set_contents(path, text, -1, &write_error);
+    if (!ok)
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to write metrics: %s", write_error->message);
+
+    close(lock_fd);
+    return ok;
+}
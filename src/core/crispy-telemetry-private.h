@@ -0,0 +1,122 @@
+/* crispy-telemetry-private.h - Internal per-run telemetry log and metrics */
+
+/*
+ * Support for --telemetry and --metrics: every script run appends one
+ * JSON line to a log, and folds its phase timings into histograms in
+ * an OpenMetrics text file for node_exporter's textfile collector.
+ * Used by CrispyScript.  This header is NOT installed or included in
+ * the public umbrella header.
+ */
+
+#ifndef CRISPY_TELEMETRY_PRIVATE_H
+#define CRISPY_TELEMETRY_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyTelemetryRecord:
+ * @script: (nullable): script path, %NULL for inline and stdin scripts
+ * @hash: (nullable): cache key of the compiled script
+ * @cache_hit: whether the compiled script came from the cache; %TRUE
+ *   for a replay
+ * @replayed: whether CRISPY_PURE replayed a recorded result instead of
+ *   loading the script; @time_execute is then the replay
+ * @prepared: whether this run paid for the prepare phases; %FALSE for
+ *   the second and later runs of --repeat, whose prepare phases are 0
+ * @exit_code: exit code of main()
+ * @time_param_expand: microseconds, as in #CrispyHookContext
+ * @time_hash: microseconds
+ * @time_cache_check: microseconds
+ * @time_compile: microseconds, 0 on a cache hit
+ * @time_module_load: microseconds
+ * @time_execute: microseconds
+ * @time_total: microseconds this run took, from the start of
+ *   crispy_script_prepare() when @prepared
+ * @plugin_costs: (nullable) (element-type CrispyPluginCost): hook costs
+ *   since the script was prepared, %NULL without plugins
+ *
+ * What one script run reports.
+ */
+typedef struct
+{
+    const gchar *script;
+    const gchar *hash;
+    gboolean     cache_hit;
+    gboolean     replayed;
+    gboolean     prepared;
+    gint         exit_code;
+    gint64       time_param_expand;
+    gint64       time_hash;
+    gint64       time_cache_check;
+    gint64       time_compile;
+    gint64       time_module_load;
+    gint64       time_execute;
+    gint64       time_total;
+    GArray      *plugin_costs;
+} CrispyTelemetryRecord;
+
+/**
+ * crispy_telemetry_append_json_string:
+ * @out: string to append to
+ * @value: (nullable): text to quote, %NULL for `null`
+ *
+ * Appends @value as a JSON string literal.
+ */
+void     crispy_telemetry_append_json_string (GString                     *out,
+                                              const gchar                 *value);
+
+/**
+ * crispy_telemetry_format_line:
+ * @record: a run
+ *
+ * Formats @record as one line of JSON with a fixed key order: "ts"
+ * (UTC, ISO 8601), "host", "pid", "script", "hash", "cache_hit",
+ * "replayed", "exit_code", then every time_* field in microseconds, then
+ * "plugin_costs": one object per plugin with its "name" and, under
+ * "hooks", the "calls", "wall_ns" and "cpu_ns" of each hook point it
+ * ran.  The array is empty without plugins.
+ *
+ * Returns: (transfer full): the line, ending in a newline
+ */
+gchar   *crispy_telemetry_format_line        (const CrispyTelemetryRecord *record);
+
+/**
+ * crispy_telemetry_append_log:
+ * @path: JSON lines file, created if missing
+ * @record: a run
+ * @error: (nullable): return location for a #GError
+ *
+ * Appends crispy_telemetry_format_line() to @path with one O_APPEND
+ * write, so concurrent crispy processes never interleave their lines.
+ *
+ * Returns: %FALSE with %CRISPY_ERROR_IO on failure
+ */
+gboolean crispy_telemetry_append_log         (const gchar                 *path,
+                                              const CrispyTelemetryRecord *record,
+                                              GError                     **error);
+
+/**
+ * crispy_telemetry_update_metrics:
+ * @path: OpenMetrics text file, e.g. "/var/lib/node_exporter/crispy.prom"
+ * @record: a run
+ * @error: (nullable): return location for a #GError
+ *
+ * Reads the counts already in @path, adds @record and rewrites the
+ * file atomically through a rename.  Phase latencies go into the
+ * histogram crispy_phase_seconds{phase=...}, with compile observed
+ * only on cache misses, the prepare phases only when
+ * @record->prepared, and cache_check and module_load not for a replay.  Runs are counted in crispy_runs_total{cache=...}
+ * and non-zero exits in crispy_failed_runs_total.  Writers are
+ * serialized with flock() on "@path.lock".
+ *
+ * Returns: %FALSE with %CRISPY_ERROR_IO on failure
+ */
+gboolean crispy_telemetry_update_metrics     (const gchar                 *path,
+                                              const CrispyTelemetryRecord *record,
+                                              GError                     **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_TELEMETRY_PRIVATE_H */
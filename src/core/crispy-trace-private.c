@@ -0,0 +1,345 @@
+/* crispy-trace-private.c - Internal Chrome trace event recorder */
+
+#define CRISPY_COMPILATION
+#include "crispy-trace-private.h"
+#include "crispy-telemetry-private.h"
+#include "../crispy-types.h"
+
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct _CrispyTrace
+{
+    GMutex   lock;
+    GString *events;    /* event objects, each preceded by ",\n" */
+    gint64   origin;    /* g_get_monotonic_time() at creation */
+    gint     pid;
+};
+
+/* a "phase ..." row of gcc's time report */
+typedef struct
+{
+    gchar  *name;
+    gint64  duration;
+} GccPhase;
+
+/* --- helper: free a GccPhase's name --- */
+static void
+gcc_phase_clear(
+    gpointer data
+){
+    g_free(((GccPhase *)data)->name);
+}
+
+/* --- helper: rc box destructor --- */
+static void
+trace_clear(
+    gpointer data
+){
+    CrispyTrace *trace;
+
+    trace = (CrispyTrace *)data;
+    g_string_free(trace->events, TRUE);
+    g_mutex_clear(&trace->lock);
+}
+
+/*
+ * --- helper: read the next number of a time report row ---
+ *
+ * Rows look like " phase parsing : 0.04 ( 67%) 0.02 ( 67%) 0.06 ( 67%)
+ * 9936k ( 63%)"; the percentages in parentheses are skipped.
+ */
+static gboolean
+read_column(
+    const gchar **p,
+    gdouble      *value
+){
+    gchar *end;
+
+    while (**p == ' ')
+        (*p)++;
+    if (**p == '(')
+    {
+        while (**p != '\0' && **p != ')')
+            (*p)++;
+        if (**p == ')')
+            (*p)++;
+        while (**p == ' ')
+            (*p)++;
+    }
+
+    *value = g_ascii_strtod(*p, &end);
+    if (end == *p)
+        return FALSE;
+
+    *p = end;
+    return TRUE;
+}
+
+/* --- helper: wall seconds of a "NAME : usr sys wall ..." row --- */
+static gboolean
+parse_report_row(
+    const gchar  *line,
+    gchar       **name,
+    gdouble      *wall
+){
+    const gchar *colon;
+    const gchar *p;
+    gdouble usr;
+    gdouble sys;
+
+    colon = strrchr(line, ':');
+    if (colon == NULL)
+        return FALSE;
+
+    p = colon + 1;
+    if (!read_column(&p, &usr) || !read_column(&p, &sys) ||
+        !read_column(&p, wall))
+        return FALSE;
+
+    *name = g_strstrip(g_strndup(line, (gsize)(colon - line)));
+    return TRUE;
+}
+
+/* --- helper: append ", "KEY": VALUE" with VALUE in milliseconds --- */
+static void
+append_ms_arg(
+    GString     *args,
+    const gchar *key,
+    gdouble      seconds
+){
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    if (args->len > 1)
+        g_string_append(args, ", ");
+    crispy_telemetry_append_json_string(args, key);
+    g_string_append_printf(args, ": %s",
+                           g_ascii_formatd(buf, sizeof(buf), "%.3f",
+                                           seconds * 1000.0));
+}
+
+/* --- helper: append ", "PATH": N" for a direct include --- */
+static void
+append_include(
+    GString     *includes,
+    const gchar *path,
+    guint        nested
+){
+    if (path == NULL)
+        return;
+
+    if (includes->len > 1)
+        g_string_append(includes, ", ");
+    crispy_telemetry_append_json_string(includes, path);
+    g_string_append_printf(includes, ": %u", nested);
+}
+
+/* --- public API --- */
+
+CrispyTrace *
+crispy_trace_new(void)
+{
+    CrispyTrace *trace;
+
+    trace = g_atomic_rc_box_new0(CrispyTrace);
+    g_mutex_init(&trace->lock);
+    trace->events = g_string_new(NULL);
+    trace->origin = g_get_monotonic_time();
+    trace->pid = (gint)getpid();
+
+    return trace;
+}
+
+CrispyTrace *
+crispy_trace_ref(
+    CrispyTrace *trace
+){
+    g_return_val_if_fail(trace != NULL, NULL);
+
+    return g_atomic_rc_box_acquire(trace);
+}
+
+void
+crispy_trace_unref(
+    CrispyTrace *trace
+){
+    g_return_if_fail(trace != NULL);
+
+    g_atomic_rc_box_release_full(trace, trace_clear);
+}
+
+void
+crispy_trace_add_span(
+    CrispyTrace *trace,
+    const gchar *category,
+    const gchar *name,
+    gint64       start,
+    gint64       duration,
+    const gchar *args
+){
+    g_autoptr(GString) event = NULL;
+
+    g_return_if_fail(trace != NULL);
+    g_return_if_fail(category != NULL);
+    g_return_if_fail(name != NULL);
+
+    event = g_string_new(",\n{\"name\": ");
+    crispy_telemetry_append_json_string(event, name);
+    g_string_append(event, ", \"cat\": ");
+    crispy_telemetry_append_json_string(event, category);
+    g_string_append_printf(event,
+        ", \"ph\": \"X\", \"ts\": %" G_GINT64_FORMAT
+        ", \"dur\": %" G_GINT64_FORMAT ", \"pid\": %d, \"tid\": %d",
+        start - trace->origin, MAX(duration, 0), trace->pid,
+        (gint)syscall(SYS_gettid));
+    if (args != NULL)
+        g_string_append_printf(event, ", \"args\": %s", args);
+    g_string_append_c(event, '}');
+
+    g_mutex_lock(&trace->lock);
+    g_string_append_len(trace->events, event->str, (gssize)event->len);
+    g_mutex_unlock(&trace->lock);
+}
+
+void
+crispy_trace_add_gcc_report(
+    CrispyTrace *trace,
+    gint64       start,
+    gint64       duration,
+    const gchar *report
+){
+    g_auto(GStrv) lines = NULL;
+    g_autoptr(GArray) phases = NULL;
+    g_autoptr(GString) detail = NULL;
+    g_autoptr(GString) includes = NULL;
+    g_autofree gchar *parsing_args = NULL;
+    const gchar *top_include;
+    GccPhase *phase;
+    GccPhase row;
+    gdouble total_wall;
+    gdouble wall;
+    gchar *name;
+    gint64 cc1_duration;
+    gint64 t;
+    guint nested;
+    gsize depth;
+    guint i;
+
+    g_return_if_fail(trace != NULL);
+
+    if (report == NULL)
+        return;
+
+    phases = g_array_new(FALSE, TRUE, sizeof(GccPhase));
+    g_array_set_clear_func(phases, gcc_phase_clear);
+    detail = g_string_new("{");
+    includes = g_string_new("{");
+    top_include = NULL;
+    nested = 0;
+    total_wall = -1.0;
+
+    lines = g_strsplit(report, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        /* -H: one dot per include level, then a space and the path */
+        depth = strspn(lines[i], ".");
+        if (depth > 0 && lines[i][depth] == ' ')
+        {
+            if (depth == 1)
+            {
+                append_include(includes, top_include, nested);
+                top_include = lines[i] + depth + 1;
+                nested = 0;
+            }
+            else
+                nested++;
+            continue;
+        }
+
+        if (!parse_report_row(lines[i], &name, &wall))
+            continue;
+
+        if (g_strcmp0(name, "TOTAL") == 0)
+            total_wall = wall;
+        else if (g_str_has_prefix(name, "phase "))
+        {
+            row.name = g_strdup(name + strlen("phase "));
+            row.duration = (gint64)(wall * G_USEC_PER_SEC);
+            g_array_append_val(phases, row);
+        }
+        else if (wall > 0.0)
+            append_ms_arg(detail, name, wall);
+
+        g_free(name);
+    }
+    append_include(includes, top_include, nested);
+
+    if (total_wall < 0.0)
+        return;
+
+    g_string_append_c(detail, '}');
+    g_string_append_c(includes, '}');
+    parsing_args = g_strdup_printf("{\"includes\": %s}", includes->str);
+
+    cc1_duration = MIN((gint64)(total_wall * G_USEC_PER_SEC), duration);
+    crispy_trace_add_span(trace, "gcc", "cc1", start, cc1_duration,
+                          detail->str);
+
+    /* the report has no timestamps; lay the phases out in order */
+    t = start;
+    for (i = 0; i < phases->len; i++)
+    {
+        phase = &g_array_index(phases, GccPhase, i);
+        phase->duration = MIN(phase->duration, start + cc1_duration - t);
+        if (phase->duration <= 0)
+            continue;
+
+        crispy_trace_add_span(trace, "gcc", phase->name, t, phase->duration,
+                              strcmp(phase->name, "parsing") == 0
+                                  ? parsing_args : NULL);
+        t += phase->duration;
+    }
+
+    /* the driver, as and ld are not in cc1's report */
+    if (duration > cc1_duration)
+        crispy_trace_add_span(trace, "gcc", "assemble and link",
+                              start + cc1_duration,
+                              duration - cc1_duration, NULL);
+}
+
+gboolean
+crispy_trace_write(
+    CrispyTrace  *trace,
+    const gchar  *path,
+    GError      **error
+){
+    g_autoptr(GString) text = NULL;
+    g_autoptr(GError) write_error = NULL;
+
+    g_return_val_if_fail(trace != NULL, FALSE);
+    g_return_val_if_fail(path != NULL, FALSE);
+
+    text = g_string_new("{\"traceEvents\": [\n");
+    g_string_append_printf(text,
+        "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+        "\"tid\": %d, \"args\": {\"name\": \"crispy\"}}",
+        trace->pid, trace->pid);
+
+    g_mutex_lock(&trace->lock);
+    g_string_append_len(text, trace->events->str,
+                        (gssize)trace->events->len);
+    g_mutex_unlock(&trace->lock);
+
+    g_string_append(text, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    if (!g_file_set_contents(path, text->str, (gssize)text->len,
+                             &write_error))
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_IO,
+                    "Failed to write trace: %s", write_error->message);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,104 @@
+/* crispy-trace-private.h - Internal Chrome trace event recorder */
+
+/*
+ * Support for --trace: spans for the steps of a crispy run, the plugin
+ * hooks and gcc's own phases, written as Chrome trace event JSON that
+ * Perfetto and chrome://tracing open.  Used by main.c, CrispyScript
+ * and CrispyPluginEngine.  This header is NOT installed or included in
+ * the public umbrella header.
+ */
+
+#ifndef CRISPY_TRACE_PRIVATE_H
+#define CRISPY_TRACE_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CrispyTrace CrispyTrace;
+
+/**
+ * crispy_trace_new:
+ *
+ * Creates an empty trace.  Timestamps are written relative to now.
+ *
+ * Returns: (transfer full): a new #CrispyTrace
+ */
+CrispyTrace *crispy_trace_new             (void);
+
+/**
+ * crispy_trace_ref:
+ * @trace: a #CrispyTrace
+ *
+ * Returns: (transfer full): @trace
+ */
+CrispyTrace *crispy_trace_ref             (CrispyTrace *trace);
+
+/**
+ * crispy_trace_unref:
+ * @trace: a #CrispyTrace
+ *
+ * Drops a reference; the last one frees the recorded events.
+ */
+void         crispy_trace_unref           (CrispyTrace *trace);
+
+/**
+ * crispy_trace_add_span:
+ * @trace: a #CrispyTrace
+ * @category: event category, such as "crispy", "hook" or "gcc"
+ * @name: span name
+ * @start: g_get_monotonic_time() when the span began
+ * @duration: microseconds
+ * @args: (nullable): a JSON object shown with the span, or %NULL
+ *
+ * Records a complete ("X") event on the calling thread.  Spans on one
+ * thread that lie inside each other are drawn nested.  Thread-safe.
+ */
+void         crispy_trace_add_span        (CrispyTrace *trace,
+                                           const gchar *category,
+                                           const gchar *name,
+                                           gint64       start,
+                                           gint64       duration,
+                                           const gchar *args);
+
+/**
+ * crispy_trace_add_gcc_report:
+ * @trace: a #CrispyTrace
+ * @start: g_get_monotonic_time() when gcc was started
+ * @duration: microseconds until gcc exited
+ * @report: (nullable): stderr of gcc run with -ftime-report and -H
+ *
+ * Adds child spans for one gcc run: a "cc1" span as long as the
+ * report's TOTAL wall time, holding one span per "phase ..." row laid
+ * end to end, then "assemble and link" for the rest of @duration.
+ * The other rows of the report become arguments of the "cc1" span.
+ * gcc does not time headers, so the "parsing" span lists each header
+ * the source includes directly with the number of headers it pulls
+ * in, taken from the -H output.  Does nothing when @report has no
+ * time report.
+ */
+void         crispy_trace_add_gcc_report  (CrispyTrace *trace,
+                                           gint64       start,
+                                           gint64       duration,
+                                           const gchar *report);
+
+/**
+ * crispy_trace_write:
+ * @trace: a #CrispyTrace
+ * @path: output file
+ * @error: (nullable): return location for a #GError
+ *
+ * Writes every event recorded so far as a Chrome trace event JSON
+ * object, replacing @path atomically.
+ *
+ * Returns: %FALSE with %CRISPY_ERROR_IO on failure
+ */
+gboolean     crispy_trace_write           (CrispyTrace  *trace,
+                                           const gchar  *path,
+                                           GError      **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyTrace, crispy_trace_unref)
+
+G_END_DECLS
+
+#endif /* CRISPY_TRACE_PRIVATE_H */
@@ -0,0 +1,377 @@
+/* crispy-watch-private.c - Internal watch mode: rerun a script on every change */
+
+#define CRISPY_COMPILATION
+#include "crispy-watch-private.h"
+#include "crispy-script-private.h"
+#include "crispy-source-utils-private.h"
+#include "../crispy-types.h"
+
+#include <gio/gio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct
+{
+    CrispyScript  *script;        /* template for each run, borrowed */
+    gchar         *source_path;
+    gint           argc;
+    gchar        **argv;          /* borrowed */
+
+    GHashTable    *monitors;      /* canonical path -> GFileMonitor* */
+    guint          debounce_id;
+
+    GPid           child;         /* 0 while idle */
+    guint          runs;          /* children started so far */
+    gboolean       rerun;         /* start again once the child is gone */
+} CrispyWatch;
+
+static void on_file_changed (GFileMonitor      *monitor,
+                             GFile             *file,
+                             GFile             *other_file,
+                             GFileMonitorEvent  event,
+                             gpointer           user_data);
+
+/* --- helper: hash table value destroy func --- */
+static void
+monitor_free(
+    gpointer data
+){
+    GFileMonitor *monitor;
+
+    monitor = (GFileMonitor *)data;
+    g_signal_handlers_disconnect_matched(monitor, G_SIGNAL_MATCH_FUNC,
+                                         0, 0, NULL,
+                                         (gpointer)on_file_changed, NULL);
+    g_file_monitor_cancel(monitor);
+    g_object_unref(monitor);
+}
+
+/* --- helper: add @path and everything it includes to @deps --- */
+static void
+collect_dependencies(
+    GHashTable  *deps,
+    const gchar *path
+){
+    g_autofree gchar *contents = NULL;
+    g_autofree gchar *dir = NULL;
+    g_auto(GStrv) names = NULL;
+    guint i;
+
+    if (g_hash_table_contains(deps, path))
+        return;
+    g_hash_table_add(deps, g_strdup(path));
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+        return;
+
+    dir = g_path_get_dirname(path);
+    names = crispy_source_find_local_includes(contents);
+    for (i = 0; names[i] != NULL; i++)
+    {
+        g_autofree gchar *dep = NULL;
+
+        dep = g_canonicalize_filename(names[i], dir);
+        if (g_file_test(dep, G_FILE_TEST_IS_REGULAR))
+            collect_dependencies(deps, dep);
+    }
+}
+
+/*
+ * update_monitors:
+ *
+ * Re-scans the script's includes and brings the monitor table in line
+ * with them.  Called before every run, so a header added by an edit is
+ * watched from then on.  With @error set, the first monitor that
+ * cannot be created is an error; otherwise it is skipped.
+ */
+static gboolean
+update_monitors(
+    CrispyWatch  *self,
+    GError      **error
+){
+    g_autoptr(GHashTable) deps = NULL;
+    GHashTableIter iter;
+    gpointer key;
+
+    deps = crispy_watch_collect_dependencies(self->source_path);
+
+    /* drop files the script no longer includes */
+    g_hash_table_iter_init(&iter, self->monitors);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+    {
+        if (!g_hash_table_contains(deps, key))
+            g_hash_table_iter_remove(&iter);
+    }
+
+    /* and watch the new ones */
+    g_hash_table_iter_init(&iter, deps);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+    {
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GError) local_error = NULL;
+        GFileMonitor *monitor;
+
+        if (g_hash_table_contains(self->monitors, key))
+            continue;
+
+        file = g_file_new_for_path((const gchar *)key);
+        monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES,
+                                      NULL, &local_error);
+        if (monitor == NULL)
+        {
+            if (error != NULL)
+            {
+                g_propagate_error(error, g_steal_pointer(&local_error));
+                return FALSE;
+            }
+            g_printerr("Warning: Cannot watch '%s': %s\n",
+                        (const gchar *)key, local_error->message);
+            continue;
+        }
+
+        g_signal_connect(monitor, "changed",
+                         G_CALLBACK(on_file_changed), self);
+        g_hash_table_insert(self->monitors, g_strdup((const gchar *)key),
+                            monitor);
+    }
+
+    return TRUE;
+}
+
+/*
+ * run_child:
+ *
+ * Body of the forked child: builds a fresh script from the template,
+ * executes it and exits.  Every run after the first bypasses the cache,
+ * whose entries are keyed on the script alone and would survive an
+ * edit to a header.
+ */
+static void G_GNUC_NORETURN
+run_child(
+    CrispyWatch *self,
+    pid_t        watcher
+){
+    CrispyScript *script;
+    GError *error;
+    gint exit_code;
+
+    /* crispy's own handlers would just queue the signal for the loop */
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    /* do not outlive the watcher */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != watcher)
+        _exit(1);
+
+    error = NULL;
+    exit_code = 1;
+    script = crispy_script_respawn_internal(
+        self->script,
+        self->runs > 0 ? CRISPY_FLAG_FORCE_COMPILE : CRISPY_FLAG_NONE,
+        CRISPY_FLAG_NONE,
+        &error);
+    if (script != NULL)
+    {
+        exit_code = crispy_script_execute(script, self->argc, self->argv,
+                                          &error);
+        if (exit_code < 0)
+            exit_code = 1;
+        g_object_unref(script);
+    }
+
+    if (error != NULL)
+    {
+        g_printerr("Error: %s\n", error->message);
+        g_error_free(error);
+    }
+
+    /* skip the watcher's atexit handlers and GLib teardown */
+    fflush(stdout);
+    fflush(stderr);
+    _exit(exit_code & 0xff);
+}
+
+static void start_run (CrispyWatch *self);
+
+static void
+on_child_exited(
+    GPid     pid,
+    gint     wait_status,
+    gpointer user_data
+){
+    CrispyWatch *self;
+
+    self = (CrispyWatch *)user_data;
+    g_spawn_close_pid(pid);
+    self->child = 0;
+
+    /* killed because the source changed: go straight to the next run */
+    if (self->rerun)
+    {
+        self->rerun = FALSE;
+        start_run(self);
+        return;
+    }
+
+    if (WIFSIGNALED(wait_status))
+        g_printerr("[%s killed by signal %d; waiting for changes]\n",
+                    self->source_path, WTERMSIG(wait_status));
+    else
+        g_printerr("[%s exited with code %d; waiting for changes]\n",
+                    self->source_path, WEXITSTATUS(wait_status));
+}
+
+static void
+start_run(
+    CrispyWatch *self
+){
+    pid_t watcher;
+    pid_t pid;
+
+    update_monitors(self, NULL);
+
+    /* anything buffered would otherwise be printed by both processes */
+    fflush(stdout);
+    fflush(stderr);
+
+    watcher = getpid();
+    pid = fork();
+    if (pid < 0)
+    {
+        g_printerr("Error: Failed to fork: %s\n", g_strerror(errno));
+        return;
+    }
+    if (pid == 0)
+        run_child(self, watcher);
+
+    self->runs++;
+    self->child = pid;
+    g_child_watch_add(pid, on_child_exited, self);
+}
+
+static gboolean
+on_debounce(
+    gpointer user_data
+){
+    CrispyWatch *self;
+
+    self = (CrispyWatch *)user_data;
+    self->debounce_id = 0;
+
+    if (self->child == 0)
+    {
+        start_run(self);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* on_child_exited() starts the next run */
+    if (!self->rerun)
+    {
+        self->rerun = TRUE;
+        kill(self->child, SIGTERM);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_file_changed(
+    GFileMonitor      *monitor,
+    GFile             *file,
+    GFile             *other_file,
+    GFileMonitorEvent  event,
+    gpointer           user_data
+){
+    CrispyWatch *self;
+
+    self = (CrispyWatch *)user_data;
+
+    /* same save events as hot swap: in place, or temp file + rename */
+    switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+        break;
+    default:
+        return;
+    }
+
+    if (self->debounce_id != 0)
+        g_source_remove(self->debounce_id);
+    self->debounce_id = g_timeout_add(CRISPY_WATCH_DEBOUNCE_MS,
+                                      on_debounce, self);
+}
+
+GHashTable *
+crispy_watch_collect_dependencies(
+    const gchar *path
+){
+    GHashTable *deps;
+
+    g_return_val_if_fail(path != NULL, NULL);
+
+    deps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    collect_dependencies(deps, path);
+
+    return deps;
+}
+
+gint
+crispy_watch_run(
+    CrispyScript  *script,
+    gint           argc,
+    gchar        **argv,
+    GError       **error
+){
+    CrispyWatch self;
+    const gchar *source_path;
+    g_autoptr(GMainLoop) loop = NULL;
+
+    g_return_val_if_fail(CRISPY_IS_SCRIPT(script), -1);
+
+    source_path = crispy_script_get_source_path_internal(script);
+    if (source_path == NULL)
+    {
+        g_set_error(error,
+                    CRISPY_ERROR,
+                    CRISPY_ERROR_LOAD,
+                    "Watch mode needs a script file");
+        return -1;
+    }
+
+    memset(&self, 0, sizeof(self));
+    self.script = script;
+    self.source_path = g_canonicalize_filename(source_path, NULL);
+    self.argc = argc;
+    self.argv = argv;
+    self.monitors = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          g_free, monitor_free);
+
+    if (!update_monitors(&self, error))
+    {
+        g_hash_table_unref(self.monitors);
+        g_free(self.source_path);
+        return -1;
+    }
+
+    start_run(&self);
+
+    /* nothing quits this loop; crispy's signal handlers end the process */
+    loop = g_main_loop_new(NULL, FALSE);
+    g_main_loop_run(loop);
+
+    if (self.debounce_id != 0)
+        g_source_remove(self.debounce_id);
+    g_hash_table_unref(self.monitors);
+    g_free(self.source_path);
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* crispy-watch-private.h - Internal watch mode: rerun a script on every change */
+
+/*
+ * Support for `crispy --watch`: one resident crispy process, with its
+ * compiler probe, config and plugins already loaded, reruns a script
+ * in a fresh forked child whenever the script or one of its local
+ * headers changes.  Used by the crispy binary.  This header is NOT
+ * installed or included in the public umbrella header.
+ */
+
+#ifndef CRISPY_WATCH_PRIVATE_H
+#define CRISPY_WATCH_PRIVATE_H
+
+#include <glib.h>
+#include "crispy-script.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_WATCH_DEBOUNCE_MS:
+ *
+ * How long the watched files must stay unchanged before a rerun
+ * starts.  Short, because it adds directly to edit-to-output latency;
+ * it only has to cover the writes and rename of a single save.
+ */
+#define CRISPY_WATCH_DEBOUNCE_MS (50)
+
+/**
+ * crispy_watch_collect_dependencies:
+ * @path: canonical path of a C source file
+ *
+ * Collects @path and, recursively, every existing file it includes
+ * with `#include "..."`.  Names are resolved against the directory of
+ * the file that includes them, as gcc does first for quoted includes;
+ * anything found only through -I is not tracked.  Each file is read
+ * once, so include cycles end.
+ *
+ * Returns: (transfer full) (element-type utf8 utf8): a set of
+ *   canonical paths, @path included
+ */
+GHashTable *crispy_watch_collect_dependencies (const gchar   *path);
+
+/**
+ * crispy_watch_run:
+ * @script: a configured, unprepared #CrispyScript created from a file;
+ *   used as the template for every run and never executed itself
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script; must
+ *   stay valid while watching
+ * @error: (nullable): return location for a #GError
+ *
+ * Runs @script in a forked child, then watches its source file and
+ * every file it pulls in with `#include "..."` (resolved against the
+ * including file's directory, recursively).  After each change the
+ * running child, if any, gets SIGTERM, and a new child re-reads the
+ * source, compiles it (bypassing the cache, which does not know about
+ * headers) and runs it.  The parent never loads script code, so a
+ * crashing script cannot take the watcher down.
+ *
+ * Iterates the global-default #GMainContext until the process is
+ * interrupted.
+ *
+ * Returns: -1 with @error set if watching could not start
+ */
+gint        crispy_watch_run                  (CrispyScript  *script,
+                                               gint           argc,
+                                               gchar        **argv,
+                                               GError       **error);
+
+G_END_DECLS
+
+#endif /* CRISPY_WATCH_PRIVATE_H */
@@ -89,6 +89,29 @@ typedef enum
     CRISPY_HOOK_FORCE_RECOMPILE
 } CrispyHookResult;
 
+/* --- Per-plugin cost accounting --- */
+
+/**
+ * CrispyPluginCost:
+ * @index: position of the plugin in load order
+ * @name: plugin name from its #CrispyPluginInfo
+ * @calls: hook calls, per #CrispyHookPoint
+ * @wall_ns: wall-clock nanoseconds spent in the hooks, per hook point
+ * @cpu_ns: CPU nanoseconds of the calling thread spent in the hooks,
+ *   per hook point
+ *
+ * What one plugin's hooks cost a script run.  Collected in
+ * #CrispyHookContext.plugin_costs.
+ */
+typedef struct
+{
+    guint        index;
+    const gchar *name;
+    guint        calls[CRISPY_HOOK_POINT_COUNT];
+    gint64       wall_ns[CRISPY_HOOK_POINT_COUNT];
+    gint64       cpu_ns[CRISPY_HOOK_POINT_COUNT];
+} CrispyPluginCost;
+
 /* --- Hook context --- */
 
 /**
@@ -122,6 +145,17 @@ typedef enum
  * @plugin_data: (nullable): per-plugin opaque state from init
  * @engine: (nullable): the plugin engine (for shared data store)
  * @error: (nullable): location for error reporting on ABORT
+ * @isa_target: (nullable): ISA clone selected for this CPU ("avx512f",
+ *   "avx2" or "default") when the script uses CRISPY_MULTIVERSION
+ * @cpus: (nullable): CPU list the script runs on when a placement
+ *   (--cpus, --numa-node or CRISPY_CPUS) pinned it, else %NULL
+ * @numa_node: NUMA node the script was placed on, or -1
+ * @sched: (nullable): scheduling policy applied to the script, or %NULL
+ * @allocator: (nullable): malloc replacement preloaded into the process
+ *   ("mimalloc", "jemalloc", ...), or %NULL for the system allocator
+ * @plugin_costs: (nullable) (element-type CrispyPluginCost): cost of
+ *   each plugin's hooks so far in this run, one entry per plugin in the
+ *   order they first ran; POST_EXECUTE consumers see every earlier hook
  *
  * Context structure passed to every hook function. Contains both
  * read-only pipeline state and mutable fields that plugins can
@@ -171,6 +205,20 @@ struct _CrispyHookContext
     gpointer         plugin_data;
     gpointer         engine;
     GError         **error;
+
+    /* CRISPY_MULTIVERSION clone for this CPU, NULL if not used */
+    const gchar     *isa_target;
+
+    /* placement applied before PRE_EXECUTE (NULL / -1 if unset) */
+    const gchar     *cpus;
+    gint             numa_node;
+    const gchar     *sched;
+
+    /* CRISPY_ALLOCATOR in effect, NULL for the system allocator */
+    const gchar     *allocator;
+
+    /* per-plugin hook cost, updated by the engine on every dispatch */
+    GArray          *plugin_costs;
 };
 
 /* --- Plugin info descriptor --- */
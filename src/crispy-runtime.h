@@ -0,0 +1,59 @@
+/* crispy-runtime.h - Umbrella header for the Crispy script runtime */
+
+#ifndef CRISPY_RUNTIME_H
+#define CRISPY_RUNTIME_H
+
+/**
+ * SECTION:crispy-runtime
+ * @title: Crispy Runtime
+ * @short_description: Performance helpers for crispy scripts
+ *
+ * The crispy runtime is a small library (libcrispy-runtime) of helpers
+ * that scripts would otherwise reimplement: an arena allocator, a
+ * read-only mmap file view, batched whole-file reads, a large-buffer
+ * output writer, a monotonic timer, a work-stealing parallel-for,
+ * in-process pipeline stages connected by ring buffers, an init
+ * arena that is snapshotted between runs, a persistent key-value
+ * store shared between processes and benchmark macros for
+ * `crispy --bench`.
+ * It depends only on GLib and is versioned together with libcrispy.
+ *
+ * Scripts do not need any CRISPY_PARAMS to use it.  When crispy sees
+ * `#include <crispy-runtime.h>` in a script it adds the include path
+ * and links libcrispy-runtime automatically:
+ * |[<!-- language="C" -->
+ * #include <crispy-runtime.h>
+ *
+ * gint
+ * main(
+ *     gint    argc,
+ *     gchar **argv
+ * ){
+ *     CrispyTimer timer;
+ *
+ *     crispy_timer_start(&timer);
+ *     crispy_writer_puts(crispy_stdout(), "hello\n");
+ *     crispy_writer_printf(crispy_stdout(), "took %.3f ms\n",
+ *                          crispy_timer_elapsed_ms(&timer));
+ *     return 0;
+ * }
+ * ]|
+ */
+
+#define CRISPY_RUNTIME_INSIDE
+
+#include "crispy-version.h"
+#include "runtime/crispy-arena.h"
+#include "runtime/crispy-mapped-file.h"
+#include "runtime/crispy-writer.h"
+#include "runtime/crispy-timer.h"
+#include "runtime/crispy-parallel.h"
+#include "runtime/crispy-file-batch.h"
+#include "runtime/crispy-stage.h"
+#include "runtime/crispy-init.h"
+#include "runtime/crispy-kv.h"
+#include "runtime/crispy-bench.h"
+
+#undef CRISPY_RUNTIME_INSIDE
+
+#endif /* CRISPY_RUNTIME_H */
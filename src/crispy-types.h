@@ -30,6 +30,8 @@ typedef struct _CrispyConfigContext    CrispyConfigContext;
  * @CRISPY_FLAG_PRESERVE_SOURCE: Keep temp source files in /tmp (-S).
  * @CRISPY_FLAG_DRY_RUN: Show compilation command without executing (--dry-run).
  * @CRISPY_FLAG_GDB: Compile as executable with debug symbols, launch under gdb (--gdb).
+ * @CRISPY_FLAG_ISOLATE: Load the module into its own link-map namespace with dlmopen (--isolate).
+ * @CRISPY_FLAG_HOT_SWAP: Rebuild and swap in the script when its source changes (--hot-swap).
  *
  * Flags controlling script compilation and execution behavior.
  */
@@ -39,7 +41,9 @@ typedef enum
     CRISPY_FLAG_FORCE_COMPILE   = 1 << 0,
     CRISPY_FLAG_PRESERVE_SOURCE = 1 << 1,
     CRISPY_FLAG_DRY_RUN         = 1 << 2,
-    CRISPY_FLAG_GDB             = 1 << 3
+    CRISPY_FLAG_GDB             = 1 << 3,
+    CRISPY_FLAG_ISOLATE         = 1 << 4,
+    CRISPY_FLAG_HOT_SWAP        = 1 << 5
 } CrispyFlags;
 
 /**
@@ -53,6 +57,28 @@ typedef enum
  */
 typedef gint (*CrispyMainFunc)(gint argc, gchar **argv);
 
+/**
+ * CrispyStateSaveFunc:
+ *
+ * Type of the optional `crispy_state_save()` export used by
+ * %CRISPY_FLAG_HOT_SWAP.  Called on the running version: it must
+ * detach the script's callbacks (remove its sources, disconnect its
+ * signal handlers) and return the state to hand over.
+ *
+ * Returns: (transfer full) (nullable): the script's state
+ */
+typedef gpointer (*CrispyStateSaveFunc)(void);
+
+/**
+ * CrispyStateRestoreFunc:
+ * @state: (transfer full) (nullable): what crispy_state_save() returned
+ *
+ * Type of the optional `crispy_state_restore()` export used by
+ * %CRISPY_FLAG_HOT_SWAP.  Called on the new version: it takes over
+ * @state and attaches the script's callbacks again.
+ */
+typedef void (*CrispyStateRestoreFunc)(gpointer state);
+
 /**
  * CRISPY_MAX_PARAMS_LEN:
  *
@@ -86,6 +112,8 @@ GQuark crispy_error_quark (void);
  * @CRISPY_ERROR_CACHE: Cache operation failed.
  * @CRISPY_ERROR_GCC_NOT_FOUND: gcc binary not found.
  * @CRISPY_ERROR_PLUGIN: Plugin operation failed.
+ * @CRISPY_ERROR_CONFIG: Config file compilation or init failed.
+ * @CRISPY_ERROR_PLACEMENT: CPU, NUMA or scheduler placement failed.
  *
  * Error codes for the %CRISPY_ERROR domain.
  */
@@ -99,7 +127,8 @@ typedef enum
     CRISPY_ERROR_CACHE,
     CRISPY_ERROR_GCC_NOT_FOUND,
     CRISPY_ERROR_PLUGIN,
-    CRISPY_ERROR_CONFIG
+    CRISPY_ERROR_CONFIG,
+    CRISPY_ERROR_PLACEMENT
 } CrispyError;
 
 G_END_DECLS
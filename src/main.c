@@ -3,6 +3,17 @@
 #define CRISPY_COMPILATION
 #include "crispy.h"
 #include "core/crispy-config-loader.h"
+#include "core/crispy-watch-private.h"
+#include "core/crispy-repl-private.h"
+#include "core/crispy-pipeline-private.h"
+#include "core/crispy-placement-private.h"
+#include "core/crispy-allocator-private.h"
+#include "core/crispy-bench-private.h"
+#include "core/crispy-plugin-builder-private.h"
+#include "core/crispy-source-utils-private.h"
+#include "core/crispy-script-private.h"
+#include "core/crispy-plugin-engine-private.h"
+#include "core/crispy-trace-private.h"
 #include "crispy-default-config.h"
 #include "crispy-logo.h"
 
@@ -34,6 +45,9 @@
 /* global state for signal cleanup */
 static gchar *g_temp_source_path = NULL;
 
+/* --trace recorder, NULL when off */
+static CrispyTrace *g_trace = NULL;
+
 /* --- CLI option variables --- */
 static gchar    *opt_inline       = NULL;
 static gchar    *opt_include      = NULL;
@@ -42,9 +56,27 @@ static gboolean  opt_no_cache     = FALSE;
 static gboolean  opt_preserve     = FALSE;
 static gboolean  opt_gdb          = FALSE;
 static gboolean  opt_dry_run      = FALSE;
+static gboolean  opt_isolate      = FALSE;
+static gboolean  opt_hot_swap     = FALSE;
+static gboolean  opt_watch        = FALSE;
+static gboolean  opt_repl         = FALSE;
+static gboolean  opt_pipeline     = FALSE;
 static gboolean  opt_clean_cache  = FALSE;
 static gchar    *opt_plugins      = NULL;
+static gdouble   opt_plugin_warn  = 0.0;
 static gchar    *opt_cache_dir    = NULL;
+static gchar    *opt_cpus         = NULL;
+static gint      opt_numa_node    = -1;
+static gchar    *opt_sched        = NULL;
+static gchar    *opt_allocator    = NULL;
+static gchar    *opt_telemetry    = NULL;
+static gchar    *opt_metrics      = NULL;
+static gchar    *opt_trace        = NULL;
+static gint      opt_repeat       = 0;
+static gboolean  opt_repeat_fork  = FALSE;
+static gchar    *opt_profiles     = NULL;
+static gboolean  opt_bench        = FALSE;
+static gchar    *opt_bench_json   = NULL;
 static gchar    *opt_config       = NULL;
 static gboolean  opt_no_config    = FALSE;
 static gboolean  opt_gen_config   = FALSE;
@@ -81,14 +113,86 @@ static GOptionEntry entries[] =
         "dry-run", 0, 0, G_OPTION_ARG_NONE, &opt_dry_run,
         "Show compilation command without executing", NULL
     },
+    {
+        "isolate", 0, 0, G_OPTION_ARG_NONE, &opt_isolate,
+        "Load the script into its own dlmopen namespace", NULL
+    },
+    {
+        "hot-swap", 0, 0, G_OPTION_ARG_NONE, &opt_hot_swap,
+        "Recompile and swap in the script when its source changes", NULL
+    },
+    {
+        "watch", 'w', 0, G_OPTION_ARG_NONE, &opt_watch,
+        "Rerun the script whenever it or its local headers change", NULL
+    },
+    {
+        "repl", 0, 0, G_OPTION_ARG_NONE, &opt_repl,
+        "Read C interactively, compiling one cell at a time", NULL
+    },
+    {
+        "pipeline", 0, 0, G_OPTION_ARG_NONE, &opt_pipeline,
+        "Run each argument as a stage of one in-process pipeline", NULL
+    },
+    {
+        "repeat", 0, 0, G_OPTION_ARG_INT, &opt_repeat,
+        "Run main() N times and report timing statistics", "N"
+    },
+    {
+        "repeat-fork", 0, 0, G_OPTION_ARG_NONE, &opt_repeat_fork,
+        "With --repeat, run each main() in a fresh forked child", NULL
+    },
+    {
+        "profiles", 0, 0, G_OPTION_ARG_STRING, &opt_profiles,
+        "Build and time each profile (debug,fast,O3,size,native,lto,NAME=FLAGS)", "LIST"
+    },
+    {
+        "bench", 0, 0, G_OPTION_ARG_NONE, &opt_bench,
+        "Run the script's CRISPY_BENCHMARK functions instead of main()", NULL
+    },
+    {
+        "bench-json", 0, 0, G_OPTION_ARG_FILENAME, &opt_bench_json,
+        "With --bench, --repeat or --profiles, also write the results as JSON to FILE (- for stdout)", "FILE"
+    },
     {
         "plugins", 'P', 0, G_OPTION_ARG_STRING, &opt_plugins,
-        "Load plugins (colon-or-comma-separated .so paths)", "PATHS"
+        "Load plugins (colon-or-comma-separated .so or .c paths)", "PATHS"
+    },
+    {
+        "plugin-warn", 0, 0, G_OPTION_ARG_DOUBLE, &opt_plugin_warn,
+        "Warn about plugins whose hooks add more than MS per run", "MS"
     },
     {
         "cache-dir", 0, 0, G_OPTION_ARG_STRING, &opt_cache_dir,
         "Override cache directory (default: ~/.cache/crispy)", "PATH"
     },
+    {
+        "cpus", 0, 0, G_OPTION_ARG_STRING, &opt_cpus,
+        "Run the script on these CPUs (e.g. 0-3,8)", "LIST"
+    },
+    {
+        "numa-node", 0, 0, G_OPTION_ARG_INT, &opt_numa_node,
+        "Run the script on the CPUs and memory of a NUMA node", "N"
+    },
+    {
+        "sched", 0, 0, G_OPTION_ARG_STRING, &opt_sched,
+        "Scheduling policy: other, batch, idle, fifo[:PRIO], rr[:PRIO]", "POLICY"
+    },
+    {
+        "allocator", 0, 0, G_OPTION_ARG_STRING, &opt_allocator,
+        "malloc replacement: mimalloc, jemalloc, tcmalloc, system or a path", "NAME"
+    },
+    {
+        "telemetry", 0, 0, G_OPTION_ARG_FILENAME, &opt_telemetry,
+        "Append one JSON line per script run to FILE", "FILE"
+    },
+    {
+        "metrics", 0, 0, G_OPTION_ARG_FILENAME, &opt_metrics,
+        "Keep phase latency histograms in FILE (OpenMetrics, e.g. for node_exporter)", "FILE"
+    },
+    {
+        "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace,
+        "Write a Chrome trace of this run to FILE (open it in Perfetto)", "FILE"
+    },
     {
         "config", 'c', 0, G_OPTION_ARG_STRING, &opt_config,
         "Explicit config file path", "PATH"
@@ -175,6 +279,390 @@ on_signal(
     return G_SOURCE_REMOVE;
 }
 
+/**
+ * run_pipeline:
+ * @n_stages: number of stage specs
+ * @specs: (array length=n_stages): one "script.c [args...]" per stage
+ * @compiler: compiler shared by every stage
+ * @cache: cache shared by every stage
+ * @flags: #CrispyFlags for every stage
+ * @extra_flags: (nullable): config flags prepended to each stage's
+ * @override_flags: (nullable): config flags appended to each stage's
+ * @engine: (nullable): plugin engine for every stage
+ * @error: return location for a #GError
+ *
+ * Builds one script per spec, each with its own argv parsed with shell
+ * quoting rules, and runs them as a single in-process pipeline.
+ *
+ * Returns: the last stage's exit code, or -1 on failure, with @error set
+ *   unless a plugin aborted
+ */
+static gint
+run_pipeline(
+    gint                  n_stages,
+    gchar               **specs,
+    CrispyCompiler       *compiler,
+    CrispyCacheProvider  *cache,
+    CrispyFlags           flags,
+    const gchar          *extra_flags,
+    const gchar          *override_flags,
+    CrispyPluginEngine   *engine,
+    GError              **error
+){
+    g_autoptr(GPtrArray) scripts = NULL;
+    g_autofree gint *argcs = NULL;
+    gchar ***argvs;
+    gint exit_code;
+    gint i;
+
+    scripts = g_ptr_array_new_with_free_func(g_object_unref);
+    argcs = g_new0(gint, n_stages);
+    argvs = g_new0(gchar **, n_stages);
+    exit_code = -1;
+
+    for (i = 0; i < n_stages; i++)
+    {
+        CrispyScript *script;
+
+        if (!g_shell_parse_argv(specs[i], &argcs[i], &argvs[i], error))
+            goto out;
+
+        script = crispy_script_new_from_file(argvs[i][0], compiler, cache,
+                                             flags, error);
+        if (script == NULL)
+            goto out;
+
+        if (extra_flags != NULL)
+            crispy_script_set_extra_flags(script, extra_flags);
+        if (override_flags != NULL)
+            crispy_script_set_override_flags(script, override_flags);
+        if (engine != NULL)
+            crispy_script_set_plugin_engine(script, engine);
+        crispy_script_set_telemetry_internal(script, opt_telemetry,
+                                             opt_metrics);
+        crispy_script_set_trace_internal(script, g_trace);
+        g_ptr_array_add(scripts, script);
+    }
+
+    exit_code = crispy_pipeline_execute((CrispyScript **)scripts->pdata,
+                                        argcs, argvs, (guint)n_stages,
+                                        error);
+
+out:
+    for (i = 0; i < n_stages; i++)
+        g_strfreev(argvs[i]);
+    g_free(argvs);
+
+    return exit_code;
+}
+
+/**
+ * repeat_script:
+ * @script: an unprepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @n_runs: number of runs
+ * @stats: (out caller-allocates): timing of the runs
+ * @exit_code: (out): the last run's exit code
+ * @error: return location for a #GError
+ *
+ * Prepares @script once and runs its main() @n_runs times.
+ *
+ * Returns: %TRUE if every run completed.  A plugin aborting the
+ *   prepare or a run fails without setting @error.
+ */
+static gboolean
+repeat_script(
+    CrispyScript      *script,
+    gint               argc,
+    gchar            **argv,
+    guint              n_runs,
+    CrispyBenchStats  *stats,
+    gint              *exit_code,
+    GError           **error
+){
+    g_autoptr(GArray) samples = NULL;
+
+    if (!crispy_script_prepare(script, argc, argv, error))
+        return FALSE;
+
+    samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+    if (!crispy_bench_repeat(script, argc, argv, n_runs, opt_repeat_fork,
+                             samples, exit_code, error))
+        return FALSE;
+
+    crispy_bench_compute_stats(samples, stats);
+    return TRUE;
+}
+
+/**
+ * write_repeat_json:
+ * @script: the script that was timed
+ * @results: (element-type CrispyBenchRunResult): runs per profile
+ * @error: return location for a #GError
+ *
+ * Writes @results to --bench-json, if given.
+ *
+ * Returns: %FALSE if the file cannot be written
+ */
+static gboolean
+write_repeat_json(
+    CrispyScript  *script,
+    GArray        *results,
+    GError       **error
+){
+    g_autofree gchar *json = NULL;
+
+    if (opt_bench_json == NULL)
+        return TRUE;
+
+    json = crispy_bench_runs_to_json(
+        crispy_script_get_source_path_internal(script), opt_repeat_fork,
+        results);
+    if (strcmp(opt_bench_json, "-") == 0)
+    {
+        g_print("%s", json);
+        return TRUE;
+    }
+
+    return g_file_set_contents(opt_bench_json, json, -1, error);
+}
+
+/**
+ * run_benchmark:
+ * @script: an unprepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @override_flags: (nullable): config flags appended to the script's
+ * @exit_code: (out): the last run's exit code
+ * @error: return location for a #GError
+ *
+ * Implements --repeat and --profiles.  Without --profiles, @script is
+ * run --repeat times and a summary of time_execute is printed to
+ * stderr.  With it, a sibling of @script is built per profile, with
+ * the profile's flags appended last, and the runs of every profile
+ * are printed side by side.  --bench-json gets the same numbers.
+ *
+ * Returns: %TRUE if every run completed.  A plugin aborting a run
+ *   fails without setting @error.
+ */
+static gboolean
+run_benchmark(
+    CrispyScript  *script,
+    gint           argc,
+    gchar        **argv,
+    const gchar   *override_flags,
+    gint          *exit_code,
+    GError       **error
+){
+    g_auto(GStrv) specs = NULL;
+    g_autoptr(GArray) results = NULL;
+    g_autoptr(GPtrArray) names = NULL;
+    CrispyBenchRunResult result;
+    gdouble baseline;
+    guint n_runs;
+    guint i;
+
+    n_runs = opt_repeat > 0 ? (guint)opt_repeat : 10;
+    results = g_array_new(FALSE, FALSE, sizeof(CrispyBenchRunResult));
+
+    if (opt_profiles == NULL)
+    {
+        if (!repeat_script(script, argc, argv, n_runs, &result.stats,
+                           exit_code, error))
+            return FALSE;
+        result.name = NULL;
+        result.exit_code = *exit_code;
+        g_array_append_val(results, result);
+
+        g_printerr("\n--- Crispy Repeat Report (%u runs%s) ---\n",
+                   result.stats.n_runs, opt_repeat_fork ? ", forked" : "");
+        g_printerr("  Min:        %.3f ms\n", result.stats.min / 1000.0);
+        g_printerr("  Median:     %.3f ms\n", result.stats.median / 1000.0);
+        g_printerr("  p95:        %.3f ms\n", result.stats.p95 / 1000.0);
+        g_printerr("  p99:        %.3f ms\n", result.stats.p99 / 1000.0);
+        g_printerr("  Mean:       %.3f ms\n", result.stats.mean / 1000.0);
+        g_printerr("  Stddev:     %.3f ms\n", result.stats.stddev / 1000.0);
+        g_printerr("----------------------------\n");
+        return write_repeat_json(script, results, error);
+    }
+
+    if (crispy_script_get_source_path_internal(script) == NULL)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PARAMS,
+                    "--profiles needs a script file");
+        return FALSE;
+    }
+
+    specs = g_strsplit(opt_profiles, ",", -1);
+    names = g_ptr_array_new_with_free_func(g_free);
+    *exit_code = 0;
+    baseline = 0.0;
+    g_printerr("\n%-10s %12s %12s %12s %12s %12s %8s\n", "profile",
+               "min ms", "median ms", "p95 ms", "p99 ms", "stddev ms",
+               "speedup");
+    for (i = 0; specs[i] != NULL; i++)
+    {
+        g_autoptr(CrispyScript) variant = NULL;
+        g_autofree gchar *flags = NULL;
+        g_autofree gchar *all_flags = NULL;
+        gchar *name;
+
+        g_strstrip(specs[i]);
+        if (specs[i][0] == '\0')
+            continue;
+        if (!crispy_bench_parse_profile(specs[i], &name, &flags, error))
+            return FALSE;
+        g_ptr_array_add(names, name);
+
+        variant = crispy_script_respawn_internal(script, 0, 0, error);
+        if (variant == NULL)
+            return FALSE;
+
+        /* the profile's flags come last, so they win */
+        all_flags = g_strjoin(" ", override_flags != NULL ? override_flags : "",
+                              flags, NULL);
+        crispy_script_set_override_flags(variant, all_flags);
+
+        if (!repeat_script(variant, argc, argv, n_runs, &result.stats,
+                           exit_code, error))
+        {
+            g_prefix_error(error, "Profile '%s': ", name);
+            return FALSE;
+        }
+        result.name = name;
+        result.exit_code = *exit_code;
+        g_array_append_val(results, result);
+
+        if (baseline == 0.0)
+            baseline = result.stats.median;
+        g_printerr("%-10s %12.3f %12.3f %12.3f %12.3f %12.3f %7.2fx\n", name,
+                   result.stats.min / 1000.0, result.stats.median / 1000.0,
+                   result.stats.p95 / 1000.0, result.stats.p99 / 1000.0,
+                   result.stats.stddev / 1000.0,
+                   result.stats.median > 0.0
+                   ? baseline / result.stats.median : 1.0);
+    }
+
+    return write_repeat_json(script, results, error);
+}
+
+/**
+ * run_microbenchmarks:
+ * @script: an unprepared #CrispyScript
+ * @argc: argument count for the script
+ * @argv: (array length=argc): argument vector for the script
+ * @placement: placement from the command line
+ * @defaults: placement from the config
+ * @error: return location for a #GError
+ *
+ * Implements --bench: loads the script, pins it, and measures every
+ * function it defines with CRISPY_BENCHMARK().  main() is not called
+ * and need not exist.  Results are printed to stdout as a table and,
+ * with --bench-json, as JSON.
+ *
+ * Returns: 0, or -1 on failure.  A plugin aborting the prepare fails
+ *   without setting @error.
+ */
+static gint
+run_microbenchmarks(
+    CrispyScript           *script,
+    gint                    argc,
+    gchar                 **argv,
+    const CrispyPlacement  *placement,
+    const CrispyPlacement  *defaults,
+    GError                **error
+){
+    g_auto(GStrv) names = NULL;
+    g_autoptr(GArray) results = NULL;
+    g_autofree gchar *symbol = NULL;
+    g_autofree gchar *cpus = NULL;
+    g_autofree gchar *json = NULL;
+    CrispyPlacement pin = CRISPY_PLACEMENT_INIT;
+    CrispyBenchmarkFunc func;
+    CrispyBenchResult result;
+    const gchar *source;
+    guint n_samples;
+    gboolean ok;
+    guint i;
+
+    source = crispy_script_get_source_internal(script);
+    names = crispy_bench_find_benchmarks(source);
+    if (names[0] == NULL)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_PARAMS,
+                    "--bench found no CRISPY_BENCHMARK() in the script");
+        return -1;
+    }
+
+    /*
+     * A script of benchmarks needs no main(), and any name found in
+     * the text may be compiled out, e.g. under #if 0: look each one up
+     * after loading instead of requiring one as the entry point.
+     */
+    crispy_script_set_entry_point_internal(script, NULL);
+    if (!crispy_script_prepare(script, argc, argv, error))
+        return -1;
+
+    crispy_placement_fill(&pin, placement->cpus, placement->numa_node,
+                          placement->sched);
+    ok = crispy_placement_fill_from_source(&pin, source, error);
+    crispy_placement_fill(&pin, defaults->cpus, defaults->numa_node,
+                          defaults->sched);
+    ok = ok && crispy_bench_pin(&pin, &cpus, error);
+    crispy_placement_clear(&pin);
+    if (!ok)
+        return -1;
+
+    n_samples = opt_repeat > 1 ? (guint)opt_repeat : 20;
+    results = g_array_new(FALSE, FALSE, sizeof(CrispyBenchResult));
+
+    g_print("%-32s %14s %12s %12s %12s\n", "benchmark", "iterations",
+            "ns/op", "95% CI +/-", "min ns/op");
+    for (i = 0; names[i] != NULL; i++)
+    {
+        g_free(symbol);
+        symbol = g_strconcat("crispy_benchmark_", names[i], NULL);
+        func = (CrispyBenchmarkFunc)crispy_script_lookup_symbol_internal(
+            script, symbol);
+        if (func == NULL)
+        {
+            g_printerr("Warning: %s() not found in the compiled script, "
+                       "skipping\n", symbol);
+            continue;
+        }
+
+        crispy_bench_measure(func, n_samples, &result);
+        result.name = names[i];
+        g_array_append_val(results, result);
+
+        g_print("%-32s %14" G_GUINT64_FORMAT " %12.3f %12.3f %12.3f\n",
+                names[i], result.iterations, result.stats.mean,
+                result.ci_high - result.stats.mean, result.stats.min);
+    }
+    crispy_script_flush_output_internal(script);
+
+    if (results->len == 0)
+    {
+        g_set_error(error, CRISPY_ERROR, CRISPY_ERROR_NO_MAIN,
+                    "--bench found no CRISPY_BENCHMARK() in the compiled "
+                    "script");
+        return -1;
+    }
+
+    if (opt_bench_json != NULL)
+    {
+        json = crispy_bench_results_to_json(
+            crispy_script_get_source_path_internal(script), cpus, results);
+        if (strcmp(opt_bench_json, "-") == 0)
+            g_print("%s", json);
+        else if (!g_file_set_contents(opt_bench_json, json, -1, error))
+            return -1;
+    }
+
+    return 0;
+}
+
 /**
  * split_argv:
  * @argc: original argument count
@@ -192,7 +680,9 @@ on_signal(
  *
  * A non-option argument is one that does not start with '-', or is
  * literally "-" (stdin mode). Options that take a value argument
- * (-i, -I, -p, -c) consume the next argv entry as well.
+ * (-i, -I, -p, -P, -c, --cache-dir, --cpus, --numa-node, --sched,
+ * --allocator, --telemetry, --metrics, --trace, --repeat, --profiles,
+ * --bench-json) consume the next argv entry as well.
  */
 static void
 split_argv(
@@ -241,7 +731,18 @@ split_argv(
             strcmp(argv[i], "--preload") == 0 ||
             strcmp(argv[i], "-P") == 0 ||
             strcmp(argv[i], "--plugins") == 0 ||
+            strcmp(argv[i], "--plugin-warn") == 0 ||
             strcmp(argv[i], "--cache-dir") == 0 ||
+            strcmp(argv[i], "--cpus") == 0 ||
+            strcmp(argv[i], "--numa-node") == 0 ||
+            strcmp(argv[i], "--sched") == 0 ||
+            strcmp(argv[i], "--allocator") == 0 ||
+            strcmp(argv[i], "--telemetry") == 0 ||
+            strcmp(argv[i], "--metrics") == 0 ||
+            strcmp(argv[i], "--trace") == 0 ||
+            strcmp(argv[i], "--repeat") == 0 ||
+            strcmp(argv[i], "--profiles") == 0 ||
+            strcmp(argv[i], "--bench-json") == 0 ||
             strcmp(argv[i], "-c") == 0 ||
             strcmp(argv[i], "--config") == 0)
         {
@@ -281,6 +782,8 @@ main(
     g_autoptr(CrispyPluginEngine) engine = NULL;
     g_autoptr(CrispyScript) script = NULL;
     CrispyConfigContext config_ctx;
+    CrispyPlacement placement = CRISPY_PLACEMENT_INIT;
+    CrispyPlacement config_placement = CRISPY_PLACEMENT_INIT;
     CrispyFlags flags;
     GModule *preloaded_lib;
     gint crispy_argc;
@@ -293,11 +796,16 @@ main(
     g_autofree gchar *config_path = NULL;
     const gchar *config_extra_flags;
     const gchar *config_override_flags;
+    gint64 t_main;
+    gint64 t_step;
 
     preloaded_lib = NULL;
     exit_code = 0;
     config_loaded = FALSE;
 
+    /* undo the LD_PRELOAD of an allocator re-exec before anything else */
+    crispy_allocator_startup();
+
     /*
      * Split argv before GOptionContext sees it. Everything after the
      * script path (first non-option arg) belongs to the script, not
@@ -405,7 +913,13 @@ main(
         return 0;
     }
 
+    /* --trace: record everything from here to exit */
+    t_main = g_get_monotonic_time();
+    if (opt_trace != NULL)
+        g_trace = crispy_trace_new();
+
     /* create compiler and cache */
+    t_step = g_get_monotonic_time();
     compiler = crispy_gcc_compiler_new(&error);
     if (compiler == NULL)
     {
@@ -413,6 +927,9 @@ main(
         g_strfreev(crispy_argv);
         return 1;
     }
+    if (g_trace != NULL)
+        crispy_trace_add_span(g_trace, "crispy", "compiler_probe", t_step,
+                              g_get_monotonic_time() - t_step, NULL);
 
     cache = crispy_file_cache_new_with_dir(opt_cache_dir);
 
@@ -449,6 +966,7 @@ main(
                 ctx_script_path);
 
             /* compile, load, and call the config's init function */
+            t_step = g_get_monotonic_time();
             if (!crispy_config_loader_compile_and_load(
                     config_path,
                     CRISPY_COMPILER(compiler),
@@ -505,6 +1023,11 @@ main(
                     }
                 }
             }
+
+            if (g_trace != NULL)
+                crispy_trace_add_span(g_trace, "crispy", "config", t_step,
+                                      g_get_monotonic_time() - t_step,
+                                      NULL);
         }
     }
 
@@ -525,6 +1048,45 @@ main(
         return 0;
     }
 
+    /*
+     * Allocator: --allocator, then the script's CRISPY_ALLOCATOR, then
+     * the config default.  Anything but the system allocator re-execs
+     * crispy with the library in LD_PRELOAD, so this comes before any
+     * plugin, preload or thread is started.  Stdin scripts cannot be
+     * read twice and only get the CLI and config choice.
+     */
+    {
+        g_autofree gchar *script_allocator = NULL;
+        const gchar *allocator;
+
+        allocator = opt_allocator;
+        if (allocator == NULL && opt_inline != NULL)
+        {
+            script_allocator = crispy_source_extract_define(
+                opt_inline, "CRISPY_ALLOCATOR");
+        }
+        else if (allocator == NULL && !opt_pipeline && !opt_repl &&
+                 script_argc > 0 && strcmp(script_argv[0], "-") != 0)
+        {
+            g_autofree gchar *contents = NULL;
+
+            if (g_file_get_contents(script_argv[0], &contents, NULL, NULL))
+                script_allocator = crispy_source_extract_define(
+                    contents, "CRISPY_ALLOCATOR");
+        }
+        if (allocator == NULL)
+            allocator = script_allocator;
+        if (allocator == NULL && config_loaded)
+            allocator = crispy_config_context_get_allocator_internal(&config_ctx);
+
+        if (!crispy_allocator_select(allocator, argv, &error))
+        {
+            g_printerr("Warning: %s; using the system allocator\n",
+                        error->message);
+            g_clear_error(&error);
+        }
+    }
+
     /* build flags bitmask: config defaults OR'd with CLI flags */
     flags = CRISPY_FLAG_NONE;
     if (config_loaded)
@@ -547,6 +1109,10 @@ main(
         flags |= CRISPY_FLAG_DRY_RUN;
     if (opt_gdb)
         flags |= CRISPY_FLAG_GDB;
+    if (opt_isolate)
+        flags |= CRISPY_FLAG_ISOLATE;
+    if (opt_hot_swap)
+        flags |= CRISPY_FLAG_HOT_SWAP;
 
     /* preload library if requested */
     if (opt_preload != NULL)
@@ -563,48 +1129,122 @@ main(
         }
     }
 
+    /*
+     * REPL mode: cells only get the config's compiler flags; plugins
+     * and script flags apply to whole scripts.
+     */
+    if (opt_repl)
+    {
+        g_autofree gchar *repl_flags = NULL;
+
+        config_extra_flags = NULL;
+        config_override_flags = NULL;
+        if (config_loaded)
+        {
+            config_extra_flags =
+                crispy_config_context_get_extra_flags_internal(&config_ctx);
+            config_override_flags =
+                crispy_config_context_get_override_flags_internal(&config_ctx);
+        }
+        repl_flags = g_strjoin(" ",
+                               config_extra_flags != NULL ? config_extra_flags : "",
+                               config_override_flags != NULL ? config_override_flags : "",
+                               NULL);
+
+        exit_code = crispy_repl_run(CRISPY_COMPILER(compiler), stdin,
+                                    opt_include, repl_flags, &error);
+        if (exit_code < 0)
+        {
+            g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        goto cleanup;
+    }
+
     /*
      * Plugin loading: config plugins first, then CLI plugins.
      * This ensures config-specified plugins run their hooks before
-     * CLI-specified plugins.
+     * CLI-specified plugins.  Plugins given as .c sources are compiled
+     * through the script cache first, all of them at once.
      */
-    if (config_loaded)
     {
-        GPtrArray *cfg_plugin_paths;
+        GArray *builds;
+        g_auto(GStrv) cli_plugin_paths = NULL;
+        guint n_config_plugins;
+        guint pi;
 
-        cfg_plugin_paths = crispy_config_context_get_plugin_paths_internal(
-            &config_ctx);
-        if (cfg_plugin_paths != NULL && cfg_plugin_paths->len > 0)
+        t_step = g_get_monotonic_time();
+        builds = g_array_new(FALSE, TRUE, sizeof(CrispyPluginBuild));
+        g_array_set_clear_func(builds,
+                               (GDestroyNotify)crispy_plugin_build_clear);
+
+        if (config_loaded)
         {
-            guint pi;
+            GPtrArray *cfg_plugin_paths;
 
-            if (engine == NULL)
-                engine = crispy_plugin_engine_new();
+            cfg_plugin_paths =
+                crispy_config_context_get_plugin_paths_internal(&config_ctx);
+            for (pi = 0; cfg_plugin_paths != NULL &&
+                         pi < cfg_plugin_paths->len; pi++)
+            {
+                CrispyPluginBuild build = { NULL, NULL, FALSE, NULL };
 
-            for (pi = 0; pi < cfg_plugin_paths->len; pi++)
+                build.path = (const gchar *)g_ptr_array_index(
+                    cfg_plugin_paths, pi);
+                g_array_append_val(builds, build);
+            }
+        }
+        n_config_plugins = builds->len;
+
+        /* CLI-specified plugins second */
+        if (opt_plugins != NULL)
+        {
+            cli_plugin_paths = g_strsplit_set(opt_plugins, ":,", -1);
+            for (pi = 0; cli_plugin_paths[pi] != NULL; pi++)
             {
-                const gchar *ppath;
+                CrispyPluginBuild build = { NULL, NULL, FALSE, NULL };
 
-                ppath = (const gchar *)g_ptr_array_index(cfg_plugin_paths, pi);
-                if (!crispy_plugin_engine_load(engine, ppath, &error))
-                {
-                    g_printerr("Warning: Config plugin '%s' failed: %s\n",
-                                ppath, error->message);
-                    g_clear_error(&error);
-                }
+                g_strstrip(cli_plugin_paths[pi]);
+                if (cli_plugin_paths[pi][0] == '\0')
+                    continue;
+
+                build.path = cli_plugin_paths[pi];
+                g_array_append_val(builds, build);
             }
         }
-    }
 
-    /* load CLI-specified plugins second */
-    if (opt_plugins != NULL)
-    {
-        if (engine == NULL)
-            engine = crispy_plugin_engine_new();
+        if (builds->len > 0)
+        {
+            if (engine == NULL)
+                engine = crispy_plugin_engine_new();
+
+            crispy_plugin_build_all((CrispyPluginBuild *)builds->data,
+                                    builds->len,
+                                    CRISPY_COMPILER(compiler),
+                                    CRISPY_CACHE_PROVIDER(cache));
+        }
 
-        if (!crispy_plugin_engine_load_paths(engine, opt_plugins, &error))
+        for (pi = 0; pi < builds->len; pi++)
         {
+            CrispyPluginBuild *build;
+
+            build = &g_array_index(builds, CrispyPluginBuild, pi);
+            if (build->error != NULL)
+                error = g_steal_pointer(&build->error);
+            else if (crispy_plugin_engine_load(engine, build->so_path,
+                                               &error))
+                continue;
+
+            if (pi < n_config_plugins)
+            {
+                g_printerr("Warning: Config plugin '%s' failed: %s\n",
+                           build->path, error->message);
+                g_clear_error(&error);
+                continue;
+            }
+
             g_printerr("Error: %s\n", error->message);
+            g_array_unref(builds);
             if (config_loaded)
                 crispy_config_context_clear_internal(&config_ctx);
             g_strfreev(crispy_argv);
@@ -612,8 +1252,18 @@ main(
                 g_module_close(preloaded_lib);
             return 1;
         }
+
+        if (g_trace != NULL && builds->len > 0)
+            crispy_trace_add_span(g_trace, "crispy", "plugins", t_step,
+                                  g_get_monotonic_time() - t_step, NULL);
+        g_array_unref(builds);
     }
 
+    if (engine != NULL && opt_plugin_warn > 0.0)
+        crispy_plugin_engine_set_cost_warning(engine, opt_plugin_warn);
+    if (engine != NULL && g_trace != NULL)
+        crispy_plugin_engine_set_trace_internal(engine, g_trace);
+
     /* inject config plugin data into the engine's shared data store */
     if (config_loaded && engine != NULL)
     {
@@ -638,10 +1288,98 @@ main(
         }
     }
 
+    /*
+     * placement: the CLI, then the script's own, then the config, as
+     * for the allocator.  The script's are only known once it is read.
+     */
+    crispy_placement_fill(&placement, opt_cpus, opt_numa_node, opt_sched);
+    if (config_loaded)
+    {
+        const gchar *cfg_cpus;
+        const gchar *cfg_sched;
+        gint cfg_numa_node;
+
+        crispy_config_context_get_placement_internal(
+            &config_ctx, &cfg_cpus, &cfg_numa_node, &cfg_sched);
+        crispy_placement_fill(&config_placement, cfg_cpus, cfg_numa_node,
+                              cfg_sched);
+    }
+
+    /* telemetry: CLI first, then config */
+    if (config_loaded)
+    {
+        const gchar *cfg_log;
+        const gchar *cfg_metrics;
+
+        crispy_config_context_get_telemetry_internal(&config_ctx, &cfg_log,
+                                                     &cfg_metrics);
+        if (opt_telemetry == NULL)
+            opt_telemetry = g_strdup(cfg_log);
+        if (opt_metrics == NULL)
+            opt_metrics = g_strdup(cfg_metrics);
+    }
+
     /* set up signal handlers for cleanup */
     g_unix_signal_add(SIGINT, on_signal, NULL);
     g_unix_signal_add(SIGTERM, on_signal, NULL);
 
+    /*
+     * Pipeline mode: every positional argument is a stage, quoted with
+     * its own arguments, e.g. `crispy --pipeline a.c 'b.c -n 3' c.c`.
+     */
+    if (opt_pipeline)
+    {
+        if (opt_inline != NULL || opt_watch || opt_hot_swap || opt_isolate)
+        {
+            g_printerr("Error: --pipeline cannot be combined with --inline, "
+                        "--watch, --hot-swap or --isolate.\n");
+            exit_code = 1;
+            goto cleanup;
+        }
+        if (script_argc == 0)
+        {
+            g_printerr("Error: No pipeline stages specified.\n"
+                        "Try 'crispy --help' for usage information.\n");
+            exit_code = 1;
+            goto cleanup;
+        }
+
+        config_extra_flags = NULL;
+        config_override_flags = NULL;
+        if (config_loaded)
+        {
+            config_extra_flags =
+                crispy_config_context_get_extra_flags_internal(&config_ctx);
+            config_override_flags =
+                crispy_config_context_get_override_flags_internal(&config_ctx);
+        }
+
+        /* stage threads inherit the placement of this one */
+        crispy_placement_fill(&placement, config_placement.cpus,
+                              config_placement.numa_node,
+                              config_placement.sched);
+        if (crispy_placement_is_set(&placement) &&
+            !crispy_placement_apply(&placement, NULL, &error))
+        {
+            g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+            goto cleanup;
+        }
+
+        exit_code = run_pipeline(script_argc, script_argv,
+                                 CRISPY_COMPILER(compiler),
+                                 CRISPY_CACHE_PROVIDER(cache),
+                                 flags, config_extra_flags,
+                                 config_override_flags, engine, &error);
+        if (exit_code < 0)
+        {
+            if (error != NULL)
+                g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        goto cleanup;
+    }
+
     /* determine mode and create script */
     is_stdin = (script_argc > 0 && strcmp(script_argv[0], "-") == 0);
 
@@ -711,9 +1449,73 @@ main(
     if (engine != NULL)
         crispy_script_set_plugin_engine(script, engine);
 
+    crispy_script_set_placement_internal(script, &placement,
+                                         &config_placement);
+    crispy_script_set_telemetry_internal(script, opt_telemetry, opt_metrics);
+    crispy_script_set_trace_internal(script, g_trace);
+
     /* track temp source path for signal cleanup */
     g_temp_source_path = g_strdup(crispy_script_get_temp_source_path(script));
 
+    /* --bench: measure CRISPY_BENCHMARK() functions instead of main() */
+    if (opt_bench)
+    {
+        if (opt_watch || opt_hot_swap || opt_gdb || opt_dry_run ||
+            opt_profiles != NULL || opt_repeat_fork)
+        {
+            g_printerr("Error: --bench cannot be combined with --watch, "
+                        "--hot-swap, --gdb, --dry-run, --profiles or "
+                        "--repeat-fork.\n");
+            exit_code = 1;
+            goto cleanup;
+        }
+
+        exit_code = run_microbenchmarks(script, script_argc, script_argv,
+                                        &placement, &config_placement,
+                                        &error);
+        if (exit_code < 0)
+        {
+            if (error != NULL)
+                g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        goto cleanup;
+    }
+
+    /* --repeat / --profiles: time many runs instead of one */
+    if (opt_repeat > 0 || opt_profiles != NULL)
+    {
+        if (opt_watch || opt_hot_swap || opt_gdb || opt_dry_run)
+        {
+            g_printerr("Error: --repeat and --profiles cannot be combined with "
+                        "--watch, --hot-swap, --gdb or --dry-run.\n");
+            exit_code = 1;
+            goto cleanup;
+        }
+
+        if (!run_benchmark(script, script_argc, script_argv,
+                           config_loaded ? config_override_flags : NULL,
+                           &exit_code, &error))
+        {
+            if (error != NULL)
+                g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        goto cleanup;
+    }
+
+    /* watch mode: rerun in a child on every change until interrupted */
+    if (opt_watch)
+    {
+        exit_code = crispy_watch_run(script, script_argc, script_argv, &error);
+        if (exit_code < 0)
+        {
+            g_printerr("Error: %s\n", error->message);
+            exit_code = 1;
+        }
+        goto cleanup;
+    }
+
     /* execute the script */
     exit_code = crispy_script_execute(script, script_argc, script_argv, &error);
     if (exit_code < 0 && error != NULL)
@@ -730,8 +1532,21 @@ main(
     }
 
 cleanup:
+    if (g_trace != NULL)
+    {
+        g_autoptr(GError) trace_error = NULL;
+
+        crispy_trace_add_span(g_trace, "crispy", "crispy", t_main,
+                              g_get_monotonic_time() - t_main, NULL);
+        if (!crispy_trace_write(g_trace, opt_trace, &trace_error))
+            g_printerr("Warning: %s\n", trace_error->message);
+        g_clear_pointer(&g_trace, crispy_trace_unref);
+    }
+
     if (config_loaded)
         crispy_config_context_clear_internal(&config_ctx);
+    crispy_placement_clear(&placement);
+    crispy_placement_clear(&config_placement);
 
     if (preloaded_lib != NULL)
         g_module_close(preloaded_lib);
@@ -745,6 +1560,14 @@ cleanup:
     g_free(opt_preload);
     g_free(opt_plugins);
     g_free(opt_cache_dir);
+    g_free(opt_cpus);
+    g_free(opt_sched);
+    g_free(opt_allocator);
+    g_free(opt_telemetry);
+    g_free(opt_metrics);
+    g_free(opt_trace);
+    g_free(opt_profiles);
+    g_free(opt_bench_json);
     g_free(opt_config);
 
     return exit_code;
@@ -0,0 +1,290 @@
+/* crispy-arena.c - Bump allocator for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-arena.h"
+
+#include <glib.h>
+#include <string.h>
+
+/*
+ * Every allocation is rounded up to CRISPY_ARENA_ALIGN bytes so that
+ * the result is suitably aligned for any scalar or SSE type.  Chunk
+ * headers are padded to the same alignment.
+ */
+#define CRISPY_ARENA_ALIGN     (16)
+#define ALIGN_UP(n)            (((n) + (CRISPY_ARENA_ALIGN - 1)) & ~((gsize)CRISPY_ARENA_ALIGN - 1))
+
+typedef struct _CrispyArenaChunk CrispyArenaChunk;
+
+struct _CrispyArenaChunk
+{
+    CrispyArenaChunk *next;
+    guint8           *data;   /* right after the header, or a region */
+    gsize             size;   /* usable bytes at data */
+    gsize             used;
+};
+
+#define CHUNK_HEADER_SIZE      ALIGN_UP(sizeof(CrispyArenaChunk))
+#define CHUNK_DATA(chunk)      ((chunk)->data)
+
+struct _CrispyArena
+{
+    CrispyArenaChunk *head;       /* chunk currently being filled */
+    gsize             chunk_size;
+    gsize             used;       /* bytes handed out */
+    gboolean          fixed;      /* single caller-owned region */
+};
+
+static CrispyArena *default_arena = NULL;
+
+/* --- helper: allocate a chunk with @size usable bytes --- */
+static CrispyArenaChunk *
+chunk_new(
+    gsize size
+){
+    CrispyArenaChunk *chunk;
+
+    chunk = (CrispyArenaChunk *)g_malloc(CHUNK_HEADER_SIZE + size);
+    chunk->next = NULL;
+    chunk->data = (guint8 *)chunk + CHUNK_HEADER_SIZE;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+static CrispyArena *
+resolve_arena(
+    CrispyArena *arena
+){
+    return arena != NULL ? arena : crispy_arena_default();
+}
+
+/* --- public API --- */
+
+CrispyArena *
+crispy_arena_new(
+    gsize chunk_size
+){
+    CrispyArena *arena;
+
+    arena = g_new0(CrispyArena, 1);
+    arena->chunk_size = chunk_size > 0
+        ? ALIGN_UP(chunk_size)
+        : CRISPY_ARENA_DEFAULT_CHUNK_SIZE;
+
+    return arena;
+}
+
+CrispyArena *
+crispy_arena_new_for_region(
+    gpointer region,
+    gsize    size
+){
+    CrispyArena *arena;
+    CrispyArenaChunk *chunk;
+
+    g_return_val_if_fail(region != NULL, NULL);
+    g_return_val_if_fail(((guintptr)region & (CRISPY_ARENA_ALIGN - 1)) == 0, NULL);
+
+    /* the header lives outside the region, so the region is all data */
+    chunk = g_new0(CrispyArenaChunk, 1);
+    chunk->data = (guint8 *)region;
+    chunk->size = size & ~((gsize)CRISPY_ARENA_ALIGN - 1);
+
+    arena = g_new0(CrispyArena, 1);
+    arena->head = chunk;
+    arena->chunk_size = chunk->size;
+    arena->fixed = TRUE;
+
+    return arena;
+}
+
+CrispyArena *
+crispy_arena_default(void)
+{
+    if (g_once_init_enter(&default_arena))
+        g_once_init_leave(&default_arena, crispy_arena_new(0));
+
+    return default_arena;
+}
+
+gpointer
+crispy_arena_alloc(
+    CrispyArena *arena,
+    gsize        size
+){
+    CrispyArenaChunk *chunk;
+    gsize aligned;
+    gpointer mem;
+
+    arena = resolve_arena(arena);
+    aligned = ALIGN_UP(size > 0 ? size : 1);
+
+    /* fast path: bump within the current chunk */
+    chunk = arena->head;
+    if (chunk != NULL && chunk->size - chunk->used >= aligned)
+    {
+        mem = CHUNK_DATA(chunk) + chunk->used;
+        chunk->used += aligned;
+        arena->used += aligned;
+        return mem;
+    }
+
+    if (arena->fixed)
+        g_error("CrispyArena: region of %" G_GSIZE_FORMAT " bytes exhausted",
+                arena->chunk_size);
+
+    /*
+     * Large requests get a dedicated chunk linked behind the current
+     * one, so the partially filled chunk stays available for the
+     * small allocations that follow.
+     */
+    if (aligned > arena->chunk_size / 4)
+    {
+        chunk = chunk_new(aligned);
+        chunk->used = aligned;
+        if (arena->head != NULL)
+        {
+            chunk->next = arena->head->next;
+            arena->head->next = chunk;
+        }
+        else
+        {
+            arena->head = chunk;
+        }
+        arena->used += aligned;
+        return CHUNK_DATA(chunk);
+    }
+
+    chunk = chunk_new(arena->chunk_size);
+    chunk->next = arena->head;
+    arena->head = chunk;
+
+    mem = CHUNK_DATA(chunk);
+    chunk->used = aligned;
+    arena->used += aligned;
+
+    return mem;
+}
+
+gpointer
+crispy_arena_alloc0(
+    CrispyArena *arena,
+    gsize        size
+){
+    gpointer mem;
+
+    mem = crispy_arena_alloc(arena, size);
+    memset(mem, 0, size);
+
+    return mem;
+}
+
+gchar *
+crispy_arena_strndup(
+    CrispyArena *arena,
+    const gchar *str,
+    gsize        n
+){
+    gchar *copy;
+    gsize len;
+
+    if (str == NULL)
+        return NULL;
+
+    len = 0;
+    while (len < n && str[len] != '\0')
+        len++;
+
+    copy = (gchar *)crispy_arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    return copy;
+}
+
+gchar *
+crispy_arena_strdup(
+    CrispyArena *arena,
+    const gchar *str
+){
+    if (str == NULL)
+        return NULL;
+
+    return crispy_arena_strndup(arena, str, strlen(str));
+}
+
+gsize
+crispy_arena_get_used(
+    CrispyArena *arena
+){
+    return resolve_arena(arena)->used;
+}
+
+void
+crispy_arena_reset(
+    CrispyArena *arena
+){
+    CrispyArenaChunk *chunk;
+    CrispyArenaChunk *next;
+    CrispyArenaChunk *keep;
+
+    arena = resolve_arena(arena);
+
+    /* keep one regular-sized chunk around for reuse */
+    keep = NULL;
+    for (chunk = arena->head; chunk != NULL; chunk = next)
+    {
+        next = chunk->next;
+        if (keep == NULL && chunk->size == arena->chunk_size)
+        {
+            keep = chunk;
+            continue;
+        }
+        g_free(chunk);
+    }
+
+    if (keep != NULL)
+    {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+
+    arena->head = keep;
+    arena->used = 0;
+}
+
+void
+crispy_arena_free(
+    CrispyArena *arena
+){
+    CrispyArenaChunk *chunk;
+    CrispyArenaChunk *next;
+
+    if (arena == NULL || arena == default_arena)
+        return;
+
+    for (chunk = arena->head; chunk != NULL; chunk = next)
+    {
+        next = chunk->next;
+        g_free(chunk);
+    }
+
+    g_free(arena);
+}
+
+/*
+ * Release the default arena when libcrispy-runtime is unloaded,
+ * which happens when crispy closes the script module or the process
+ * exits, whichever comes first.
+ */
+static void __attribute__((destructor))
+release_default_arena(void)
+{
+    CrispyArena *arena;
+
+    arena = default_arena;
+    default_arena = NULL;
+    crispy_arena_free(arena);
+}
@@ -0,0 +1,166 @@
+/* crispy-arena.h - Bump allocator for crispy scripts */
+
+#ifndef CRISPY_ARENA_H
+#define CRISPY_ARENA_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyArena:
+ *
+ * An opaque bump allocator.  Allocations are carved sequentially out
+ * of large chunks and are never freed individually; the whole arena is
+ * released at once with crispy_arena_reset() or crispy_arena_free().
+ *
+ * An arena is not thread-safe.  Use one arena per thread.
+ */
+typedef struct _CrispyArena CrispyArena;
+
+/**
+ * CRISPY_ARENA_DEFAULT_CHUNK_SIZE:
+ *
+ * Chunk size used when crispy_arena_new() is given 0.
+ */
+#define CRISPY_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+/**
+ * crispy_arena_new:
+ * @chunk_size: size in bytes of each backing chunk, or 0 for
+ *              %CRISPY_ARENA_DEFAULT_CHUNK_SIZE
+ *
+ * Creates a new, empty arena.  Memory is requested from the system in
+ * blocks of @chunk_size bytes; requests larger than a quarter of the
+ * chunk size get a dedicated block.
+ *
+ * Returns: (transfer full): a new #CrispyArena
+ */
+CrispyArena *crispy_arena_new      (gsize chunk_size);
+
+/**
+ * crispy_arena_new_for_region:
+ * @region: start of caller-owned memory, aligned to 16 bytes
+ * @size: size of @region in bytes
+ *
+ * Creates an arena that allocates only from @region, in order from
+ * its start, so that the first crispy_arena_get_used() bytes of
+ * @region hold everything allocated.  Running out of @region aborts.
+ * Freeing the arena leaves @region untouched.
+ *
+ * Returns: (transfer full): a new #CrispyArena
+ */
+CrispyArena *crispy_arena_new_for_region (gpointer region,
+                                          gsize    size);
+
+/**
+ * crispy_arena_default:
+ *
+ * Returns the script-wide arena.  It is created on first use and
+ * released automatically when the script's module is unloaded or the
+ * process exits, so scripts never need to free it.
+ *
+ * Returns: (transfer none): the default #CrispyArena
+ */
+CrispyArena *crispy_arena_default  (void);
+
+/**
+ * crispy_arena_alloc:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ * @size: number of bytes to allocate
+ *
+ * Allocates @size bytes aligned to 16 bytes.  The memory is
+ * uninitialized.  Aborts on out-of-memory like g_malloc().
+ *
+ * Returns: (transfer none): the allocated memory, owned by @arena
+ */
+gpointer     crispy_arena_alloc    (CrispyArena *arena,
+                                    gsize        size);
+
+/**
+ * crispy_arena_alloc0:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ * @size: number of bytes to allocate
+ *
+ * Like crispy_arena_alloc() but zero-fills the memory.
+ *
+ * Returns: (transfer none): the allocated memory, owned by @arena
+ */
+gpointer     crispy_arena_alloc0   (CrispyArena *arena,
+                                    gsize        size);
+
+/**
+ * crispy_arena_new_n:
+ * @arena: (nullable): a #CrispyArena, or %NULL for the default arena
+ * @struct_type: the type of the elements to allocate
+ * @n_structs: the number of elements to allocate
+ *
+ * Typed, zero-filled allocation of @n_structs elements from @arena,
+ * analogous to g_new0().
+ */
+#define crispy_arena_new_n(arena, struct_type, n_structs) \
+    ((struct_type *)crispy_arena_alloc0((arena), sizeof(struct_type) * (gsize)(n_structs)))
+
+/**
+ * crispy_arena_strdup:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ * @str: (nullable): the string to copy
+ *
+ * Copies @str into @arena.
+ *
+ * Returns: (transfer none) (nullable): the copy, or %NULL if @str is %NULL
+ */
+gchar       *crispy_arena_strdup   (CrispyArena *arena,
+                                    const gchar *str);
+
+/**
+ * crispy_arena_strndup:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ * @str: (nullable): the string to copy
+ * @n: maximum number of bytes to copy
+ *
+ * Copies at most @n bytes of @str into @arena and nul-terminates the
+ * result.
+ *
+ * Returns: (transfer none) (nullable): the copy, or %NULL if @str is %NULL
+ */
+gchar       *crispy_arena_strndup  (CrispyArena *arena,
+                                    const gchar *str,
+                                    gsize        n);
+
+/**
+ * crispy_arena_get_used:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ *
+ * Returns: the number of bytes handed out since creation or the last
+ *          crispy_arena_reset()
+ */
+gsize        crispy_arena_get_used (CrispyArena *arena);
+
+/**
+ * crispy_arena_reset:
+ * @arena: (nullable): a #CrispyArena, or %NULL for crispy_arena_default()
+ *
+ * Invalidates every allocation made from @arena.  The first chunk is
+ * kept for reuse; any additional chunks are returned to the system.
+ */
+void         crispy_arena_reset    (CrispyArena *arena);
+
+/**
+ * crispy_arena_free:
+ * @arena: (nullable): a #CrispyArena
+ *
+ * Releases @arena and all memory allocated from it.  Passing the
+ * default arena is a no-op; it is released at script exit.
+ */
+void         crispy_arena_free     (CrispyArena *arena);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyArena, crispy_arena_free)
+
+G_END_DECLS
+
+#endif /* CRISPY_ARENA_H */
@@ -0,0 +1,61 @@
+/* crispy-bench.h - Function-level benchmarks run by crispy --bench */
+
+#ifndef CRISPY_BENCH_H
+#define CRISPY_BENCH_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_BENCHMARK:
+ * @name: benchmark name, a C identifier
+ * @n: name of the iteration count parameter
+ *
+ * Defines a benchmark that `crispy --bench script.c` runs instead of
+ * main().  The body must run the code under test @n times; crispy
+ * picks @n so that one sample takes about 10 ms:
+ * |[<!-- language="C" -->
+ * CRISPY_BENCHMARK(parse_line, n)
+ * {
+ *     guint64 i;
+ *
+ *     for (i = 0; i < n; i++)
+ *         CRISPY_BENCH_KEEP(parse_line("key=value"));
+ * }
+ * ]|
+ *
+ * The macro defines the exported function `crispy_benchmark_<name>`,
+ * which crispy looks up in the loaded module.  It must be used at the
+ * start of a line at file scope.
+ */
+#define CRISPY_BENCHMARK(name, n) \
+    void crispy_benchmark_##name (guint64 n); \
+    void crispy_benchmark_##name (guint64 n)
+
+/**
+ * CRISPY_BENCH_KEEP:
+ * @value: a scalar or pointer value
+ *
+ * Makes the compiler believe @value is used, so the computation that
+ * produced it is not optimized away.
+ */
+#define CRISPY_BENCH_KEEP(value) \
+    __asm__ __volatile__ ("" : : "r,m" (value) : "memory")
+
+/**
+ * CRISPY_BENCH_CLOBBER:
+ *
+ * Makes the compiler believe all memory was read and written, so
+ * stores to buffers nothing reads are kept.
+ */
+#define CRISPY_BENCH_CLOBBER() \
+    __asm__ __volatile__ ("" : : : "memory")
+
+G_END_DECLS
+
+#endif /* CRISPY_BENCH_H */
@@ -0,0 +1,785 @@
+/* crispy-file-batch.c - Batched whole-file reads for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-file-batch.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Design
+ *
+ * Every queued path becomes a request that is opened, fstat()ed and
+ * read into a buffer sized from st_size.  Files that report no size
+ * (procfs, pipes) are read in growing chunks until EOF.
+ *
+ * io_uring backend: OPENAT and READ are ring operations; up to
+ * queue_depth requests are in flight, each with at most one SQE
+ * outstanding, so one io_uring_enter() both submits the next steps of
+ * every request and reaps finished ones.  The ring is driven entirely
+ * from the calling thread, which is also where callbacks run.
+ *
+ * Thread backend: requests are pushed to a GThreadPool that performs
+ * the same open/fstat/read sequence with blocking calls and hands the
+ * finished request back through a GAsyncQueue, so callbacks still run
+ * on the calling thread.
+ *
+ * If io_uring_enter() fails for good mid-run, the ring is torn down
+ * and the unfinished requests are redone on the thread backend.  The
+ * kernel may still be writing into the buffers of requests that were
+ * in flight, so those buffers are abandoned rather than freed.
+ */
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#ifdef IO_URING_OP_SUPPORTED
+#define CRISPY_HAVE_IO_URING 1
+#endif
+#endif
+
+#define CRISPY_FILE_BATCH_CHUNK       (4096)
+#define CRISPY_FILE_BATCH_MAX_THREADS (16)
+#define CRISPY_FILE_BATCH_MAX_READ    (1U << 30)
+
+typedef struct
+{
+    gchar          *path;
+    CrispyReadFunc  callback;
+    gpointer        user_data;
+
+    gint            fd;
+    gchar          *data;
+    gsize           length;
+    gsize           capacity;
+    gboolean        size_known;   /* capacity is the file's st_size */
+    gboolean        done;
+    GError         *error;
+} CrispyFileRequest;
+
+#ifdef CRISPY_HAVE_IO_URING
+typedef struct
+{
+    gint                  fd;
+    guint                 entries;
+
+    guint                *sq_head;
+    guint                *sq_tail;
+    guint                *sq_mask;
+    guint                *sq_array;
+    guint                 sqe_tail;   /* local tail, published on enter */
+    struct io_uring_sqe  *sqes;
+
+    guint                *cq_head;
+    guint                *cq_tail;
+    guint                *cq_mask;
+    struct io_uring_cqe  *cqes;
+
+    gpointer              sq_map;
+    gsize                 sq_map_len;
+    gpointer              cq_map;
+    gsize                 cq_map_len;
+    gsize                 sqes_len;
+} CrispyRing;
+#endif
+
+struct _CrispyFileBatch
+{
+    GPtrArray    *requests;
+    guint         depth;
+
+#ifdef CRISPY_HAVE_IO_URING
+    CrispyRing   *ring;
+#endif
+    GThreadPool  *pool;
+    GAsyncQueue  *done;
+};
+
+/* --- requests --- */
+
+static void
+request_free(
+    gpointer data
+){
+    CrispyFileRequest *req;
+
+    req = data;
+    if (req->fd >= 0)
+        close(req->fd);
+    g_free(req->path);
+    g_free(req->data);
+    g_clear_error(&req->error);
+    g_free(req);
+}
+
+static void
+request_set_errno(
+    CrispyFileRequest *req,
+    const gchar       *what,
+    gint               errnum
+){
+    g_clear_error(&req->error);
+    g_set_error(&req->error,
+                G_FILE_ERROR,
+                g_file_error_from_errno(errnum),
+                "Failed to %s '%s': %s",
+                what, req->path, g_strerror(errnum));
+}
+
+/* size the buffer once the file is open; FALSE (with error) on failure */
+static gboolean
+request_opened(
+    CrispyFileRequest *req,
+    gint               fd
+){
+    struct stat st;
+
+    req->fd = fd;
+
+    if (fstat(fd, &st) < 0)
+    {
+        request_set_errno(req, "stat", errno);
+        return FALSE;
+    }
+
+    req->size_known = S_ISREG(st.st_mode) && st.st_size > 0;
+    req->capacity = req->size_known ? (gsize)st.st_size
+                                    : CRISPY_FILE_BATCH_CHUNK;
+    req->data = g_malloc(req->capacity + 1);
+    req->length = 0;
+
+    return TRUE;
+}
+
+/* account for a successful read of @n bytes; TRUE once the file is done */
+static gboolean
+request_consume(
+    CrispyFileRequest *req,
+    gsize              n
+){
+    if (n == 0)
+        return TRUE;
+
+    req->length += n;
+
+    /* the size from fstat() is trusted; growth after open is not read */
+    if (req->size_known && req->length >= req->capacity)
+        return TRUE;
+
+    if (req->length == req->capacity)
+    {
+        req->capacity *= 2;
+        req->data = g_realloc(req->data, req->capacity + 1);
+    }
+
+    return FALSE;
+}
+
+/* close the file and deliver the result; returns 1 if it failed */
+static guint
+request_finish(
+    CrispyFileRequest *req
+){
+    guint failed;
+
+    if (req->fd >= 0)
+    {
+        close(req->fd);
+        req->fd = -1;
+    }
+
+    req->done = TRUE;
+
+    if (req->error != NULL)
+    {
+        req->callback(req->path, NULL, 0, req->error, req->user_data);
+        failed = 1;
+    }
+    else
+    {
+        req->data[req->length] = '\0';
+        req->callback(req->path, req->data, req->length, NULL,
+                      req->user_data);
+        failed = 0;
+    }
+
+    /* release the contents now rather than when the batch is cleared */
+    g_clear_pointer(&req->data, g_free);
+    g_clear_error(&req->error);
+
+    return failed;
+}
+
+/* --- thread backend --- */
+
+static void
+read_blocking(
+    CrispyFileRequest *req
+){
+    gssize n;
+    gint fd;
+
+    fd = g_open(req->path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        request_set_errno(req, "open", errno);
+        return;
+    }
+
+    if (!request_opened(req, fd))
+        return;
+
+    for (;;)
+    {
+        n = read(fd, req->data + req->length,
+                 MIN(req->capacity - req->length, CRISPY_FILE_BATCH_MAX_READ));
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            request_set_errno(req, "read", errno);
+            return;
+        }
+        if (request_consume(req, (gsize)n))
+            return;
+    }
+}
+
+static void
+thread_read(
+    gpointer data,
+    gpointer user_data
+){
+    CrispyFileBatch *batch;
+
+    batch = user_data;
+    read_blocking(data);
+    g_async_queue_push(batch->done, data);
+}
+
+static void
+start_threads(
+    CrispyFileBatch *batch
+){
+    batch->done = g_async_queue_new();
+    batch->pool = g_thread_pool_new(thread_read, batch,
+                                    (gint)MIN(batch->depth,
+                                              CRISPY_FILE_BATCH_MAX_THREADS),
+                                    FALSE, NULL);
+}
+
+/* requests already done (by a failed ring run) are skipped */
+static guint
+run_threads(
+    CrispyFileBatch *batch
+){
+    CrispyFileRequest *req;
+    guint pushed;
+    guint completed;
+    guint failed;
+
+    pushed = 0;
+    completed = 0;
+    failed = 0;
+
+    /* callbacks may queue more files, so re-check the length each time */
+    for (;;)
+    {
+        while (pushed < batch->requests->len)
+        {
+            req = g_ptr_array_index(batch->requests, pushed++);
+            if (req->done)
+                completed++;
+            else
+                g_thread_pool_push(batch->pool, req, NULL);
+        }
+
+        if (completed == batch->requests->len)
+            break;
+
+        req = g_async_queue_pop(batch->done);
+        failed += request_finish(req);
+        completed++;
+    }
+
+    return failed;
+}
+
+/* --- io_uring backend --- */
+
+#ifdef CRISPY_HAVE_IO_URING
+
+static gint
+ring_enter(
+    CrispyRing *ring,
+    guint       min_complete
+){
+    guint to_submit;
+    glong ret;
+
+    /* publish the SQEs prepared since the last call */
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                  min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+    return ret < 0 ? -errno : (gint)ret;
+}
+
+static struct io_uring_sqe *
+ring_get_sqe(
+    CrispyRing *ring
+){
+    struct io_uring_sqe *sqe;
+    guint index;
+
+    if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+        >= ring->entries)
+    {
+        /* cannot happen while each request has one SQE outstanding */
+        if (ring_enter(ring, 0) < 0)
+            return NULL;
+        if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+            >= ring->entries)
+            return NULL;
+    }
+
+    index = ring->sqe_tail & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+static void
+ring_free(
+    CrispyRing *ring
+){
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_map != NULL && ring->cq_map != MAP_FAILED &&
+        ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_len);
+    if (ring->sq_map != NULL && ring->sq_map != MAP_FAILED)
+        munmap(ring->sq_map, ring->sq_map_len);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    g_free(ring);
+}
+
+/* the ring is only usable if the kernel knows OPENAT and READ */
+static gboolean
+ring_probe(
+    CrispyRing *ring
+){
+    struct io_uring_probe *probe;
+    gboolean ok;
+    gsize size;
+
+    size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    probe = g_malloc0(size);
+
+    ok = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+                 probe, 256) >= 0 &&
+         probe->last_op >= IORING_OP_READ &&
+         (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+         (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+
+    g_free(probe);
+    return ok;
+}
+
+static CrispyRing *
+ring_new(
+    guint entries
+){
+    struct io_uring_params params;
+    CrispyRing *ring;
+    guint8 *sq;
+    guint8 *cq;
+
+    ring = g_new0(CrispyRing, 1);
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (gint)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+    {
+        g_free(ring);
+        return NULL;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_map_len = params.sq_off.array + params.sq_entries * sizeof(guint);
+    ring->cq_map_len = params.cq_off.cqes +
+                       params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sq_map_len = MAX(ring->sq_map_len, ring->cq_map_len);
+        ring->cq_map_len = ring->sq_map_len;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED)
+        goto fail;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cq_map = ring->sq_map;
+    else
+    {
+        ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED)
+            goto fail;
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+
+    sq = ring->sq_map;
+    ring->sq_head = (guint *)(sq + params.sq_off.head);
+    ring->sq_tail = (guint *)(sq + params.sq_off.tail);
+    ring->sq_mask = (guint *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (guint *)(sq + params.sq_off.array);
+    ring->sqe_tail = *ring->sq_tail;
+
+    cq = ring->cq_map;
+    ring->cq_head = (guint *)(cq + params.cq_off.head);
+    ring->cq_tail = (guint *)(cq + params.cq_off.tail);
+    ring->cq_mask = (guint *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    if (!ring_probe(ring))
+        goto fail;
+
+    return ring;
+
+fail:
+    ring_free(ring);
+    return NULL;
+}
+
+/*
+ * The ring failed for good: drop it and reset the first @next
+ * requests that have not finished so the thread backend starts them
+ * over.  Their SQEs may still be running, so the buffers the kernel
+ * could write into are leaked, not freed.  An OPENAT in flight may
+ * also leak the descriptor it returns.
+ */
+static void
+ring_abandon(
+    CrispyFileBatch *batch,
+    guint            next
+){
+    CrispyFileRequest *req;
+    guint i;
+
+    ring_free(batch->ring);
+    batch->ring = NULL;
+
+    for (i = 0; i < next; i++)
+    {
+        req = g_ptr_array_index(batch->requests, i);
+        if (req->done)
+            continue;
+
+        /* a read in flight holds its own reference to the file */
+        if (req->fd >= 0)
+        {
+            close(req->fd);
+            req->fd = -1;
+        }
+        req->data = NULL;
+        req->length = 0;
+        req->capacity = 0;
+        req->size_known = FALSE;
+        g_clear_error(&req->error);
+    }
+
+    start_threads(batch);
+}
+
+static gboolean
+ring_prep_open(
+    CrispyRing        *ring,
+    CrispyFileRequest *req
+){
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe(ring);
+    if (sqe == NULL)
+        return FALSE;
+
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (guint64)(guintptr)req->path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = (guint64)(guintptr)req;
+
+    return TRUE;
+}
+
+static gboolean
+ring_prep_read(
+    CrispyRing        *ring,
+    CrispyFileRequest *req
+){
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe(ring);
+    if (sqe == NULL)
+        return FALSE;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = req->fd;
+    sqe->addr = (guint64)(guintptr)(req->data + req->length);
+    sqe->len = (guint)MIN(req->capacity - req->length,
+                          CRISPY_FILE_BATCH_MAX_READ);
+    sqe->off = req->length;
+    sqe->user_data = (guint64)(guintptr)req;
+
+    return TRUE;
+}
+
+/* advance @req after a completion; TRUE once it is ready to finish */
+static gboolean
+ring_complete(
+    CrispyRing        *ring,
+    CrispyFileRequest *req,
+    gint               res
+){
+    if (req->fd < 0)
+    {
+        /* OPENAT completed */
+        if (res < 0)
+        {
+            request_set_errno(req, "open", -res);
+            return TRUE;
+        }
+        if (!request_opened(req, res))
+            return TRUE;
+    }
+    else if (res < 0)
+    {
+        if (res != -EINTR && res != -EAGAIN)
+        {
+            request_set_errno(req, "read", -res);
+            return TRUE;
+        }
+    }
+    else if (request_consume(req, (gsize)res))
+        return TRUE;
+
+    if (!ring_prep_read(ring, req))
+    {
+        request_set_errno(req, "read", EBUSY);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* FALSE if the ring failed before every request finished */
+static gboolean
+run_ring(
+    CrispyFileBatch *batch,
+    guint           *failed
+){
+    CrispyRing *ring;
+    CrispyFileRequest *req;
+    struct io_uring_cqe *cqe;
+    guint next;
+    guint active;
+    guint completed;
+    guint head;
+    gint res;
+    gint ret;
+
+    ring = batch->ring;
+    next = 0;
+    active = 0;
+    completed = 0;
+
+    while (completed < batch->requests->len)
+    {
+        /* top up to the queue depth with new opens */
+        while (next < batch->requests->len && active < batch->depth)
+        {
+            req = g_ptr_array_index(batch->requests, next);
+            if (!ring_prep_open(ring, req))
+                break;
+            next++;
+            active++;
+        }
+
+        ret = ring_enter(ring, 1);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY)
+        {
+            ring_abandon(batch, next);
+            return FALSE;
+        }
+
+        head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            cqe = &ring->cqes[head & *ring->cq_mask];
+            req = (CrispyFileRequest *)(guintptr)cqe->user_data;
+            res = cqe->res;
+
+            head++;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+            if (ring_complete(ring, req, res))
+            {
+                *failed += request_finish(req);
+                active--;
+                completed++;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+#endif /* CRISPY_HAVE_IO_URING */
+
+/* --- public API --- */
+
+CrispyFileBatch *
+crispy_file_batch_new(
+    guint queue_depth
+){
+    CrispyFileBatch *batch;
+
+    batch = g_new0(CrispyFileBatch, 1);
+    batch->requests = g_ptr_array_new_with_free_func(request_free);
+    batch->depth = queue_depth > 0 ? queue_depth
+                                   : CRISPY_FILE_BATCH_DEFAULT_DEPTH;
+
+#ifdef CRISPY_HAVE_IO_URING
+    if (g_getenv("CRISPY_NO_IO_URING") == NULL)
+        batch->ring = ring_new(batch->depth);
+
+    if (batch->ring != NULL)
+    {
+        batch->depth = MIN(batch->depth, batch->ring->entries);
+        return batch;
+    }
+#endif
+
+    start_threads(batch);
+
+    return batch;
+}
+
+void
+crispy_file_batch_add(
+    CrispyFileBatch *batch,
+    const gchar     *path,
+    CrispyReadFunc   callback,
+    gpointer         user_data
+){
+    CrispyFileRequest *req;
+
+    g_return_if_fail(batch != NULL);
+    g_return_if_fail(path != NULL);
+    g_return_if_fail(callback != NULL);
+
+    req = g_new0(CrispyFileRequest, 1);
+    req->path = g_strdup(path);
+    req->callback = callback;
+    req->user_data = user_data;
+    req->fd = -1;
+
+    g_ptr_array_add(batch->requests, req);
+}
+
+guint
+crispy_file_batch_run(
+    CrispyFileBatch *batch
+){
+    guint failed;
+
+    g_return_val_if_fail(batch != NULL, 0);
+
+    failed = 0;
+#ifdef CRISPY_HAVE_IO_URING
+    /* a ring that fails mid-run hands the rest to the thread pool */
+    if (batch->ring == NULL || !run_ring(batch, &failed))
+#endif
+        failed += run_threads(batch);
+
+    g_ptr_array_set_size(batch->requests, 0);
+
+    return failed;
+}
+
+const gchar *
+crispy_file_batch_get_backend(
+    CrispyFileBatch *batch
+){
+    g_return_val_if_fail(batch != NULL, NULL);
+
+#ifdef CRISPY_HAVE_IO_URING
+    if (batch->ring != NULL)
+        return "io_uring";
+#endif
+
+    return "threads";
+}
+
+void
+crispy_file_batch_free(
+    CrispyFileBatch *batch
+){
+    if (batch == NULL)
+        return;
+
+    if (batch->pool != NULL)
+        g_thread_pool_free(batch->pool, TRUE, TRUE);
+    if (batch->done != NULL)
+        g_async_queue_unref(batch->done);
+
+#ifdef CRISPY_HAVE_IO_URING
+    if (batch->ring != NULL)
+        ring_free(batch->ring);
+#endif
+
+    g_ptr_array_unref(batch->requests);
+    g_free(batch);
+}
+
+guint
+crispy_read_files(
+    const gchar * const *paths,
+    CrispyReadFunc       callback,
+    gpointer             user_data
+){
+    g_autoptr(CrispyFileBatch) batch = NULL;
+    guint i;
+
+    g_return_val_if_fail(paths != NULL, 0);
+    g_return_val_if_fail(callback != NULL, 0);
+
+    batch = crispy_file_batch_new(0);
+    for (i = 0; paths[i] != NULL; i++)
+        crispy_file_batch_add(batch, paths[i], callback, user_data);
+
+    return crispy_file_batch_run(batch);
+}
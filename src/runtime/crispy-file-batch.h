@@ -0,0 +1,132 @@
+/* crispy-file-batch.h - Batched whole-file reads for crispy scripts */
+
+#ifndef CRISPY_FILE_BATCH_H
+#define CRISPY_FILE_BATCH_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_FILE_BATCH_DEFAULT_DEPTH:
+ *
+ * Number of files kept in flight when crispy_file_batch_new() is
+ * given a depth of 0.
+ */
+#define CRISPY_FILE_BATCH_DEFAULT_DEPTH (64)
+
+/**
+ * CrispyFileBatch:
+ *
+ * An opaque queue of files to be read in one batch.
+ */
+typedef struct _CrispyFileBatch CrispyFileBatch;
+
+/**
+ * CrispyReadFunc:
+ * @path: the path that was queued
+ * @data: (nullable): the file contents, nul-terminated, or %NULL on
+ *        error
+ * @length: length of @data in bytes, not counting the nul
+ * @error: (nullable): why the file could not be read, or %NULL on
+ *         success
+ * @user_data: data passed to crispy_file_batch_add()
+ *
+ * Completion callback for one file.  It always runs on the thread that
+ * called crispy_file_batch_run().  @data and @error are owned by the
+ * batch and are only valid for the duration of the call; copy what
+ * you need to keep.
+ */
+typedef void (*CrispyReadFunc) (const gchar   *path,
+                                const gchar   *data,
+                                gsize          length,
+                                const GError  *error,
+                                gpointer       user_data);
+
+/**
+ * crispy_file_batch_new:
+ * @queue_depth: maximum number of files open and in flight at once,
+ *               or 0 for %CRISPY_FILE_BATCH_DEFAULT_DEPTH
+ *
+ * Creates an empty batch.  Reads are submitted through io_uring when
+ * the kernel supports it (opens and reads as ring operations, many
+ * files per system call) and otherwise through a small thread pool.
+ * Setting the `CRISPY_NO_IO_URING` environment variable forces the
+ * thread pool.  A ring that fails during a run is dropped, and the
+ * batch uses the thread pool from then on.
+ *
+ * Returns: (transfer full): a new #CrispyFileBatch
+ */
+CrispyFileBatch *crispy_file_batch_new         (guint             queue_depth);
+
+/**
+ * crispy_file_batch_add:
+ * @batch: a #CrispyFileBatch
+ * @path: file to read
+ * @callback: (scope call): called once @path has been read or has
+ *            failed
+ * @user_data: data passed to @callback
+ *
+ * Queues @path.  Nothing is read until crispy_file_batch_run().
+ */
+void             crispy_file_batch_add         (CrispyFileBatch  *batch,
+                                                const gchar      *path,
+                                                CrispyReadFunc    callback,
+                                                gpointer          user_data);
+
+/**
+ * crispy_file_batch_run:
+ * @batch: a #CrispyFileBatch
+ *
+ * Reads every queued file and invokes its callback as each one
+ * completes, in completion order rather than queue order.  Returns
+ * once all callbacks have run; the batch is then empty and can be
+ * reused.
+ *
+ * Errors are reported per file in the %G_FILE_ERROR domain.
+ *
+ * Returns: the number of files that could not be read
+ */
+guint            crispy_file_batch_run         (CrispyFileBatch  *batch);
+
+/**
+ * crispy_file_batch_get_backend:
+ * @batch: a #CrispyFileBatch
+ *
+ * Returns: (transfer none): "io_uring" or "threads", whichever
+ *          backend the batch uses
+ */
+const gchar     *crispy_file_batch_get_backend (CrispyFileBatch  *batch);
+
+/**
+ * crispy_file_batch_free:
+ * @batch: (nullable): a #CrispyFileBatch
+ *
+ * Frees @batch and discards any files that were queued but not run.
+ */
+void             crispy_file_batch_free        (CrispyFileBatch  *batch);
+
+/**
+ * crispy_read_files:
+ * @paths: (array zero-terminated=1): %NULL-terminated list of paths
+ * @callback: (scope call): called once per path
+ * @user_data: data passed to @callback
+ *
+ * Convenience wrapper: reads every file in @paths with a
+ * default-depth batch.
+ *
+ * Returns: the number of files that could not be read
+ */
+guint            crispy_read_files             (const gchar * const *paths,
+                                                CrispyReadFunc       callback,
+                                                gpointer             user_data);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyFileBatch, crispy_file_batch_free)
+
+G_END_DECLS
+
+#endif /* CRISPY_FILE_BATCH_H */
@@ -0,0 +1,236 @@
+/* crispy-init.c - Persisted initialization snapshots for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-init.h"
+
+#include <glib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE    (0x100000)
+#endif
+
+#define SNAPSHOT_MAGIC         "CRSPSNAP"
+#define SNAPSHOT_VERSION       (1)
+
+/*
+ * The reserved region starts with this header and the arena's data
+ * follows it, so a snapshot file is just the first
+ * SNAPSHOT_HEADER_SIZE + used bytes of the region, and loading it is
+ * a single mmap() of the file over the start of the region.
+ */
+#define SNAPSHOT_HEADER_SIZE   (64)
+
+typedef struct
+{
+    gchar   magic[8];
+    guint32 version;
+    guint32 header_size;
+    guint64 base;
+    guint64 used;
+    guint64 root;
+} CrispySnapshotHeader;
+
+G_STATIC_ASSERT(sizeof(CrispySnapshotHeader) <= SNAPSHOT_HEADER_SIZE);
+
+static GMutex       init_lock;
+static guint8      *region = NULL;
+static gboolean     region_fixed = FALSE;
+static CrispyArena *init_arena = NULL;
+static gpointer     init_root = NULL;
+
+/* --- helper: reserve the region, at the fixed base if possible --- */
+static gboolean
+reserve_region(void)
+{
+    gpointer addr;
+
+    if (region != NULL)
+        return TRUE;
+
+    addr = mmap((gpointer)CRISPY_INIT_ARENA_BASE, CRISPY_INIT_ARENA_SIZE,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE,
+                -1, 0);
+
+    /* kernels before 4.17 treat the flag as a hint and map elsewhere */
+    if (addr != MAP_FAILED && addr != (gpointer)CRISPY_INIT_ARENA_BASE)
+    {
+        munmap(addr, CRISPY_INIT_ARENA_SIZE);
+        addr = MAP_FAILED;
+    }
+    region_fixed = (addr != MAP_FAILED);
+
+    /* still usable as an arena, just not snapshotted */
+    if (addr == MAP_FAILED)
+        addr = mmap(NULL, CRISPY_INIT_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED)
+        return FALSE;
+
+    region = (guint8 *)addr;
+    return TRUE;
+}
+
+/* --- helper: create the arena over the reserved region --- */
+static CrispyArena *
+region_arena_new(void)
+{
+    return crispy_arena_new_for_region(region + SNAPSHOT_HEADER_SIZE,
+                                       CRISPY_INIT_ARENA_SIZE - SNAPSHOT_HEADER_SIZE);
+}
+
+/* --- public API --- */
+
+CrispyArena *
+crispy_init_arena(void)
+{
+    CrispyArena *arena;
+
+    g_mutex_lock(&init_lock);
+    if (init_arena == NULL)
+        init_arena = reserve_region() ? region_arena_new() : crispy_arena_new(0);
+    arena = init_arena;
+    g_mutex_unlock(&init_lock);
+
+    return arena;
+}
+
+gpointer
+crispy_init_get_root(void)
+{
+    return init_root;
+}
+
+gboolean
+crispy_init_snapshot_load(
+    const gchar *path
+){
+    CrispySnapshotHeader header;
+    struct stat st;
+    gpointer addr;
+    gboolean loaded;
+    gint fd;
+
+    g_return_val_if_fail(path != NULL, FALSE);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return FALSE;
+
+    loaded = FALSE;
+    g_mutex_lock(&init_lock);
+
+    /* the arena is already in use by this process */
+    if (init_arena != NULL)
+        goto out;
+
+    if (fstat(fd, &st) != 0 ||
+        pread(fd, &header, sizeof(header), 0) != (gssize)sizeof(header))
+        goto out;
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SNAPSHOT_VERSION ||
+        header.header_size != SNAPSHOT_HEADER_SIZE ||
+        header.base != (guint64)CRISPY_INIT_ARENA_BASE ||
+        header.used > CRISPY_INIT_ARENA_SIZE - SNAPSHOT_HEADER_SIZE ||
+        (guint64)st.st_size != SNAPSHOT_HEADER_SIZE + header.used)
+        goto out;
+
+    if (!reserve_region() || !region_fixed)
+        goto out;
+
+    /*
+     * Replace the start of the reservation with a private mapping of
+     * the file: pages are shared with the page cache until written,
+     * and the anonymous rest of the region stays available for
+     * whatever main() allocates afterwards.
+     */
+    addr = mmap(region, (gsize)st.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        /* a failed MAP_FIXED may have dropped part of the reservation */
+        munmap(region, CRISPY_INIT_ARENA_SIZE);
+        region = NULL;
+        region_fixed = FALSE;
+        goto out;
+    }
+
+    init_arena = region_arena_new();
+    if (header.used > 0)
+        (void)crispy_arena_alloc(init_arena, (gsize)header.used);
+    init_root = (gpointer)(guintptr)header.root;
+    loaded = TRUE;
+
+out:
+    g_mutex_unlock(&init_lock);
+    close(fd);
+
+    return loaded;
+}
+
+gboolean
+crispy_init_snapshot_save(
+    const gchar *path,
+    gpointer     root
+){
+    CrispySnapshotHeader *header;
+    gsize used;
+    gboolean saved;
+
+    g_return_val_if_fail(path != NULL, FALSE);
+
+    saved = FALSE;
+    g_mutex_lock(&init_lock);
+    init_root = root;
+
+    if (init_arena == NULL || !region_fixed)
+        goto out;
+
+    /* a root outside the arena would dangle in the next run */
+    used = crispy_arena_get_used(init_arena);
+    if (root != NULL &&
+        ((guint8 *)root < region + SNAPSHOT_HEADER_SIZE ||
+         (guint8 *)root >= region + SNAPSHOT_HEADER_SIZE + used))
+        goto out;
+
+    header = (CrispySnapshotHeader *)region;
+    memset(header, 0, SNAPSHOT_HEADER_SIZE);
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->header_size = SNAPSHOT_HEADER_SIZE;
+    header->base = (guint64)(guintptr)region;
+    header->used = used;
+    header->root = (guint64)(guintptr)root;
+
+    saved = g_file_set_contents(path, (const gchar *)region,
+                                (gssize)(SNAPSHOT_HEADER_SIZE + used), NULL);
+
+out:
+    g_mutex_unlock(&init_lock);
+
+    return saved;
+}
+
+/*
+ * Give the address range back when libcrispy-runtime is unloaded, so
+ * that a script reloaded into the same process (--watch, --hot-swap,
+ * --repl) can map its snapshot at the fixed base again.
+ */
+static void __attribute__((destructor))
+release_init_arena(void)
+{
+    crispy_arena_free(init_arena);
+    init_arena = NULL;
+    init_root = NULL;
+
+    if (region != NULL)
+        munmap(region, CRISPY_INIT_ARENA_SIZE);
+    region = NULL;
+    region_fixed = FALSE;
+}
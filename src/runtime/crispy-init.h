@@ -0,0 +1,91 @@
+/* crispy-init.h - Persisted initialization snapshots for crispy scripts */
+
+#ifndef CRISPY_INIT_H
+#define CRISPY_INIT_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include "crispy-arena.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CRISPY_INIT_ARENA_BASE:
+ *
+ * Address the init arena is mapped at.  Every run maps it at the same
+ * place, so pointers stored inside the arena stay valid when a later
+ * run maps the snapshot back in.
+ */
+#define CRISPY_INIT_ARENA_BASE ((guintptr)G_GUINT64_CONSTANT(0x200000000000))
+
+/**
+ * CRISPY_INIT_ARENA_SIZE:
+ *
+ * Address space reserved for the init arena.  Only the pages that are
+ * touched use memory.
+ */
+#define CRISPY_INIT_ARENA_SIZE (G_GSIZE_CONSTANT(4) * 1024 * 1024 * 1024)
+
+/**
+ * crispy_init_arena:
+ *
+ * Returns the arena that a script's `crispy_init()` builds its
+ * long-lived data in.  When a script defines
+ * |[<!-- language="C" -->
+ * gpointer crispy_init (void);
+ * ]|
+ * crispy calls it once before main() and saves the init arena to the
+ * cache afterwards.  The next run with the same build and the same
+ * declared inputs maps that snapshot copy-on-write instead of calling
+ * `crispy_init()` at all.
+ *
+ * Data reachable from the root must live entirely in this arena:
+ * pointers to the heap, to static data or to open files do not survive
+ * a snapshot.  If the fixed address is unavailable the arena still
+ * works, but nothing is saved.
+ *
+ * Returns: (transfer none): the init #CrispyArena
+ */
+CrispyArena *crispy_init_arena         (void);
+
+/**
+ * crispy_init_get_root:
+ *
+ * Returns the value `crispy_init()` returned, either in this run or
+ * in the run that saved the snapshot.
+ *
+ * Returns: (transfer none) (nullable): the root of the init data
+ */
+gpointer     crispy_init_get_root      (void);
+
+/**
+ * crispy_init_snapshot_load:
+ * @path: snapshot file
+ *
+ * Maps the init arena from @path.  Called by crispy before main();
+ * scripts do not call it.
+ *
+ * Returns: %TRUE if the snapshot was mapped and `crispy_init()` can
+ *          be skipped
+ */
+gboolean     crispy_init_snapshot_load (const gchar *path);
+
+/**
+ * crispy_init_snapshot_save:
+ * @path: snapshot file to write
+ * @root: (nullable): the value `crispy_init()` returned
+ *
+ * Records @root and writes the used part of the init arena to @path.
+ * Called by crispy after `crispy_init()`; scripts do not call it.
+ *
+ * Returns: %TRUE if the snapshot was written
+ */
+gboolean     crispy_init_snapshot_save (const gchar *path,
+                                        gpointer     root);
+
+G_END_DECLS
+
+#endif /* CRISPY_INIT_H */
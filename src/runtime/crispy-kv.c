@@ -0,0 +1,789 @@
+/* crispy-kv.c - Persistent mmap-backed key-value store for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-kv.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define KV_MAGIC               "CRSPKVST"
+#define KV_VERSION             (1)
+#define KV_HEADER_SIZE         (64)
+#define KV_INITIAL_SLOTS       (1024)
+#define KV_INITIAL_DATA        (256 * 1024)
+#define KV_ALIGN8(n)           (((n) + 7) & ~(guint64)7)
+
+/*
+ * File layout: the header, then n_slots slots of an open-addressing
+ * hash table, then an append-only area of records.  A slot holds the
+ * key's hash and the file offset of its current record; offset 0 marks
+ * an empty slot, since the header sits there.  Slots are never
+ * emptied, so a probe always ends at an empty slot: the writer keeps
+ * the table at most half full.
+ */
+typedef struct
+{
+    gchar   magic[8];
+    guint32 version;
+    guint32 retired;       /* a rewrite has replaced this file */
+    guint64 n_slots;       /* power of two */
+    guint64 count;
+    guint64 data_offset;
+    guint64 data_size;
+    guint64 data_used;
+} KvHeader;
+
+G_STATIC_ASSERT(sizeof(KvHeader) <= KV_HEADER_SIZE);
+
+typedef struct
+{
+    guint64 hash;
+    guint64 offset;
+} KvSlot;
+
+/* a record: this, the key and a nul, padding, the value, padding */
+typedef struct
+{
+    guint32 key_len;
+    guint32 reserved;
+    guint64 value_len;
+} KvRecord;
+
+#define RECORD_VALUE_OFFSET(key_len) \
+    KV_ALIGN8(sizeof(KvRecord) + (guint64)(key_len) + 1)
+#define RECORD_SIZE(key_len, value_len) \
+    (RECORD_VALUE_OFFSET(key_len) + KV_ALIGN8((guint64)(value_len)))
+
+typedef struct
+{
+    gpointer addr;
+    gsize    len;
+} KvMapping;
+
+struct _CrispyKv
+{
+    gchar    *path;         /* <dir>/<name>.kv */
+    gchar    *tmp_path;     /* rewrite target, renamed over path */
+    gint      lock_fd;      /* flock()ed by the writer */
+
+    guint8   *map;
+    gsize     map_len;
+    dev_t     dev;          /* identity of the mapped file */
+    ino_t     ino;
+
+    GArray   *retired;      /* KvMapping: kept for crispy_kv_get() */
+};
+
+#define HEADER(kv)   ((KvHeader *)(kv)->map)
+#define SLOTS(kv)    ((KvSlot *)((kv)->map + KV_HEADER_SIZE))
+
+/* --- helpers --- */
+
+/* FNV-1a: stable across processes and builds, unlike g_str_hash() */
+static guint64
+kv_hash(
+    const gchar *key,
+    gsize        key_len
+){
+    guint64 hash;
+    gsize i;
+
+    hash = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+    for (i = 0; i < key_len; i++)
+    {
+        hash ^= (guint8)key[i];
+        hash *= G_GUINT64_CONSTANT(0x100000001b3);
+    }
+
+    return hash;
+}
+
+static gboolean
+name_is_valid(
+    const gchar *name
+){
+    const gchar *p;
+
+    if (name[0] == '\0' || name[0] == '.')
+        return FALSE;
+    for (p = name; *p != '\0'; p++)
+    {
+        if (!g_ascii_isalnum(*p) && *p != '-' && *p != '_' && *p != '.')
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+set_errno_error(
+    GError      **error,
+    gint          saved_errno,
+    const gchar  *what,
+    const gchar  *path
+){
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                "Failed to %s '%s': %s", what, path, g_strerror(saved_errno));
+}
+
+/* --- helper: the record at @offset, or NULL if it is out of bounds --- */
+static const KvRecord *
+record_at(
+    guint8  *map,
+    gsize    map_len,
+    guint64  offset
+){
+    const KvRecord *record;
+
+    if (offset < KV_HEADER_SIZE || offset + sizeof(KvRecord) > map_len)
+        return NULL;
+
+    record = (const KvRecord *)(map + offset);
+    if (RECORD_SIZE(record->key_len, record->value_len) > map_len - offset)
+        return NULL;
+
+    return record;
+}
+
+/*
+ * find_slot:
+ *
+ * Probes for @key.  Returns the slot holding it, with its record
+ * offset in @offset, or the empty slot where it would go, with
+ * @offset set to 0.  Returns NULL only for a corrupt, full table.
+ */
+static KvSlot *
+find_slot(
+    guint8      *map,
+    gsize        map_len,
+    const gchar *key,
+    gsize        key_len,
+    guint64      hash,
+    guint64     *offset
+){
+    const KvRecord *record;
+    KvSlot *slots;
+    KvSlot *slot;
+    guint64 mask;
+    guint64 probes;
+    guint64 i;
+
+    slots = (KvSlot *)(map + KV_HEADER_SIZE);
+    mask = ((KvHeader *)map)->n_slots - 1;
+
+    for (i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++)
+    {
+        slot = &slots[i];
+        *offset = __atomic_load_n(&slot->offset, __ATOMIC_ACQUIRE);
+        if (*offset == 0)
+            return slot;
+        if (slot->hash != hash)
+            continue;
+
+        record = record_at(map, map_len, *offset);
+        if (record != NULL && record->key_len == key_len &&
+            memcmp(record + 1, key, key_len) == 0)
+            return slot;
+    }
+
+    return NULL;
+}
+
+/* --- helper: map @fd, keeping any previous mapping alive --- */
+static gboolean
+map_fd(
+    CrispyKv  *kv,
+    gint       fd,
+    GError   **error
+){
+    const KvHeader *header;
+    KvMapping old;
+    struct stat st;
+    gpointer addr;
+
+    if (fstat(fd, &st) != 0)
+    {
+        set_errno_error(error, errno, "stat", kv->path);
+        return FALSE;
+    }
+
+    if ((guint64)st.st_size < KV_HEADER_SIZE)
+        goto invalid;
+
+    addr = mmap(NULL, (gsize)st.st_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        set_errno_error(error, errno, "map", kv->path);
+        return FALSE;
+    }
+
+    header = (const KvHeader *)addr;
+    if (memcmp(header->magic, KV_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != KV_VERSION ||
+        header->n_slots == 0 ||
+        (header->n_slots & (header->n_slots - 1)) != 0 ||
+        header->data_offset < KV_HEADER_SIZE + header->n_slots * sizeof(KvSlot) ||
+        header->data_offset + header->data_size != (guint64)st.st_size ||
+        header->data_used > header->data_size)
+    {
+        munmap(addr, (gsize)st.st_size);
+        goto invalid;
+    }
+
+    if (kv->map != NULL)
+    {
+        old.addr = kv->map;
+        old.len = kv->map_len;
+        g_array_append_val(kv->retired, old);
+    }
+
+    kv->map = (guint8 *)addr;
+    kv->map_len = (gsize)st.st_size;
+    kv->dev = st.st_dev;
+    kv->ino = st.st_ino;
+
+    return TRUE;
+
+invalid:
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "'%s' is not a crispy key-value store", kv->path);
+    return FALSE;
+}
+
+/* --- helper: size @fd for a new table and write its header --- */
+static guint8 *
+layout_file(
+    CrispyKv  *kv,
+    gint       fd,
+    guint64    n_slots,
+    guint64    data_size,
+    gsize     *len,
+    GError   **error
+){
+    KvHeader *header;
+    guint64 data_offset;
+    gpointer addr;
+
+    data_offset = KV_HEADER_SIZE + n_slots * sizeof(KvSlot);
+    *len = (gsize)(data_offset + data_size);
+
+    if (ftruncate(fd, (off_t)*len) != 0)
+    {
+        set_errno_error(error, errno, "resize", kv->path);
+        return NULL;
+    }
+
+    addr = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        set_errno_error(error, errno, "map", kv->path);
+        return NULL;
+    }
+
+    header = (KvHeader *)addr;
+    header->version = KV_VERSION;
+    header->n_slots = n_slots;
+    header->data_offset = data_offset;
+    header->data_size = data_size;
+    memcpy(header->magic, KV_MAGIC, sizeof(header->magic));
+
+    return (guint8 *)addr;
+}
+
+/*
+ * refresh:
+ *
+ * Follows a rewrite by another process: once the mapped file is
+ * retired, map whatever is at the path now.
+ */
+static gboolean
+refresh(
+    CrispyKv  *kv,
+    GError   **error
+){
+    struct stat st;
+    gboolean ok;
+    gint fd;
+
+    if (!__atomic_load_n(&HEADER(kv)->retired, __ATOMIC_ACQUIRE))
+        return TRUE;
+
+    fd = open(kv->path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        set_errno_error(error, errno, "open", kv->path);
+        return FALSE;
+    }
+
+    /* the rewrite has not renamed its file into place yet */
+    if (fstat(fd, &st) == 0 && st.st_dev == kv->dev && st.st_ino == kv->ino)
+    {
+        close(fd);
+        return TRUE;
+    }
+
+    ok = map_fd(kv, fd, error);
+    close(fd);
+
+    return ok;
+}
+
+static gboolean
+writer_lock(
+    CrispyKv  *kv,
+    GError   **error
+){
+    while (flock(kv->lock_fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+        {
+            set_errno_error(error, errno, "lock", kv->path);
+            return FALSE;
+        }
+    }
+
+    if (!refresh(kv, error))
+    {
+        flock(kv->lock_fd, LOCK_UN);
+        return FALSE;
+    }
+
+    /* a rewrite died between retiring this file and replacing it */
+    if (HEADER(kv)->retired)
+        __atomic_store_n(&HEADER(kv)->retired, 0, __ATOMIC_RELEASE);
+
+    return TRUE;
+}
+
+static void
+writer_unlock(
+    CrispyKv *kv
+){
+    flock(kv->lock_fd, LOCK_UN);
+}
+
+/*
+ * rewrite:
+ *
+ * Copies the current record of every key into a new, larger file with
+ * room for @extra more bytes and one more key, then renames it over
+ * the store.  Overwritten records are dropped on the way.  The old
+ * file is marked retired first, so no handle can miss the switch.
+ */
+static gboolean
+rewrite(
+    CrispyKv  *kv,
+    guint64    extra,
+    GError   **error
+){
+    const KvRecord *record;
+    KvHeader *old_header;
+    KvHeader *new_header;
+    KvSlot *old_slots;
+    KvSlot *new_slots;
+    KvSlot *slot;
+    KvMapping old;
+    guint8 *new_map;
+    gsize new_len;
+    guint64 n_slots;
+    guint64 live;
+    guint64 data_size;
+    guint64 used;
+    guint64 size;
+    guint64 mask;
+    guint64 i;
+    guint64 j;
+    struct stat st;
+    gint fd;
+
+    old_header = HEADER(kv);
+    old_slots = SLOTS(kv);
+
+    live = 0;
+    for (i = 0; i < old_header->n_slots; i++)
+    {
+        record = record_at(kv->map, kv->map_len, old_slots[i].offset);
+        if (record != NULL)
+            live += RECORD_SIZE(record->key_len, record->value_len);
+    }
+
+    n_slots = old_header->n_slots;
+    while ((old_header->count + 1) * 2 > n_slots)
+        n_slots *= 2;
+    data_size = MAX((guint64)KV_INITIAL_DATA, (live + extra) * 2);
+
+    fd = open(kv->tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        set_errno_error(error, errno, "create", kv->tmp_path);
+        return FALSE;
+    }
+
+    new_map = layout_file(kv, fd, n_slots, data_size, &new_len, error);
+    if (new_map == NULL)
+    {
+        close(fd);
+        g_unlink(kv->tmp_path);
+        return FALSE;
+    }
+
+    new_header = (KvHeader *)new_map;
+    new_slots = (KvSlot *)(new_map + KV_HEADER_SIZE);
+    mask = n_slots - 1;
+    used = 0;
+
+    for (i = 0; i < old_header->n_slots; i++)
+    {
+        record = record_at(kv->map, kv->map_len, old_slots[i].offset);
+        if (record == NULL)
+            continue;
+
+        size = RECORD_SIZE(record->key_len, record->value_len);
+        memcpy(new_map + new_header->data_offset + used, record, size);
+
+        for (j = old_slots[i].hash & mask; new_slots[j].offset != 0; j = (j + 1) & mask)
+            ;
+        slot = &new_slots[j];
+        slot->hash = old_slots[i].hash;
+        slot->offset = new_header->data_offset + used;
+
+        used += size;
+        new_header->count++;
+    }
+    new_header->data_used = used;
+
+    if (msync(new_map, new_len, MS_SYNC) != 0 || fstat(fd, &st) != 0)
+    {
+        set_errno_error(error, errno, "write", kv->tmp_path);
+        munmap(new_map, new_len);
+        close(fd);
+        g_unlink(kv->tmp_path);
+        return FALSE;
+    }
+    close(fd);
+
+    __atomic_store_n(&old_header->retired, 1, __ATOMIC_RELEASE);
+    if (rename(kv->tmp_path, kv->path) != 0)
+    {
+        set_errno_error(error, errno, "replace", kv->path);
+        __atomic_store_n(&old_header->retired, 0, __ATOMIC_RELEASE);
+        munmap(new_map, new_len);
+        g_unlink(kv->tmp_path);
+        return FALSE;
+    }
+
+    old.addr = kv->map;
+    old.len = kv->map_len;
+    g_array_append_val(kv->retired, old);
+
+    kv->map = new_map;
+    kv->map_len = new_len;
+    kv->dev = st.st_dev;
+    kv->ino = st.st_ino;
+
+    return TRUE;
+}
+
+/* --- helper: the write itself; the caller holds the writer lock --- */
+static gboolean
+put_locked(
+    CrispyKv       *kv,
+    const gchar    *key,
+    gconstpointer   value,
+    gsize           len,
+    GError        **error
+){
+    KvRecord *record;
+    KvHeader *header;
+    KvSlot *slot;
+    guint64 offset;
+    guint64 hash;
+    guint64 size;
+    gsize key_len;
+
+    key_len = strlen(key);
+    if (key_len > G_MAXUINT32)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "Key too long for '%s'", kv->path);
+        return FALSE;
+    }
+
+    hash = kv_hash(key, key_len);
+    size = RECORD_SIZE(key_len, len);
+
+    slot = find_slot(kv->map, kv->map_len, key, key_len, hash, &offset);
+    header = HEADER(kv);
+    if (slot == NULL ||
+        header->data_used + size > header->data_size ||
+        (offset == 0 && (header->count + 1) * 2 > header->n_slots))
+    {
+        if (!rewrite(kv, size, error))
+            return FALSE;
+
+        slot = find_slot(kv->map, kv->map_len, key, key_len, hash, &offset);
+        header = HEADER(kv);
+    }
+
+    /* write the record where no reader looks yet, then publish it */
+    record = (KvRecord *)(kv->map + header->data_offset + header->data_used);
+    record->key_len = (guint32)key_len;
+    record->reserved = 0;
+    record->value_len = len;
+    memcpy(record + 1, key, key_len);
+    ((guint8 *)(record + 1))[key_len] = '\0';
+    if (len > 0)
+        memcpy((guint8 *)record + RECORD_VALUE_OFFSET(key_len), value, len);
+
+    __atomic_store_n(&header->data_used, header->data_used + size,
+                     __ATOMIC_RELEASE);
+
+    if (offset == 0)
+    {
+        slot->hash = hash;
+        __atomic_add_fetch(&header->count, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slot->offset, (guint64)((guint8 *)record - kv->map),
+                     __ATOMIC_RELEASE);
+
+    return TRUE;
+}
+
+/* --- public API --- */
+
+CrispyKv *
+crispy_kv_open(
+    const gchar  *name,
+    GError      **error
+){
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *lock_path = NULL;
+    CrispyKv *kv;
+    struct stat st;
+    gsize len;
+    guint8 *map;
+    gint fd;
+
+    g_return_val_if_fail(name != NULL, NULL);
+    g_return_val_if_fail(error == NULL || *error == NULL, NULL);
+
+    if (!name_is_valid(name))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "Invalid key-value store name '%s'", name);
+        return NULL;
+    }
+
+    if (g_getenv("CRISPY_KV_DIR") != NULL)
+        dir = g_strdup(g_getenv("CRISPY_KV_DIR"));
+    else
+        dir = g_build_filename(g_get_user_cache_dir(), "crispy", "kv", NULL);
+
+    if (g_mkdir_with_parents(dir, 0700) != 0)
+    {
+        set_errno_error(error, errno, "create", dir);
+        return NULL;
+    }
+
+    kv = g_new0(CrispyKv, 1);
+    kv->path = g_strdup_printf("%s/%s.kv", dir, name);
+    kv->tmp_path = g_strconcat(kv->path, ".tmp", NULL);
+    kv->retired = g_array_new(FALSE, FALSE, sizeof(KvMapping));
+
+    lock_path = g_strconcat(kv->path, ".lock", NULL);
+    kv->lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (kv->lock_fd < 0)
+    {
+        set_errno_error(error, errno, "open", lock_path);
+        crispy_kv_close(kv);
+        return NULL;
+    }
+
+    while (flock(kv->lock_fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+        {
+            set_errno_error(error, errno, "lock", kv->path);
+            crispy_kv_close(kv);
+            return NULL;
+        }
+    }
+
+    /* the lock makes creating the file race-free */
+    fd = open(kv->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        set_errno_error(error, errno, "open", kv->path);
+        goto fail;
+    }
+
+    if (st.st_size == 0)
+    {
+        map = layout_file(kv, fd, KV_INITIAL_SLOTS, KV_INITIAL_DATA,
+                          &len, error);
+        if (map == NULL)
+            goto fail;
+        munmap(map, len);
+    }
+
+    if (!map_fd(kv, fd, error))
+        goto fail;
+    close(fd);
+
+    if (HEADER(kv)->retired)
+        __atomic_store_n(&HEADER(kv)->retired, 0, __ATOMIC_RELEASE);
+    writer_unlock(kv);
+
+    return kv;
+
+fail:
+    if (fd >= 0)
+        close(fd);
+    writer_unlock(kv);
+    crispy_kv_close(kv);
+    return NULL;
+}
+
+gconstpointer
+crispy_kv_get(
+    CrispyKv    *kv,
+    const gchar *key,
+    gsize       *len
+){
+    const KvRecord *record;
+    guint64 offset;
+    gsize key_len;
+
+    g_return_val_if_fail(kv != NULL, NULL);
+    g_return_val_if_fail(key != NULL, NULL);
+
+    if (!refresh(kv, NULL))
+        return NULL;
+
+    key_len = strlen(key);
+    if (find_slot(kv->map, kv->map_len, key, key_len,
+                  kv_hash(key, key_len), &offset) == NULL || offset == 0)
+        return NULL;
+
+    record = record_at(kv->map, kv->map_len, offset);
+    if (record == NULL)
+        return NULL;
+
+    if (len != NULL)
+        *len = (gsize)record->value_len;
+
+    return (const guint8 *)record + RECORD_VALUE_OFFSET(key_len);
+}
+
+gboolean
+crispy_kv_put(
+    CrispyKv       *kv,
+    const gchar    *key,
+    gconstpointer   value,
+    gsize           len,
+    GError        **error
+){
+    gboolean ok;
+
+    g_return_val_if_fail(kv != NULL, FALSE);
+    g_return_val_if_fail(key != NULL, FALSE);
+    g_return_val_if_fail(value != NULL || len == 0, FALSE);
+
+    if (!writer_lock(kv, error))
+        return FALSE;
+    ok = put_locked(kv, key, value, len, error);
+    writer_unlock(kv);
+
+    return ok;
+}
+
+gboolean
+crispy_kv_compare_and_swap(
+    CrispyKv       *kv,
+    const gchar    *key,
+    gconstpointer   old_value,
+    gsize           old_len,
+    gconstpointer   new_value,
+    gsize           new_len,
+    GError        **error
+){
+    gconstpointer current;
+    gsize current_len;
+    gboolean matches;
+    gboolean ok;
+
+    g_return_val_if_fail(kv != NULL, FALSE);
+    g_return_val_if_fail(key != NULL, FALSE);
+    g_return_val_if_fail(new_value != NULL || new_len == 0, FALSE);
+
+    if (!writer_lock(kv, error))
+        return FALSE;
+
+    current = crispy_kv_get(kv, key, &current_len);
+    if (old_value == NULL)
+        matches = (current == NULL);
+    else
+        matches = current != NULL && current_len == old_len &&
+                  memcmp(current, old_value, old_len) == 0;
+
+    ok = matches && put_locked(kv, key, new_value, new_len, error);
+    writer_unlock(kv);
+
+    return ok;
+}
+
+guint64
+crispy_kv_get_count(
+    CrispyKv *kv
+){
+    g_return_val_if_fail(kv != NULL, 0);
+
+    if (!refresh(kv, NULL))
+        return 0;
+
+    return __atomic_load_n(&HEADER(kv)->count, __ATOMIC_RELAXED);
+}
+
+gboolean
+crispy_kv_sync(
+    CrispyKv *kv
+){
+    g_return_val_if_fail(kv != NULL, FALSE);
+
+    return msync(kv->map, kv->map_len, MS_SYNC) == 0;
+}
+
+void
+crispy_kv_close(
+    CrispyKv *kv
+){
+    KvMapping *mapping;
+    guint i;
+
+    if (kv == NULL)
+        return;
+
+    for (i = 0; i < kv->retired->len; i++)
+    {
+        mapping = &g_array_index(kv->retired, KvMapping, i);
+        munmap(mapping->addr, mapping->len);
+    }
+    g_array_free(kv->retired, TRUE);
+
+    if (kv->map != NULL)
+        munmap(kv->map, kv->map_len);
+    if (kv->lock_fd >= 0)
+        close(kv->lock_fd);
+
+    g_free(kv->path);
+    g_free(kv->tmp_path);
+    g_free(kv);
+}
@@ -0,0 +1,139 @@
+/* crispy-kv.h - Persistent mmap-backed key-value store for crispy scripts */
+
+#ifndef CRISPY_KV_H
+#define CRISPY_KV_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyKv:
+ *
+ * A persistent hash table of string keys and binary values, shared by
+ * every process that opens the same name.  The table is a file mapped
+ * into memory: reads take no locks and no system calls, and writers
+ * are serialized across processes by a lock file.
+ *
+ * Every write appends an immutable record and then publishes it with
+ * a single atomic store, so a process killed at any point leaves the
+ * store consistent: a reader sees either the old value or the new one.
+ * When the file fills up, the writer compacts it into a larger file
+ * and renames that over the old one; open handles follow on their next
+ * call.
+ *
+ * A handle is not thread-safe.  Open one per thread.
+ */
+typedef struct _CrispyKv CrispyKv;
+
+/**
+ * crispy_kv_open:
+ * @name: name of the store; letters, digits, '-', '_' and '.' only
+ * @error: (nullable): return location for a #GError
+ *
+ * Opens the store @name, creating it if needed.  Stores live in
+ * `$CRISPY_KV_DIR`, or in `crispy/kv` under the user cache directory
+ * (`~/.cache/crispy/kv`).  Errors are in the %G_FILE_ERROR domain.
+ *
+ * Returns: (transfer full) (nullable): a new #CrispyKv, or %NULL
+ */
+CrispyKv      *crispy_kv_open              (const gchar   *name,
+                                            GError       **error);
+
+/**
+ * crispy_kv_get:
+ * @kv: a #CrispyKv
+ * @key: the key
+ * @len: (out) (optional): length of the value
+ *
+ * Looks up @key without locking.  The value is not copied: it points
+ * into the mapping and stays valid, and unchanged, until
+ * crispy_kv_close(), even if another process replaces it.
+ *
+ * Returns: (transfer none) (nullable): the value, or %NULL if @key is
+ *          not in the store
+ */
+gconstpointer  crispy_kv_get               (CrispyKv      *kv,
+                                            const gchar   *key,
+                                            gsize         *len);
+
+/**
+ * crispy_kv_put:
+ * @kv: a #CrispyKv
+ * @key: the key
+ * @value: (array length=len): the value
+ * @len: length of @value
+ * @error: (nullable): return location for a #GError
+ *
+ * Sets @key to @value, replacing any previous value.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean       crispy_kv_put               (CrispyKv      *kv,
+                                            const gchar   *key,
+                                            gconstpointer  value,
+                                            gsize          len,
+                                            GError       **error);
+
+/**
+ * crispy_kv_compare_and_swap:
+ * @kv: a #CrispyKv
+ * @key: the key
+ * @old_value: (nullable) (array length=old_len): the expected value, or
+ *             %NULL if @key is expected to be absent
+ * @old_len: length of @old_value
+ * @new_value: (array length=new_len): the value to store
+ * @new_len: length of @new_value
+ * @error: (nullable): return location for a #GError
+ *
+ * Sets @key to @new_value only if its current value is @old_value,
+ * atomically with respect to every other writer of the store.  On
+ * failure @error is left unset if the value simply differed.
+ *
+ * Returns: %TRUE if the value was swapped
+ */
+gboolean       crispy_kv_compare_and_swap  (CrispyKv      *kv,
+                                            const gchar   *key,
+                                            gconstpointer  old_value,
+                                            gsize          old_len,
+                                            gconstpointer  new_value,
+                                            gsize          new_len,
+                                            GError       **error);
+
+/**
+ * crispy_kv_get_count:
+ * @kv: a #CrispyKv
+ *
+ * Returns: the number of keys in the store
+ */
+guint64        crispy_kv_get_count         (CrispyKv      *kv);
+
+/**
+ * crispy_kv_sync:
+ * @kv: a #CrispyKv
+ *
+ * Flushes the store to disk with msync().  Writes already survive a
+ * crash of the process without it; this also covers a crash of the
+ * machine.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean       crispy_kv_sync              (CrispyKv      *kv);
+
+/**
+ * crispy_kv_close:
+ * @kv: (nullable): a #CrispyKv
+ *
+ * Unmaps the store.  Values returned by crispy_kv_get() become invalid.
+ */
+void           crispy_kv_close             (CrispyKv      *kv);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyKv, crispy_kv_close)
+
+G_END_DECLS
+
+#endif /* CRISPY_KV_H */
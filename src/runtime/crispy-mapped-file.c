@@ -0,0 +1,191 @@
+/* crispy-mapped-file.c - Read-only mmap file views for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-mapped-file.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct _CrispyMappedFile
+{
+    gchar *data;
+    gsize  length;
+};
+
+/* --- helper: translate flags into madvise() calls on a range --- */
+static void
+apply_advice(
+    gpointer       addr,
+    gsize          length,
+    CrispyMapFlags flags
+){
+    if (length == 0)
+        return;
+
+    /* failures are not fatal: the hints are purely advisory */
+    if (flags & CRISPY_MAP_SEQUENTIAL)
+        (void)madvise(addr, length, MADV_SEQUENTIAL);
+    else if (flags & CRISPY_MAP_RANDOM)
+        (void)madvise(addr, length, MADV_RANDOM);
+
+    if (flags & CRISPY_MAP_WILLNEED)
+        (void)madvise(addr, length, MADV_WILLNEED);
+
+#ifdef MADV_HUGEPAGE
+    if (flags & CRISPY_MAP_HUGEPAGE)
+        (void)madvise(addr, length, MADV_HUGEPAGE);
+#endif
+}
+
+/* --- public API --- */
+
+CrispyMappedFile *
+crispy_map_file(
+    const gchar     *path,
+    CrispyMapFlags   flags,
+    GError         **error
+){
+    CrispyMappedFile *file;
+    struct stat st;
+    gpointer addr;
+    gint mmap_flags;
+    gint saved_errno;
+    gint fd;
+
+    g_return_val_if_fail(path != NULL, NULL);
+
+    fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        saved_errno = errno;
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(saved_errno),
+                    "Failed to open '%s': %s",
+                    path, g_strerror(saved_errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0)
+    {
+        saved_errno = errno;
+        close(fd);
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(saved_errno),
+                    "Failed to stat '%s': %s",
+                    path, g_strerror(saved_errno));
+        return NULL;
+    }
+
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    G_FILE_ERROR_INVAL,
+                    "'%s' is not a regular file",
+                    path);
+        return NULL;
+    }
+
+    file = g_new0(CrispyMappedFile, 1);
+
+    /* mmap() rejects zero-length mappings; hand out an empty view */
+    if (st.st_size == 0)
+    {
+        close(fd);
+        file->data = (gchar *)"";
+        file->length = 0;
+        return file;
+    }
+
+    mmap_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (flags & CRISPY_MAP_POPULATE)
+        mmap_flags |= MAP_POPULATE;
+#endif
+
+    addr = mmap(NULL, (gsize)st.st_size, PROT_READ, mmap_flags, fd, 0);
+    saved_errno = errno;
+    close(fd);
+
+    if (addr == MAP_FAILED)
+    {
+        g_free(file);
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(saved_errno),
+                    "Failed to map '%s': %s",
+                    path, g_strerror(saved_errno));
+        return NULL;
+    }
+
+    file->data = (gchar *)addr;
+    file->length = (gsize)st.st_size;
+
+    apply_advice(file->data, file->length, flags);
+
+    return file;
+}
+
+const gchar *
+crispy_mapped_file_get_data(
+    CrispyMappedFile *file
+){
+    g_return_val_if_fail(file != NULL, NULL);
+
+    return file->data;
+}
+
+gsize
+crispy_mapped_file_get_length(
+    CrispyMappedFile *file
+){
+    g_return_val_if_fail(file != NULL, 0);
+
+    return file->length;
+}
+
+void
+crispy_mapped_file_advise(
+    CrispyMappedFile *file,
+    gsize             offset,
+    gsize             length,
+    CrispyMapFlags    flags
+){
+    gsize page_size;
+    gsize start;
+
+    g_return_if_fail(file != NULL);
+
+    if (offset >= file->length)
+        return;
+
+    if (length == 0 || length > file->length - offset)
+        length = file->length - offset;
+
+    /* madvise() wants a page-aligned start address */
+    page_size = (gsize)sysconf(_SC_PAGESIZE);
+    start = offset - (offset % page_size);
+
+    apply_advice(file->data + start, length + (offset - start), flags);
+}
+
+void
+crispy_mapped_file_free(
+    CrispyMappedFile *file
+){
+    if (file == NULL)
+        return;
+
+    if (file->length > 0)
+        munmap(file->data, file->length);
+
+    g_free(file);
+}
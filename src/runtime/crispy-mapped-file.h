@@ -0,0 +1,115 @@
+/* crispy-mapped-file.h - Read-only mmap file views for crispy scripts */
+
+#ifndef CRISPY_MAPPED_FILE_H
+#define CRISPY_MAPPED_FILE_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyMapFlags:
+ * @CRISPY_MAP_NONE: No access hint (MADV_NORMAL).
+ * @CRISPY_MAP_SEQUENTIAL: The file will be read front to back
+ *   (MADV_SEQUENTIAL); the kernel reads ahead aggressively.
+ * @CRISPY_MAP_RANDOM: The file will be accessed randomly
+ *   (MADV_RANDOM); read-ahead is disabled.
+ * @CRISPY_MAP_WILLNEED: Start paging the whole file in now
+ *   (MADV_WILLNEED).
+ * @CRISPY_MAP_POPULATE: Pre-fault all pages at map time
+ *   (MAP_POPULATE); slower to map, no page faults afterwards.
+ * @CRISPY_MAP_HUGEPAGE: Ask for transparent huge pages where the
+ *   filesystem supports them (MADV_HUGEPAGE).
+ *
+ * Access hints for crispy_map_file().  SEQUENTIAL and RANDOM are
+ * mutually exclusive; the others may be combined freely.  Hints the
+ * kernel does not support are silently ignored.
+ */
+typedef enum
+{
+    CRISPY_MAP_NONE       = 0,
+    CRISPY_MAP_SEQUENTIAL = 1 << 0,
+    CRISPY_MAP_RANDOM     = 1 << 1,
+    CRISPY_MAP_WILLNEED   = 1 << 2,
+    CRISPY_MAP_POPULATE   = 1 << 3,
+    CRISPY_MAP_HUGEPAGE   = 1 << 4
+} CrispyMapFlags;
+
+/**
+ * CrispyMappedFile:
+ *
+ * An opaque read-only view of a file mapped into memory.
+ */
+typedef struct _CrispyMappedFile CrispyMappedFile;
+
+/**
+ * crispy_map_file:
+ * @path: path of the file to map
+ * @flags: #CrispyMapFlags access hints
+ * @error: return location for a #GError, or %NULL
+ *
+ * Maps @path read-only and applies the requested madvise() hints.
+ * The file descriptor is closed immediately; the mapping stays valid
+ * until crispy_mapped_file_free().  Empty files are supported and
+ * yield a zero-length view.
+ *
+ * Errors are reported in the %G_FILE_ERROR domain.
+ *
+ * Returns: (transfer full) (nullable): a new #CrispyMappedFile, or
+ *          %NULL on error
+ */
+CrispyMappedFile *crispy_map_file               (const gchar       *path,
+                                                 CrispyMapFlags     flags,
+                                                 GError           **error);
+
+/**
+ * crispy_mapped_file_get_data:
+ * @file: a #CrispyMappedFile
+ *
+ * Returns a pointer to the mapped contents.  The data is not
+ * nul-terminated; use crispy_mapped_file_get_length() for bounds.
+ *
+ * Returns: (transfer none): the mapped bytes
+ */
+const gchar      *crispy_mapped_file_get_data   (CrispyMappedFile  *file);
+
+/**
+ * crispy_mapped_file_get_length:
+ * @file: a #CrispyMappedFile
+ *
+ * Returns: the length of the mapping in bytes
+ */
+gsize             crispy_mapped_file_get_length (CrispyMappedFile  *file);
+
+/**
+ * crispy_mapped_file_advise:
+ * @file: a #CrispyMappedFile
+ * @offset: byte offset of the range
+ * @length: length of the range in bytes, or 0 for "to the end"
+ * @flags: #CrispyMapFlags access hints (%CRISPY_MAP_POPULATE is ignored)
+ *
+ * Applies madvise() hints to part of an existing mapping, for scripts
+ * whose access pattern changes between phases.
+ */
+void              crispy_mapped_file_advise     (CrispyMappedFile  *file,
+                                                 gsize              offset,
+                                                 gsize              length,
+                                                 CrispyMapFlags     flags);
+
+/**
+ * crispy_mapped_file_free:
+ * @file: (nullable): a #CrispyMappedFile
+ *
+ * Unmaps the file and frees @file.
+ */
+void              crispy_mapped_file_free       (CrispyMappedFile  *file);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyMappedFile, crispy_mapped_file_free)
+
+G_END_DECLS
+
+#endif /* CRISPY_MAPPED_FILE_H */
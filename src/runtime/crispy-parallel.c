@@ -0,0 +1,658 @@
+/* crispy-parallel.c - Work-stealing data parallelism for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-parallel.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Design
+ *
+ * One process-wide pool of worker threads is started lazily.  A
+ * parallel loop publishes a job; the caller plus up to (concurrency - 1)
+ * workers join it, each owning one "slot" holding a contiguous index
+ * range.  A participant repeatedly takes @grain indices from the front
+ * of its own range; when that is empty it steals the back half of some
+ * other participant's range.  Ranges only ever shrink or move, so when
+ * a full scan of all slots finds nothing left, the participant is done.
+ *
+ * The caller closes the job once it runs dry and waits only for the
+ * workers that actually joined, so sleeping workers never delay a loop.
+ */
+
+#define CRISPY_PARALLEL_CACHE_LINE (64)
+#define CRISPY_PARALLEL_CHUNKS_PER_THREAD (16)
+
+typedef struct _CrispyParallelJob CrispyParallelJob;
+
+typedef void (*CrispyParallelBody) (CrispyParallelJob *job,
+                                    guint              slot,
+                                    gint64             begin,
+                                    gint64             end);
+
+/* one participant's range; padded so slots never share a cache line */
+typedef struct
+{
+    GMutex  lock;
+    gint64  lo;
+    gint64  hi;
+} __attribute__((aligned(CRISPY_PARALLEL_CACHE_LINE))) CrispyRangeSlot;
+
+struct _CrispyParallelJob
+{
+    CrispyParallelBody   body;
+    CrispyParallelFunc   fn;
+    CrispyReduceMapFunc  map;
+    gpointer             user_data;
+
+    guint8              *accs;        /* reduce: n_slots accumulators */
+    gsize                acc_stride;
+
+    gint64               grain;
+    guint                n_slots;
+    CrispyRangeSlot     *slots;
+
+    /* protected by pool.lock */
+    guint                joined;      /* workers that entered the job */
+    guint                left;        /* workers that finished */
+    gboolean             closed;      /* no more workers may join */
+};
+
+typedef struct
+{
+    GMutex              lock;
+    GCond               work_cond;    /* workers: new job published */
+    GCond               done_cond;    /* caller: joined workers left */
+    GMutex              job_lock;     /* serializes unrelated callers */
+
+    GPtrArray          *threads;
+    guint               n_workers;
+    pid_t               owner_pid;    /* process that started the workers */
+    guint               concurrency;  /* 0 = not detected yet */
+    guint64             generation;
+    CrispyParallelJob  *job;
+    gboolean            shutdown;
+} CrispyParallelPool;
+
+static CrispyParallelPool pool;
+
+static gpointer worker_main (gpointer data);
+
+/* set on worker threads and on a caller while it runs a job */
+static GPrivate in_parallel = G_PRIVATE_INIT(NULL);
+
+/* --- CPU quota detection --- */
+
+/*
+ * read_cgroup_v2_quota:
+ * @cgroup_path: the process's cgroup v2 path (e.g. "/user.slice/...")
+ *
+ * Walks from @cgroup_path up to the root reading each cpu.max
+ * ("max 100000" or "<quota> <period>"); the tightest limit wins.
+ *
+ * Returns: the CPU limit rounded up, or 0 if unlimited
+ */
+static guint
+read_cgroup_v2_quota(
+    const gchar *cgroup_path
+){
+    g_autofree gchar *dir = NULL;
+    guint best;
+
+    best = 0;
+    dir = g_strdup(cgroup_path);
+
+    while (TRUE)
+    {
+        g_autofree gchar *file = NULL;
+        g_autofree gchar *contents = NULL;
+        gchar *parent;
+
+        file = g_build_filename("/sys/fs/cgroup", dir, "cpu.max", NULL);
+        if (g_file_get_contents(file, &contents, NULL, NULL) &&
+            !g_str_has_prefix(contents, "max"))
+        {
+            gchar *endp;
+            gint64 quota;
+            gint64 period;
+
+            quota = g_ascii_strtoll(contents, &endp, 10);
+            period = g_ascii_strtoll(endp, NULL, 10);
+            if (quota > 0 && period > 0)
+            {
+                guint cpus;
+
+                cpus = (guint)((quota + period - 1) / period);
+                if (best == 0 || cpus < best)
+                    best = cpus;
+            }
+        }
+
+        if (strcmp(dir, "/") == 0 || dir[0] == '\0')
+            break;
+
+        parent = g_path_get_dirname(dir);
+        g_free(dir);
+        dir = parent;
+    }
+
+    return best;
+}
+
+/*
+ * read_cgroup_v1_quota:
+ *
+ * Reads cpu.cfs_quota_us / cpu.cfs_period_us from the cgroup v1 cpu
+ * controller as seen from inside the process's cgroup namespace.
+ *
+ * Returns: the CPU limit rounded up, or 0 if unlimited or unknown
+ */
+static guint
+read_cgroup_v1_quota(void)
+{
+    static const gchar *dirs[] = {
+        "/sys/fs/cgroup/cpu",
+        "/sys/fs/cgroup/cpu,cpuacct",
+        NULL
+    };
+    gint i;
+
+    for (i = 0; dirs[i] != NULL; i++)
+    {
+        g_autofree gchar *quota_path = NULL;
+        g_autofree gchar *period_path = NULL;
+        g_autofree gchar *quota_str = NULL;
+        g_autofree gchar *period_str = NULL;
+        gint64 quota;
+        gint64 period;
+
+        quota_path = g_build_filename(dirs[i], "cpu.cfs_quota_us", NULL);
+        period_path = g_build_filename(dirs[i], "cpu.cfs_period_us", NULL);
+
+        if (!g_file_get_contents(quota_path, &quota_str, NULL, NULL) ||
+            !g_file_get_contents(period_path, &period_str, NULL, NULL))
+        {
+            continue;
+        }
+
+        quota = g_ascii_strtoll(quota_str, NULL, 10);
+        period = g_ascii_strtoll(period_str, NULL, 10);
+        if (quota > 0 && period > 0)
+            return (guint)((quota + period - 1) / period);
+    }
+
+    return 0;
+}
+
+static guint
+detect_cpu_quota(void)
+{
+    g_autofree gchar *self_cgroup = NULL;
+    gchar **lines;
+    guint quota;
+    gint i;
+
+    quota = 0;
+
+    if (g_file_get_contents("/proc/self/cgroup", &self_cgroup, NULL, NULL))
+    {
+        /* the unified (v2) hierarchy is the "0::<path>" entry */
+        lines = g_strsplit(self_cgroup, "\n", -1);
+        for (i = 0; lines[i] != NULL; i++)
+        {
+            if (g_str_has_prefix(lines[i], "0::"))
+            {
+                quota = read_cgroup_v2_quota(lines[i] + 3);
+                break;
+            }
+        }
+        g_strfreev(lines);
+    }
+
+    if (quota == 0)
+        quota = read_cgroup_v1_quota();
+
+    return quota;
+}
+
+static guint
+detect_concurrency(void)
+{
+    const gchar *env;
+    guint n_cpus;
+    guint quota;
+
+    env = g_getenv("CRISPY_NUM_THREADS");
+    if (env != NULL && env[0] != '\0')
+    {
+        guint64 n;
+
+        n = g_ascii_strtoull(env, NULL, 10);
+        if (n > 0 && n <= 4096)
+            return (guint)n;
+    }
+
+    /* g_get_num_processors() already honours the affinity mask */
+    n_cpus = g_get_num_processors();
+    quota = detect_cpu_quota();
+    if (quota > 0 && quota < n_cpus)
+        n_cpus = quota;
+
+    return MAX(n_cpus, 1);
+}
+
+/* --- worker pool --- */
+
+/* pool.lock must be held */
+static void
+ensure_workers(
+    guint wanted
+){
+    /*
+     * After fork() only the forking thread survives; forget the
+     * parent's workers (without touching their handles) and start
+     * fresh ones for this process.
+     */
+    if (pool.n_workers > 0 && pool.owner_pid != getpid())
+    {
+        pool.threads = NULL;
+        pool.n_workers = 0;
+    }
+
+    while (pool.n_workers < wanted)
+    {
+        g_autofree gchar *name = NULL;
+        GThread *thread;
+
+        name = g_strdup_printf("crispy-par-%u", pool.n_workers);
+        thread = g_thread_try_new(name, worker_main, NULL, NULL);
+        if (thread == NULL)
+            break;
+
+        if (pool.threads == NULL)
+        {
+            pool.threads = g_ptr_array_new();
+            pool.owner_pid = getpid();
+        }
+        g_ptr_array_add(pool.threads, thread);
+        pool.n_workers++;
+    }
+}
+
+/* --- work stealing --- */
+
+/* take up to @grain indices from the front of our own range */
+static gboolean
+take_own(
+    CrispyParallelJob *job,
+    guint              slot,
+    gint64            *out_begin,
+    gint64            *out_end
+){
+    CrispyRangeSlot *s;
+    gboolean found;
+
+    s = &job->slots[slot];
+    found = FALSE;
+
+    g_mutex_lock(&s->lock);
+    if (s->lo < s->hi)
+    {
+        *out_begin = s->lo;
+        *out_end = (s->hi - s->lo > job->grain) ? s->lo + job->grain : s->hi;
+        s->lo = *out_end;
+        found = TRUE;
+    }
+    g_mutex_unlock(&s->lock);
+
+    return found;
+}
+
+/* move the back half of some other participant's range into ours */
+static gboolean
+steal(
+    CrispyParallelJob *job,
+    guint              slot
+){
+    guint i;
+
+    for (i = 1; i < job->n_slots; i++)
+    {
+        CrispyRangeSlot *victim;
+        gint64 lo;
+        gint64 hi;
+        gint64 remaining;
+
+        victim = &job->slots[(slot + i) % job->n_slots];
+
+        g_mutex_lock(&victim->lock);
+        remaining = victim->hi - victim->lo;
+        if (remaining <= 0)
+        {
+            g_mutex_unlock(&victim->lock);
+            continue;
+        }
+
+        hi = victim->hi;
+        if (remaining > job->grain)
+        {
+            lo = victim->lo + remaining / 2;
+            victim->hi = lo;
+        }
+        else
+        {
+            lo = victim->lo;
+            victim->lo = hi;
+        }
+        g_mutex_unlock(&victim->lock);
+
+        g_mutex_lock(&job->slots[slot].lock);
+        job->slots[slot].lo = lo;
+        job->slots[slot].hi = hi;
+        g_mutex_unlock(&job->slots[slot].lock);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+run_participant(
+    CrispyParallelJob *job,
+    guint              slot
+){
+    gint64 begin;
+    gint64 end;
+
+    while (TRUE)
+    {
+        if (take_own(job, slot, &begin, &end))
+        {
+            job->body(job, slot, begin, end);
+            continue;
+        }
+
+        if (!steal(job, slot))
+            break;
+    }
+}
+
+static gpointer
+worker_main(
+    gpointer data
+){
+    guint64 seen;
+
+    g_private_set(&in_parallel, GINT_TO_POINTER(1));
+
+    g_mutex_lock(&pool.lock);
+    seen = pool.generation;
+
+    while (TRUE)
+    {
+        CrispyParallelJob *job;
+        guint slot;
+
+        while (!pool.shutdown && pool.generation == seen)
+            g_cond_wait(&pool.work_cond, &pool.lock);
+
+        if (pool.shutdown)
+            break;
+
+        seen = pool.generation;
+        job = pool.job;
+        if (job == NULL || job->closed || job->joined + 1 >= job->n_slots)
+            continue;
+
+        slot = ++job->joined;
+        g_mutex_unlock(&pool.lock);
+
+        run_participant(job, slot);
+
+        g_mutex_lock(&pool.lock);
+        job->left++;
+        if (job->closed && job->left == job->joined)
+            g_cond_broadcast(&pool.done_cond);
+    }
+
+    g_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+/*
+ * run_job:
+ * @job: job with body/fn/map/user_data set
+ * @begin: first index
+ * @end: last index (exclusive)
+ * @grain: requested grain (0 = auto)
+ * @n_slots: most threads to use, crispy_parallel_get_concurrency() as
+ *   read once by the caller
+ *
+ * Runs @job to completion.  Falls back to a single serial call when
+ * nested inside another loop, when only one thread is available, or
+ * when the range fits in a single grain.
+ */
+static void
+run_job(
+    CrispyParallelJob *job,
+    gint64             begin,
+    gint64             end,
+    gint64             grain,
+    guint              n_slots
+){
+    guint i;
+    gint64 total;
+    gint64 per_slot;
+
+    total = end - begin;
+    if (total <= 0)
+        return;
+
+    if (g_private_get(&in_parallel) != NULL)
+    {
+        job->body(job, 0, begin, end);
+        return;
+    }
+
+    if (grain <= 0)
+        grain = MAX(total / ((gint64)n_slots * CRISPY_PARALLEL_CHUNKS_PER_THREAD), 1);
+    job->grain = grain;
+
+    if (n_slots == 1 || total <= grain)
+    {
+        job->body(job, 0, begin, end);
+        return;
+    }
+
+    g_mutex_lock(&pool.job_lock);
+
+    g_mutex_lock(&pool.lock);
+    ensure_workers(n_slots - 1);
+    n_slots = MIN(n_slots, pool.n_workers + 1);
+    g_mutex_unlock(&pool.lock);
+
+    /* initial even split; stealing rebalances from there */
+    job->n_slots = n_slots;
+    job->slots = g_aligned_alloc0(n_slots, sizeof(CrispyRangeSlot),
+                                  CRISPY_PARALLEL_CACHE_LINE);
+    per_slot = total / n_slots;
+    for (i = 0; i < n_slots; i++)
+    {
+        g_mutex_init(&job->slots[i].lock);
+        job->slots[i].lo = begin + per_slot * i;
+        job->slots[i].hi = (i + 1 == n_slots) ? end : begin + per_slot * (i + 1);
+    }
+
+    /* publish */
+    g_mutex_lock(&pool.lock);
+    pool.job = job;
+    pool.generation++;
+    g_cond_broadcast(&pool.work_cond);
+    g_mutex_unlock(&pool.lock);
+
+    g_private_set(&in_parallel, GINT_TO_POINTER(1));
+    run_participant(job, 0);
+    g_private_set(&in_parallel, NULL);
+
+    /* close the job and wait for the workers that joined */
+    g_mutex_lock(&pool.lock);
+    job->closed = TRUE;
+    pool.job = NULL;
+    while (job->left < job->joined)
+        g_cond_wait(&pool.done_cond, &pool.lock);
+    g_mutex_unlock(&pool.lock);
+
+    for (i = 0; i < n_slots; i++)
+        g_mutex_clear(&job->slots[i].lock);
+    g_aligned_free(job->slots);
+    job->slots = NULL;
+
+    g_mutex_unlock(&pool.job_lock);
+}
+
+/* --- loop bodies --- */
+
+static void
+for_body(
+    CrispyParallelJob *job,
+    guint              slot,
+    gint64             begin,
+    gint64             end
+){
+    job->fn(begin, end, job->user_data);
+}
+
+static void
+reduce_body(
+    CrispyParallelJob *job,
+    guint              slot,
+    gint64             begin,
+    gint64             end
+){
+    job->map(begin, end, job->accs + job->acc_stride * slot, job->user_data);
+}
+
+/* --- public API --- */
+
+void
+crispy_parallel_for(
+    gint64              begin,
+    gint64              end,
+    gint64              grain,
+    CrispyParallelFunc  fn,
+    gpointer            user_data
+){
+    CrispyParallelJob job;
+
+    g_return_if_fail(fn != NULL);
+
+    memset(&job, 0, sizeof(job));
+    job.body = for_body;
+    job.fn = fn;
+    job.user_data = user_data;
+
+    run_job(&job, begin, end, grain, crispy_parallel_get_concurrency());
+}
+
+void
+crispy_parallel_reduce(
+    gint64                   begin,
+    gint64                   end,
+    gint64                   grain,
+    gpointer                 result,
+    gsize                    acc_size,
+    gconstpointer            identity,
+    CrispyReduceMapFunc      map,
+    CrispyReduceCombineFunc  combine,
+    gpointer                 user_data
+){
+    CrispyParallelJob job;
+    guint n_accs;
+    guint i;
+
+    g_return_if_fail(result != NULL);
+    g_return_if_fail(acc_size > 0);
+    g_return_if_fail(identity != NULL);
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(combine != NULL);
+
+    memset(&job, 0, sizeof(job));
+    job.body = reduce_body;
+    job.map = map;
+    job.user_data = user_data;
+
+    /*
+     * One accumulator per possible participant, each on its own cache
+     * lines.  The concurrency is read once: another thread may change
+     * it, and run_job() must not use more slots than there are
+     * accumulators.
+     */
+    n_accs = crispy_parallel_get_concurrency();
+    job.acc_stride = (acc_size + CRISPY_PARALLEL_CACHE_LINE - 1)
+                     & ~((gsize)CRISPY_PARALLEL_CACHE_LINE - 1);
+    job.accs = g_aligned_alloc(n_accs, job.acc_stride,
+                               CRISPY_PARALLEL_CACHE_LINE);
+    for (i = 0; i < n_accs; i++)
+        memcpy(job.accs + job.acc_stride * i, identity, acc_size);
+
+    run_job(&job, begin, end, grain, n_accs);
+
+    memcpy(result, identity, acc_size);
+    for (i = 0; i < n_accs; i++)
+        combine(result, job.accs + job.acc_stride * i, user_data);
+
+    g_aligned_free(job.accs);
+}
+
+guint
+crispy_parallel_get_concurrency(void)
+{
+    guint n;
+
+    g_mutex_lock(&pool.lock);
+    if (pool.concurrency == 0)
+        pool.concurrency = detect_concurrency();
+    n = pool.concurrency;
+    g_mutex_unlock(&pool.lock);
+
+    return n;
+}
+
+void
+crispy_parallel_set_concurrency(
+    guint n_threads
+){
+    g_mutex_lock(&pool.lock);
+    pool.concurrency = n_threads > 0 ? n_threads : detect_concurrency();
+    g_mutex_unlock(&pool.lock);
+}
+
+/*
+ * Stop and join the workers when libcrispy-runtime is unloaded, so no
+ * thread is left running code from an unmapped library.
+ */
+static void __attribute__((destructor))
+shutdown_pool(void)
+{
+    guint i;
+
+    g_mutex_lock(&pool.lock);
+    pool.shutdown = TRUE;
+    g_cond_broadcast(&pool.work_cond);
+    g_mutex_unlock(&pool.lock);
+
+    /* a forked child does not own the parent's worker threads */
+    if (pool.threads == NULL || pool.owner_pid != getpid())
+        return;
+
+    for (i = 0; i < pool.threads->len; i++)
+        g_thread_join(g_ptr_array_index(pool.threads, i));
+
+    g_ptr_array_unref(pool.threads);
+    pool.threads = NULL;
+    pool.n_workers = 0;
+}
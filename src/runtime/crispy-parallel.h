@@ -0,0 +1,141 @@
+/* crispy-parallel.h - Work-stealing data parallelism for crispy scripts */
+
+#ifndef CRISPY_PARALLEL_H
+#define CRISPY_PARALLEL_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyParallelFunc:
+ * @begin: first index of the chunk (inclusive)
+ * @end: last index of the chunk (exclusive)
+ * @user_data: data passed to crispy_parallel_for()
+ *
+ * Body of a parallel loop.  Called concurrently from several threads
+ * with disjoint [@begin, @end) sub-ranges.
+ */
+typedef void (*CrispyParallelFunc)      (gint64        begin,
+                                         gint64        end,
+                                         gpointer      user_data);
+
+/**
+ * CrispyReduceMapFunc:
+ * @begin: first index of the chunk (inclusive)
+ * @end: last index of the chunk (exclusive)
+ * @acc: this thread's private accumulator (acc_size bytes)
+ * @user_data: data passed to crispy_parallel_reduce()
+ *
+ * Folds the indices [@begin, @end) into @acc.  Each thread has its
+ * own accumulator, so no locking is needed.
+ */
+typedef void (*CrispyReduceMapFunc)     (gint64        begin,
+                                         gint64        end,
+                                         gpointer      acc,
+                                         gpointer      user_data);
+
+/**
+ * CrispyReduceCombineFunc:
+ * @acc: accumulator to update
+ * @other: accumulator to merge into @acc
+ * @user_data: data passed to crispy_parallel_reduce()
+ *
+ * Merges @other into @acc.  Must be associative; the order in which
+ * per-thread accumulators are combined is unspecified.
+ */
+typedef void (*CrispyReduceCombineFunc) (gpointer      acc,
+                                         gconstpointer other,
+                                         gpointer      user_data);
+
+/**
+ * crispy_parallel_for:
+ * @begin: first index (inclusive)
+ * @end: last index (exclusive)
+ * @grain: number of indices a thread takes at a time, or 0 to
+ *         pick one automatically
+ * @fn: (scope call): loop body
+ * @user_data: data passed to @fn
+ *
+ * Runs @fn over [@begin, @end) on the shared work-stealing pool and
+ * returns when every index has been processed.  The calling thread
+ * takes part in the work.
+ *
+ * The range is split evenly between the participating threads; a
+ * thread that runs out of work steals half of the remaining range of
+ * another thread, so uneven iterations balance automatically.
+ *
+ * The pool is started on first use and shared by every call in the
+ * process.  Calls from inside a running loop body (nested parallelism)
+ * run serially on the calling thread; calls from several unrelated
+ * threads at once are queued.
+ */
+void  crispy_parallel_for             (gint64                   begin,
+                                       gint64                   end,
+                                       gint64                   grain,
+                                       CrispyParallelFunc       fn,
+                                       gpointer                 user_data);
+
+/**
+ * crispy_parallel_reduce:
+ * @begin: first index (inclusive)
+ * @end: last index (exclusive)
+ * @grain: chunk size, or 0 to pick one automatically
+ * @result: (out caller-allocates): location of @acc_size bytes that
+ *          receives the combined result
+ * @acc_size: size of one accumulator in bytes
+ * @identity: initial value for each accumulator (@acc_size bytes)
+ * @map: (scope call): folds a chunk into an accumulator
+ * @combine: (scope call): merges two accumulators
+ * @user_data: data passed to @map and @combine
+ *
+ * Parallel reduction.  Every participating thread starts from a copy
+ * of @identity, folds the chunks it processes into it with @map, and
+ * the per-thread accumulators are then merged into @result with
+ * @combine on the calling thread.
+ *
+ * Because the split between threads depends on timing, floating
+ * point reductions may differ in the last bits between runs.
+ */
+void  crispy_parallel_reduce          (gint64                   begin,
+                                       gint64                   end,
+                                       gint64                   grain,
+                                       gpointer                 result,
+                                       gsize                    acc_size,
+                                       gconstpointer            identity,
+                                       CrispyReduceMapFunc      map,
+                                       CrispyReduceCombineFunc  combine,
+                                       gpointer                 user_data);
+
+/**
+ * crispy_parallel_get_concurrency:
+ *
+ * Returns the number of threads (including the caller) that take part
+ * in a parallel loop.  Unless changed with
+ * crispy_parallel_set_concurrency(), this is the number of CPUs the
+ * process may use: the affinity mask, capped by the cgroup CPU quota
+ * (cgroup v2 `cpu.max` or v1 `cpu.cfs_quota_us`).  The
+ * `CRISPY_NUM_THREADS` environment variable overrides detection.
+ *
+ * Returns: the concurrency level, at least 1
+ */
+guint crispy_parallel_get_concurrency (void);
+
+/**
+ * crispy_parallel_set_concurrency:
+ * @n_threads: number of threads to use, or 0 to restore the detected
+ *             default
+ *
+ * Changes how many threads later parallel loops use.  Extra worker
+ * threads are started on demand; lowering the value leaves surplus
+ * workers idle.  Useful for scaling benchmarks.
+ */
+void  crispy_parallel_set_concurrency (guint                    n_threads);
+
+G_END_DECLS
+
+#endif /* CRISPY_PARALLEL_H */
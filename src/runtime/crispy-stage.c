@@ -0,0 +1,460 @@
+/* crispy-stage.c - In-process pipeline stages for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-stage.h"
+
+#include <glib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Design
+ *
+ * Each pair of adjacent stages shares a ring: a power-of-two byte
+ * buffer with a free-running head (advanced only by the consumer) and
+ * tail (advanced only by the producer).  Both sides copy in or out and
+ * publish their new position with a release store, so the fast path
+ * takes no lock and makes no system call.
+ *
+ * Only a side that finds the ring full or empty blocks.  It spins
+ * briefly, then raises its "waiting" flag and sleeps on the ring's
+ * condition variable.  The other side checks the flag after each
+ * publish, behind a full fence, and takes the mutex only if it is set.
+ * Because the sleeper re-checks under the mutex after raising the
+ * flag, a wakeup cannot be lost.
+ */
+
+#define CRISPY_STAGE_CACHE_LINE   (64)
+#define CRISPY_STAGE_SPINS        (64)
+#define CRISPY_STAGE_WRITER_SIZE  (64 * 1024)
+#define CRISPY_STAGE_LINE_SIZE    (64 * 1024)
+
+typedef struct
+{
+    /* consumer side */
+    gsize     head __attribute__((aligned(CRISPY_STAGE_CACHE_LINE)));
+    gint      consumer_waiting;
+    gint      read_closed;
+
+    /* producer side */
+    gsize     tail __attribute__((aligned(CRISPY_STAGE_CACHE_LINE)));
+    gint      producer_waiting;
+    gint      write_closed;
+
+    /* fixed after creation */
+    gchar    *buf __attribute__((aligned(CRISPY_STAGE_CACHE_LINE)));
+    gsize     size;
+    GMutex    lock;
+    GCond     cond;
+} CrispyRing;
+
+struct _CrispyStage
+{
+    CrispyStageFunc   func;
+    gint              argc;
+    gchar           **argv;
+    gint              exit_code;
+
+    CrispyRing       *in;           /* NULL: standard input */
+    CrispyRing       *out;          /* NULL: standard output */
+    CrispyWriter     *output;
+
+    gchar            *line_buf;     /* crispy_stage_read_line() buffer */
+    gsize             line_size;
+    gsize             line_start;   /* first unconsumed byte */
+    gsize             line_end;     /* end of buffered input */
+};
+
+/* --- ring --- */
+
+static CrispyRing *
+ring_new(
+    gsize size
+){
+    CrispyRing *ring;
+
+    ring = g_new0(CrispyRing, 1);
+    ring->size = size;
+    ring->buf = (gchar *)g_malloc(size);
+    g_mutex_init(&ring->lock);
+    g_cond_init(&ring->cond);
+
+    return ring;
+}
+
+static void
+ring_free(
+    CrispyRing *ring
+){
+    g_mutex_clear(&ring->lock);
+    g_cond_clear(&ring->cond);
+    g_free(ring->buf);
+    g_free(ring);
+}
+
+/* consumer: is there data or end of input? */
+static gboolean
+ring_readable(
+    CrispyRing *ring
+){
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head ||
+           __atomic_load_n(&ring->write_closed, __ATOMIC_ACQUIRE);
+}
+
+/* producer: is there space, or nobody left to read? */
+static gboolean
+ring_writable(
+    CrispyRing *ring
+){
+    return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) <
+               ring->size ||
+           __atomic_load_n(&ring->read_closed, __ATOMIC_ACQUIRE);
+}
+
+static void
+ring_wait(
+    CrispyRing  *ring,
+    gint        *waiting,
+    gboolean   (*ready)(CrispyRing *ring)
+){
+    guint i;
+
+    for (i = 0; i < CRISPY_STAGE_SPINS; i++)
+    {
+        if (ready(ring))
+            return;
+        g_thread_yield();
+    }
+
+    g_mutex_lock(&ring->lock);
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!ready(ring))
+        g_cond_wait(&ring->cond, &ring->lock);
+    __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+    g_mutex_unlock(&ring->lock);
+}
+
+static void
+ring_wake(
+    CrispyRing *ring,
+    gint       *waiting
+){
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(waiting, __ATOMIC_RELAXED))
+        return;
+
+    g_mutex_lock(&ring->lock);
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+}
+
+/* --- helper: mark one end closed and wake whoever is asleep --- */
+static void
+ring_close(
+    CrispyRing *ring,
+    gint       *closed
+){
+    __atomic_store_n(closed, 1, __ATOMIC_SEQ_CST);
+
+    g_mutex_lock(&ring->lock);
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+}
+
+/* producer: copy all of @data in; FALSE once the reader is gone */
+static gboolean
+ring_write(
+    CrispyRing  *ring,
+    const gchar *data,
+    gsize        len
+){
+    gsize space;
+    gsize offset;
+    gsize first;
+    gsize n;
+
+    while (len > 0)
+    {
+        if (__atomic_load_n(&ring->read_closed, __ATOMIC_ACQUIRE))
+            return FALSE;
+
+        space = ring->size -
+                (ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+        if (space == 0)
+        {
+            ring_wait(ring, &ring->producer_waiting, ring_writable);
+            continue;
+        }
+
+        n = MIN(space, len);
+        offset = ring->tail & (ring->size - 1);
+        first = MIN(n, ring->size - offset);
+        memcpy(ring->buf + offset, data, first);
+        memcpy(ring->buf, data + first, n - first);
+
+        __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+        ring_wake(ring, &ring->consumer_waiting);
+
+        data += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+/* consumer: copy out up to @len bytes; 0 at end of input */
+static gsize
+ring_read(
+    CrispyRing *ring,
+    gchar      *buf,
+    gsize       len
+){
+    gsize avail;
+    gsize offset;
+    gsize first;
+    gsize n;
+
+    for (;;)
+    {
+        avail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head;
+        if (avail > 0)
+            break;
+
+        /* the producer publishes its last bytes before closing */
+        if (__atomic_load_n(&ring->write_closed, __ATOMIC_ACQUIRE))
+        {
+            avail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) -
+                    ring->head;
+            if (avail == 0)
+                return 0;
+            break;
+        }
+
+        ring_wait(ring, &ring->consumer_waiting, ring_readable);
+    }
+
+    n = MIN(avail, len);
+    offset = ring->head & (ring->size - 1);
+    first = MIN(n, ring->size - offset);
+    memcpy(buf, ring->buf + offset, first);
+    memcpy(buf + first, ring->buf, n - first);
+
+    __atomic_store_n(&ring->head, ring->head + n, __ATOMIC_RELEASE);
+    ring_wake(ring, &ring->producer_waiting);
+
+    return n;
+}
+
+/* CrispyWriterSinkFunc for a stage's output */
+static gboolean
+ring_sink(
+    gconstpointer data,
+    gsize         len,
+    gpointer      user_data
+){
+    return ring_write((CrispyRing *)user_data, (const gchar *)data, len);
+}
+
+/* --- stage input --- */
+
+static gssize
+stage_read_raw(
+    CrispyStage *stage,
+    gchar       *buf,
+    gsize        len
+){
+    gssize n;
+
+    if (stage->in != NULL)
+        return (gssize)ring_read(stage->in, buf, len);
+
+    do
+        n = read(STDIN_FILENO, buf, len);
+    while (n < 0 && errno == EINTR);
+
+    return n;
+}
+
+gssize
+crispy_stage_read(
+    CrispyStage *stage,
+    gpointer     buf,
+    gsize        len
+){
+    gsize n;
+
+    g_return_val_if_fail(stage != NULL, -1);
+    g_return_val_if_fail(buf != NULL || len == 0, -1);
+
+    /* hand out what crispy_stage_read_line() buffered first */
+    if (stage->line_start < stage->line_end)
+    {
+        n = MIN(len, stage->line_end - stage->line_start);
+        memcpy(buf, stage->line_buf + stage->line_start, n);
+        stage->line_start += n;
+        return (gssize)n;
+    }
+
+    return stage_read_raw(stage, (gchar *)buf, len);
+}
+
+gchar *
+crispy_stage_read_line(
+    CrispyStage *stage,
+    gsize       *len
+){
+    gchar *line;
+    gchar *newline;
+    gssize n;
+
+    g_return_val_if_fail(stage != NULL, NULL);
+
+    if (stage->line_buf == NULL)
+    {
+        stage->line_size = CRISPY_STAGE_LINE_SIZE;
+        stage->line_buf = (gchar *)g_malloc(stage->line_size);
+    }
+
+    for (;;)
+    {
+        newline = memchr(stage->line_buf + stage->line_start, '\n',
+                         stage->line_end - stage->line_start);
+        if (newline != NULL)
+        {
+            line = stage->line_buf + stage->line_start;
+            *newline = '\0';
+            if (len != NULL)
+                *len = (gsize)(newline - line);
+            stage->line_start = (gsize)(newline - stage->line_buf) + 1;
+            return line;
+        }
+
+        /* no complete line buffered: make room and read more */
+        if (stage->line_start > 0)
+        {
+            memmove(stage->line_buf, stage->line_buf + stage->line_start,
+                    stage->line_end - stage->line_start);
+            stage->line_end -= stage->line_start;
+            stage->line_start = 0;
+        }
+        if (stage->line_end + 1 >= stage->line_size)
+        {
+            stage->line_size *= 2;
+            stage->line_buf = (gchar *)g_realloc(stage->line_buf,
+                                                 stage->line_size);
+        }
+
+        /* one byte stays free for the terminator of a final line */
+        n = stage_read_raw(stage, stage->line_buf + stage->line_end,
+                           stage->line_size - stage->line_end - 1);
+        if (n <= 0)
+            break;
+        stage->line_end += (gsize)n;
+    }
+
+    if (stage->line_end == stage->line_start)
+        return NULL;
+
+    /* last line without a newline */
+    line = stage->line_buf + stage->line_start;
+    stage->line_buf[stage->line_end] = '\0';
+    if (len != NULL)
+        *len = stage->line_end - stage->line_start;
+    stage->line_start = stage->line_end;
+
+    return line;
+}
+
+CrispyWriter *
+crispy_stage_get_output(
+    CrispyStage *stage
+){
+    g_return_val_if_fail(stage != NULL, NULL);
+
+    return stage->output;
+}
+
+/* --- pipeline --- */
+
+static gpointer
+run_stage(
+    gpointer data
+){
+    CrispyStage *stage;
+
+    stage = (CrispyStage *)data;
+    stage->exit_code = stage->func(stage, stage->argc, stage->argv);
+
+    /* end of output for the next stage, broken pipe for the previous */
+    crispy_writer_flush(stage->output);
+    if (stage->out != NULL)
+        ring_close(stage->out, &stage->out->write_closed);
+    if (stage->in != NULL)
+        ring_close(stage->in, &stage->in->read_closed);
+
+    return NULL;
+}
+
+gint
+crispy_pipeline_run(
+    CrispyStageFunc  *stages,
+    gint             *argcs,
+    gchar          ***argvs,
+    guint             n_stages
+){
+    CrispyStage *stage;
+    CrispyRing **rings;
+    GThread **threads;
+    gint exit_code;
+    guint i;
+
+    g_return_val_if_fail(stages != NULL, -1);
+    g_return_val_if_fail(argcs != NULL && argvs != NULL, -1);
+    g_return_val_if_fail(n_stages > 0, -1);
+
+    stage = g_new0(CrispyStage, n_stages);
+    rings = g_new0(CrispyRing *, n_stages);
+    threads = g_new0(GThread *, n_stages);
+
+    for (i = 0; i + 1 < n_stages; i++)
+        rings[i] = ring_new(CRISPY_STAGE_RING_SIZE);
+
+    for (i = 0; i < n_stages; i++)
+    {
+        stage[i].func = stages[i];
+        stage[i].argc = argcs[i];
+        stage[i].argv = argvs[i];
+        stage[i].in = (i > 0) ? rings[i - 1] : NULL;
+        stage[i].out = rings[i];
+        stage[i].output = (stage[i].out != NULL)
+            ? crispy_writer_new_for_sink(ring_sink, stage[i].out,
+                                         CRISPY_STAGE_WRITER_SIZE)
+            : crispy_stdout();
+    }
+
+    /* the last stage runs on the calling thread */
+    for (i = 0; i + 1 < n_stages; i++)
+        threads[i] = g_thread_new("crispy-stage", run_stage, &stage[i]);
+    run_stage(&stage[n_stages - 1]);
+    for (i = 0; i + 1 < n_stages; i++)
+        g_thread_join(threads[i]);
+
+    exit_code = stage[n_stages - 1].exit_code;
+
+    for (i = 0; i < n_stages; i++)
+    {
+        if (stage[i].out != NULL)
+        {
+            crispy_writer_free(stage[i].output);
+            ring_free(stage[i].out);
+        }
+        g_free(stage[i].line_buf);
+    }
+    g_free(threads);
+    g_free(rings);
+    g_free(stage);
+
+    return exit_code;
+}
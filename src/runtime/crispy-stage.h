@@ -0,0 +1,117 @@
+/* crispy-stage.h - In-process pipeline stages for crispy scripts */
+
+#ifndef CRISPY_STAGE_H
+#define CRISPY_STAGE_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include "crispy-writer.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyStage:
+ *
+ * One stage of an in-process pipeline: its input is the previous
+ * stage's output (standard input for the first stage) and its output
+ * feeds the next stage (standard output for the last one).  Adjacent
+ * stages run on their own threads and are connected by a lock-free
+ * single-producer/single-consumer ring buffer, so no data passes
+ * through the kernel.
+ *
+ * A stage is owned by its thread and is not thread-safe.
+ */
+typedef struct _CrispyStage CrispyStage;
+
+/**
+ * CrispyStageFunc:
+ * @stage: the stage to read from and write to
+ * @argc: argument count for this stage
+ * @argv: (array length=argc): argument vector; argv[0] is the script
+ *
+ * Entry point of a stage.  Scripts that run under
+ * `crispy --pipeline` export it as `crispy_stage_main`.  Returning
+ * ends the stage: its output is flushed and closed, and the previous
+ * stage's further output is discarded.
+ *
+ * Returns: the stage's exit code
+ */
+typedef gint (*CrispyStageFunc) (CrispyStage  *stage,
+                                 gint          argc,
+                                 gchar       **argv);
+
+/**
+ * CRISPY_STAGE_RING_SIZE:
+ *
+ * Capacity in bytes of the ring between two stages.  Small enough to
+ * stay in L2 cache, large enough that neither side waits often.
+ */
+#define CRISPY_STAGE_RING_SIZE (256 * 1024)
+
+/**
+ * crispy_stage_read:
+ * @stage: a #CrispyStage
+ * @buf: (out caller-allocates): buffer to fill
+ * @len: size of @buf
+ *
+ * Reads up to @len bytes, waiting until at least one is available.
+ *
+ * Returns: the number of bytes read, 0 at end of input, or -1 on a
+ *          read error from standard input
+ */
+gssize        crispy_stage_read       (CrispyStage  *stage,
+                                       gpointer      buf,
+                                       gsize         len);
+
+/**
+ * crispy_stage_read_line:
+ * @stage: a #CrispyStage
+ * @len: (out) (optional): length of the line, without the newline
+ *
+ * Returns the next line of input with its newline replaced by a nul.
+ * The last line need not end with a newline.
+ *
+ * Returns: (transfer none) (nullable): the line, valid until the next
+ *          read from @stage, or %NULL at end of input
+ */
+gchar        *crispy_stage_read_line  (CrispyStage  *stage,
+                                       gsize        *len);
+
+/**
+ * crispy_stage_get_output:
+ * @stage: a #CrispyStage
+ *
+ * Returns the writer for this stage's output: one that fills the ring
+ * to the next stage, or crispy_stdout() for the last stage.  Writes
+ * fail once the next stage has returned.
+ *
+ * Returns: (transfer none): the output #CrispyWriter
+ */
+CrispyWriter *crispy_stage_get_output (CrispyStage  *stage);
+
+/**
+ * crispy_pipeline_run:
+ * @stages: (array length=n_stages): entry point of each stage, in order
+ * @argcs: (array length=n_stages): argument count of each stage
+ * @argvs: (array length=n_stages): argument vector of each stage
+ * @n_stages: number of stages, at least 1
+ *
+ * Runs the stages concurrently, each on its own thread, connected
+ * first to last, and returns once all of them have returned.  This is
+ * what `crispy --pipeline` calls.  A stage script can also call it
+ * with just itself from main(), which lets the same script run alone
+ * or in a shell pipeline.
+ *
+ * Returns: the last stage's exit code, as a shell pipeline would
+ */
+gint          crispy_pipeline_run     (CrispyStageFunc  *stages,
+                                       gint             *argcs,
+                                       gchar          ***argvs,
+                                       guint             n_stages);
+
+G_END_DECLS
+
+#endif /* CRISPY_STAGE_H */
@@ -0,0 +1,57 @@
+/* crispy-timer.c - Monotonic timer for in-script measurement */
+
+#define CRISPY_COMPILATION
+#include "crispy-timer.h"
+
+#include <glib.h>
+#include <time.h>
+
+gint64
+crispy_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + (gint64)ts.tv_nsec;
+}
+
+void
+crispy_timer_start(
+    CrispyTimer *timer
+){
+    g_return_if_fail(timer != NULL);
+
+    timer->start_ns = crispy_time_ns();
+}
+
+gint64
+crispy_timer_elapsed_ns(
+    const CrispyTimer *timer
+){
+    g_return_val_if_fail(timer != NULL, 0);
+
+    return crispy_time_ns() - timer->start_ns;
+}
+
+gdouble
+crispy_timer_elapsed_ms(
+    const CrispyTimer *timer
+){
+    return (gdouble)crispy_timer_elapsed_ns(timer) / 1e6;
+}
+
+gint64
+crispy_timer_lap_ns(
+    CrispyTimer *timer
+){
+    gint64 now;
+    gint64 elapsed;
+
+    g_return_val_if_fail(timer != NULL, 0);
+
+    now = crispy_time_ns();
+    elapsed = now - timer->start_ns;
+    timer->start_ns = now;
+
+    return elapsed;
+}
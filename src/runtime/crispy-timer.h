@@ -0,0 +1,73 @@
+/* crispy-timer.h - Monotonic timer for in-script measurement */
+
+#ifndef CRISPY_TIMER_H
+#define CRISPY_TIMER_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyTimer:
+ * @start_ns: monotonic timestamp of the last start or lap, in nanoseconds
+ *
+ * A stack-allocated stopwatch.  Unlike #GTimer it needs no heap
+ * allocation and reports nanoseconds.
+ */
+typedef struct
+{
+    gint64 start_ns;
+} CrispyTimer;
+
+/**
+ * crispy_time_ns:
+ *
+ * Reads CLOCK_MONOTONIC.  The epoch is arbitrary; only differences
+ * between two readings are meaningful.
+ *
+ * Returns: the current monotonic time in nanoseconds
+ */
+gint64  crispy_time_ns              (void);
+
+/**
+ * crispy_timer_start:
+ * @timer: a #CrispyTimer
+ *
+ * (Re)starts @timer at the current time.
+ */
+void    crispy_timer_start          (CrispyTimer       *timer);
+
+/**
+ * crispy_timer_elapsed_ns:
+ * @timer: a started #CrispyTimer
+ *
+ * Returns: nanoseconds since @timer was started
+ */
+gint64  crispy_timer_elapsed_ns     (const CrispyTimer *timer);
+
+/**
+ * crispy_timer_elapsed_ms:
+ * @timer: a started #CrispyTimer
+ *
+ * Returns: milliseconds since @timer was started, with fractional part
+ */
+gdouble crispy_timer_elapsed_ms     (const CrispyTimer *timer);
+
+/**
+ * crispy_timer_lap_ns:
+ * @timer: a started #CrispyTimer
+ *
+ * Returns the time since the last start or lap and restarts @timer,
+ * for timing consecutive phases with a single timer.
+ *
+ * Returns: nanoseconds since the previous start or lap
+ */
+gint64  crispy_timer_lap_ns         (CrispyTimer       *timer);
+
+G_END_DECLS
+
+#endif /* CRISPY_TIMER_H */
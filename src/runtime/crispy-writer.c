@@ -0,0 +1,291 @@
+/* crispy-writer.c - Large-buffer output writer for crispy scripts */
+
+#define CRISPY_COMPILATION
+#include "crispy-writer.h"
+
+#include <glib.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+struct _CrispyWriter
+{
+    gint                  fd;         /* -1 when writing to a sink */
+    CrispyWriterSinkFunc  sink;
+    gpointer              sink_data;
+    gchar                *buf;
+    gsize                 size;
+    gsize                 len;
+    gboolean              failed;     /* sticky: set once any write fails */
+};
+
+static CrispyWriter *stdout_writer = NULL;
+
+static CrispyWriter *
+resolve_writer(
+    CrispyWriter *writer
+){
+    return writer != NULL ? writer : crispy_stdout();
+}
+
+/* --- helper: hand @data to the sink, or write(2) all of it, retrying --- */
+static gboolean
+write_all(
+    CrispyWriter  *writer,
+    const gchar   *data,
+    gsize          len
+){
+    gssize n;
+
+    if (writer->sink != NULL)
+    {
+        if (!writer->sink(data, len, writer->sink_data))
+            writer->failed = TRUE;
+        return !writer->failed;
+    }
+
+    if (writer->fd == STDOUT_FILENO)
+        fflush(stdout);
+
+    while (len > 0)
+    {
+        n = write(writer->fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            writer->failed = TRUE;
+            return FALSE;
+        }
+        data += n;
+        len -= (gsize)n;
+    }
+
+    return TRUE;
+}
+
+/* --- public API --- */
+
+CrispyWriter *
+crispy_writer_new(
+    gint  fd,
+    gsize buffer_size
+){
+    CrispyWriter *writer;
+
+    g_return_val_if_fail(fd >= 0, NULL);
+
+    writer = g_new0(CrispyWriter, 1);
+    writer->fd = fd;
+    writer->size = buffer_size > 0
+        ? buffer_size
+        : CRISPY_WRITER_DEFAULT_BUFFER_SIZE;
+    writer->buf = (gchar *)g_malloc(writer->size);
+
+    return writer;
+}
+
+CrispyWriter *
+crispy_writer_new_for_sink(
+    CrispyWriterSinkFunc sink,
+    gpointer             user_data,
+    gsize                buffer_size
+){
+    CrispyWriter *writer;
+
+    g_return_val_if_fail(sink != NULL, NULL);
+
+    writer = crispy_writer_new(0, buffer_size);
+    writer->fd = -1;
+    writer->sink = sink;
+    writer->sink_data = user_data;
+
+    return writer;
+}
+
+CrispyWriter *
+crispy_stdout(void)
+{
+    if (g_once_init_enter(&stdout_writer))
+        g_once_init_leave(&stdout_writer, crispy_writer_new(STDOUT_FILENO, 0));
+
+    return stdout_writer;
+}
+
+gboolean
+crispy_writer_flush(
+    CrispyWriter *writer
+){
+    writer = resolve_writer(writer);
+
+    if (writer->len > 0)
+    {
+        write_all(writer, writer->buf, writer->len);
+        writer->len = 0;
+    }
+
+    return !writer->failed;
+}
+
+void
+crispy_writer_write(
+    CrispyWriter  *writer,
+    gconstpointer  data,
+    gsize          len
+){
+    writer = resolve_writer(writer);
+
+    if (writer->size - writer->len >= len)
+    {
+        memcpy(writer->buf + writer->len, data, len);
+        writer->len += len;
+        return;
+    }
+
+    crispy_writer_flush(writer);
+
+    /* anything that would not fit an empty buffer goes straight out */
+    if (len >= writer->size)
+    {
+        write_all(writer, (const gchar *)data, len);
+        return;
+    }
+
+    memcpy(writer->buf, data, len);
+    writer->len = len;
+}
+
+void
+crispy_writer_puts(
+    CrispyWriter *writer,
+    const gchar  *str
+){
+    g_return_if_fail(str != NULL);
+
+    crispy_writer_write(writer, str, strlen(str));
+}
+
+void
+crispy_writer_putc(
+    CrispyWriter *writer,
+    gchar         c
+){
+    writer = resolve_writer(writer);
+
+    if (writer->len == writer->size)
+        crispy_writer_flush(writer);
+
+    writer->buf[writer->len++] = c;
+}
+
+void
+crispy_writer_write_int(
+    CrispyWriter *writer,
+    gint64        value
+){
+    gchar digits[24];
+    gchar *p;
+    guint64 magnitude;
+
+    /* format right to left; negate in unsigned space so INT64_MIN works */
+    p = digits + sizeof(digits);
+    magnitude = value < 0 ? (guint64)0 - (guint64)value : (guint64)value;
+
+    do
+    {
+        *--p = (gchar)('0' + (magnitude % 10));
+        magnitude /= 10;
+    }
+    while (magnitude != 0);
+
+    if (value < 0)
+        *--p = '-';
+
+    crispy_writer_write(writer, p, (gsize)(digits + sizeof(digits) - p));
+}
+
+void
+crispy_writer_printf(
+    CrispyWriter *writer,
+    const gchar  *format,
+    ...
+){
+    va_list args;
+    gint needed;
+
+    g_return_if_fail(format != NULL);
+
+    writer = resolve_writer(writer);
+
+    /* try to format straight into the free space of the buffer */
+    va_start(args, format);
+    needed = vsnprintf(writer->buf + writer->len,
+                       writer->size - writer->len, format, args);
+    va_end(args);
+
+    if (needed < 0)
+        return;
+
+    if ((gsize)needed < writer->size - writer->len)
+    {
+        writer->len += (gsize)needed;
+        return;
+    }
+
+    /* did not fit: flush and retry, or format on the heap if huge */
+    crispy_writer_flush(writer);
+
+    if ((gsize)needed < writer->size)
+    {
+        va_start(args, format);
+        vsnprintf(writer->buf, writer->size, format, args);
+        va_end(args);
+        writer->len = (gsize)needed;
+    }
+    else
+    {
+        g_autofree gchar *str = NULL;
+
+        va_start(args, format);
+        str = g_strdup_vprintf(format, args);
+        va_end(args);
+        write_all(writer, str, (gsize)needed);
+    }
+}
+
+void
+crispy_writer_free(
+    CrispyWriter *writer
+){
+    if (writer == NULL)
+        return;
+
+    crispy_writer_flush(writer);
+
+    if (writer == stdout_writer)
+        return;
+
+    g_free(writer->buf);
+    g_free(writer);
+}
+
+/*
+ * Flush and release the stdout writer when libcrispy-runtime is
+ * unloaded (crispy closes the script module) or at process exit.
+ */
+static void __attribute__((destructor))
+release_stdout_writer(void)
+{
+    CrispyWriter *writer;
+
+    writer = stdout_writer;
+    stdout_writer = NULL;
+    if (writer == NULL)
+        return;
+
+    crispy_writer_flush(writer);
+    g_free(writer->buf);
+    g_free(writer);
+}
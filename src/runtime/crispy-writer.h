@@ -0,0 +1,169 @@
+/* crispy-writer.h - Large-buffer output writer for crispy scripts */
+
+#ifndef CRISPY_WRITER_H
+#define CRISPY_WRITER_H
+
+#if !defined(CRISPY_RUNTIME_INSIDE) && !defined(CRISPY_COMPILATION)
+#error "Only <crispy-runtime.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * CrispyWriter:
+ *
+ * An opaque buffered writer on top of a raw file descriptor or a
+ * #CrispyWriterSinkFunc.  Output
+ * is collected in a large buffer and written with as few write()
+ * calls as possible, which is considerably faster than stdio for
+ * scripts that print millions of lines.
+ *
+ * A writer is not thread-safe.
+ */
+typedef struct _CrispyWriter CrispyWriter;
+
+/**
+ * CrispyWriterSinkFunc:
+ * @data: bytes to deliver
+ * @len: number of bytes in @data
+ * @user_data: data passed to crispy_writer_new_for_sink()
+ *
+ * Receives a writer's output in place of write(2).  Called with whole
+ * buffers, so it runs rarely.
+ *
+ * Returns: %FALSE if the bytes could not be delivered; the writer then
+ *          reports failure from crispy_writer_flush()
+ */
+typedef gboolean (*CrispyWriterSinkFunc) (gconstpointer data,
+                                          gsize         len,
+                                          gpointer      user_data);
+
+/**
+ * CRISPY_WRITER_DEFAULT_BUFFER_SIZE:
+ *
+ * Buffer size used when crispy_writer_new() is given 0.
+ */
+#define CRISPY_WRITER_DEFAULT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * crispy_writer_new:
+ * @fd: file descriptor to write to (not closed by the writer)
+ * @buffer_size: buffer size in bytes, or 0 for
+ *               %CRISPY_WRITER_DEFAULT_BUFFER_SIZE
+ *
+ * Returns: (transfer full): a new #CrispyWriter
+ */
+CrispyWriter *crispy_writer_new       (gint          fd,
+                                       gsize         buffer_size);
+
+/**
+ * crispy_writer_new_for_sink:
+ * @sink: function that receives each full buffer
+ * @user_data: data passed to @sink
+ * @buffer_size: buffer size in bytes, or 0 for
+ *               %CRISPY_WRITER_DEFAULT_BUFFER_SIZE
+ *
+ * Creates a writer that hands its output to @sink instead of a file
+ * descriptor.  Pipeline stages use one to write into the next stage's
+ * ring buffer.
+ *
+ * Returns: (transfer full): a new #CrispyWriter
+ */
+CrispyWriter *crispy_writer_new_for_sink (CrispyWriterSinkFunc sink,
+                                          gpointer             user_data,
+                                          gsize                buffer_size);
+
+/**
+ * crispy_stdout:
+ *
+ * Returns the shared writer for standard output.  It is created on
+ * first use and flushed automatically when the script finishes.
+ *
+ * The writer calls fflush(stdout) before each flush so that text
+ * printed earlier with g_print() or printf() keeps its order.
+ *
+ * Returns: (transfer none): the stdout #CrispyWriter
+ */
+CrispyWriter *crispy_stdout           (void);
+
+/**
+ * crispy_writer_write:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ * @data: bytes to write
+ * @len: number of bytes in @data
+ *
+ * Appends @len bytes to the buffer, flushing as needed.  Writes
+ * larger than the buffer bypass it.
+ */
+void          crispy_writer_write     (CrispyWriter *writer,
+                                       gconstpointer data,
+                                       gsize         len);
+
+/**
+ * crispy_writer_puts:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ * @str: a nul-terminated string
+ *
+ * Appends @str.  Unlike puts(3), no newline is added.
+ */
+void          crispy_writer_puts      (CrispyWriter *writer,
+                                       const gchar  *str);
+
+/**
+ * crispy_writer_putc:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ * @c: the byte to append
+ *
+ * Appends a single byte.
+ */
+void          crispy_writer_putc      (CrispyWriter *writer,
+                                       gchar         c);
+
+/**
+ * crispy_writer_write_int:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ * @value: the integer to format
+ *
+ * Appends @value in decimal without going through printf().
+ */
+void          crispy_writer_write_int (CrispyWriter *writer,
+                                       gint64        value);
+
+/**
+ * crispy_writer_printf:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ * @format: printf()-style format string
+ * @...: arguments for @format
+ *
+ * Formats directly into the buffer.
+ */
+void          crispy_writer_printf    (CrispyWriter *writer,
+                                       const gchar  *format,
+                                       ...) G_GNUC_PRINTF(2, 3);
+
+/**
+ * crispy_writer_flush:
+ * @writer: (nullable): a #CrispyWriter, or %NULL for crispy_stdout()
+ *
+ * Writes out everything buffered so far.
+ *
+ * Returns: %FALSE if this or any earlier write failed (errno is
+ *          preserved from the failing call), %TRUE otherwise
+ */
+gboolean      crispy_writer_flush     (CrispyWriter *writer);
+
+/**
+ * crispy_writer_free:
+ * @writer: (nullable): a #CrispyWriter
+ *
+ * Flushes and frees @writer.  Passing crispy_stdout() only flushes it.
+ */
+void          crispy_writer_free      (CrispyWriter *writer);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CrispyWriter, crispy_writer_free)
+
+G_END_DECLS
+
+#endif /* CRISPY_WRITER_H */
@@ -0,0 +1,235 @@
+/* test-concurrency.c - Stress tests for sharing libcrispy objects across threads */
+
+/*
+ * Several threads run complete script pipelines at once against one
+ * CrispyGccCompiler, one CrispyFileCache and one CrispyPluginEngine.
+ * Build with `make DEBUG=1 TSAN=1 test` to run them under
+ * ThreadSanitizer.
+ */
+
+#define CRISPY_COMPILATION
+#include "../src/crispy.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define N_THREADS     (8)
+#define N_ITERATIONS  (4)
+
+/* shared by every pipeline thread */
+static CrispyGccCompiler *g_compiler = NULL;
+static CrispyFileCache *g_cache = NULL;
+static gchar *plugin_dir = NULL;
+
+typedef struct
+{
+    CrispyPluginEngine *engine;
+    guint               index;
+} PipelineArgs;
+
+/* --- helper: get path to a test plugin --- */
+static gchar *
+get_test_plugin_path(
+    const gchar *name
+){
+    return g_strdup_printf("%s/test-plugin-%s.so", plugin_dir, name);
+}
+
+/*
+ * run_pipelines:
+ *
+ * Thread body: compiles and runs N_ITERATIONS scripts.  Even threads
+ * all run the same source, so they race on one cache entry; odd
+ * threads each get their own.  The first iteration forces a compile,
+ * so the shared entry is also rebuilt while others load it.
+ */
+static gpointer
+run_pipelines(
+    gpointer user_data
+){
+    PipelineArgs *args;
+    guint i;
+
+    args = (PipelineArgs *)user_data;
+
+    for (i = 0; i < N_ITERATIONS; i++)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(CrispyScript) script = NULL;
+        g_autofree gchar *body = NULL;
+        gint expected;
+        gint exit_code;
+        gchar *argv[] = { "test", NULL };
+
+        expected = (args->index % 2 == 0) ? 7 : (gint)(10 + args->index);
+        body = g_strdup_printf("return %d;", expected);
+
+        script = crispy_script_new_from_inline(
+            body, NULL,
+            CRISPY_COMPILER(g_compiler),
+            CRISPY_CACHE_PROVIDER(g_cache),
+            i == 0 ? CRISPY_FLAG_FORCE_COMPILE : CRISPY_FLAG_NONE,
+            &error);
+        g_assert_no_error(error);
+
+        if (args->engine != NULL)
+            crispy_script_set_plugin_engine(script, args->engine);
+
+        exit_code = crispy_script_execute(script, 1, argv, &error);
+        g_assert_no_error(error);
+        g_assert_cmpint(exit_code, ==, expected);
+    }
+
+    return NULL;
+}
+
+/*
+ * hammer_engine:
+ *
+ * Thread body: churns the data store and loads more plugins while the
+ * pipelines are dispatching hooks through the same engine.
+ */
+static gpointer
+hammer_engine(
+    gpointer user_data
+){
+    CrispyPluginEngine *engine;
+    g_autofree gchar *path = NULL;
+    guint i;
+
+    engine = (CrispyPluginEngine *)user_data;
+    path = get_test_plugin_path("noop");
+
+    for (i = 0; i < 200; i++)
+    {
+        g_autofree gchar *key = NULL;
+
+        key = g_strdup_printf("stress-%u", i % 16);
+        crispy_plugin_engine_set_data(engine, key,
+                                      g_strdup(key), g_free);
+        g_assert_cmpstr(crispy_plugin_engine_get_data(engine, key), ==, key);
+        g_assert_nonnull(crispy_plugin_engine_get_data(engine, "test-counter"));
+
+        if (i % 50 == 0)
+        {
+            g_autoptr(GError) error = NULL;
+
+            crispy_plugin_engine_load(engine, path, &error);
+            g_assert_no_error(error);
+        }
+    }
+
+    return NULL;
+}
+
+/* --- tests --- */
+
+/**
+ * test_concurrent_pipelines:
+ *
+ * N_THREADS pipelines share one compiler and cache, with no plugins.
+ */
+static void
+test_concurrent_pipelines(void)
+{
+    GThread *threads[N_THREADS];
+    PipelineArgs args[N_THREADS];
+    guint i;
+
+    for (i = 0; i < N_THREADS; i++)
+    {
+        args[i].engine = NULL;
+        args[i].index = i;
+        threads[i] = g_thread_new("pipeline", run_pipelines, &args[i]);
+    }
+
+    for (i = 0; i < N_THREADS; i++)
+        g_thread_join(threads[i]);
+}
+
+/**
+ * test_concurrent_engine:
+ *
+ * N_THREADS pipelines share one plugin engine as well.  The counter
+ * plugin bumps a data-store value after every run while another
+ * thread writes to the data store and loads plugins; every execution
+ * must be counted exactly once.
+ */
+static void
+test_concurrent_engine(void)
+{
+    g_autoptr(CrispyPluginEngine) engine = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *path = NULL;
+    GThread *threads[N_THREADS];
+    GThread *hammer;
+    PipelineArgs args[N_THREADS];
+    gint *count;
+    guint i;
+
+    engine = crispy_plugin_engine_new();
+
+    path = get_test_plugin_path("counter");
+    crispy_plugin_engine_load(engine, path, &error);
+    g_assert_no_error(error);
+
+    count = g_new0(gint, 1);
+    crispy_plugin_engine_set_data(engine, "test-counter", count, g_free);
+
+    hammer = g_thread_new("hammer", hammer_engine, engine);
+    for (i = 0; i < N_THREADS; i++)
+    {
+        args[i].engine = engine;
+        args[i].index = i;
+        threads[i] = g_thread_new("pipeline", run_pipelines, &args[i]);
+    }
+
+    for (i = 0; i < N_THREADS; i++)
+        g_thread_join(threads[i]);
+    g_thread_join(hammer);
+
+    g_assert_cmpint(g_atomic_int_get(count), ==, N_THREADS * N_ITERATIONS);
+    g_assert_cmpuint(crispy_plugin_engine_get_plugin_count(engine), ==, 5);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *cache_dir = NULL;
+    gint ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    /* determine plugin directory from LD_LIBRARY_PATH or default */
+    plugin_dir = g_strdup(g_getenv("LD_LIBRARY_PATH"));
+    if (plugin_dir == NULL || plugin_dir[0] == '\0')
+    {
+        g_free(plugin_dir);
+        plugin_dir = g_strdup("build/release");
+    }
+
+    /* private cache so concurrent rebuilds don't touch the user's */
+    cache_dir = g_dir_make_tmp("crispy-test-concurrency-XXXXXX", &error);
+    g_assert_no_error(error);
+
+    g_compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+    g_cache = crispy_file_cache_new_with_dir(cache_dir);
+
+    g_test_add_func("/concurrency/pipelines", test_concurrent_pipelines);
+    g_test_add_func("/concurrency/engine", test_concurrent_engine);
+
+    ret = g_test_run();
+
+    crispy_cache_provider_purge(CRISPY_CACHE_PROVIDER(g_cache), NULL);
+    g_rmdir(cache_dir);
+
+    g_clear_object(&g_compiler);
+    g_clear_object(&g_cache);
+    g_free(plugin_dir);
+
+    return ret;
+}
@@ -252,6 +252,134 @@ test_config_context_cache_dir(void)
     crispy_config_context_clear_internal(&ctx);
 }
 
+/* test: placement setters, unset by default */
+static void
+test_config_context_placement(void)
+{
+    CrispyConfigContext ctx;
+    const gchar *cpus;
+    const gchar *sched;
+    gint numa_node;
+
+    init_test_ctx(&ctx, 0, NULL);
+
+    crispy_config_context_get_placement_internal(&ctx, &cpus, &numa_node,
+                                                 &sched);
+    g_assert_null(cpus);
+    g_assert_cmpint(numa_node, ==, -1);
+    g_assert_null(sched);
+
+    crispy_config_context_set_cpus(&ctx, "0-3,8");
+    crispy_config_context_set_numa_node(&ctx, 1);
+    crispy_config_context_set_sched(&ctx, "fifo:10");
+    crispy_config_context_get_placement_internal(&ctx, &cpus, &numa_node,
+                                                 &sched);
+    g_assert_cmpstr(cpus, ==, "0-3,8");
+    g_assert_cmpint(numa_node, ==, 1);
+    g_assert_cmpstr(sched, ==, "fifo:10");
+
+    /* NULL and negative values unset again */
+    crispy_config_context_set_cpus(&ctx, NULL);
+    crispy_config_context_set_numa_node(&ctx, -5);
+    crispy_config_context_get_placement_internal(&ctx, &cpus, &numa_node,
+                                                 &sched);
+    g_assert_null(cpus);
+    g_assert_cmpint(numa_node, ==, -1);
+
+    crispy_config_context_clear_internal(&ctx);
+}
+
+/* test: allocator default */
+static void
+test_config_context_allocator(void)
+{
+    CrispyConfigContext ctx;
+
+    init_test_ctx(&ctx, 0, NULL);
+
+    g_assert_null(crispy_config_context_get_allocator_internal(&ctx));
+
+    crispy_config_context_set_allocator(&ctx, "mimalloc");
+    g_assert_cmpstr(
+        crispy_config_context_get_allocator_internal(&ctx),
+        ==, "mimalloc");
+
+    crispy_config_context_set_allocator(&ctx, NULL);
+    g_assert_null(crispy_config_context_get_allocator_internal(&ctx));
+
+    crispy_config_context_clear_internal(&ctx);
+}
+
+/* test: telemetry paths default to unset and can be cleared */
+static void
+test_config_context_telemetry(void)
+{
+    CrispyConfigContext ctx;
+    const gchar *log_path;
+    const gchar *metrics_path;
+
+    init_test_ctx(&ctx, 0, NULL);
+
+    crispy_config_context_get_telemetry_internal(&ctx, &log_path,
+                                                 &metrics_path);
+    g_assert_null(log_path);
+    g_assert_null(metrics_path);
+
+    crispy_config_context_set_telemetry(&ctx, "/tmp/runs.jsonl",
+                                        "/tmp/crispy.prom");
+    crispy_config_context_get_telemetry_internal(&ctx, &log_path,
+                                                 &metrics_path);
+    g_assert_cmpstr(log_path, ==, "/tmp/runs.jsonl");
+    g_assert_cmpstr(metrics_path, ==, "/tmp/crispy.prom");
+
+    crispy_config_context_set_telemetry(&ctx, NULL, "/tmp/other.prom");
+    crispy_config_context_get_telemetry_internal(&ctx, &log_path,
+                                                 &metrics_path);
+    g_assert_null(log_path);
+    g_assert_cmpstr(metrics_path, ==, "/tmp/other.prom");
+
+    crispy_config_context_clear_internal(&ctx);
+}
+
+/* test: a snapshot round-trips, a damaged one is refused */
+static void
+test_config_context_snapshot(void)
+{
+    g_autoptr(GVariant) snapshot = NULL;
+    g_autoptr(GVariant) damaged = NULL;
+    CrispyConfigContext ctx;
+    gchar *script_argv[] = { "test.c", NULL };
+    static const guchar garbage[16] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+
+    init_test_ctx(&ctx, 1, script_argv);
+    crispy_config_context_set_extra_flags(&ctx, "-lm");
+    crispy_config_context_add_plugin(&ctx, "/p/timing.so");
+    snapshot = crispy_config_context_to_variant_internal(&ctx);
+    crispy_config_context_clear_internal(&ctx);
+
+    init_test_ctx(&ctx, 1, script_argv);
+    g_assert_true(crispy_config_context_apply_variant_internal(&ctx,
+                                                               snapshot));
+    g_assert_cmpstr(crispy_config_context_get_extra_flags_internal(&ctx),
+                    ==, "-lm");
+    g_assert_cmpuint(
+        crispy_config_context_get_plugin_paths_internal(&ctx)->len, ==, 1);
+    crispy_config_context_clear_internal(&ctx);
+
+    /* the right type, as the loader reads it, but not a real snapshot */
+    damaged = g_variant_ref_sink(g_variant_new_from_data(
+        G_VARIANT_TYPE(CRISPY_CONFIG_SNAPSHOT_TYPE), garbage,
+        sizeof(garbage), FALSE, NULL, NULL));
+    init_test_ctx(&ctx, 1, script_argv);
+    g_assert_false(crispy_config_context_apply_variant_internal(&ctx,
+                                                                damaged));
+    g_assert_null(crispy_config_context_get_extra_flags_internal(&ctx));
+    crispy_config_context_clear_internal(&ctx);
+}
+
 /* test: set_script_argv replaces argv and takes ownership */
 static void
 test_config_context_set_script_argv(void)
@@ -311,6 +439,14 @@ main(
                      test_config_context_flags);
     g_test_add_func("/config-context/cache-dir",
                      test_config_context_cache_dir);
+    g_test_add_func("/config-context/placement",
+                     test_config_context_placement);
+    g_test_add_func("/config-context/allocator",
+                     test_config_context_allocator);
+    g_test_add_func("/config-context/telemetry",
+                     test_config_context_telemetry);
+    g_test_add_func("/config-context/snapshot",
+                     test_config_context_snapshot);
     g_test_add_func("/config-context/set-script-argv",
                      test_config_context_set_script_argv);
 
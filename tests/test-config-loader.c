@@ -375,6 +375,97 @@ test_config_loader_sets_multiple_fields(void)
     cleanup_temp_config(config_path);
 }
 
+/* --- helper: load @config_path into a fresh @ctx --- */
+static void
+load_config(
+    const gchar         *config_path,
+    CrispyCompiler      *compiler,
+    CrispyCacheProvider *cache,
+    CrispyConfigContext *ctx
+){
+    g_autoptr(GError) error = NULL;
+    gboolean result;
+
+    crispy_config_context_init_internal(ctx, 0, NULL, 0, NULL, NULL);
+    result = crispy_config_loader_compile_and_load(config_path, compiler,
+                                                   cache, ctx, &error);
+    g_assert_no_error(error);
+    g_assert_true(result);
+}
+
+/* test: a pure config runs once; later loads apply its snapshot */
+static void
+test_config_loader_pure_snapshot(void)
+{
+    g_autoptr(CrispyGccCompiler) compiler = NULL;
+    g_autoptr(CrispyFileCache) cache = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *input_path = NULL;
+    CrispyConfigContext ctx;
+    const gchar *cpus;
+    const gchar *sched;
+    gint numa_node;
+    gchar *config_path;
+
+    compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+
+    cache = crispy_file_cache_new();
+
+    /* counts its runs in the environment, which a snapshot skips */
+    config_path = write_temp_config(
+        "#define CRISPY_CONFIG_PURE \"input.txt\"\n"
+        "#include <crispy.h>\n"
+        "G_MODULE_EXPORT gboolean\n"
+        "crispy_config_init(CrispyConfigContext *ctx)\n"
+        "{\n"
+        "    const gchar *runs = g_getenv(\"CRISPY_TEST_CONFIG_RUNS\");\n"
+        "    g_setenv(\"CRISPY_TEST_CONFIG_RUNS\",\n"
+        "             runs == NULL ? \"1\" : \"2\", TRUE);\n"
+        "    crispy_config_context_set_extra_flags(ctx, \"-lm\");\n"
+        "    crispy_config_context_add_plugin(ctx, \"/p/timing.so\");\n"
+        "    crispy_config_context_set_numa_node(ctx, 0);\n"
+        "    return TRUE;\n"
+        "}\n");
+
+    /* a relative input is resolved against the config's directory */
+    dir = g_path_get_dirname(config_path);
+    input_path = g_build_filename(dir, "input.txt", NULL);
+    g_file_set_contents(input_path, dir, -1, &error);
+    g_assert_no_error(error);
+
+    g_unsetenv("CRISPY_TEST_CONFIG_RUNS");
+    load_config(config_path, CRISPY_COMPILER(compiler),
+                CRISPY_CACHE_PROVIDER(cache), &ctx);
+    g_assert_cmpstr(g_getenv("CRISPY_TEST_CONFIG_RUNS"), ==, "1");
+    crispy_config_context_clear_internal(&ctx);
+
+    load_config(config_path, CRISPY_COMPILER(compiler),
+                CRISPY_CACHE_PROVIDER(cache), &ctx);
+    g_assert_cmpstr(g_getenv("CRISPY_TEST_CONFIG_RUNS"), ==, "1");
+    g_assert_cmpstr(
+        crispy_config_context_get_extra_flags_internal(&ctx), ==, "-lm");
+    g_assert_cmpuint(
+        crispy_config_context_get_plugin_paths_internal(&ctx)->len, ==, 1);
+    crispy_config_context_get_placement_internal(&ctx, &cpus, &numa_node,
+                                                 &sched);
+    g_assert_cmpint(numa_node, ==, 0);
+    crispy_config_context_clear_internal(&ctx);
+
+    /* a changed input runs the config again */
+    g_file_set_contents(input_path, "changed", -1, &error);
+    g_assert_no_error(error);
+    load_config(config_path, CRISPY_COMPILER(compiler),
+                CRISPY_CACHE_PROVIDER(cache), &ctx);
+    g_assert_cmpstr(g_getenv("CRISPY_TEST_CONFIG_RUNS"), ==, "2");
+    crispy_config_context_clear_internal(&ctx);
+
+    g_unsetenv("CRISPY_TEST_CONFIG_RUNS");
+    g_unlink(input_path);
+    cleanup_temp_config(config_path);
+}
+
 gint
 main(
     gint    argc,
@@ -402,6 +493,8 @@ main(
                      test_config_loader_compile_error);
     g_test_add_func("/config-loader/sets-multiple-fields",
                      test_config_loader_sets_multiple_fields);
+    g_test_add_func("/config-loader/pure-snapshot",
+                     test_config_loader_pure_snapshot);
 
     return g_test_run();
 }
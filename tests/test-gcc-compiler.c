@@ -2,6 +2,8 @@
 
 #define CRISPY_COMPILATION
 #include "../src/crispy.h"
+#include "../src/core/crispy-gcc-compiler-private.h"
+#include "../src/core/crispy-trace-private.h"
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -139,6 +141,81 @@ test_gcc_compiler_compile_shared_with_glib(void)
     g_unlink(out_path);
 }
 
+/* test: the time report becomes gcc phase spans in a trace */
+static void
+test_gcc_compiler_compile_shared_with_report(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyGccCompiler) compiler = NULL;
+    g_autoptr(CrispyTrace) trace = NULL;
+    g_autofree gchar *src_path = NULL;
+    g_autofree gchar *out_path = NULL;
+    g_autofree gchar *trace_path = NULL;
+    g_autofree gchar *report = NULL;
+    g_autofree gchar *failed_report = NULL;
+    g_autofree gchar *json = NULL;
+    const gchar *source;
+    gint64 t_start;
+    gboolean ok;
+    gint fd;
+
+    compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+
+    source = "#include <glib.h>\n"
+             "int main(){ g_print(\"test\\n\"); return 0; }\n";
+
+    src_path = g_strdup("/tmp/crispy-test-report-XXXXXX.c");
+    fd = g_mkstemp(src_path);
+    g_assert_cmpint(fd, >=, 0);
+    write(fd, source, strlen(source));
+    close(fd);
+
+    out_path = g_strdup("/tmp/crispy-test-report-XXXXXX.so");
+    fd = g_mkstemp(out_path);
+    close(fd);
+
+    t_start = g_get_monotonic_time();
+    ok = crispy_gcc_compiler_compile_shared_with_report_internal(
+        compiler, src_path, out_path, NULL, &report, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_nonnull(strstr(report, "TOTAL"));
+
+    trace = crispy_trace_new();
+    crispy_trace_add_gcc_report(trace, t_start,
+                                g_get_monotonic_time() - t_start, report);
+
+    trace_path = g_strdup("/tmp/crispy-test-report-XXXXXX.json");
+    fd = g_mkstemp(trace_path);
+    close(fd);
+    g_assert_true(crispy_trace_write(trace, trace_path, &error));
+    g_assert_no_error(error);
+
+    g_assert_true(g_file_get_contents(trace_path, &json, NULL, NULL));
+    g_assert_true(g_str_has_prefix(json, "{\"traceEvents\": ["));
+    g_assert_nonnull(strstr(json, "\"name\": \"cc1\", \"cat\": \"gcc\""));
+    g_assert_nonnull(strstr(json, "glib.h\": "));
+
+    /* a failed traced compile reports the diagnostics only */
+    g_assert_true(g_file_set_contents(src_path,
+        "#include <glib.h>\n"
+        "int f(void){ return nosuch; }\n", -1, NULL));
+    ok = crispy_gcc_compiler_compile_shared_with_report_internal(
+        compiler, src_path, out_path, NULL, &failed_report, &error);
+    g_assert_false(ok);
+    g_assert_null(failed_report);
+    g_assert_error(error, CRISPY_ERROR, CRISPY_ERROR_COMPILE);
+    g_assert_nonnull(strstr(error->message, "nosuch"));
+    g_assert_null(strstr(error->message, "\n. "));
+    g_assert_null(strstr(error->message, "Multiple include guards"));
+    g_assert_null(strstr(error->message, "TOTAL"));
+
+    g_unlink(src_path);
+    g_unlink(out_path);
+    g_unlink(trace_path);
+}
+
 /* test: compile with extra flags (-lm) */
 static void
 test_gcc_compiler_compile_shared_with_extra_flags(void)
@@ -270,6 +347,8 @@ main(
                     test_gcc_compiler_compile_shared_trivial);
     g_test_add_func("/gcc-compiler/compile-shared-with-glib",
                     test_gcc_compiler_compile_shared_with_glib);
+    g_test_add_func("/gcc-compiler/compile-shared-with-report",
+                    test_gcc_compiler_compile_shared_with_report);
     g_test_add_func("/gcc-compiler/compile-shared-with-extra-flags",
                     test_gcc_compiler_compile_shared_with_extra_flags);
     g_test_add_func("/gcc-compiler/compile-failure-syntax-error",
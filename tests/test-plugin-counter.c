@@ -0,0 +1,24 @@
+/* test-plugin-counter.c - Test plugin that counts executions via the data store */
+
+#define CRISPY_COMPILATION
+#include "crispy.h"
+
+CRISPY_PLUGIN_DEFINE("test-counter", "Counts post-execute hooks", "0.1.0", "Test", "AGPLv3");
+
+/*
+ * Increments the gint stored under "test-counter" in the engine's data
+ * store.  Pipelines on several threads share the engine, so the counter
+ * is updated atomically.
+ */
+CrispyHookResult
+crispy_plugin_on_post_execute(CrispyHookContext *ctx)
+{
+    gint *count;
+
+    count = (gint *)crispy_plugin_engine_get_data(
+        (CrispyPluginEngine *)ctx->engine, "test-counter");
+    if (count != NULL)
+        g_atomic_int_inc(count);
+
+    return CRISPY_HOOK_CONTINUE;
+}
@@ -3,8 +3,10 @@
 #define CRISPY_COMPILATION
 #include "crispy.h"
 #include "core/crispy-plugin-engine-private.h"
+#include "core/crispy-plugin-builder-private.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -336,6 +338,244 @@ test_script_plugin_abort(void)
     g_assert_cmpstr(error->message, ==, "Aborted by test-abort plugin");
 }
 
+/**
+ * test_engine_subscriptions:
+ *
+ * With 20 noop plugins and one counter, only POST_EXECUTE has a
+ * subscriber and only the counter is called.  Run with -m perf to see
+ * the cost of a dispatch.
+ */
+static void
+test_engine_subscriptions(void)
+{
+    g_autoptr(CrispyPluginEngine) engine = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *noop_path = NULL;
+    g_autofree gchar *counter_path = NULL;
+    CrispyHookContext ctx;
+    gint *count;
+    gdouble elapsed;
+    gint i;
+
+    engine = crispy_plugin_engine_new();
+    noop_path = get_test_plugin_path("noop");
+    counter_path = get_test_plugin_path("counter");
+    for (i = 0; i < 20; i++)
+    {
+        crispy_plugin_engine_load(engine, noop_path, &error);
+        g_assert_no_error(error);
+    }
+
+    for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
+        g_assert_false(crispy_plugin_engine_has_hook(engine, (CrispyHookPoint)i));
+
+    crispy_plugin_engine_load(engine, counter_path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpuint(crispy_plugin_engine_get_plugin_count(engine), ==, 21);
+
+    count = g_new0(gint, 1);
+    crispy_plugin_engine_set_data(engine, "test-counter", count, g_free);
+
+    for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
+    {
+        g_assert_cmpint(crispy_plugin_engine_has_hook(engine, (CrispyHookPoint)i),
+                        ==, i == CRISPY_HOOK_POST_EXECUTE);
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.error = &error;
+    for (i = 0; i < CRISPY_HOOK_POINT_COUNT; i++)
+    {
+        g_assert_cmpint(crispy_plugin_engine_dispatch(engine,
+                                                      (CrispyHookPoint)i, &ctx),
+                        ==, CRISPY_HOOK_CONTINUE);
+    }
+    g_assert_cmpint(*count, ==, 1);
+
+    if (!g_test_perf())
+        return;
+
+    /* all nine hooks, as one run of a script fires them */
+    g_test_timer_start();
+    for (i = 0; i < 1000000; i++)
+        crispy_plugin_engine_dispatch(engine,
+                                      (CrispyHookPoint)(i % CRISPY_HOOK_POINT_COUNT),
+                                      &ctx);
+    elapsed = g_test_timer_elapsed();
+    g_test_minimized_result(elapsed * 1000.0,
+                            "%.1f ns per dispatch with 20 noop plugins",
+                            elapsed * 1000.0);
+}
+
+/**
+ * test_engine_build_sources:
+ *
+ * Two plugin sources and a .so build together: the sources are
+ * compiled through the cache, the .so passes through, and all three
+ * load.  A second build of the same sources is a cache hit.
+ */
+static void
+test_engine_build_sources(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyGccCompiler) compiler = NULL;
+    g_autoptr(CrispyFileCache) cache = NULL;
+    g_autoptr(CrispyPluginEngine) engine = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *first = NULL;
+    g_autofree gchar *second = NULL;
+    g_autofree gchar *noop_path = NULL;
+    CrispyPluginBuild builds[3];
+    guint i;
+
+    compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+    cache = crispy_file_cache_new();
+    engine = crispy_plugin_engine_new();
+
+    dir = g_dir_make_tmp("crispy-test-plugin-XXXXXX", &error);
+    g_assert_no_error(error);
+    first = g_build_filename(dir, "first.c", NULL);
+    second = g_build_filename(dir, "second.c", NULL);
+    g_file_set_contents(first,
+        "#define CRISPY_COMPILATION\n"
+        "#include \"crispy-plugin.h\"\n"
+        "CRISPY_PLUGIN_DEFINE(\"first\", \"test\", \"0.1.0\", "
+        "\"test\", \"AGPLv3\");\n", -1, &error);
+    g_assert_no_error(error);
+    g_file_set_contents(second,
+        "#define CRISPY_COMPILATION\n"
+        "#include \"crispy-plugin.h\"\n"
+        "CRISPY_PLUGIN_DEFINE(\"second\", \"test\", \"0.1.0\", "
+        "\"test\", \"AGPLv3\");\n", -1, &error);
+    g_assert_no_error(error);
+    noop_path = get_test_plugin_path("noop");
+
+    memset(builds, 0, sizeof(builds));
+    builds[0].path = first;
+    builds[1].path = noop_path;
+    builds[2].path = second;
+    crispy_plugin_build_all(builds, 3, CRISPY_COMPILER(compiler),
+                            CRISPY_CACHE_PROVIDER(cache));
+
+    g_assert_cmpstr(builds[1].so_path, ==, noop_path);
+    for (i = 0; i < 3; i++)
+    {
+        g_assert_no_error(builds[i].error);
+        crispy_plugin_engine_load(engine, builds[i].so_path, &error);
+        g_assert_no_error(error);
+        crispy_plugin_build_clear(&builds[i]);
+    }
+    g_assert_cmpuint(crispy_plugin_engine_get_plugin_count(engine), ==, 3);
+
+    crispy_plugin_build_all(builds, 3, CRISPY_COMPILER(compiler),
+                            CRISPY_CACHE_PROVIDER(cache));
+    for (i = 0; i < 3; i++)
+    {
+        g_assert_no_error(builds[i].error);
+        g_assert_true(builds[i].cache_hit);
+        crispy_plugin_build_clear(&builds[i]);
+    }
+
+    g_unlink(first);
+    g_unlink(second);
+    g_rmdir(dir);
+}
+
+/**
+ * test_engine_build_error:
+ *
+ * A plugin source that does not compile reports an error naming it.
+ */
+static void
+test_engine_build_error(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyGccCompiler) compiler = NULL;
+    g_autoptr(CrispyFileCache) cache = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *path = NULL;
+    CrispyPluginBuild build;
+
+    compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+    cache = crispy_file_cache_new();
+
+    dir = g_dir_make_tmp("crispy-test-plugin-XXXXXX", &error);
+    g_assert_no_error(error);
+    path = g_build_filename(dir, "broken.c", NULL);
+    g_file_set_contents(path, "this is not C;\n", -1, &error);
+    g_assert_no_error(error);
+
+    memset(&build, 0, sizeof(build));
+    build.path = path;
+    crispy_plugin_build_all(&build, 1, CRISPY_COMPILER(compiler),
+                            CRISPY_CACHE_PROVIDER(cache));
+    g_assert_null(build.so_path);
+    g_assert_error(build.error, CRISPY_ERROR, CRISPY_ERROR_COMPILE);
+    g_assert_nonnull(strstr(build.error->message, "broken.c"));
+    crispy_plugin_build_clear(&build);
+
+    g_unlink(path);
+    g_rmdir(dir);
+}
+
+/**
+ * test_engine_plugin_costs:
+ *
+ * With a plugin_costs array in the context, each hook call is charged
+ * to its plugin, and a plugin over the threshold is warned about.
+ */
+static void
+test_engine_plugin_costs(void)
+{
+    g_autoptr(CrispyPluginEngine) engine = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GArray) costs = NULL;
+    g_autofree gchar *noop_path = NULL;
+    g_autofree gchar *counter_path = NULL;
+    CrispyHookContext ctx;
+    CrispyPluginCost *cost;
+
+    engine = crispy_plugin_engine_new();
+    noop_path = get_test_plugin_path("noop");
+    counter_path = get_test_plugin_path("counter");
+    crispy_plugin_engine_load(engine, noop_path, &error);
+    g_assert_no_error(error);
+    crispy_plugin_engine_load(engine, counter_path, &error);
+    g_assert_no_error(error);
+    crispy_plugin_engine_set_data(engine, "test-counter", g_new0(gint, 1),
+                                  g_free);
+
+    costs = g_array_new(FALSE, TRUE, sizeof(CrispyPluginCost));
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.error = &error;
+    ctx.plugin_costs = costs;
+    crispy_plugin_engine_dispatch(engine, CRISPY_HOOK_SOURCE_LOADED, &ctx);
+    crispy_plugin_engine_dispatch(engine, CRISPY_HOOK_POST_EXECUTE, &ctx);
+    crispy_plugin_engine_dispatch(engine, CRISPY_HOOK_POST_EXECUTE, &ctx);
+
+    /* the noop plugin exports no hooks, so it never runs */
+    g_assert_cmpuint(costs->len, ==, 1);
+    cost = &g_array_index(costs, CrispyPluginCost, 0);
+    g_assert_cmpuint(cost->index, ==, 1);
+    g_assert_cmpstr(cost->name, ==, "test-counter");
+    g_assert_cmpuint(cost->calls[CRISPY_HOOK_POST_EXECUTE], ==, 2);
+    g_assert_cmpuint(cost->calls[CRISPY_HOOK_SOURCE_LOADED], ==, 0);
+    g_assert_cmpint(cost->wall_ns[CRISPY_HOOK_POST_EXECUTE], >, 0);
+    g_assert_cmpint(cost->cpu_ns[CRISPY_HOOK_POST_EXECUTE], >=, 0);
+
+    /* no threshold, no warning */
+    crispy_plugin_engine_check_costs(engine, costs);
+
+    crispy_plugin_engine_set_cost_warning(engine, 0.000001);
+    g_assert_cmpfloat(crispy_plugin_engine_get_cost_warning(engine), >, 0.0);
+    g_test_expect_message(NULL, G_LOG_LEVEL_WARNING,
+                          "Plugin 'test-counter' added * in post_execute");
+    crispy_plugin_engine_check_costs(engine, costs);
+    g_test_assert_expected_messages();
+}
+
 /**
  * test_engine_is_final_type:
  *
@@ -373,6 +613,10 @@ main(
     g_test_add_func("/plugin-engine/dispatch-abort", test_engine_dispatch_abort);
     g_test_add_func("/plugin-engine/script-with-plugins", test_script_with_plugins);
     g_test_add_func("/plugin-engine/script-plugin-abort", test_script_plugin_abort);
+    g_test_add_func("/plugin-engine/subscriptions", test_engine_subscriptions);
+    g_test_add_func("/plugin-engine/plugin-costs", test_engine_plugin_costs);
+    g_test_add_func("/plugin-engine/build-sources", test_engine_build_sources);
+    g_test_add_func("/plugin-engine/build-error", test_engine_build_error);
     g_test_add_func("/plugin-engine/is-final-type", test_engine_is_final_type);
 
     return g_test_run();
@@ -0,0 +1,150 @@
+/* test-repl.c - Tests for the --repl session loop */
+
+#define CRISPY_COMPILATION
+#include "../src/crispy.h"
+#include "../src/core/crispy-repl-private.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * helper: feed @session to crispy_repl_run() through a memory stream
+ * and return what its cells wrote to @out_path.  Cells write with
+ * note(), which the session has to define first.
+ */
+static gchar *
+run_session(
+    const gchar *session,
+    const gchar *out_path
+){
+    g_autoptr(CrispyGccCompiler) compiler = NULL;
+    g_autoptr(GError) error = NULL;
+    gchar *contents;
+    FILE *input;
+
+    compiler = crispy_gcc_compiler_new(&error);
+    g_assert_no_error(error);
+
+    g_assert_true(g_file_set_contents(out_path, "", -1, NULL));
+
+    input = fmemopen((gpointer)session, strlen(session), "r");
+    g_assert_nonnull(input);
+    g_assert_cmpint(crispy_repl_run(CRISPY_COMPILER(compiler), input,
+                                    NULL, NULL, &error), ==, 0);
+    g_assert_no_error(error);
+    fclose(input);
+
+    g_assert_true(g_file_get_contents(out_path, &contents, NULL, NULL));
+    return contents;
+}
+
+/* helper: a cell defining note(), which appends a number to @out_path */
+static gchar *
+note_cell(
+    const gchar *out_path
+){
+    return g_strdup_printf(
+        "void note(gint v)\n"
+        "{\n"
+        "    FILE *f = fopen(\"%s\", \"a\");\n"
+        "    fprintf(f, \"%%d\\n\", v);\n"
+        "    fclose(f);\n"
+        "}\n",
+        out_path);
+}
+
+/* test: declarations, functions and statements build on each other */
+static void
+test_repl_cells(void)
+{
+    g_autofree gchar *out_path = NULL;
+    g_autofree gchar *note = NULL;
+    g_autofree gchar *session = NULL;
+    g_autofree gchar *output = NULL;
+    gint fd;
+
+    fd = g_file_open_tmp("crispy-test-repl-XXXXXX", &out_path, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    close(fd);
+
+    /*
+     * "static" and "extern" cells must be kept as declarations: taken
+     * as statements, they would be locals of a one-off function and
+     * the later cells that use them would not compile.
+     */
+    note = note_cell(out_path);
+    session = g_strconcat(
+        "#include <stdio.h>\n",
+        "static gint counter = 40;\n",
+        "extern char **environ;\n",
+        note,
+        "counter += 2;\n",
+        "note(counter);\n",
+        "(void)0;\n",
+        "note(environ != NULL);\n",
+        NULL);
+
+    output = run_session(session, out_path);
+    g_assert_cmpstr(output, ==, "42\n1\n");
+
+    g_unlink(out_path);
+}
+
+/* test: a broken cell is forgotten, a redefinition does not replace */
+static void
+test_repl_errors_and_redefinition(void)
+{
+    g_autofree gchar *out_path = NULL;
+    g_autofree gchar *note = NULL;
+    g_autofree gchar *session = NULL;
+    g_autofree gchar *output = NULL;
+    gint fd;
+
+    fd = g_file_open_tmp("crispy-test-repl-XXXXXX", &out_path, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    close(fd);
+
+    note = note_cell(out_path);
+    session = g_strconcat(
+        "#include <stdio.h>\n",
+        note,
+        "gint twice(gint x){ return 2 * x; }\n",
+        "note(no_such_name);\n",
+        "gint twice(gint x){ return 3 * x; }\n",
+        "note(twice(5));\n",
+        "\n",
+        "note(\n",
+        "    7)\n",
+        "\n",
+        ".quit\n",
+        "note(99);\n",
+        NULL);
+
+    /*
+     * The first twice() still wins.  The cell missing its ';' is
+     * submitted by the blank line and fails on its own.  Nothing
+     * after .quit runs.
+     */
+    output = run_session(session, out_path);
+    g_assert_cmpstr(output, ==, "10\n");
+
+    g_unlink(out_path);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/repl/cells",
+                    test_repl_cells);
+    g_test_add_func("/repl/errors-and-redefinition",
+                    test_repl_errors_and_redefinition);
+
+    return g_test_run();
+}
@@ -0,0 +1,760 @@
+/* test-runtime.c - Tests for the crispy script runtime library */
+
+#define CRISPY_COMPILATION
+#include "../src/crispy-runtime.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* helper: create an empty temp file, return its path and an open fd */
+static gchar *
+make_temp_file(
+    gint *out_fd
+){
+    gchar *tmpl;
+    gint fd;
+
+    tmpl = g_strdup("/tmp/crispy-test-runtime-XXXXXX");
+    fd = g_mkstemp(tmpl);
+    g_assert_cmpint(fd, >=, 0);
+
+    if (out_fd != NULL)
+        *out_fd = fd;
+    else
+        close(fd);
+
+    return tmpl;
+}
+
+/* test: arena allocations are aligned, distinct and counted */
+static void
+test_arena_alloc(void)
+{
+    g_autoptr(CrispyArena) arena = NULL;
+    guint8 *a;
+    guint8 *b;
+    gint *zeros;
+    gint i;
+
+    arena = crispy_arena_new(1024);
+
+    a = crispy_arena_alloc(arena, 3);
+    b = crispy_arena_alloc(arena, 5);
+    g_assert_cmpuint((guintptr)a % 16, ==, 0);
+    g_assert_cmpuint((guintptr)b % 16, ==, 0);
+    g_assert_true(b != a);
+
+    zeros = crispy_arena_new_n(arena, gint, 64);
+    for (i = 0; i < 64; i++)
+        g_assert_cmpint(zeros[i], ==, 0);
+
+    g_assert_cmpuint(crispy_arena_get_used(arena), >=, 3 + 5 + 64 * sizeof(gint));
+}
+
+/* test: large allocations and many chunks survive reset */
+static void
+test_arena_large_and_reset(void)
+{
+    g_autoptr(CrispyArena) arena = NULL;
+    guint8 *big;
+    gchar *s;
+    gint i;
+
+    arena = crispy_arena_new(256);
+
+    /* spill over several chunks */
+    for (i = 0; i < 100; i++)
+    {
+        s = crispy_arena_strdup(arena, "some text");
+        g_assert_cmpstr(s, ==, "some text");
+    }
+
+    /* bigger than a quarter chunk: gets its own block */
+    big = crispy_arena_alloc(arena, 4096);
+    memset(big, 0xab, 4096);
+
+    s = crispy_arena_strndup(arena, "truncate me", 8);
+    g_assert_cmpstr(s, ==, "truncate");
+
+    crispy_arena_reset(arena);
+    g_assert_cmpuint(crispy_arena_get_used(arena), ==, 0);
+
+    s = crispy_arena_strdup(arena, "again");
+    g_assert_cmpstr(s, ==, "again");
+}
+
+/* test: NULL selects the default arena, which cannot be freed */
+static void
+test_arena_default(void)
+{
+    gchar *s;
+
+    g_assert_true(crispy_arena_default() == crispy_arena_default());
+
+    s = crispy_arena_strdup(NULL, "default");
+    g_assert_cmpstr(s, ==, "default");
+    g_assert_cmpuint(crispy_arena_get_used(NULL), >, 0);
+
+    /* no-op: released at exit */
+    crispy_arena_free(crispy_arena_default());
+    g_assert_cmpstr(s, ==, "default");
+}
+
+/* test: mapping a file exposes its exact contents */
+static void
+test_map_file(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyMappedFile) mapped = NULL;
+    g_autofree gchar *path = NULL;
+    const gchar *contents = "line one\nline two\n";
+
+    path = make_temp_file(NULL);
+    g_assert_true(g_file_set_contents(path, contents, -1, &error));
+
+    mapped = crispy_map_file(path,
+                             CRISPY_MAP_SEQUENTIAL | CRISPY_MAP_WILLNEED,
+                             &error);
+    g_assert_no_error(error);
+    g_assert_nonnull(mapped);
+
+    g_assert_cmpuint(crispy_mapped_file_get_length(mapped), ==, strlen(contents));
+    g_assert_true(memcmp(crispy_mapped_file_get_data(mapped),
+                         contents, strlen(contents)) == 0);
+
+    /* advising a sub-range must not disturb the mapping */
+    crispy_mapped_file_advise(mapped, 5, 0, CRISPY_MAP_RANDOM);
+    g_assert_true(memcmp(crispy_mapped_file_get_data(mapped),
+                         contents, strlen(contents)) == 0);
+
+    g_unlink(path);
+}
+
+/* test: empty files map to a zero-length view */
+static void
+test_map_file_empty(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyMappedFile) mapped = NULL;
+    g_autofree gchar *path = NULL;
+
+    path = make_temp_file(NULL);
+
+    mapped = crispy_map_file(path, CRISPY_MAP_NONE, &error);
+    g_assert_no_error(error);
+    g_assert_nonnull(mapped);
+    g_assert_cmpuint(crispy_mapped_file_get_length(mapped), ==, 0);
+
+    g_unlink(path);
+}
+
+/* test: missing files report G_FILE_ERROR_NOENT */
+static void
+test_map_file_missing(void)
+{
+    g_autoptr(GError) error = NULL;
+    CrispyMappedFile *mapped;
+
+    mapped = crispy_map_file("/nonexistent/crispy-runtime-test",
+                             CRISPY_MAP_NONE, &error);
+    g_assert_null(mapped);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+}
+
+/* test: writer output matches, including overflow and bypass paths */
+static void
+test_writer(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *result = NULL;
+    g_autofree gchar *large = NULL;
+    g_autoptr(GString) expected = NULL;
+    CrispyWriter *writer;
+    gint fd;
+    gint i;
+
+    path = make_temp_file(&fd);
+    expected = g_string_new(NULL);
+
+    /* a tiny buffer exercises every flush path */
+    writer = crispy_writer_new(fd, 16);
+
+    for (i = 0; i < 50; i++)
+    {
+        crispy_writer_write_int(writer, i - 25);
+        crispy_writer_putc(writer, ' ');
+        g_string_append_printf(expected, "%d ", i - 25);
+    }
+
+    crispy_writer_write_int(writer, G_MININT64);
+    g_string_append_printf(expected, "%" G_GINT64_FORMAT, (gint64)G_MININT64);
+
+    crispy_writer_printf(writer, "[%s=%d]", "key", 12345);
+    g_string_append_printf(expected, "[%s=%d]", "key", 12345);
+
+    /* longer than the buffer: formatted on the heap / written through */
+    large = g_strnfill(100, 'x');
+    crispy_writer_printf(writer, "%s", large);
+    crispy_writer_puts(writer, large);
+    g_string_append(expected, large);
+    g_string_append(expected, large);
+
+    g_assert_true(crispy_writer_flush(writer));
+    crispy_writer_free(writer);
+    close(fd);
+
+    g_assert_true(g_file_get_contents(path, &result, NULL, &error));
+    g_assert_no_error(error);
+    g_assert_cmpstr(result, ==, expected->str);
+
+    g_unlink(path);
+}
+
+/* test: timer readings are monotonic and laps restart the timer */
+static void
+test_timer(void)
+{
+    CrispyTimer timer;
+    gint64 t1;
+    gint64 t2;
+    gint64 lap;
+
+    t1 = crispy_time_ns();
+    t2 = crispy_time_ns();
+    g_assert_cmpint(t2, >=, t1);
+
+    crispy_timer_start(&timer);
+    g_usleep(2000);
+    g_assert_cmpint(crispy_timer_elapsed_ns(&timer), >=, 2000000);
+    g_assert_cmpfloat(crispy_timer_elapsed_ms(&timer), >=, 2.0);
+
+    lap = crispy_timer_lap_ns(&timer);
+    g_assert_cmpint(lap, >=, 2000000);
+    g_assert_cmpint(crispy_timer_elapsed_ns(&timer), <, lap);
+}
+
+/* parallel_for body: mark each index, with deliberately uneven cost */
+static void
+mark_indices(
+    gint64   begin,
+    gint64   end,
+    gpointer user_data
+){
+    gint *hits;
+    gint64 i;
+
+    hits = user_data;
+    for (i = begin; i < end; i++)
+    {
+        if (i % 97 == 0)
+            g_usleep(50);
+        g_atomic_int_inc(&hits[i]);
+    }
+}
+
+/* test: every index is visited exactly once */
+static void
+test_parallel_for(void)
+{
+    const gint64 n = 20000;
+    g_autofree gint *hits = NULL;
+    gint64 i;
+
+    hits = g_new0(gint, n);
+
+    crispy_parallel_for(0, n, 0, mark_indices, hits);
+    for (i = 0; i < n; i++)
+        g_assert_cmpint(hits[i], ==, 1);
+
+    /* explicit grain, offset range */
+    crispy_parallel_for(100, n, 7, mark_indices, hits);
+    for (i = 0; i < n; i++)
+        g_assert_cmpint(hits[i], ==, i < 100 ? 1 : 2);
+
+    /* empty range is a no-op */
+    crispy_parallel_for(5, 5, 0, mark_indices, hits);
+    g_assert_cmpint(hits[5], ==, 1);
+}
+
+static void
+sum_map(
+    gint64   begin,
+    gint64   end,
+    gpointer acc,
+    gpointer user_data
+){
+    gint64 i;
+
+    for (i = begin; i < end; i++)
+        *(gint64 *)acc += i;
+}
+
+static void
+sum_combine(
+    gpointer      acc,
+    gconstpointer other,
+    gpointer      user_data
+){
+    *(gint64 *)acc += *(const gint64 *)other;
+}
+
+/* test: reduce matches the closed-form sum at several concurrencies */
+static void
+test_parallel_reduce(void)
+{
+    const gint64 n = 1000000;
+    gint64 identity;
+    gint64 result;
+    guint threads;
+
+    identity = 0;
+
+    for (threads = 1; threads <= 4; threads++)
+    {
+        crispy_parallel_set_concurrency(threads);
+        g_assert_cmpuint(crispy_parallel_get_concurrency(), ==, threads);
+
+        result = -1;
+        crispy_parallel_reduce(0, n, 0, &result, sizeof(result), &identity,
+                               sum_map, sum_combine, NULL);
+        g_assert_cmpint(result, ==, n * (n - 1) / 2);
+    }
+
+    crispy_parallel_set_concurrency(0);
+    g_assert_cmpuint(crispy_parallel_get_concurrency(), >=, 1);
+}
+
+/* nested body: each outer index runs an inner (serialized) loop */
+static void
+nested_outer(
+    gint64   begin,
+    gint64   end,
+    gpointer user_data
+){
+    gint *hits;
+    gint64 i;
+
+    hits = user_data;
+    for (i = begin; i < end; i++)
+        crispy_parallel_for(i * 10, i * 10 + 10, 0, mark_indices, hits);
+}
+
+/* test: nested parallel loops complete without deadlocking */
+static void
+test_parallel_nested(void)
+{
+    g_autofree gint *hits = NULL;
+    gint64 i;
+
+    hits = g_new0(gint, 1000);
+
+    crispy_parallel_set_concurrency(4);
+    crispy_parallel_for(0, 100, 1, nested_outer, hits);
+    crispy_parallel_set_concurrency(0);
+
+    for (i = 0; i < 1000; i++)
+        g_assert_cmpint(hits[i], ==, 1);
+}
+
+typedef struct
+{
+    GHashTable      *expected;   /* path -> expected contents */
+    GHashTable      *seen;       /* path -> GINT_TO_POINTER(count) */
+    guint            errors;
+    gchar           *requeue;    /* queued from the callback, if set */
+    CrispyFileBatch *batch;
+} BatchResult;
+
+static void
+check_read(
+    const gchar  *path,
+    const gchar  *data,
+    gsize         length,
+    const GError *error,
+    gpointer      user_data
+){
+    BatchResult *res;
+    const gchar *expected;
+    gint count;
+
+    res = user_data;
+
+    count = GPOINTER_TO_INT(g_hash_table_lookup(res->seen, path));
+    g_hash_table_replace(res->seen, g_strdup(path), GINT_TO_POINTER(count + 1));
+
+    if (error != NULL)
+    {
+        g_assert_null(data);
+        g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+        res->errors++;
+        return;
+    }
+
+    g_assert_nonnull(data);
+    g_assert_cmpint(data[length], ==, '\0');
+
+    expected = g_hash_table_lookup(res->expected, path);
+    if (expected != NULL)
+    {
+        g_assert_cmpuint(length, ==, strlen(expected));
+        g_assert_true(memcmp(data, expected, length) == 0);
+    }
+    else
+    {
+        /* procfs: no size up front, but never empty */
+        g_assert_cmpuint(length, >, 0);
+    }
+
+    if (res->requeue != NULL)
+    {
+        crispy_file_batch_add(res->batch, res->requeue, check_read, res);
+        g_clear_pointer(&res->requeue, g_free);
+    }
+}
+
+/* run one batch over files of assorted sizes with the current backend */
+static void
+run_file_batch(
+    gboolean force_threads
+){
+    g_autoptr(GPtrArray) paths = NULL;
+    g_autoptr(CrispyFileBatch) batch = NULL;
+    BatchResult res;
+    gchar *path;
+    gchar *contents;
+    guint failed;
+    guint i;
+
+    if (force_threads)
+        g_setenv("CRISPY_NO_IO_URING", "1", TRUE);
+    else
+        g_unsetenv("CRISPY_NO_IO_URING");
+
+    batch = crispy_file_batch_new(4);
+    if (force_threads)
+        g_assert_cmpstr(crispy_file_batch_get_backend(batch), ==, "threads");
+
+    paths = g_ptr_array_new_with_free_func(g_free);
+    res.expected = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    res.seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    res.errors = 0;
+    res.requeue = NULL;
+    res.batch = batch;
+
+    /* sizes 0, 1, ... and one large file: more files than the depth */
+    for (i = 0; i < 20; i++)
+    {
+        path = make_temp_file(NULL);
+        contents = g_strnfill(i == 19 ? 200000 : i * 37, (gchar)('a' + i));
+        g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+        g_hash_table_insert(res.expected, path, contents);
+        g_ptr_array_add(paths, path);
+        crispy_file_batch_add(batch, path, check_read, &res);
+    }
+
+    crispy_file_batch_add(batch, "/nonexistent/crispy-batch-test",
+                          check_read, &res);
+    crispy_file_batch_add(batch, "/proc/self/status", check_read, &res);
+
+    /* a callback may queue more work on the running batch */
+    res.requeue = g_strdup(g_ptr_array_index(paths, 3));
+
+    failed = crispy_file_batch_run(batch);
+    g_assert_cmpuint(failed, ==, 1);
+    g_assert_cmpuint(res.errors, ==, 1);
+    g_assert_null(res.requeue);
+
+    for (i = 0; i < paths->len; i++)
+        g_assert_cmpint(GPOINTER_TO_INT(g_hash_table_lookup(res.seen,
+                                        g_ptr_array_index(paths, i))),
+                        ==, i == 3 ? 2 : 1);
+
+    /* the batch is empty again and reusable */
+    g_assert_cmpuint(crispy_file_batch_run(batch), ==, 0);
+
+    for (i = 0; i < paths->len; i++)
+        g_unlink(g_ptr_array_index(paths, i));
+
+    g_hash_table_unref(res.expected);
+    g_hash_table_unref(res.seen);
+    g_unsetenv("CRISPY_NO_IO_URING");
+}
+
+/* test: batched reads with whichever backend the kernel allows */
+static void
+test_file_batch(void)
+{
+    run_file_batch(FALSE);
+}
+
+/* test: batched reads through the thread-pool fallback */
+static void
+test_file_batch_threads(void)
+{
+    run_file_batch(TRUE);
+}
+
+/* pipeline stages: produce 1..N, double each line, sum what arrives */
+#define PIPELINE_LINES (200000)
+
+static guint64 pipeline_sum;
+static guint   pipeline_lines;
+
+static gint
+stage_produce(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    CrispyWriter *out;
+    gint i;
+
+    out = crispy_stage_get_output(stage);
+    for (i = 1; i <= PIPELINE_LINES; i++)
+        crispy_writer_printf(out, "%d\n", i);
+
+    return 0;
+}
+
+static gint
+stage_double(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    CrispyWriter *out;
+    gchar *line;
+
+    out = crispy_stage_get_output(stage);
+    while ((line = crispy_stage_read_line(stage, NULL)) != NULL)
+        crispy_writer_printf(out, "%" G_GINT64_FORMAT "\n",
+                             g_ascii_strtoll(line, NULL, 10) * 2);
+
+    return 0;
+}
+
+static gint
+stage_sum(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    gchar *line;
+    gsize len;
+
+    while ((line = crispy_stage_read_line(stage, &len)) != NULL)
+    {
+        g_assert_cmpuint(len, ==, strlen(line));
+        pipeline_sum += g_ascii_strtoull(line, NULL, 10);
+        pipeline_lines++;
+    }
+
+    return 5;
+}
+
+/* a stage that stops reading early */
+static gint
+stage_head(
+    CrispyStage  *stage,
+    gint          argc,
+    gchar       **argv
+){
+    g_assert_nonnull(crispy_stage_read_line(stage, NULL));
+    return 3;
+}
+
+/* test: stages see every line in order; exit code is the last stage's */
+static void
+test_pipeline(void)
+{
+    CrispyStageFunc stages[3] = { stage_produce, stage_double, stage_sum };
+    CrispyStageFunc early[2] = { stage_produce, stage_head };
+    gchar *stage_argv[] = { (gchar *)"stage", NULL };
+    gchar **argvs[3] = { stage_argv, stage_argv, stage_argv };
+    gint argcs[3] = { 1, 1, 1 };
+    guint64 n;
+
+    pipeline_sum = 0;
+    pipeline_lines = 0;
+    g_assert_cmpint(crispy_pipeline_run(stages, argcs, argvs, 3), ==, 5);
+
+    n = PIPELINE_LINES;
+    g_assert_cmpuint(pipeline_lines, ==, n);
+    g_assert_cmpuint(pipeline_sum, ==, n * (n + 1));
+
+    /* the producer must not block once its reader is gone */
+    g_assert_cmpint(crispy_pipeline_run(early, argcs, argvs, 2), ==, 3);
+}
+
+/* helper: bump @key by one with compare-and-swap, @n times */
+static void
+kv_increment(
+    CrispyKv    *kv,
+    const gchar *key,
+    gint         n
+){
+    const guint64 *current;
+    guint64 old_value;
+    guint64 new_value;
+    gint i;
+
+    for (i = 0; i < n; i++)
+    {
+        do
+        {
+            current = crispy_kv_get(kv, key, NULL);
+            old_value = *current;
+            new_value = old_value + 1;
+        }
+        while (!crispy_kv_compare_and_swap(kv, key, &old_value,
+                                           sizeof(old_value), &new_value,
+                                           sizeof(new_value), NULL));
+    }
+}
+
+/* test: kv store get/put/cas, growth and sharing between processes */
+static void
+test_kv(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyKv) kv = NULL;
+    g_autoptr(CrispyKv) other = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *lock_path = NULL;
+    const gchar *first;
+    const guint64 *counter;
+    gchar key[32];
+    gchar value[32];
+    guint64 zero;
+    gsize len;
+    gint status;
+    pid_t pid;
+    gint i;
+
+    dir = g_dir_make_tmp("crispy-test-kv-XXXXXX", &error);
+    g_assert_no_error(error);
+    g_setenv("CRISPY_KV_DIR", dir, TRUE);
+
+    g_assert_null(crispy_kv_open("../escape", &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_clear_error(&error);
+
+    kv = crispy_kv_open("test", &error);
+    g_assert_no_error(error);
+    g_assert_null(crispy_kv_get(kv, "missing", NULL));
+
+    g_assert_true(crispy_kv_put(kv, "a", "one", 4, &error));
+    first = crispy_kv_get(kv, "a", &len);
+    g_assert_cmpstr(first, ==, "one");
+    g_assert_cmpuint(len, ==, 4);
+
+    /* compare-and-swap only replaces the expected value */
+    g_assert_false(crispy_kv_compare_and_swap(kv, "a", "two", 4,
+                                              "three", 6, &error));
+    g_assert_no_error(error);
+    g_assert_false(crispy_kv_compare_and_swap(kv, "a", NULL, 0,
+                                              "three", 6, &error));
+    g_assert_true(crispy_kv_compare_and_swap(kv, "a", "one", 4,
+                                             "three", 6, &error));
+    g_assert_cmpstr(crispy_kv_get(kv, "a", NULL), ==, "three");
+
+    /* enough keys to grow the file several times */
+    for (i = 0; i < 20000; i++)
+    {
+        g_snprintf(key, sizeof(key), "key-%d", i);
+        g_snprintf(value, sizeof(value), "value-%d", i);
+        g_assert_true(crispy_kv_put(kv, key, value, strlen(value) + 1,
+                                    &error));
+    }
+    g_assert_no_error(error);
+    g_assert_cmpuint(crispy_kv_get_count(kv), ==, 20001);
+    g_assert_cmpstr(crispy_kv_get(kv, "key-12345", NULL), ==, "value-12345");
+
+    /* earlier values stay readable after the file was replaced */
+    g_assert_cmpstr(first, ==, "one");
+
+    /* a second handle sees everything and follows later rewrites */
+    other = crispy_kv_open("test", &error);
+    g_assert_no_error(error);
+    g_assert_cmpstr(crispy_kv_get(other, "key-0", NULL), ==, "value-0");
+
+    zero = 0;
+    g_assert_true(crispy_kv_put(kv, "counter", &zero, sizeof(zero), &error));
+
+    pid = fork();
+    g_assert_cmpint(pid, >=, 0);
+    if (pid == 0)
+    {
+        CrispyKv *child;
+
+        child = crispy_kv_open("test", NULL);
+        kv_increment(child, "counter", 5000);
+        crispy_kv_close(child);
+        _exit(0);
+    }
+    kv_increment(other, "counter", 5000);
+    g_assert_cmpint(waitpid(pid, &status, 0), ==, pid);
+    g_assert_true(WIFEXITED(status));
+    g_assert_cmpint(WEXITSTATUS(status), ==, 0);
+
+    counter = crispy_kv_get(kv, "counter", NULL);
+    g_assert_nonnull(counter);
+    g_assert_cmpuint(*counter, ==, 10000);
+    g_assert_true(crispy_kv_sync(kv));
+
+    g_clear_pointer(&kv, crispy_kv_close);
+    g_clear_pointer(&other, crispy_kv_close);
+    g_unsetenv("CRISPY_KV_DIR");
+
+    path = g_build_filename(dir, "test.kv", NULL);
+    lock_path = g_build_filename(dir, "test.kv.lock", NULL);
+    g_unlink(path);
+    g_unlink(lock_path);
+    g_rmdir(dir);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/runtime/arena-alloc",
+                    test_arena_alloc);
+    g_test_add_func("/runtime/arena-large-and-reset",
+                    test_arena_large_and_reset);
+    g_test_add_func("/runtime/arena-default",
+                    test_arena_default);
+    g_test_add_func("/runtime/map-file",
+                    test_map_file);
+    g_test_add_func("/runtime/map-file-empty",
+                    test_map_file_empty);
+    g_test_add_func("/runtime/map-file-missing",
+                    test_map_file_missing);
+    g_test_add_func("/runtime/writer",
+                    test_writer);
+    g_test_add_func("/runtime/timer",
+                    test_timer);
+    g_test_add_func("/runtime/parallel-for",
+                    test_parallel_for);
+    g_test_add_func("/runtime/parallel-reduce",
+                    test_parallel_reduce);
+    g_test_add_func("/runtime/parallel-nested",
+                    test_parallel_nested);
+    g_test_add_func("/runtime/file-batch",
+                    test_file_batch);
+    g_test_add_func("/runtime/file-batch-threads",
+                    test_file_batch_threads);
+    g_test_add_func("/runtime/pipeline",
+                    test_pipeline);
+    g_test_add_func("/runtime/kv",
+                    test_kv);
+
+    return g_test_run();
+}
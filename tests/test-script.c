@@ -2,10 +2,18 @@
 
 #define CRISPY_COMPILATION
 #include "../src/crispy.h"
+#include "../src/core/crispy-bench-private.h"
+#include "../src/core/crispy-pipeline-private.h"
+#include "../src/core/crispy-script-private.h"
+#include "../src/core/crispy-telemetry-private.h"
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 /* shared compiler and cache for all tests */
@@ -272,6 +280,860 @@ test_script_arg_passing(void)
     g_unlink(path);
 }
 
+/* test: including crispy-runtime.h links libcrispy-runtime automatically */
+static void
+test_script_runtime_autolink(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    g_autofree gchar *path = NULL;
+    gint exit_code;
+
+    path = write_temp_script(
+        "#include <crispy-runtime.h>\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    gchar *s = crispy_arena_strdup(NULL, \"runtime\");\n"
+        "    CrispyTimer timer;\n"
+        "    crispy_timer_start(&timer);\n"
+        "    crispy_writer_puts(crispy_stdout(), s);\n"
+        "    crispy_writer_putc(crispy_stdout(), '\\n');\n"
+        "    return crispy_timer_elapsed_ns(&timer) >= 0 ? 5 : 1;\n"
+        "}\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE,
+        &error);
+    g_assert_no_error(error);
+
+    exit_code = crispy_script_execute(script, 1, &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 5);
+
+    g_unlink(path);
+}
+
+/* test: CRISPY_MULTIVERSION functions and whole-script builds run */
+static void
+test_script_multiversion(void)
+{
+    static const gchar *sources[] = {
+        /* per-function target_clones */
+        "static CRISPY_MULTIVERSION gint\n"
+        "sum(const gint *v, gint n){\n"
+        "    gint s = 0, i;\n"
+        "    for (i = 0; i < n; i++) s += v[i];\n"
+        "    return s;\n"
+        "}\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    gint v[64] = { 0 };\n"
+        "    v[10] = 6;\n"
+        "    return sum(v, 64);\n"
+        "}\n",
+        /* whole script, one build per ISA */
+        "#define CRISPY_MULTIVERSION_SCRIPT\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    gdouble v[64];\n"
+        "    gdouble s = 0.0;\n"
+        "    gint i;\n"
+        "    for (i = 0; i < 64; i++) v[i] = 0.125;\n"
+        "    for (i = 0; i < 64; i++) s += v[i];\n"
+        "    return (gint)s - 2;\n"
+        "}\n"
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(sources); i++)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(CrispyScript) script = NULL;
+        g_autofree gchar *path = NULL;
+        gint exit_code;
+
+        path = write_temp_script(sources[i]);
+
+        script = crispy_script_new_from_file(
+            path,
+            CRISPY_COMPILER(g_compiler),
+            CRISPY_CACHE_PROVIDER(g_cache),
+            CRISPY_FLAG_FORCE_COMPILE,
+            &error);
+        g_assert_no_error(error);
+
+        exit_code = crispy_script_execute(script, 1, &path, &error);
+        g_assert_no_error(error);
+        g_assert_cmpint(exit_code, ==, 6);
+
+        g_unlink(path);
+    }
+}
+
+/* test: isolated scripts get their own copy of the module's globals */
+static void
+test_script_isolate(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) first = NULL;
+    g_autoptr(CrispyScript) second = NULL;
+    g_autoptr(CrispyScript) shared_first = NULL;
+    g_autoptr(CrispyScript) shared_second = NULL;
+    g_autofree gchar *path = NULL;
+    gint exit_code;
+
+    path = write_temp_script(
+        "#include <glib.h>\n"
+        "gint calls = 0;\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    return ++calls;\n"
+        "}\n");
+
+    /* both instances are alive at once: one namespace each */
+    first = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE | CRISPY_FLAG_ISOLATE,
+        &error);
+    g_assert_no_error(error);
+    exit_code = crispy_script_execute(first, 1, &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 1);
+
+    second = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_ISOLATE,
+        &error);
+    g_assert_no_error(error);
+    exit_code = crispy_script_execute(second, 1, &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 1);
+
+    /* without isolation the second load reuses the first instance */
+    shared_first = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_NONE,
+        &error);
+    g_assert_no_error(error);
+    exit_code = crispy_script_execute(shared_first, 1, &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 1);
+
+    shared_second = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_NONE,
+        &error);
+    g_assert_no_error(error);
+    exit_code = crispy_script_execute(shared_second, 1, &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 2);
+
+    g_unlink(path);
+}
+
+/* test: --hot-swap hands the running state to the rebuilt module */
+static void
+test_script_hot_swap(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *next_path = NULL;
+    gchar *script_argv[3];
+    gint exit_code;
+
+    /*
+     * Version 1 overwrites itself with version 2 from inside its main
+     * loop; version 2's crispy_state_restore() marks the shared state
+     * and quits the loop that version 1's main() is still running.
+     */
+    path = write_temp_script(
+        "#include <glib.h>\n"
+        "typedef struct { GMainLoop *loop; gint result; } State;\n"
+        "static State *state;\n"
+        "static gboolean rewrite(gpointer data){\n"
+        "    gchar **argv = data;\n"
+        "    gchar *src = NULL;\n"
+        "    g_file_get_contents(argv[1], &src, NULL, NULL);\n"
+        "    g_file_set_contents(argv[0], src, -1, NULL);\n"
+        "    g_free(src);\n"
+        "    return G_SOURCE_REMOVE;\n"
+        "}\n"
+        "static gboolean give_up(gpointer data){\n"
+        "    g_main_loop_quit(state->loop);\n"
+        "    return G_SOURCE_REMOVE;\n"
+        "}\n"
+        "gpointer crispy_state_save(void){ return state; }\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    guint give_up_id;\n"
+        "    state = g_new0(State, 1);\n"
+        "    state->loop = g_main_loop_new(NULL, FALSE);\n"
+        "    state->result = 1;\n"
+        "    g_timeout_add(100, rewrite, argv);\n"
+        "    give_up_id = g_timeout_add_seconds(60, give_up, NULL);\n"
+        "    g_main_loop_run(state->loop);\n"
+        "    g_source_remove(give_up_id);\n"
+        "    return state->result;\n"
+        "}\n");
+    next_path = write_temp_script(
+        "#include <glib.h>\n"
+        "typedef struct { GMainLoop *loop; gint result; } State;\n"
+        "static State *state;\n"
+        "static gboolean quit(gpointer data){\n"
+        "    g_main_loop_quit(state->loop);\n"
+        "    return G_SOURCE_REMOVE;\n"
+        "}\n"
+        "void crispy_state_restore(gpointer saved){\n"
+        "    state = saved;\n"
+        "    state->result = 2;\n"
+        "    g_idle_add(quit, NULL);\n"
+        "}\n"
+        "gint main(gint argc, gchar **argv){ return 0; }\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE | CRISPY_FLAG_HOT_SWAP,
+        &error);
+    g_assert_no_error(error);
+
+    script_argv[0] = path;
+    script_argv[1] = next_path;
+    script_argv[2] = NULL;
+    exit_code = crispy_script_execute(script, 2, script_argv, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(exit_code, ==, 2);
+
+    g_unlink(path);
+    g_unlink(next_path);
+}
+
+/*
+ * helper: execute a fresh script for @path without forcing a compile,
+ * reporting the run to @log_path if not %NULL
+ */
+static gint
+execute_cached_logged(
+    const gchar *path,
+    const gchar *log_path
+){
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    gchar *script_argv[2];
+    gint exit_code;
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_NONE,
+        &error);
+    g_assert_no_error(error);
+    crispy_script_set_telemetry_internal(script, log_path, NULL);
+
+    script_argv[0] = (gchar *)path;
+    script_argv[1] = NULL;
+    exit_code = crispy_script_execute(script, 1, script_argv, &error);
+    g_assert_no_error(error);
+
+    return exit_code;
+}
+
+/* helper: execute a fresh script for @path without forcing a compile */
+static gint
+execute_cached(
+    const gchar *path
+){
+    return execute_cached_logged(path, NULL);
+}
+
+/* test: CRISPY_PURE replays output and exit code until an input changes */
+static void
+test_script_pure(void)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *input = NULL;
+    g_autofree gchar *runs = NULL;
+    g_autofree gchar *out_path = NULL;
+    g_autofree gchar *source = NULL;
+    g_autofree gchar *output = NULL;
+    g_autofree gchar *counted = NULL;
+    g_autofree gchar *log_path = NULL;
+    g_autofree gchar *log = NULL;
+    g_auto(GStrv) lines = NULL;
+    gint saved_stdin;
+    gint saved_stdout;
+    gint null_fd;
+    gint out_fd;
+
+    input = write_temp_script("a\n");
+    runs = write_temp_script("");
+    log_path = write_temp_script("");
+
+    /* every real run appends to @runs and echoes @input */
+    source = g_strdup_printf(
+        "#include <glib.h>\n"
+        "#define CRISPY_PURE \"%s\"\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    gchar *text = NULL;\n"
+        "    gchar *count = NULL;\n"
+        "    gchar *more;\n"
+        "    g_file_get_contents(\"%s\", &text, NULL, NULL);\n"
+        "    g_file_get_contents(\"%s\", &count, NULL, NULL);\n"
+        "    more = g_strconcat(count, \"x\", NULL);\n"
+        "    g_file_set_contents(\"%s\", more, -1, NULL);\n"
+        "    g_print(\"%%s\", text);\n"
+        "    g_free(text); g_free(count); g_free(more);\n"
+        "    return 3;\n"
+        "}\n",
+        input, input, runs, runs);
+    path = write_temp_script(source);
+
+    /* stdin is part of the key: make it empty; collect stdout */
+    out_path = write_temp_script("");
+    null_fd = open("/dev/null", O_RDONLY);
+    out_fd = open(out_path, O_WRONLY | O_TRUNC);
+    g_assert_cmpint(null_fd, >=, 0);
+    g_assert_cmpint(out_fd, >=, 0);
+    fflush(stdout);
+    saved_stdin = dup(STDIN_FILENO);
+    saved_stdout = dup(STDOUT_FILENO);
+    dup2(null_fd, STDIN_FILENO);
+    dup2(out_fd, STDOUT_FILENO);
+
+    g_assert_cmpint(execute_cached_logged(path, log_path), ==, 3);
+    g_assert_cmpint(execute_cached_logged(path, log_path), ==, 3);
+    g_file_set_contents(input, "b\n", -1, NULL);
+    g_assert_cmpint(execute_cached_logged(path, log_path), ==, 3);
+
+    fflush(stdout);
+    dup2(saved_stdin, STDIN_FILENO);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(null_fd);
+    close(out_fd);
+
+    /* the second run was replayed: same output, no side effect */
+    g_assert_true(g_file_get_contents(out_path, &output, NULL, NULL));
+    g_assert_cmpstr(output, ==, "a\na\nb\n");
+    g_assert_true(g_file_get_contents(runs, &counted, NULL, NULL));
+    g_assert_cmpstr(counted, ==, "xx");
+
+    /* the replay is reported too, as a cache hit */
+    g_assert_true(g_file_get_contents(log_path, &log, NULL, NULL));
+    lines = g_strsplit(log, "\n", -1);
+    g_assert_cmpuint(g_strv_length(lines), ==, 4);
+    g_assert_nonnull(strstr(lines[0], "\"replayed\": false"));
+    g_assert_nonnull(strstr(lines[1],
+        "\"cache_hit\": true, \"replayed\": true, \"exit_code\": 3,"));
+    g_assert_nonnull(strstr(lines[2], "\"replayed\": false"));
+
+    g_unlink(path);
+    g_unlink(input);
+    g_unlink(runs);
+    g_unlink(out_path);
+    g_unlink(log_path);
+}
+
+/*
+ * helper: execute_cached() in a child process, since the init arena
+ * can only be mapped at its fixed address once per process
+ */
+static gint
+execute_cached_in_child(
+    const gchar *path
+){
+    gint status;
+    pid_t pid;
+
+    pid = fork();
+    g_assert_cmpint(pid, >=, 0);
+    if (pid == 0)
+        _exit(execute_cached(path));
+
+    g_assert_cmpint(waitpid(pid, &status, 0), ==, pid);
+    g_assert_true(WIFEXITED(status));
+
+    return WEXITSTATUS(status);
+}
+
+/* helper: like execute_cached_in_child(), with @n_runs runs in the child */
+static gint
+repeat_cached_in_child(
+    const gchar *path,
+    guint        n_runs
+){
+    gint status;
+    pid_t pid;
+
+    pid = fork();
+    g_assert_cmpint(pid, >=, 0);
+    if (pid == 0)
+    {
+        g_autoptr(CrispyScript) script = NULL;
+        g_autoptr(GArray) samples = NULL;
+        gchar *script_argv[2];
+        gint exit_code;
+
+        script = crispy_script_new_from_file(
+            path,
+            CRISPY_COMPILER(g_compiler),
+            CRISPY_CACHE_PROVIDER(g_cache),
+            CRISPY_FLAG_NONE,
+            NULL);
+        script_argv[0] = (gchar *)path;
+        script_argv[1] = NULL;
+        samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+        if (script == NULL ||
+            !crispy_script_prepare(script, 1, script_argv, NULL) ||
+            !crispy_bench_repeat(script, 1, script_argv, n_runs, FALSE,
+                                 samples, &exit_code, NULL))
+            _exit(255);
+        _exit(exit_code);
+    }
+
+    g_assert_cmpint(waitpid(pid, &status, 0), ==, pid);
+    g_assert_true(WIFEXITED(status));
+
+    return WEXITSTATUS(status);
+}
+
+/* test: crispy_init() runs once; later runs map its saved arena */
+static void
+test_script_init_snapshot(void)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *input = NULL;
+    g_autofree gchar *runs = NULL;
+    g_autofree gchar *source = NULL;
+    g_autofree gchar *counted = NULL;
+
+    input = write_temp_script("41");
+    runs = write_temp_script("");
+
+    /* every real crispy_init() appends to @runs; main() adds 1 */
+    source = g_strdup_printf(
+        "#include <crispy-runtime.h>\n"
+        "#include <stdlib.h>\n"
+        "#define CRISPY_INIT_INPUTS \"%s\"\n"
+        "typedef struct { gint value; gchar *name; } Index;\n"
+        "gpointer crispy_init(void){\n"
+        "    Index *index;\n"
+        "    gchar *text = NULL;\n"
+        "    gchar *count = NULL;\n"
+        "    gchar *more;\n"
+        "    g_file_get_contents(\"%s\", &text, NULL, NULL);\n"
+        "    g_file_get_contents(\"%s\", &count, NULL, NULL);\n"
+        "    more = g_strconcat(count, \"x\", NULL);\n"
+        "    g_file_set_contents(\"%s\", more, -1, NULL);\n"
+        "    index = crispy_arena_new_n(crispy_init_arena(), Index, 1);\n"
+        "    index->value = atoi(text);\n"
+        "    index->name = crispy_arena_strdup(crispy_init_arena(), \"idx\");\n"
+        "    g_free(text); g_free(count); g_free(more);\n"
+        "    return index;\n"
+        "}\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    Index *index = crispy_init_get_root();\n"
+        "    if (index == NULL || g_strcmp0(index->name, \"idx\") != 0)\n"
+        "        return 1;\n"
+        "    return index->value + 1;\n"
+        "}\n",
+        input, input, runs, runs);
+    path = write_temp_script(source);
+
+    g_assert_cmpint(execute_cached_in_child(path), ==, 42);
+    g_assert_cmpint(execute_cached_in_child(path), ==, 42);
+    g_file_set_contents(input, "9", -1, NULL);
+    g_assert_cmpint(execute_cached_in_child(path), ==, 10);
+    g_assert_cmpint(execute_cached_in_child(path), ==, 10);
+
+    /* only a changed input rebuilt the index */
+    g_assert_true(g_file_get_contents(runs, &counted, NULL, NULL));
+    g_assert_cmpstr(counted, ==, "xx");
+    g_clear_pointer(&counted, g_free);
+
+    /* in-process repeats reuse the first run's root, mapped or built */
+    g_assert_cmpint(repeat_cached_in_child(path, 3), ==, 10);
+    g_file_set_contents(input, "4", -1, NULL);
+    g_assert_cmpint(repeat_cached_in_child(path, 3), ==, 5);
+    g_assert_true(g_file_get_contents(runs, &counted, NULL, NULL));
+    g_assert_cmpstr(counted, ==, "xxx");
+
+    g_unlink(path);
+    g_unlink(input);
+    g_unlink(runs);
+}
+
+/* test: CRISPY_CPUS pins the script before it runs */
+static void
+test_script_placement(void)
+{
+    g_autofree gchar *status = NULL;
+    g_autofree gchar *source = NULL;
+    g_autofree gchar *path = NULL;
+    const gchar *allowed;
+    gint cpu;
+
+    /* first CPU this process may run on */
+    g_assert_true(g_file_get_contents("/proc/self/status", &status,
+                                      NULL, NULL));
+    allowed = strstr(status, "Cpus_allowed_list:");
+    g_assert_nonnull(allowed);
+    cpu = atoi(allowed + strlen("Cpus_allowed_list:"));
+
+    source = g_strdup_printf(
+        "#include <glib.h>\n"
+        "#include <string.h>\n"
+        "#define CRISPY_CPUS \"%d\"\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    gchar *status = NULL;\n"
+        "    gchar *expected;\n"
+        "    gint ok;\n"
+        "    g_file_get_contents(\"/proc/self/status\", &status, NULL, NULL);\n"
+        "    expected = g_strdup_printf(\"Cpus_allowed_list:\\t%%d\\n\", %d);\n"
+        "    ok = status != NULL && strstr(status, expected) != NULL;\n"
+        "    g_free(status); g_free(expected);\n"
+        "    return ok ? 7 : 1;\n"
+        "}\n",
+        cpu, cpu);
+    path = write_temp_script(source);
+
+    /* in a child, so the test process keeps its own affinity */
+    g_assert_cmpint(execute_cached_in_child(path), ==, 7);
+
+    g_unlink(path);
+}
+
+/* test: --repeat keeps module state in-process, not across forks */
+static void
+test_script_repeat(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    g_autoptr(GArray) samples = NULL;
+    g_autoptr(GArray) runs = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *json = NULL;
+    CrispyBenchStats stats;
+    CrispyBenchRunResult run;
+    gint64 times[] = { 50, 10, 40, 20, 30 };
+    gint exit_code;
+
+    path = write_temp_script(
+        "#include <glib.h>\n"
+        "static gint calls = 0;\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    return ++calls;\n"
+        "}\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE,
+        &error);
+    g_assert_no_error(error);
+    g_assert_true(crispy_script_prepare(script, 1, &path, &error));
+    g_assert_no_error(error);
+
+    /* every fork starts from the freshly loaded module */
+    samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+    g_assert_true(crispy_bench_repeat(script, 1, &path, 3, TRUE,
+                                      samples, &exit_code, &error));
+    g_assert_no_error(error);
+    g_assert_cmpuint(samples->len, ==, 3);
+    g_assert_cmpint(exit_code, ==, 1);
+
+    /* in-process runs share the counter */
+    g_assert_true(crispy_bench_repeat(script, 1, &path, 4, FALSE,
+                                      samples, &exit_code, &error));
+    g_assert_no_error(error);
+    g_assert_cmpuint(samples->len, ==, 7);
+    g_assert_cmpint(exit_code, ==, 4);
+
+    /* stats over known samples */
+    g_array_set_size(samples, 0);
+    g_array_append_vals(samples, times, G_N_ELEMENTS(times));
+    crispy_bench_compute_stats(samples, &stats);
+    g_assert_cmpuint(stats.n_runs, ==, 5);
+    g_assert_cmpfloat(stats.min, ==, 10.0);
+    g_assert_cmpfloat(stats.median, ==, 30.0);
+    g_assert_cmpfloat(stats.p95, ==, 50.0);
+    g_assert_cmpfloat(stats.mean, ==, 30.0);
+    g_assert_cmpfloat_with_epsilon(stats.stddev, 15.8114, 0.001);
+
+    /* --bench-json: one profile per line, times in microseconds */
+    run.name = "fast";
+    run.stats = stats;
+    run.exit_code = 4;
+    runs = g_array_new(FALSE, FALSE, sizeof(CrispyBenchRunResult));
+    g_array_append_val(runs, run);
+    json = crispy_bench_runs_to_json("repeat.c", FALSE, runs);
+    g_assert_nonnull(strstr(json,
+        "    {\"name\": \"fast\", \"runs\": 5, \"exit_code\": 4, "
+        "\"min_us\": 10.000, \"median_us\": 30.000, \"p95_us\": 50.000, "));
+
+    g_unlink(path);
+    g_free(path);
+    g_clear_object(&script);
+
+    /* a negative exit code is a sample, not a failed run */
+    path = write_temp_script(
+        "#include <glib.h>\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    return -1;\n"
+        "}\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE,
+        &error);
+    g_assert_no_error(error);
+    g_assert_true(crispy_script_prepare(script, 1, &path, &error));
+    g_assert_no_error(error);
+
+    g_array_set_size(samples, 0);
+    g_assert_true(crispy_bench_repeat(script, 1, &path, 2, FALSE,
+                                      samples, &exit_code, &error));
+    g_assert_no_error(error);
+    g_assert_cmpuint(samples->len, ==, 2);
+    g_assert_cmpint(exit_code, ==, -1);
+
+    g_unlink(path);
+}
+
+/* test: CRISPY_BENCHMARK() functions are found and measured without main() */
+static void
+test_script_bench(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    g_autoptr(GArray) results = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *json = NULL;
+    g_auto(GStrv) names = NULL;
+    CrispyBenchmarkFunc func;
+    CrispyBenchResult result;
+
+    path = write_temp_script(
+        "#include <crispy-runtime.h>\n"
+        "#if 0\n"
+        "CRISPY_BENCHMARK(disabled, n)\n"
+        "{\n"
+        "}\n"
+        "#endif\n"
+        "CRISPY_BENCHMARK(sum, n)\n"
+        "{\n"
+        "    guint64 i, total = 0;\n"
+        "    for (i = 0; i < n; i++)\n"
+        "        CRISPY_BENCH_KEEP(total += i);\n"
+        "}\n"
+        "/* CRISPY_BENCHMARK(commented, n) is not a benchmark */\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE,
+        &error);
+    g_assert_no_error(error);
+
+    names = crispy_bench_find_benchmarks(
+        crispy_script_get_source_internal(script));
+    g_assert_cmpuint(g_strv_length(names), ==, 2);
+    g_assert_cmpstr(names[0], ==, "disabled");
+    g_assert_cmpstr(names[1], ==, "sum");
+
+    /* no entry point: the compiled-out first name must not fail prepare */
+    crispy_script_set_entry_point_internal(script, NULL);
+    g_assert_true(crispy_script_prepare(script, 1, &path, &error));
+    g_assert_no_error(error);
+    g_assert_null(crispy_script_lookup_symbol_internal(
+        script, "crispy_benchmark_disabled"));
+    func = (CrispyBenchmarkFunc)crispy_script_lookup_symbol_internal(
+        script, "crispy_benchmark_sum");
+    g_assert_nonnull(func);
+
+    crispy_bench_measure(func, 3, &result);
+    result.name = names[1];
+    g_assert_cmpuint(result.stats.n_runs, ==, 3);
+    g_assert_cmpuint(result.iterations, >, 1);
+    g_assert_cmpfloat(result.stats.mean, >, 0.0);
+    g_assert_cmpfloat(result.ci_low, <=, result.stats.mean);
+    g_assert_cmpfloat(result.ci_high, >=, result.stats.mean);
+
+    results = g_array_new(FALSE, FALSE, sizeof(CrispyBenchResult));
+    g_array_append_val(results, result);
+    json = crispy_bench_results_to_json("bench.c", "0", results);
+    g_assert_true(g_str_has_prefix(json, "{\n  \"script\": \"bench.c\""));
+    g_assert_nonnull(strstr(json, "{\"name\": \"sum\", \"iterations\": "));
+
+    g_unlink(path);
+}
+
+/* test: pipeline stages may define the same global and helper names */
+static void
+test_script_pipeline_local_symbols(void)
+{
+    g_autoptr(GError) error = NULL;
+    CrispyScript *scripts[2];
+    gchar *paths[2];
+    gchar **argvs[2];
+    gint argcs[2];
+    guint i;
+
+    /* bound to the first stage's counter, the second would return 11 */
+    paths[0] = write_temp_script(
+        "#include <crispy-runtime.h>\n"
+        "gint counter = 1;\n"
+        "gint value(void){ return counter; }\n"
+        "gint crispy_stage_main(CrispyStage *stage, gint argc, gchar **argv){\n"
+        "    crispy_writer_write_int(crispy_stage_get_output(stage), value());\n"
+        "    crispy_writer_putc(crispy_stage_get_output(stage), '\\n');\n"
+        "    return 0;\n"
+        "}\n");
+    paths[1] = write_temp_script(
+        "#include <crispy-runtime.h>\n"
+        "#include <stdlib.h>\n"
+        "gint counter = 2;\n"
+        "gint value(void){ return counter; }\n"
+        "gint crispy_stage_main(CrispyStage *stage, gint argc, gchar **argv){\n"
+        "    gchar *line = crispy_stage_read_line(stage, NULL);\n"
+        "    return value() * 10 + (line != NULL ? atoi(line) : 0);\n"
+        "}\n");
+
+    for (i = 0; i < 2; i++)
+    {
+        scripts[i] = crispy_script_new_from_file(
+            paths[i],
+            CRISPY_COMPILER(g_compiler),
+            CRISPY_CACHE_PROVIDER(g_cache),
+            CRISPY_FLAG_FORCE_COMPILE,
+            &error);
+        g_assert_no_error(error);
+        argcs[i] = 1;
+        argvs[i] = &paths[i];
+    }
+
+    g_assert_cmpint(crispy_pipeline_execute(scripts, argcs, argvs, 2,
+                                            &error), ==, 21);
+    g_assert_no_error(error);
+
+    for (i = 0; i < 2; i++)
+    {
+        g_object_unref(scripts[i]);
+        g_unlink(paths[i]);
+        g_free(paths[i]);
+    }
+}
+
+/* test: every run is logged as a JSON line and counted in the metrics */
+static void
+test_script_telemetry(void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(CrispyScript) script = NULL;
+    g_autoptr(GString) escaped = NULL;
+    g_autoptr(GArray) costs = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *log_path = NULL;
+    g_autofree gchar *metrics_path = NULL;
+    g_autofree gchar *log = NULL;
+    g_autofree gchar *metrics = NULL;
+    g_autofree gchar *lock_path = NULL;
+    g_autofree gchar *line = NULL;
+    g_auto(GStrv) lines = NULL;
+    CrispyTelemetryRecord record;
+    CrispyPluginCost cost;
+
+    escaped = g_string_new(NULL);
+    crispy_telemetry_append_json_string(escaped, "a\"b\\c\n");
+    g_assert_cmpstr(escaped->str, ==, "\"a\\\"b\\\\c\\u000a\"");
+
+    /* plugin costs list only the hooks a plugin ran */
+    memset(&record, 0, sizeof(record));
+    memset(&cost, 0, sizeof(cost));
+    cost.name = "timing";
+    cost.calls[CRISPY_HOOK_POST_EXECUTE] = 2;
+    cost.wall_ns[CRISPY_HOOK_POST_EXECUTE] = 3000;
+    cost.cpu_ns[CRISPY_HOOK_POST_EXECUTE] = 1000;
+    costs = g_array_new(FALSE, TRUE, sizeof(CrispyPluginCost));
+    g_array_append_val(costs, cost);
+    record.plugin_costs = costs;
+    line = crispy_telemetry_format_line(&record);
+    g_assert_true(g_str_has_suffix(line,
+        ", \"plugin_costs\": [{\"name\": \"timing\", \"hooks\": "
+        "{\"post_execute\": {\"calls\": 2, \"wall_ns\": 3000, "
+        "\"cpu_ns\": 1000}}}]}\n"));
+
+    dir = g_dir_make_tmp("crispy-test-telemetry-XXXXXX", &error);
+    g_assert_no_error(error);
+    log_path = g_build_filename(dir, "runs.jsonl", NULL);
+    metrics_path = g_build_filename(dir, "crispy.prom", NULL);
+    lock_path = g_strconcat(metrics_path, ".lock", NULL);
+
+    path = write_temp_script(
+        "#include <glib.h>\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    return 3;\n"
+        "}\n");
+
+    script = crispy_script_new_from_file(
+        path,
+        CRISPY_COMPILER(g_compiler),
+        CRISPY_CACHE_PROVIDER(g_cache),
+        CRISPY_FLAG_FORCE_COMPILE,
+        &error);
+    g_assert_no_error(error);
+    crispy_script_set_telemetry_internal(script, log_path, metrics_path);
+
+    /* a compiled run, then a second run that skips the prepare phases */
+    g_assert_cmpint(crispy_script_execute(script, 1, &path, &error), ==, 3);
+    g_assert_no_error(error);
+    g_assert_cmpint(crispy_script_run(script, 1, &path, &error), ==, 3);
+    g_assert_no_error(error);
+
+    g_assert_true(g_file_get_contents(log_path, &log, NULL, NULL));
+    lines = g_strsplit(log, "\n", -1);
+    g_assert_cmpuint(g_strv_length(lines), ==, 3);
+    g_assert_cmpstr(lines[2], ==, "");
+    g_assert_true(g_str_has_prefix(lines[0], "{\"ts\": \""));
+    g_assert_nonnull(strstr(lines[0], "\"cache_hit\": false"));
+    g_assert_nonnull(strstr(lines[0], "\"exit_code\": 3"));
+    g_assert_nonnull(strstr(lines[1], "\"time_compile\": 0,"));
+    g_assert_nonnull(strstr(lines[1], "\"plugin_costs\": []"));
+    g_assert_true(g_str_has_suffix(lines[1], "}"));
+
+    g_assert_true(g_file_get_contents(metrics_path, &metrics, NULL, NULL));
+    g_assert_true(g_str_has_suffix(metrics, "# EOF\n"));
+    g_assert_nonnull(strstr(metrics,
+        "crispy_phase_seconds_count{phase=\"execute\"} 2\n"));
+    g_assert_nonnull(strstr(metrics,
+        "crispy_phase_seconds_count{phase=\"compile\"} 1\n"));
+    g_assert_nonnull(strstr(metrics,
+        "crispy_phase_seconds_bucket{phase=\"total\",le=\"+Inf\"} 2\n"));
+    g_assert_nonnull(strstr(metrics, "crispy_runs_total{cache=\"miss\"} 2\n"));
+    g_assert_nonnull(strstr(metrics, "crispy_failed_runs_total 2\n"));
+
+    g_unlink(log_path);
+    g_unlink(metrics_path);
+    g_unlink(lock_path);
+    g_rmdir(dir);
+    g_unlink(path);
+}
+
 gint
 main(
     gint    argc,
@@ -302,6 +1164,28 @@ main(
                     test_script_preserve_source);
     g_test_add_func("/script/arg-passing",
                     test_script_arg_passing);
+    g_test_add_func("/script/runtime-autolink",
+                    test_script_runtime_autolink);
+    g_test_add_func("/script/multiversion",
+                    test_script_multiversion);
+    g_test_add_func("/script/isolate",
+                    test_script_isolate);
+    g_test_add_func("/script/hot-swap",
+                    test_script_hot_swap);
+    g_test_add_func("/script/pure",
+                    test_script_pure);
+    g_test_add_func("/script/init-snapshot",
+                    test_script_init_snapshot);
+    g_test_add_func("/script/placement",
+                    test_script_placement);
+    g_test_add_func("/script/repeat",
+                    test_script_repeat);
+    g_test_add_func("/script/bench",
+                    test_script_bench);
+    g_test_add_func("/script/pipeline-local-symbols",
+                    test_script_pipeline_local_symbols);
+    g_test_add_func("/script/telemetry",
+                    test_script_telemetry);
 
     return g_test_run();
 }
@@ -0,0 +1,214 @@
+/* test-watch.c - Tests for --watch include tracking and reruns */
+
+#define CRISPY_COMPILATION
+#include "../src/crispy.h"
+#include "../src/core/crispy-source-utils-private.h"
+#include "../src/core/crispy-watch-private.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* helper: write @contents to @dir/@name */
+static gchar *
+write_file(
+    const gchar *dir,
+    const gchar *name,
+    const gchar *contents
+){
+    gchar *path;
+
+    path = g_build_filename(dir, name, NULL);
+    g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+
+    return path;
+}
+
+/* helper: wait up to a minute for @path to hold exactly @expected */
+static gboolean
+wait_for_contents(
+    const gchar *path,
+    const gchar *expected
+){
+    guint i;
+
+    for (i = 0; i < 600; i++)
+    {
+        g_autofree gchar *contents = NULL;
+
+        if (g_file_get_contents(path, &contents, NULL, NULL) &&
+            g_strcmp0(contents, expected) == 0)
+            return TRUE;
+        g_usleep(100 * 1000);
+    }
+
+    return FALSE;
+}
+
+/* test: only quoted includes are collected, in order */
+static void
+test_watch_find_local_includes(void)
+{
+    g_auto(GStrv) names = NULL;
+
+    names = crispy_source_find_local_includes(
+        "#include <stdio.h>\n"
+        "#include \"a.h\"\n"
+        "  #  include \"sub/b.h\"\n"
+        "#include \"\"\n"
+        "#define X \"not.h\"\n"
+        "int main(void){ return 0; }\n"
+        "#include\t\"last.h\"");
+    g_assert_cmpuint(g_strv_length(names), ==, 3);
+    g_assert_cmpstr(names[0], ==, "a.h");
+    g_assert_cmpstr(names[1], ==, "sub/b.h");
+    g_assert_cmpstr(names[2], ==, "last.h");
+
+    g_strfreev(names);
+    names = crispy_source_find_local_includes(NULL);
+    g_assert_cmpuint(g_strv_length(names), ==, 0);
+}
+
+/* test: nested includes are followed, cycles end, the rest is skipped */
+static void
+test_watch_collect_dependencies(void)
+{
+    g_autoptr(GHashTable) deps = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *sub = NULL;
+    g_autofree gchar *main_path = NULL;
+    g_autofree gchar *a_path = NULL;
+    g_autofree gchar *b_path = NULL;
+    g_autofree gchar *c_path = NULL;
+    g_autofree gchar *stdio_path = NULL;
+    g_autofree gchar *missing_path = NULL;
+
+    dir = g_dir_make_tmp("crispy-test-watch-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    sub = g_build_filename(dir, "sub", NULL);
+    g_assert_cmpint(g_mkdir(sub, 0700), ==, 0);
+
+    /* a.h and sub/b.h include each other; <stdio.h> must not match */
+    main_path = write_file(dir, "main.c",
+                           "#include <stdio.h>\n"
+                           "#include \"a.h\"\n"
+                           "#include \"missing.h\"\n"
+                           "int main(void){ return 0; }\n");
+    a_path = write_file(dir, "a.h", "#include \"sub/b.h\"\n");
+    b_path = write_file(dir, "sub/b.h",
+                        "#include \"../a.h\"\n"
+                        "#include \"c.h\"\n");
+    c_path = write_file(dir, "sub/c.h", "#define C 1\n");
+    stdio_path = write_file(dir, "stdio.h", "#error wrong stdio.h\n");
+    missing_path = g_build_filename(dir, "missing.h", NULL);
+
+    deps = crispy_watch_collect_dependencies(main_path);
+    g_assert_cmpuint(g_hash_table_size(deps), ==, 4);
+    g_assert_true(g_hash_table_contains(deps, main_path));
+    g_assert_true(g_hash_table_contains(deps, a_path));
+    g_assert_true(g_hash_table_contains(deps, b_path));
+    g_assert_true(g_hash_table_contains(deps, c_path));
+    g_assert_false(g_hash_table_contains(deps, stdio_path));
+    g_assert_false(g_hash_table_contains(deps, missing_path));
+
+    g_unlink(main_path);
+    g_unlink(a_path);
+    g_unlink(b_path);
+    g_unlink(c_path);
+    g_unlink(stdio_path);
+    g_rmdir(sub);
+    g_rmdir(dir);
+}
+
+/* test: editing an included header reruns the script */
+static void
+test_watch_rerun_on_header_edit(void)
+{
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *script_path = NULL;
+    g_autofree gchar *header_path = NULL;
+    g_autofree gchar *out_path = NULL;
+    gchar *script_argv[3];
+    gint status;
+    pid_t pid;
+
+    dir = g_dir_make_tmp("crispy-test-watch-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    out_path = write_file(dir, "out.txt", "");
+    header_path = write_file(dir, "value.h", "#define VALUE \"1\"\n");
+
+    /* every run appends VALUE to the file named by argv[1] */
+    script_path = write_file(dir, "script.c",
+        "#include <glib.h>\n"
+        "#include <stdio.h>\n"
+        "#include \"value.h\"\n"
+        "gint main(gint argc, gchar **argv){\n"
+        "    FILE *out = fopen(argv[1], \"a\");\n"
+        "    fputs(VALUE, out);\n"
+        "    fclose(out);\n"
+        "    return 0;\n"
+        "}\n");
+
+    /* crispy_watch_run() never returns, so the watcher gets a process */
+    pid = fork();
+    g_assert_cmpint(pid, >=, 0);
+    if (pid == 0)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(CrispyGccCompiler) compiler = NULL;
+        g_autoptr(CrispyFileCache) cache = NULL;
+        g_autoptr(CrispyScript) script = NULL;
+
+        compiler = crispy_gcc_compiler_new(&error);
+        cache = crispy_file_cache_new();
+        if (compiler != NULL)
+            script = crispy_script_new_from_file(
+                script_path,
+                CRISPY_COMPILER(compiler),
+                CRISPY_CACHE_PROVIDER(cache),
+                CRISPY_FLAG_FORCE_COMPILE,
+                &error);
+
+        script_argv[0] = script_path;
+        script_argv[1] = out_path;
+        script_argv[2] = NULL;
+        if (script != NULL)
+            crispy_watch_run(script, 2, script_argv, &error);
+        _exit(1);
+    }
+
+    /* the first run has the monitors in place */
+    g_assert_true(wait_for_contents(out_path, "1"));
+
+    g_assert_true(g_file_set_contents(header_path, "#define VALUE \"2\"\n",
+                                      -1, NULL));
+    g_assert_true(wait_for_contents(out_path, "12"));
+
+    kill(pid, SIGTERM);
+    g_assert_cmpint(waitpid(pid, &status, 0), ==, pid);
+
+    g_unlink(script_path);
+    g_unlink(header_path);
+    g_unlink(out_path);
+    g_rmdir(dir);
+}
+
+gint
+main(
+    gint    argc,
+    gchar **argv
+){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/watch/find-local-includes",
+                    test_watch_find_local_includes);
+    g_test_add_func("/watch/collect-dependencies",
+                    test_watch_collect_dependencies);
+    g_test_add_func("/watch/rerun-on-header-edit",
+                    test_watch_rerun_on_header_edit);
+
+    return g_test_run();
+}